@@ -17,6 +17,11 @@
 #include "paddle/fluid/framework/fleet/box_wrapper.h"
 #include "paddle/fluid/framework/trainer.h"
 #include "paddle/fluid/framework/trainer_desc.pb.h"
+#include "paddle/fluid/platform/cpu_info.h"
+#ifdef PADDLE_WITH_CUDA
+#include "paddle/fluid/platform/gpu_info.h"
+#endif
+#include "paddle/fluid/platform/metrics.h"
 DECLARE_bool(enable_binding_train_cpu);
 namespace paddle {
 namespace framework {
@@ -28,6 +33,7 @@ void BoxPSTrainer::Initialize(const TrainerDesc& trainer_desc,
 
   SetDataset(dataset);
   ParseDumpConfig(trainer_desc);
+  platform::StartMetricsWriterFromFlags();
   // get filelist from trainer_desc here
   const std::vector<paddle::framework::DataFeed*> readers =
       dataset->GetReaders();
@@ -36,7 +42,7 @@ void BoxPSTrainer::Initialize(const TrainerDesc& trainer_desc,
   param_config_ = trainer_desc.boxps_param();
   async_mode_ = param_config_.async_mode();
   if (async_mode_) {
-    dense_table_.reset(new BoxPSAsynDenseTable(thread_num_));
+    dense_table_.reset(new BoxPSAsynDenseTable(thread_num_, param_config_));
     VLOG(3) << "async mode ";
   }
   dump_thread_num_ = param_config_.dump_thread_num();
@@ -104,6 +110,10 @@ void BoxPSTrainer::InitDumpEnv() {
     dump_thread_.push_back(
         std::thread(std::bind(&TrainerBase::DumpWork, this, i)));
   }
+  InitDumpFieldFormatEnv();
+  for (int i = 0; i < thread_num_; ++i) {
+    workers_[i]->SetDumpFieldBatchChannel(field_queue_.get());
+  }
   VLOG(0) << "init dump write file thread num=" << dump_thread_num_;
 }
 
@@ -169,6 +179,26 @@ GetThreadPool(int thread_num) {
     return thread_pools;
   }
   std::vector<int>& train_cores = boxps::get_train_cores();
+#ifdef PADDLE_WITH_CUDA
+  if (SlotRecordPool().node_num() > 1) {
+    // the pack of a gpu reads the records and the host buffers on its node
+    int device_num = platform::GetCUDADeviceCount();
+    for (int i = 0; i < thread_num && i < device_num; ++i) {
+      int node = platform::GetCUDANumaNode(i);
+      std::vector<int> ncores;
+      for (int core : train_cores) {
+        if (platform::CpuNumaNode(core) == node) {
+          ncores.push_back(core);
+        }
+      }
+      if (ncores.empty()) {
+        ncores = platform::NumaNodeCpus(node);
+      }
+      thread_pools[i]->SetCPUAffinity(ncores, false);
+    }
+    return thread_pools;
+  }
+#endif
   if (train_cores.size() < static_cast<size_t>(thread_num)) {
     return thread_pools;
   }
@@ -18,22 +18,32 @@ limitations under the License. */
 
 #include "paddle/fluid/framework/device_worker.h"
 #include "paddle/fluid/framework/fleet/box_wrapper.h"
+#include "paddle/fluid/framework/op_instruction_list.h"
 #include "paddle/fluid/framework/tensor_util.h"
 #include "paddle/fluid/framework/trainer_desc.pb.h"
 #include "paddle/fluid/platform/cpu_helper.h"
+#include "paddle/fluid/platform/cpu_info.h"
 #include "paddle/fluid/platform/device_context.h"
 #include "paddle/fluid/platform/gpu_info.h"
+#include "paddle/fluid/platform/hot_path_trace.h"
+#include "paddle/fluid/platform/metrics.h"
 #include "paddle/fluid/platform/lodtensor_printer.h"
 
 #include "paddle/fluid/platform/collective_helper.h"
 #include "paddle/fluid/platform/nccl_helper.h"
 
 DECLARE_bool(enable_sync_dense_moment);
+DECLARE_bool(enable_op_instruction_list);
 namespace paddle {
 namespace framework {
 
-BoxPSAsynDenseTable::BoxPSAsynDenseTable(const int device_num)
-    : device_num_(device_num) {
+BoxPSAsynDenseTable::BoxPSAsynDenseTable(const int device_num,
+                                         const BoxPSWorkerParameter& param)
+    : device_num_(device_num),
+      beta1_(param.async_beta1()),
+      beta2_(param.async_beta2()),
+      epsilon_(param.async_epsilon()),
+      update_thread_num_(std::max(param.async_update_thread_num(), 1)) {
   device_grads_.resize(device_num);
 }
 BoxPSAsynDenseTable::~BoxPSAsynDenseTable() {}
@@ -87,8 +97,17 @@ void BoxPSAsynDenseTable::Init(
       }
     }
   }
-  VLOG(0) << "base lr is " << base_lr_;
+  VLOG(0) << "base lr is " << base_lr_ << ", beta1: " << beta1_
+          << ", beta2: " << beta2_ << ", epsilon: " << epsilon_
+          << ", update thread num: " << update_thread_num_;
   ps_buffer_.reset(new PSBufferQueue(8 * 3));  // magic number
+  if (update_thread_num_ > 1) {
+    update_pool_.reset(new ThreadPool(update_thread_num_));
+  }
+  update_num_ = 0;
+  merge_total_ = 0;
+  max_queue_depth_ = 0;
+  update_timer_.Reset();
 
   update_thread_ = new std::thread(&BoxPSAsynDenseTable::AsyncUpdate, this);
 }
@@ -99,6 +118,11 @@ void BoxPSAsynDenseTable::Finalize(void) {
   }
   ps_buffer_->Close();
   update_thread_->join();
+  update_pool_ = nullptr;
+  VLOG(0) << "async dense update num: " << update_num_ << ", avg merge: "
+          << (update_num_ > 0 ? 1.0 * merge_total_ / update_num_ : 0)
+          << ", max queue depth: " << max_queue_depth_
+          << ", update span: " << update_timer_.ElapsedSec();
 
   for (size_t i = 0; i < async_param_list_.size(); ++i) {
     VLOG(0) << "begin to copy back" << async_param_list_[i];
@@ -113,6 +137,68 @@ void BoxPSAsynDenseTable::Finalize(void) {
   update_thread_ = nullptr;
 }
 
+// Fused grad merge and adam of the async dense table, the param, moments
+// and grads are read once per element.
+void AsyncAdamKernel(const float* const* grads, size_t merge_num, size_t len,
+                     float lr, float beta1, float beta2, float epsilon,
+                     float* param, float* mom1, float* mom2) {
+  const float scale = 1.0f / merge_num;
+  size_t j = 0;
+#ifdef __AVX__
+  constexpr size_t block = 8;  // floats in a ymm register
+  const __m256 v_scale = _mm256_set1_ps(scale);
+  const __m256 v_beta1 = _mm256_set1_ps(beta1);
+  const __m256 v_beta1_rest = _mm256_set1_ps(1.0f - beta1);
+  const __m256 v_beta2 = _mm256_set1_ps(beta2);
+  const __m256 v_beta2_rest = _mm256_set1_ps(1.0f - beta2);
+  const __m256 v_epsilon = _mm256_set1_ps(epsilon);
+  const __m256 v_lr = _mm256_set1_ps(lr);
+  for (; j + block <= len; j += block) {
+    __m256 g = _mm256_loadu_ps(grads[0] + j);
+    for (size_t k = 1; k < merge_num; ++k) {
+      g = _mm256_add_ps(g, _mm256_loadu_ps(grads[k] + j));
+    }
+    g = _mm256_mul_ps(g, v_scale);
+    __m256 m1 = _mm256_add_ps(_mm256_mul_ps(v_beta1, _mm256_loadu_ps(mom1 + j)),
+                              _mm256_mul_ps(v_beta1_rest, g));
+    __m256 m2 = _mm256_add_ps(
+        _mm256_mul_ps(v_beta2, _mm256_loadu_ps(mom2 + j)),
+        _mm256_mul_ps(v_beta2_rest, _mm256_mul_ps(g, g)));
+    __m256 delta = _mm256_div_ps(
+        m1, _mm256_add_ps(_mm256_sqrt_ps(m2), v_epsilon));
+    _mm256_storeu_ps(mom1 + j, m1);
+    _mm256_storeu_ps(mom2 + j, m2);
+    _mm256_storeu_ps(
+        param + j,
+        _mm256_sub_ps(_mm256_loadu_ps(param + j), _mm256_mul_ps(v_lr, delta)));
+  }
+#endif
+  for (; j < len; ++j) {
+    float g = grads[0][j];
+    for (size_t k = 1; k < merge_num; ++k) {
+      g += grads[k][j];
+    }
+    g *= scale;
+    mom1[j] = beta1 * mom1[j] + (1.0f - beta1) * g;
+    mom2[j] = beta2 * mom2[j] + (1.0f - beta2) * g * g;
+    param[j] -= lr * (mom1[j] / (std::sqrt(mom2[j]) + epsilon));
+  }
+}
+
+void BoxPSAsynDenseTable::AdamUpdate(
+    const std::vector<std::vector<LoDTensor>*>& grads, size_t merge_num,
+    size_t param_idx, size_t begin, size_t end, float learning_rate) {
+  const float* grad_data[4];  // max package
+  for (size_t k = 0; k < merge_num; ++k) {
+    grad_data[k] = (*grads[k])[param_idx].data<float>() + begin;
+  }
+  float* param_data = ps_[param_idx * 3].data<float>() + begin;
+  float* mom1_data = ps_[param_idx * 3 + 1].data<float>() + begin;
+  float* mom2_data = ps_[param_idx * 3 + 2].data<float>() + begin;
+  AsyncAdamKernel(grad_data, merge_num, end - begin, learning_rate, beta1_,
+                  beta2_, epsilon_, param_data, mom1_data, mom2_data);
+}
+
 void BoxPSAsynDenseTable::AsyncUpdate() {
   VLOG(0) << "Begin AsyncUpdate";
   std::vector<std::vector<LoDTensor>*> grad(4, nullptr);  // max package
@@ -120,62 +206,59 @@ void BoxPSAsynDenseTable::AsyncUpdate() {
   auto box_ptr = BoxWrapper::GetInstance();
   std::map<std::string, float> lr_map = box_ptr->GetLRMap();
 
-  while (ps_buffer_->Receive(&grad[0])) {
-    size_t merge_num = ps_buffer_->Size() + 1;
-    if (merge_num > 4) {
-      merge_num = 4;
+  // every param is split into blocks, the blocks of all params are spread
+  // over the update threads
+  const size_t kBlockSize = 64 * 1024;
+  const size_t param_num = async_param_list_.size() / 3;
+  std::vector<float> learning_rates(param_num, base_lr_);
+  std::vector<std::pair<size_t, size_t>> blocks;  // (param, begin)
+  for (size_t i = 0; i < param_num; ++i) {
+    auto it = lr_map.find(async_param_list_[i * 3]);
+    if (it != lr_map.end()) {
+      learning_rates[i] = it->second;
+    }
+    for (size_t begin = 0; begin < async_param_size_[i * 3];
+         begin += kBlockSize) {
+      blocks.emplace_back(i, begin);
     }
+  }
+
+  while (ps_buffer_->Receive(&grad[0])) {
+    size_t queue_depth = ps_buffer_->Size() + 1;
+    size_t merge_num = std::min<size_t>(queue_depth, grad.size());
     for (size_t i = 1; i < merge_num; ++i) {
       ps_buffer_->Receive(&grad[i]);
     }
+    update_timer_.Resume();
     AutoWRLock ps_lock(&ps_lock_);
-    // VLOG(0) << "AsyncUpdate recevie grads, and begin to update param, merge "
-    // << merge_num;
-    for (size_t i = 0; i < async_param_list_.size() / 3; ++i) {
-      LoDTensor* param_tensor = &ps_[i * 3];
-      LoDTensor* mom1_tensor = &ps_[i * 3 + 1];
-      LoDTensor* mom2_tensor = &ps_[i * 3 + 2];
-      LoDTensor* grad_tensor = &(*grad[0])[i];
-      auto len = async_param_size_[i * 3];
-      float* grad_data = grad_tensor->mutable_data<float>(platform::CPUPlace());
-      float* param_data =
-          param_tensor->mutable_data<float>(platform::CPUPlace());
-      float* mom1_data = mom1_tensor->mutable_data<float>(platform::CPUPlace());
-      float* mom2_data = mom2_tensor->mutable_data<float>(platform::CPUPlace());
-
-      // merge grad
-      for (size_t k = 1; k < merge_num; ++k) {
-        LoDTensor* other_grad_tensor = &(*grad[k])[i];
-        float* other_grad_data =
-            other_grad_tensor->mutable_data<float>(platform::CPUPlace());
-        for (size_t j = 0; j < len; ++j) {
-          grad_data[j] += other_grad_data[j];
-        }
+    auto update_blocks = [&](size_t tid, size_t thread_num) {
+      for (size_t b = tid; b < blocks.size(); b += thread_num) {
+        size_t i = blocks[b].first;
+        size_t begin = blocks[b].second;
+        size_t end = std::min(begin + kBlockSize, async_param_size_[i * 3]);
+        AdamUpdate(grad, merge_num, i, begin, end, learning_rates[i]);
       }
-      if (merge_num > 1) {
-        for (size_t j = 0; j < len; ++j) {
-          grad_data[j] /= merge_num;
-        }
-      }
-      // float tmp = param_data[0];
-      float learning_rate = base_lr_;
-      if (lr_map.find(async_param_list_[i * 3]) != lr_map.end()) {
-        learning_rate = lr_map[async_param_list_[i * 3]];
+    };
+    if (update_pool_ == nullptr || blocks.size() < 2) {
+      update_blocks(0, 1);
+    } else {
+      size_t thread_num =
+          std::min<size_t>(update_thread_num_, blocks.size());
+      std::vector<std::future<void>> wait_futures;
+      for (size_t tid = 0; tid < thread_num; ++tid) {
+        wait_futures.emplace_back(update_pool_->Run(
+            [&update_blocks, tid, thread_num]() {
+              update_blocks(tid, thread_num);
+            }));
       }
-      // VLOG(0) << "learning rate for " << async_param_list_[i * 3] << " is "
-      // << learning_rate;
-      for (size_t j = 0; j < len; ++j) {
-        mom1_data[j] = 0.99 * mom1_data[j] +
-                       0.01 * grad_data[j];  // magic beta and episilon
-        mom2_data[j] =
-            0.9999 * mom2_data[j] + 0.0001 * grad_data[j] * grad_data[j];
-        param_data[j] -=
-            learning_rate * (mom1_data[j] / (sqrt(mom2_data[j]) + 1e-8));
+      for (auto& f : wait_futures) {
+        f.get();
       }
-      // VLOG(0) << "update dense for " << async_param_list_[i*3] << ", param["
-      // << tmp << "] - 0.000005 * [" << mom1_data[0] << "] / [" << mom1_data[1]
-      // << "] = [" << param_data[0]  << "]";
     }
+    update_timer_.Pause();
+    ++update_num_;
+    merge_total_ += merge_num;
+    max_queue_depth_ = std::max(max_queue_depth_, queue_depth);
   }
   VLOG(0) << "Quit AsyncUpdate";
 }
@@ -233,7 +316,10 @@ void BoxPSAsynDenseTable::PushDense(const platform::Place& place,
     TensorCopy(*static_cast<const Tensor*>(tensor), platform::CPUPlace(),
                static_cast<Tensor*>(&grad[i / 3]));
   }
+  auto box_ptr = BoxWrapper::GetInstance();
+  box_ptr->AsyncDenseTimer(device_id, false, ps_buffer_->Size());
   ps_buffer_->Send(&grad);
+  box_ptr->AsyncDenseTimer(device_id, true);
 }
 
 static const int DenseKStepNode = 1;
@@ -406,6 +492,9 @@ int BoxPSWorker::PackBatchTask(void) {
  * @brief add auc monitor
  */
 inline void AddAucMonitor(const Scope* scope, const platform::Place& place) {
+  static auto* latency = platform::MetricsRegistry::Instance().GetHistogram(
+      "padbox_auc_add_latency_ms", "the milliseconds to add a batch to auc");
+  platform::ScopedLatency scoped_latency(latency);
   auto box_ptr = BoxWrapper::GetInstance();
   auto& metric_list = box_ptr->GetMetricList();
   for (auto iter = metric_list.begin(); iter != metric_list.end(); iter++) {
@@ -429,15 +518,38 @@ void BoxPSWorker::TrainFiles() {
   }
   int step = 0;
   platform::SetDeviceId(device_id_);
+  std::unique_ptr<OpInstructionList> instructions;
+  if (FLAGS_enable_op_instruction_list) {
+    std::vector<OperatorBase*> ops;
+    for (auto& op : ops_) {
+      ops.push_back(op.get());
+    }
+    instructions.reset(new OpInstructionList(ops));
+  }
+  auto& registry = platform::MetricsRegistry::Instance();
+  auto* batches = registry.GetCounter("padbox_train_batches_total",
+                                      "the batches trained");
+  auto* instances = registry.GetCounter("padbox_train_instances_total",
+                                        "the instances trained");
+  auto* step_latency = registry.GetHistogram(
+      "padbox_train_step_latency_ms", "the milliseconds of a train step");
   while ((batch_size = PackBatchTask()) > 0) {
+    platform::TraceScope trace(platform::TraceEvent::kTrainStep, batch_size);
+    platform::ScopedLatency scoped_latency(step_latency);
+    batches->Increase();
+    instances->Increase(batch_size);
     VLOG(2) << "[" << device_id_
             << "]begin running ops, batch size:" << batch_size
             << ", batch id=" << step;
     if (dense_table_) {
       dense_table_->PullDense(place_, *thread_scope_);
     }
-    for (auto& op : ops_) {
-      op->Run(*thread_scope_, place_);
+    if (instructions) {
+      instructions->Run(*thread_scope_, place_);
+    } else {
+      for (auto& op : ops_) {
+        op->Run(*thread_scope_, place_);
+      }
     }
     if (dense_table_) {
       dense_table_->PushDense(place_, *thread_scope_);
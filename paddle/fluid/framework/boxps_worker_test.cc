@@ -0,0 +1,83 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/framework/device_worker.h"
+
+namespace paddle {
+namespace framework {
+
+#ifdef PADDLE_WITH_BOX_PS
+// Several steps of AsyncAdamKernel against the adam of the async dense
+// table in double, which has no bias correction. 37 floats cover the
+// vectorized blocks and the tail.
+static void CheckAsyncAdam(size_t merge_num) {
+  const size_t len = 37;
+  const int step_num = 5;
+  const float lr = 0.01f;
+  const float beta1 = 0.9f;
+  const float beta2 = 0.999f;
+  const float epsilon = 1e-6f;
+
+  std::vector<float> param(len);
+  std::vector<float> mom1(len, 0.0f);
+  std::vector<float> mom2(len, 0.0f);
+  for (size_t j = 0; j < len; ++j) {
+    param[j] = 0.1f * j - 1.0f;
+  }
+  std::vector<double> expect_param(param.begin(), param.end());
+  std::vector<double> expect_mom1(len, 0.0);
+  std::vector<double> expect_mom2(len, 0.0);
+  std::vector<std::vector<float>> grads(merge_num, std::vector<float>(len));
+  std::vector<const float*> grad_data(merge_num);
+  for (int step = 0; step < step_num; ++step) {
+    for (size_t k = 0; k < merge_num; ++k) {
+      for (size_t j = 0; j < len; ++j) {
+        grads[k][j] = std::sin(0.3f * j + step + k) * (k + 1);
+      }
+      grad_data[k] = grads[k].data();
+    }
+    AsyncAdamKernel(grad_data.data(), merge_num, len, lr, beta1, beta2,
+                    epsilon, param.data(), mom1.data(), mom2.data());
+
+    for (size_t j = 0; j < len; ++j) {
+      double g = 0;
+      for (size_t k = 0; k < merge_num; ++k) {
+        g += grads[k][j];
+      }
+      g /= merge_num;
+      expect_mom1[j] = beta1 * expect_mom1[j] + (1 - beta1) * g;
+      expect_mom2[j] = beta2 * expect_mom2[j] + (1 - beta2) * g * g;
+      expect_param[j] -=
+          lr * expect_mom1[j] / (std::sqrt(expect_mom2[j]) + epsilon);
+    }
+
+    for (size_t j = 0; j < len; ++j) {
+      ASSERT_NEAR(mom1[j], expect_mom1[j], 1e-5) << step << " " << j;
+      ASSERT_NEAR(mom2[j], expect_mom2[j], 1e-5) << step << " " << j;
+      ASSERT_NEAR(param[j], expect_param[j], 1e-4) << step << " " << j;
+    }
+  }
+}
+
+TEST(AsyncAdamKernel, single_grad) { CheckAsyncAdam(1); }
+
+TEST(AsyncAdamKernel, merged_grads) { CheckAsyncAdam(3); }
+#endif
+
+}  // namespace framework
+}  // namespace paddle
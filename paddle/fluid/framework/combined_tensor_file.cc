@@ -0,0 +1,514 @@
+/* Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/framework/combined_tensor_file.h"
+
+#include <xxhash.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+
+#include "paddle/fluid/framework/data_type.h"
+
+namespace paddle {
+namespace framework {
+
+namespace {
+
+constexpr uint64_t kMagic = 0x4E49424D4F434450ULL;  // PDCOMBIN
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kFlagChecksum = 1;
+// the payloads are written, read and hashed in chunks of kChunkBytes
+constexpr uint64_t kChunkBytes = 16UL << 20;
+
+struct Header {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t flags;
+  uint64_t tensor_num;
+  uint64_t index_bytes;
+  uint64_t file_bytes;
+};
+
+uint64_t AlignUp(uint64_t value) {
+  return (value + kCombinedFileAlignment - 1) / kCombinedFileAlignment *
+         kCombinedFileAlignment;
+}
+
+class IndexWriter {
+ public:
+  template <typename T>
+  void Write(const T& value) {
+    buffer_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  void Write(const std::string& str) {
+    Write(static_cast<uint32_t>(str.size()));
+    buffer_.append(str);
+  }
+
+  const std::string& buffer() const { return buffer_; }
+
+ private:
+  std::string buffer_;
+};
+
+class IndexReader {
+ public:
+  IndexReader(const char* pos, const char* end) : pos_(pos), end_(end) {}
+
+  template <typename T>
+  T Read() {
+    T value;
+    Read(&value, sizeof(T));
+    return value;
+  }
+
+  std::string ReadString() {
+    std::string str(ReadCount<uint32_t>(1), '\0');
+    Read(&str[0], str.size());
+    return str;
+  }
+
+  // read the number of the following elements of elem_bytes each, it is
+  // checked before any memory is reserved for them
+  template <typename T>
+  size_t ReadCount(size_t elem_bytes) {
+    uint64_t count = Read<T>();
+    PADDLE_ENFORCE_LE(
+        count, static_cast<size_t>(end_ - pos_) / elem_bytes,
+        platform::errors::Unavailable(
+            "The index of the combined file is truncated, please check "
+            "whether the model file is complete or damaged."));
+    return count;
+  }
+
+ private:
+  void Read(void* value, size_t size) {
+    PADDLE_ENFORCE_LE(
+        size, static_cast<size_t>(end_ - pos_),
+        platform::errors::Unavailable(
+            "The index of the combined file is truncated, please check "
+            "whether the model file is complete or damaged."));
+    memcpy(value, pos_, size);
+    pos_ += size;
+  }
+
+  const char* pos_;
+  const char* end_;
+};
+
+void WriteIndex(const std::vector<CombinedTensorInfo>& infos,
+                IndexWriter* writer) {
+  for (auto& info : infos) {
+    writer->Write(info.name);
+    writer->Write(static_cast<int32_t>(info.type));
+    writer->Write(static_cast<uint32_t>(info.dims.size()));
+    for (auto dim : info.dims) {
+      writer->Write(dim);
+    }
+    writer->Write(static_cast<uint32_t>(info.lod.size()));
+    for (auto& level : info.lod) {
+      writer->Write(static_cast<uint64_t>(level.size()));
+      for (auto offset : level) {
+        writer->Write(static_cast<uint64_t>(offset));
+      }
+    }
+    writer->Write(info.offset);
+    writer->Write(info.bytes);
+    writer->Write(info.checksum);
+  }
+}
+
+std::vector<CombinedTensorInfo> ParseIndex(const char* data, size_t size,
+                                           uint64_t file_bytes) {
+  PADDLE_ENFORCE_EQ(IsAlignedCombinedFile(data, size), true,
+                    platform::errors::InvalidArgument(
+                        "The file is not an aligned combined file."));
+  Header header;
+  memcpy(&header, data, sizeof(Header));
+  PADDLE_ENFORCE_EQ(header.version, kVersion,
+                    platform::errors::InvalidArgument(
+                        "The combined file version %u is not supported, "
+                        "only version %u is supported.",
+                        header.version, kVersion));
+  PADDLE_ENFORCE_LE(
+      header.file_bytes, file_bytes,
+      platform::errors::Unavailable(
+          "The combined file is truncated, %lu bytes expected but %lu "
+          "found, please check whether the model file is complete.",
+          header.file_bytes, file_bytes));
+  PADDLE_ENFORCE_EQ(header.index_bytes <= size - sizeof(Header) &&
+                        header.tensor_num <= header.index_bytes,
+                    true,
+                    platform::errors::Unavailable(
+                        "The index of the combined file is truncated."));
+
+  IndexReader reader(data + sizeof(Header),
+                     data + sizeof(Header) + header.index_bytes);
+  std::vector<CombinedTensorInfo> infos(header.tensor_num);
+  for (auto& info : infos) {
+    info.name = reader.ReadString();
+    info.type = static_cast<proto::VarType::Type>(reader.Read<int32_t>());
+    info.dims.resize(reader.ReadCount<uint32_t>(sizeof(int64_t)));
+    for (auto& dim : info.dims) {
+      dim = reader.Read<int64_t>();
+    }
+    info.lod.resize(reader.ReadCount<uint32_t>(sizeof(uint64_t)));
+    for (auto& level : info.lod) {
+      level.resize(reader.ReadCount<uint64_t>(sizeof(uint64_t)));
+      for (size_t i = 0; i < level.size(); ++i) {
+        level[i] = reader.Read<uint64_t>();
+      }
+    }
+    info.offset = reader.Read<uint64_t>();
+    info.bytes = reader.Read<uint64_t>();
+    info.has_checksum = header.flags & kFlagChecksum;
+    info.checksum = reader.Read<uint64_t>();
+
+    PADDLE_ENFORCE_EQ(
+        info.bytes,
+        product(make_ddim(info.dims)) * SizeOfType(info.type),
+        platform::errors::InvalidArgument(
+            "The payload of %s in the combined file has %lu bytes, it does "
+            "not match its dims and data type.",
+            info.name, info.bytes));
+    PADDLE_ENFORCE_EQ(
+        info.offset % kCombinedFileAlignment == 0 &&
+            info.offset + info.bytes <= header.file_bytes,
+        true,
+        platform::errors::Unavailable(
+            "The payload of %s is out of the combined file, please check "
+            "whether the model file is complete or damaged.",
+            info.name));
+  }
+  return infos;
+}
+
+// Run fn(i) for i in [0, num) on thread_num threads, the first exception is
+// rethrown after the threads are joined.
+void ParallelRun(size_t num, int thread_num,
+                 const std::function<void(size_t)>& fn) {
+  std::atomic<size_t> next(0);
+  std::exception_ptr error;
+  std::mutex mutex;
+  auto worker = [&]() {
+    for (size_t i = next++; i < num; i = next++) {
+      try {
+        fn(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        next = num;
+      }
+    }
+  };
+  thread_num = static_cast<int>(
+      std::max<size_t>(1, std::min<size_t>(thread_num, num)));
+  std::vector<std::thread> threads;
+  for (int t = 1; t < thread_num; ++t) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& t : threads) {
+    t.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+struct Chunk {
+  size_t tensor;
+  uint64_t begin;
+  uint64_t bytes;
+};
+
+// Split the payloads into chunks, chunk_base[i] is the first chunk of the
+// i-th tensor.
+std::vector<Chunk> SplitChunks(const std::vector<CombinedTensorInfo>& infos,
+                               std::vector<size_t>* chunk_base) {
+  std::vector<Chunk> chunks;
+  chunk_base->clear();
+  for (size_t i = 0; i < infos.size(); ++i) {
+    chunk_base->push_back(chunks.size());
+    for (uint64_t begin = 0; begin < infos[i].bytes; begin += kChunkBytes) {
+      chunks.push_back(
+          {i, begin, std::min(kChunkBytes, infos[i].bytes - begin)});
+    }
+  }
+  chunk_base->push_back(chunks.size());
+  return chunks;
+}
+
+uint64_t CombineChunkHashes(const uint64_t* hashes, size_t num) {
+  return XXH64(hashes, num * sizeof(uint64_t), 0);
+}
+
+}  // namespace
+
+bool IsAlignedCombinedFile(const char* data, size_t size) {
+  uint64_t magic;
+  if (size < sizeof(Header)) {
+    return false;
+  }
+  memcpy(&magic, data, sizeof(magic));
+  return magic == kMagic;
+}
+
+std::vector<CombinedTensorInfo> ParseAlignedCombinedFile(const char* data,
+                                                         size_t size) {
+  return ParseIndex(data, size, size);
+}
+
+uint64_t CombinedTensorChecksum(const char* data, uint64_t bytes) {
+  std::vector<uint64_t> hashes;
+  for (uint64_t begin = 0; begin < bytes; begin += kChunkBytes) {
+    hashes.push_back(
+        XXH64(data + begin, std::min(kChunkBytes, bytes - begin), 0));
+  }
+  return CombineChunkHashes(hashes.data(), hashes.size());
+}
+
+void CheckCombinedTensor(const CombinedTensorInfo& info, const char* data) {
+  if (!info.has_checksum) {
+    return;
+  }
+  PADDLE_ENFORCE_EQ(
+      CombinedTensorChecksum(data, info.bytes), info.checksum,
+      platform::errors::InvalidArgument(
+          "The checksum of %s in the combined file does not match, please "
+          "check whether the model file is damaged.",
+          info.name));
+}
+
+#ifndef _WIN32
+namespace {
+
+void PWriteFully(int fd, const char* data, uint64_t bytes, uint64_t offset,
+                 const std::string& path) {
+  while (bytes > 0) {
+    ssize_t ret = pwrite(fd, data, bytes, offset);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    PADDLE_ENFORCE_GT(ret, 0, platform::errors::Unavailable(
+                                  "Failed to write %s, error: %s.", path,
+                                  strerror(errno)));
+    data += ret;
+    bytes -= ret;
+    offset += ret;
+  }
+}
+
+void PReadFully(int fd, char* data, uint64_t bytes, uint64_t offset,
+                const std::string& path) {
+  while (bytes > 0) {
+    ssize_t ret = pread(fd, data, bytes, offset);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    PADDLE_ENFORCE_GT(ret, 0, platform::errors::Unavailable(
+                                  "Failed to read %s, error: %s, please check "
+                                  "whether the model file is complete.",
+                                  path, ret < 0 ? strerror(errno) : "EOF"));
+    data += ret;
+    bytes -= ret;
+    offset += ret;
+  }
+}
+
+}  // namespace
+
+void SaveAlignedCombinedFile(const std::string& path,
+                             const std::vector<std::string>& names,
+                             const std::vector<const LoDTensor*>& tensors,
+                             bool checksum, int thread_num) {
+  PADDLE_ENFORCE_EQ(names.size(), tensors.size(),
+                    platform::errors::InvalidArgument(
+                        "The number of names (%d) and tensors (%d) to save "
+                        "must be equal.",
+                        names.size(), tensors.size()));
+  std::vector<CombinedTensorInfo> infos(tensors.size());
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    PADDLE_ENFORCE_EQ(platform::is_cpu_place(tensors[i]->place()), true,
+                      platform::errors::InvalidArgument(
+                          "The tensor %s to save must be on CPU.", names[i]));
+    infos[i].name = names[i];
+    infos[i].type = tensors[i]->type();
+    infos[i].dims = vectorize(tensors[i]->dims());
+    infos[i].lod = tensors[i]->lod();
+    infos[i].bytes = tensors[i]->numel() * SizeOfType(infos[i].type);
+    infos[i].has_checksum = checksum;
+    infos[i].offset = 0;
+    infos[i].checksum = 0;
+  }
+  // the fields of the index have fixed sizes, lay the payloads out after
+  // an index of zero offsets and fill the index when they are written
+  IndexWriter layout;
+  WriteIndex(infos, &layout);
+  Header header;
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.flags = checksum ? kFlagChecksum : 0;
+  header.tensor_num = infos.size();
+  header.index_bytes = layout.buffer().size();
+  uint64_t offset = sizeof(Header) + header.index_bytes;
+  for (auto& info : infos) {
+    info.offset = AlignUp(offset);
+    offset = info.offset + info.bytes;
+  }
+  header.file_bytes = offset;
+
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  PADDLE_ENFORCE_NE(fd, -1, platform::errors::Unavailable(
+                                "Cannot open %s to save variables, error: %s.",
+                                path, strerror(errno)));
+  std::vector<size_t> chunk_base;
+  std::vector<Chunk> chunks = SplitChunks(infos, &chunk_base);
+  std::vector<uint64_t> hashes(chunks.size());
+  try {
+    PADDLE_ENFORCE_EQ(ftruncate(fd, header.file_bytes), 0,
+                      platform::errors::Unavailable(
+                          "Failed to resize %s, error: %s.", path,
+                          strerror(errno)));
+    ParallelRun(chunks.size(), thread_num, [&](size_t i) {
+      const Chunk& chunk = chunks[i];
+      const char* data =
+          static_cast<const char*>(tensors[chunk.tensor]->data<void>()) +
+          chunk.begin;
+      if (checksum) {
+        hashes[i] = XXH64(data, chunk.bytes, 0);
+      }
+      PWriteFully(fd, data, chunk.bytes,
+                  infos[chunk.tensor].offset + chunk.begin, path);
+    });
+    if (checksum) {
+      for (size_t i = 0; i < infos.size(); ++i) {
+        infos[i].checksum = CombineChunkHashes(
+            hashes.data() + chunk_base[i], chunk_base[i + 1] - chunk_base[i]);
+      }
+    }
+    IndexWriter index;
+    index.Write(header);
+    WriteIndex(infos, &index);
+    PWriteFully(fd, index.buffer().data(), index.buffer().size(), 0, path);
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+  PADDLE_ENFORCE_EQ(close(fd), 0,
+                    platform::errors::Unavailable(
+                        "Failed to close %s, error: %s.", path,
+                        strerror(errno)));
+}
+
+void LoadAlignedCombinedFile(const std::string& path,
+                             const std::vector<LoDTensor*>& tensors,
+                             int thread_num) {
+  int fd = open(path.c_str(), O_RDONLY);
+  PADDLE_ENFORCE_NE(fd, -1, platform::errors::Unavailable(
+                                "Cannot open %s to load variables, error: %s.",
+                                path, strerror(errno)));
+  try {
+    struct stat file_stat;
+    PADDLE_ENFORCE_EQ(fstat(fd, &file_stat), 0,
+                      platform::errors::Unavailable(
+                          "Failed to stat %s, error: %s.", path,
+                          strerror(errno)));
+    const uint64_t file_bytes = file_stat.st_size;
+    Header header;
+    PADDLE_ENFORCE_GE(file_bytes, sizeof(Header),
+                      platform::errors::InvalidArgument(
+                          "%s is not an aligned combined file.", path));
+    PReadFully(fd, reinterpret_cast<char*>(&header), sizeof(Header), 0, path);
+    PADDLE_ENFORCE_LE(header.index_bytes, file_bytes - sizeof(Header),
+                      platform::errors::Unavailable(
+                          "The index of %s is truncated.", path));
+    std::string index(sizeof(Header) + header.index_bytes, '\0');
+    PReadFully(fd, &index[0], index.size(), 0, path);
+    std::vector<CombinedTensorInfo> infos =
+        ParseIndex(index.data(), index.size(), file_bytes);
+    PADDLE_ENFORCE_EQ(
+        infos.size(), tensors.size(),
+        platform::errors::InvalidArgument(
+            "%s has %d tensors, but %d variables are to be loaded.", path,
+            infos.size(), tensors.size()));
+
+    std::vector<char*> buffers(infos.size());
+    for (size_t i = 0; i < infos.size(); ++i) {
+      tensors[i]->Resize(make_ddim(infos[i].dims));
+      tensors[i]->set_lod(infos[i].lod);
+      buffers[i] = static_cast<char*>(
+          tensors[i]->mutable_data(platform::CPUPlace(), infos[i].type));
+    }
+    std::vector<size_t> chunk_base;
+    std::vector<Chunk> chunks = SplitChunks(infos, &chunk_base);
+    std::vector<uint64_t> hashes(chunks.size());
+    ParallelRun(chunks.size(), thread_num, [&](size_t i) {
+      const Chunk& chunk = chunks[i];
+      char* data = buffers[chunk.tensor] + chunk.begin;
+      PReadFully(fd, data, chunk.bytes,
+                 infos[chunk.tensor].offset + chunk.begin, path);
+      if (infos[chunk.tensor].has_checksum) {
+        hashes[i] = XXH64(data, chunk.bytes, 0);
+      }
+    });
+    for (size_t i = 0; i < infos.size(); ++i) {
+      PADDLE_ENFORCE_EQ(
+          !infos[i].has_checksum ||
+              CombineChunkHashes(hashes.data() + chunk_base[i],
+                                 chunk_base[i + 1] - chunk_base[i]) ==
+                  infos[i].checksum,
+          true,
+          platform::errors::InvalidArgument(
+              "The checksum of %s in %s does not match, please check "
+              "whether the model file is damaged.",
+              infos[i].name, path));
+    }
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+  close(fd);
+}
+
+bool IsAlignedCombinedFile(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return false;
+  }
+  char header[sizeof(Header)];
+  ssize_t ret = pread(fd, header, sizeof(Header), 0);
+  close(fd);
+  return ret == static_cast<ssize_t>(sizeof(Header)) &&
+         IsAlignedCombinedFile(header, sizeof(Header));
+}
+#endif
+
+}  // namespace framework
+}  // namespace paddle
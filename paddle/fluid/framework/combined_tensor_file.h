@@ -0,0 +1,89 @@
+/* Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "paddle/fluid/framework/framework.pb.h"
+#include "paddle/fluid/framework/lod_tensor.h"
+
+namespace paddle {
+namespace framework {
+
+/*
+ * The aligned combined tensor file, an alternative to the sequence of
+ * SerializeToStream records written by save_combine:
+ *
+ *   header | index | payload 0 | payload 1 | ...
+ *
+ * The index holds the name, data type, dims, LoD, offset, size and the
+ * optional checksum of every tensor. Each payload starts at a multiple of
+ * kCombinedFileAlignment, so the payloads are written and read in parallel
+ * with pwrite/pread and a mapped file can be aliased by the tensors.
+ *
+ * The file starts with a 64 bit magic, it never matches the uint32_t
+ * version 0 of a LoDTensor record, so the readers tell the formats apart.
+ */
+constexpr uint64_t kCombinedFileAlignment = 4096;
+
+struct CombinedTensorInfo {
+  std::string name;
+  proto::VarType::Type type;
+  std::vector<int64_t> dims;
+  LoD lod;
+  // the offset of the payload in the file and its size in bytes
+  uint64_t offset;
+  uint64_t bytes;
+  // false if the file is saved without checksums
+  bool has_checksum;
+  uint64_t checksum;
+};
+
+// Whether [data, data + size) starts with an aligned combined file header.
+bool IsAlignedCombinedFile(const char* data, size_t size);
+
+// Parse the header and the index of an aligned combined file in memory,
+// the payloads are checked to be in [data, data + size).
+std::vector<CombinedTensorInfo> ParseAlignedCombinedFile(const char* data,
+                                                         size_t size);
+
+// The checksum of a payload, it is computed over fixed size chunks so that
+// the chunks are hashed by the threads writing or reading them.
+uint64_t CombinedTensorChecksum(const char* data, uint64_t bytes);
+
+// Throw if info has a checksum and data does not match it.
+void CheckCombinedTensor(const CombinedTensorInfo& info, const char* data);
+
+#ifndef _WIN32
+// Write the CPU tensors to path with thread_num threads.
+void SaveAlignedCombinedFile(const std::string& path,
+                             const std::vector<std::string>& names,
+                             const std::vector<const LoDTensor*>& tensors,
+                             bool checksum, int thread_num);
+
+// Read an aligned combined file into CPU tensors with thread_num threads,
+// the number of tensors must match the file.
+void LoadAlignedCombinedFile(const std::string& path,
+                             const std::vector<LoDTensor*>& tensors,
+                             int thread_num);
+
+// Whether the file at path is an aligned combined file.
+bool IsAlignedCombinedFile(const std::string& path);
+#endif
+
+}  // namespace framework
+}  // namespace paddle
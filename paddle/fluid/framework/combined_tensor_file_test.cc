@@ -0,0 +1,171 @@
+//   Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/combined_tensor_file.h"
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "paddle/fluid/platform/device_context.h"
+#include "paddle/fluid/platform/timer.h"
+
+namespace paddle {
+namespace framework {
+
+static void FillTensor(LoDTensor* tensor, int64_t rows, int64_t cols) {
+  float* data = tensor->mutable_data<float>(make_ddim({rows, cols}),
+                                            platform::CPUPlace());
+  for (int64_t i = 0; i < rows * cols; ++i) {
+    data[i] = static_cast<float>(i % 1000) * 0.5f;
+  }
+}
+
+static void ExpectEqual(const LoDTensor& expect, const LoDTensor& actual) {
+  ASSERT_EQ(expect.dims(), actual.dims());
+  ASSERT_EQ(expect.type(), actual.type());
+  ASSERT_EQ(expect.lod(), actual.lod());
+  const float* expect_data = expect.data<float>();
+  const float* actual_data = actual.data<float>();
+  for (int64_t i = 0; i < expect.numel(); ++i) {
+    ASSERT_EQ(expect_data[i], actual_data[i]);
+  }
+}
+
+static std::string ReadFile(const std::string& path) {
+  std::ifstream fin(path, std::ios::binary);
+  return std::string((std::istreambuf_iterator<char>(fin)),
+                     std::istreambuf_iterator<char>());
+}
+
+TEST(CombinedTensorFile, SaveAndLoad) {
+  const std::string path = "combined_tensor_file_test.bin";
+  LoDTensor small, large, empty;
+  FillTensor(&small, 5, 3);
+  small.set_lod({{0, 2, 5}});
+  // larger than a chunk, it is written by several threads
+  FillTensor(&large, 5 << 20, 1);
+  FillTensor(&empty, 0, 4);
+
+  for (bool checksum : {true, false}) {
+    SaveAlignedCombinedFile(path, {"small", "large", "empty"},
+                            {&small, &large, &empty}, checksum, 4);
+    EXPECT_TRUE(IsAlignedCombinedFile(path));
+
+    LoDTensor out1, out2, out3;
+    LoadAlignedCombinedFile(path, {&out1, &out2, &out3}, 3);
+    ExpectEqual(small, out1);
+    ExpectEqual(large, out2);
+    ExpectEqual(empty, out3);
+
+    std::string file = ReadFile(path);
+    auto infos = ParseAlignedCombinedFile(file.data(), file.size());
+    ASSERT_EQ(infos.size(), 3UL);
+    EXPECT_EQ(infos[1].name, "large");
+    for (auto& info : infos) {
+      EXPECT_EQ(info.offset % kCombinedFileAlignment, 0UL);
+      EXPECT_EQ(info.has_checksum, checksum);
+      CheckCombinedTensor(info, file.data() + info.offset);
+    }
+    // a truncated file is rejected
+    EXPECT_ANY_THROW(ParseAlignedCombinedFile(file.data(), file.size() - 1));
+    EXPECT_ANY_THROW(LoadAlignedCombinedFile(path, {&out1, &out2}, 1));
+
+    if (checksum) {
+      file[infos[1].offset + 100] ^= 1;
+      EXPECT_ANY_THROW(
+          CheckCombinedTensor(infos[1], file.data() + infos[1].offset));
+      std::ofstream fout(path, std::ios::binary);
+      fout << file;
+      fout.close();
+      EXPECT_ANY_THROW(LoadAlignedCombinedFile(path, {&out1, &out2, &out3}, 3));
+    }
+  }
+  // the sequential format is not taken as an aligned file
+  std::ostringstream ss;
+  platform::CPUDeviceContext ctx;
+  SerializeToStream(ss, small, ctx);
+  EXPECT_FALSE(IsAlignedCombinedFile(ss.str().data(), ss.str().size()));
+  std::remove(path.c_str());
+}
+
+// Compare with writing and reading the tensors one by one with
+// SerializeToStream and DeserializeFromStream.
+TEST(CombinedTensorFile, Benchmark) {
+  const std::string path = "combined_tensor_file_bench.bin";
+  const int tensor_num = 8;
+  std::vector<LoDTensor> tensors(tensor_num);
+  std::vector<const LoDTensor*> ptrs;
+  std::vector<std::string> names;
+  for (int i = 0; i < tensor_num; ++i) {
+    FillTensor(&tensors[i], 1 << 20, 8);
+    ptrs.push_back(&tensors[i]);
+    names.push_back("param_" + std::to_string(i));
+  }
+
+  platform::CPUDeviceContext ctx;
+  platform::Timer timer;
+  timer.Start();
+  {
+    std::ofstream fout(path, std::ios::binary);
+    for (auto& tensor : tensors) {
+      SerializeToStream(fout, tensor, ctx);
+    }
+  }
+  timer.Pause();
+  double stream_save = timer.ElapsedSec();
+  timer.Reset();
+  timer.Start();
+  {
+    std::ifstream fin(path, std::ios::binary);
+    LoDTensor out;
+    for (int i = 0; i < tensor_num; ++i) {
+      DeserializeFromStream(fin, &out, ctx);
+    }
+  }
+  timer.Pause();
+  double stream_load = timer.ElapsedSec();
+
+  timer.Reset();
+  timer.Start();
+  SaveAlignedCombinedFile(path, names, ptrs, true, 8);
+  timer.Pause();
+  double aligned_save = timer.ElapsedSec();
+  std::vector<LoDTensor> outs(tensor_num);
+  std::vector<LoDTensor*> out_ptrs;
+  for (auto& out : outs) {
+    out_ptrs.push_back(&out);
+  }
+  timer.Reset();
+  timer.Start();
+  LoadAlignedCombinedFile(path, out_ptrs, 8);
+  timer.Pause();
+  double aligned_load = timer.ElapsedSec();
+  std::remove(path.c_str());
+
+  LOG(INFO) << "stream save: " << stream_save << "s, load: " << stream_load
+            << "s";
+  LOG(INFO) << "aligned save: " << aligned_save << "s, load: " << aligned_load
+            << "s";
+  ExpectEqual(tensors[tensor_num - 1], outs[tensor_num - 1]);
+}
+
+}  // namespace framework
+}  // namespace paddle
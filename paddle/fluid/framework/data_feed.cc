@@ -37,6 +37,9 @@ limitations under the License. */
 #include "paddle/fluid/framework/feed_fetch_type.h"
 #include "paddle/fluid/framework/fleet/box_wrapper.h"
 #include "paddle/fluid/framework/fleet/fleet_wrapper.h"
+#include "paddle/fluid/framework/threadpool.h"
+#include "paddle/fluid/platform/hot_path_trace.h"
+#include "paddle/fluid/platform/metrics.h"
 #include "paddle/fluid/platform/monitor.h"
 #include "paddle/fluid/platform/timer.h"
 #include "paddle/fluid/string/string_helper.h"
@@ -49,6 +52,10 @@ typedef void (*MyPadBoxFreeObject)(paddle::framework::ISlotParser*);
 #endif
 
 DECLARE_bool(enable_ins_parser_file);
+#ifdef PADDLE_WITH_BOX_PS
+DECLARE_int32(padbox_pack_prefetch_num);
+DECLARE_int32(padbox_pack_thread_num);
+#endif
 
 namespace paddle {
 namespace framework {
@@ -2099,14 +2106,7 @@ void SlotPaddleBoxDataFeed::Init(const DataFeedDesc& data_feed_desc) {
   used_slots_info_.resize(use_slot_size_);
 
   feed_vec_.resize(used_slots_info_.size());
-  const int kEstimatedFeasignNumPerSlot = 5;  // Magic Number
   for (size_t i = 0; i < all_slot_num; i++) {
-    batch_float_feasigns_.push_back(std::vector<float>());
-    batch_uint64_feasigns_.push_back(std::vector<uint64_t>());
-    batch_float_feasigns_[i].reserve(default_batch_size_ *
-                                     kEstimatedFeasignNumPerSlot);
-    batch_uint64_feasigns_[i].reserve(default_batch_size_ *
-                                      kEstimatedFeasignNumPerSlot);
     offset_.push_back(std::vector<size_t>());
     offset_[i].reserve(default_batch_size_ +
                        1);  // Each lod info will prepend a zero
@@ -2166,8 +2166,33 @@ int SlotPaddleBoxDataFeed::Next() {
   int phase = GetCurrentPhase();  // join: 1, update: 0
   this->CheckStart();
   if (offset_index_ >= static_cast<int>(batch_offsets_.size())) {
+    if (prefetching_) {
+      // the records of the pass may be released after the last batch
+      prefetcher_->stop();
+      prefetching_ = false;
+    }
     return 0;
   }
+  if (offset_index_ == 0) {
+    // the pv batches of the join phase are packed on the reader thread
+    prefetching_ =
+        FLAGS_padbox_pack_prefetch_num > 0 && !(enable_pv_merge_ && phase == 1);
+    if (prefetching_) {
+      if (prefetcher_ == nullptr) {
+#if defined(PADDLE_WITH_CUDA) && defined(_LINUX)
+        const bool pinned = true;
+#else
+        const bool pinned = false;
+#endif
+        prefetcher_.reset(new MiniBatchPackPrefetcher(
+            used_slots_info_, FLAGS_padbox_pack_prefetch_num,
+            FLAGS_padbox_pack_thread_num, pinned));
+      }
+      prefetcher_->start(records_, batch_offsets_, 0);
+    } else if (prefetcher_ != nullptr) {
+      prefetcher_->stop();
+    }
+  }
   auto& batch = batch_offsets_[offset_index_++];
   if (enable_pv_merge_ && phase == 1) {
     // join phase : output_pv_channel to consume_pv_channel
@@ -2183,7 +2208,13 @@ int SlotPaddleBoxDataFeed::Next() {
   } else {
     this->batch_size_ = batch.second;
     batch_timer_.Resume();
-    PutToFeedSlotVec(&records_[batch.first], this->batch_size_);
+    if (prefetching_) {
+      auto* pack = prefetcher_->next();
+      CHECK(pack != nullptr && pack->ins_num() == this->batch_size_);
+      PutToFeedHostPack(pack);
+    } else {
+      PutToFeedSlotVec(&records_[batch.first], this->batch_size_);
+    }
     // update set join q value
     if (phase == 0 && FLAGS_padbox_slotrecord_extend_dim > 0) {
       // pcoc
@@ -2318,64 +2349,45 @@ void SlotPaddleBoxDataFeed::PutToFeedSlotVec(const SlotRecord* ins_vec,
   pack_->pack_instance(ins_vec, num);
   BuildSlotBatchGPU(pack_->ins_num());
 #else
-  for (int j = 0; j < use_slot_size_; ++j) {
+  if (host_pack_ == nullptr) {
+    host_pack_.reset(new MiniBatchHostPack(used_slots_info_));
+  }
+  host_pack_->pack_instance(ins_vec, num);
+  host_pack_->pack_slot_offsets();
+  PutToFeedHostPack(host_pack_.get());
+#endif
+}
+
+void SlotPaddleBoxDataFeed::PutToFeedHostPack(MiniBatchHostPack* pack) {
+#if defined(PADDLE_WITH_CUDA) && defined(_LINUX)
+  paddle::platform::SetDeviceId(
+      boost::get<platform::CUDAPlace>(place_).GetDeviceId());
+  pack_->transfer(pack);
+  BuildSlotBatchGPU(pack_->ins_num());
+#else
+  // the pack gathers the values straight into the feed tensors, which
+  // CopyToFeedTensor only allows on the CPU place without CUDA as well
+  PADDLE_ENFORCE_EQ(
+      platform::is_cpu_place(this->place_), true,
+      platform::errors::Unimplemented(
+          "The host pack only feeds the CPU place without CUDA, but got %s.",
+          this->place_));
+  int num = pack->ins_num();
+  const size_t* slot_offsets = pack->slot_offsets().data();
+  for (int j = 0; j < use_slot_size_; ++j, slot_offsets += num + 1) {
     auto& feed = feed_vec_[j];
     if (feed == nullptr) {
       continue;
     }
-
-    auto& slot_offset = offset_[j];
-    slot_offset.clear();
-    slot_offset.reserve(num + 1);
-    slot_offset.push_back(0);
-
-    int total_instance = 0;
     auto& info = used_slots_info_[j];
-    // fill slot value with default value 0
+    int total_instance = static_cast<int>(slot_offsets[num]);
     if (info.type[0] == 'f') {  // float
-      auto& batch_fea = batch_float_feasigns_[j];
-      batch_fea.clear();
-
-      for (int i = 0; i < num; ++i) {
-        auto r = ins_vec[i];
-        size_t fea_num = 0;
-        float* slot_values =
-            r->slot_float_feasigns_.get_values(info.slot_value_idx, &fea_num);
-        batch_fea.resize(total_instance + fea_num);
-        memcpy(&batch_fea[total_instance], slot_values,
-               sizeof(float) * fea_num);
-        total_instance += fea_num;
-        slot_offset.push_back(total_instance);
-      }
-
-      float* feasign = batch_fea.data();
-      float* tensor_ptr =
-          feed->mutable_data<float>({total_instance, 1}, this->place_);
-      CopyToFeedTensor(tensor_ptr, feasign, total_instance * sizeof(float));
-
+      pack->copy_slot_values(
+          j, feed->mutable_data<float>({total_instance, 1}, this->place_));
     } else if (info.type[0] == 'u') {  // uint64
-      auto& batch_fea = batch_uint64_feasigns_[j];
-      batch_fea.clear();
-
-      for (int i = 0; i < num; ++i) {
-        auto r = ins_vec[i];
-        size_t fea_num = 0;
-        uint64_t* slot_values =
-            r->slot_uint64_feasigns_.get_values(info.slot_value_idx, &fea_num);
-        if (fea_num > 0) {
-          batch_fea.resize(total_instance + fea_num);
-          memcpy(&batch_fea[total_instance], slot_values,
-                 sizeof(uint64_t) * fea_num);
-          total_instance += fea_num;
-        }
-        slot_offset.push_back(total_instance);
-      }
-
       // no uint64_t type in paddlepaddle
-      uint64_t* feasign = batch_fea.data();
-      int64_t* tensor_ptr =
-          feed->mutable_data<int64_t>({total_instance, 1}, this->place_);
-      CopyToFeedTensor(tensor_ptr, feasign, total_instance * sizeof(int64_t));
+      pack->copy_slot_values(
+          j, feed->mutable_data<int64_t>({total_instance, 1}, this->place_));
     }
 
     if (info.dense) {
@@ -2385,6 +2397,8 @@ void SlotPaddleBoxDataFeed::PutToFeedSlotVec(const SlotRecord* ins_vec,
       }
       feed->Resize(framework::make_ddim(info.local_shape));
     } else {
+      auto& slot_offset = offset_[j];
+      slot_offset.assign(slot_offsets, slot_offsets + num + 1);
       LoD data_lod{slot_offset};
       feed_vec_[j]->set_lod(data_lod);
     }
@@ -2667,6 +2681,23 @@ void SlotPaddleBoxDataFeed::LoadIntoMemory() {
     LoadIntoMemoryByCommand();
   }
 }
+// record the parse of a block of num instances since *begin_ns, the next
+// block begins now
+static void TraceParsedBlock(int64_t* begin_ns, uint64_t num) {
+  if (!platform::HotPathTrace::Enabled()) {
+    return;
+  }
+  int64_t now = platform::HotPathTrace::NowNs();
+  platform::HotPathTrace::Instance().Record(platform::TraceEvent::kParseIns,
+                                            *begin_ns, now, num);
+  *begin_ns = now;
+}
+// count the instances read from a file
+static void CountReadIns(uint64_t num) {
+  static auto* read_ins = platform::MetricsRegistry::Instance().GetCounter(
+      "padbox_read_ins_total", "the instances read from the files");
+  read_ins->Increase(num);
+}
 // \n split by line
 void SlotPaddleBoxDataFeed::LoadIntoMemoryByLine(void) {
   paddle::framework::ISlotParser* parser =
@@ -2688,6 +2719,8 @@ void SlotPaddleBoxDataFeed::LoadIntoMemoryByLine(void) {
   while (this->PickOneFile(&filename)) {
     VLOG(3) << "PickOneFile, filename=" << filename
             << ", thread_id=" << thread_id_;
+    platform::TraceScope trace(platform::TraceEvent::kReadIns);
+    int64_t block_begin_ns = platform::HotPathTrace::NowNs();
     std::vector<SlotRecord> record_vec;
     platform::Timer timeline;
     timeline.Start();
@@ -2715,7 +2748,7 @@ void SlotPaddleBoxDataFeed::LoadIntoMemoryByLine(void) {
     };
 
     line_func = [this, &parser, &record_vec, &offset, &filename, &record_func,
-                 &old_offset](const std::string& line) {
+                 &old_offset, &block_begin_ns](const std::string& line) {
       old_offset = offset;
       if (!parser->ParseOneInstance(line, record_func)) {
         offset = old_offset;
@@ -2724,6 +2757,7 @@ void SlotPaddleBoxDataFeed::LoadIntoMemoryByLine(void) {
         return false;
       }
       if (offset >= OBJPOOL_BLOCK_SIZE) {
+        TraceParsedBlock(&block_begin_ns, offset);
         input_channel_->Write(std::move(record_vec));
         record_vec.clear();
         SlotRecordPool().get(&record_vec, OBJPOOL_BLOCK_SIZE);
@@ -2765,6 +2799,8 @@ void SlotPaddleBoxDataFeed::LoadIntoMemoryByLine(void) {
     record_vec.clear();
     record_vec.shrink_to_fit();
     timeline.Pause();
+    trace.set_arg(lines);
+    CountReadIns(lines);
     VLOG(3) << "LoadIntoMemoryByLib() read all lines, file=" << filename
             << ", cost time=" << timeline.ElapsedSec()
             << " seconds, thread_id=" << thread_id_ << ", lines=" << lines
@@ -2814,6 +2850,7 @@ void SlotPaddleBoxDataFeed::LoadIntoMemoryByFile(void) {
   while (this->PickOneFile(&filename)) {
     VLOG(3) << "PickOneFile, filename=" << filename
             << ", thread_id=" << thread_id_;
+    platform::TraceScope trace(platform::TraceEvent::kReadIns);
     platform::Timer timeline;
     timeline.Start();
 
@@ -2852,6 +2889,8 @@ void SlotPaddleBoxDataFeed::LoadIntoMemoryByFile(void) {
       }
     } while (!is_ok);
     timeline.Pause();
+    trace.set_arg(lines);
+    CountReadIns(lines);
     VLOG(3) << "LoadIntoMemoryByLib() read all file, file=" << filename
             << ", cost time=" << timeline.ElapsedSec()
             << " seconds, thread_id=" << thread_id_ << ", lines=" << lines;
@@ -2878,6 +2917,8 @@ void SlotPaddleBoxDataFeed::LoadIntoMemoryByCommand(void) {
   while (this->PickOneFile(&filename)) {
     VLOG(3) << "PickOneFile, filename=" << filename
             << ", thread_id=" << thread_id_;
+    platform::TraceScope trace(platform::TraceEvent::kReadIns);
+    int64_t block_begin_ns = platform::HotPathTrace::NowNs();
     int lines = 0;
     std::vector<SlotRecord> record_vec;
     platform::Timer timeline;
@@ -2898,7 +2939,8 @@ void SlotPaddleBoxDataFeed::LoadIntoMemoryByCommand(void) {
 
       lines = line_reader.read_file(
           this->fp_.get(),
-          [this, &record_vec, &offset, &filename](const std::string& line) {
+          [this, &record_vec, &offset, &filename,
+           &block_begin_ns](const std::string& line) {
             if (ParseOneInstance(line, &record_vec[offset])) {
               ++offset;
             } else {
@@ -2907,6 +2949,7 @@ void SlotPaddleBoxDataFeed::LoadIntoMemoryByCommand(void) {
               return false;
             }
             if (offset >= OBJPOOL_BLOCK_SIZE) {
+              TraceParsedBlock(&block_begin_ns, offset);
               input_channel_->Write(std::move(record_vec));
               record_vec.clear();
               SlotRecordPool().get(&record_vec, OBJPOOL_BLOCK_SIZE);
@@ -2928,6 +2971,8 @@ void SlotPaddleBoxDataFeed::LoadIntoMemoryByCommand(void) {
     record_vec.clear();
     record_vec.shrink_to_fit();
     timeline.Pause();
+    trace.set_arg(lines);
+    CountReadIns(lines);
     VLOG(3) << "LoadIntoMemory() read all lines, file=" << filename
             << ", lines=" << lines
             << ", sample lines=" << line_reader.get_sample_line()
@@ -3181,6 +3226,8 @@ void SlotPaddleBoxDataFeedWithGpuReplicaCache::LoadIntoMemoryByLib(void) {
     record_vec.clear();
     record_vec.shrink_to_fit();
     timeline.Pause();
+    trace.set_arg(lines);
+    CountReadIns(lines);
     VLOG(3) << "LoadIntoMemoryByLib() read all lines, file=" << filename
             << ", cost time=" << timeline.ElapsedSec()
             << " seconds, thread_id=" << thread_id_ << ", count=" << lines
@@ -3262,6 +3309,8 @@ void SlotPaddleBoxDataFeedWithGpuReplicaCache::LoadIntoMemoryByCommand(void) {
     record_vec.clear();
     record_vec.shrink_to_fit();
     timeline.Pause();
+    trace.set_arg(lines);
+    CountReadIns(lines);
     VLOG(3) << "LoadIntoMemory() read all lines, file=" << filename
             << ", cost time=" << timeline.ElapsedSec()
             << " seconds, thread_id=" << thread_id_;
@@ -3487,6 +3536,8 @@ void InputTableDataFeed::LoadIntoMemoryByLib() {
     record_vec.clear();
     record_vec.shrink_to_fit();
     timeline.Pause();
+    trace.set_arg(lines);
+    CountReadIns(lines);
     VLOG(3) << "LoadIntoMemoryByLib() read all lines, file=" << filename
             << ", cost time=" << timeline.ElapsedSec()
             << " seconds, thread_id=" << thread_id_ << ", lines=" << lines
@@ -3565,83 +3616,29 @@ void InputIndexDataFeed::LoadIntoMemory() {
 }
 
 ////////////////////////////// pack ////////////////////////////////////
-#if defined(PADDLE_WITH_CUDA) && defined(_LINUX)
-static void SetCPUAffinity(int tid) {
-  std::vector<int>& cores = boxps::get_train_cores();
-  if (cores.empty()) {
-    VLOG(0) << "not found binding read ins thread cores";
-    return;
-  }
-
-  size_t core_num = cores.size() / 2;
-  if (core_num < 8) {
-    return;
-  }
-  cpu_set_t mask;
-  CPU_ZERO(&mask);
-  CPU_SET(cores[core_num + (tid % core_num)], &mask);
-  pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
-}
-MiniBatchGpuPack::MiniBatchGpuPack(const paddle::platform::Place& place,
-                                   const std::vector<UsedSlotInfo>& infos) {
-  place_ = place;
-  //  paddle::platform::SetDeviceId(boost::get<platform::CUDAPlace>(place).GetDeviceId());
-  //  paddle::platform::CUDADeviceContext* context =
-  //      dynamic_cast<paddle::platform::CUDADeviceContext*>(platform::DeviceContextPool::Instance().Get(
-  //          place));
-  stream_ = dynamic_cast<platform::CUDADeviceContext*>(
-                platform::DeviceContextPool::Instance().Get(
-                    boost::get<platform::CUDAPlace>(place)))
-                ->stream();
-
-  ins_num_ = 0;
-  pv_num_ = 0;
-  used_float_num_ = 0;
-  used_uint64_num_ = 0;
-  enable_pv_ = false;
-
-  used_slot_size_ = static_cast<int>(infos.size());
-  for (int i = 0; i < used_slot_size_; ++i) {
-    auto& info = infos[i];
+MiniBatchHostPack::MiniBatchHostPack(const std::vector<UsedSlotInfo>& infos,
+                                     bool pinned) {
+  buf_.set_pinned(pinned);
+  for (auto& info : infos) {
     if (info.type[0] == 'u') {
-      gpu_used_slots_.push_back({1, info.slot_value_idx});
+      used_slots_.push_back({1, info.slot_value_idx});
       ++used_uint64_num_;
     } else {
-      gpu_used_slots_.push_back({0, info.slot_value_idx});
+      used_slots_.push_back({0, info.slot_value_idx});
       ++used_float_num_;
     }
   }
-  copy_host2device(&gpu_slots_, gpu_used_slots_.data(), gpu_used_slots_.size());
-
-  slot_buf_ptr_ = memory::AllocShared(place_, used_slot_size_ * sizeof(void*));
-
-  int device_id = boost::get<platform::CUDAPlace>(place).GetDeviceId();
-  VLOG(3) << "begin get batch pack device id: " << device_id;
-  qvalue_tensor_ = &BoxWrapper::GetInstance()->GetQTensor(device_id);
-  // sync
-  CUDA_CHECK(cudaStreamSynchronize(stream_));
 }
 
-MiniBatchGpuPack::~MiniBatchGpuPack() {}
-
-void MiniBatchGpuPack::reset(const paddle::platform::Place& place) {
-  place_ = place;
-  stream_ = dynamic_cast<platform::CUDADeviceContext*>(
-                platform::DeviceContextPool::Instance().Get(
-                    boost::get<platform::CUDAPlace>(place)))
-                ->stream();
+void MiniBatchHostPack::reset(void) {
   ins_num_ = 0;
   pv_num_ = 0;
   enable_pv_ = false;
-
+  batch_ins_ = nullptr;
   pack_timer_.Reset();
-  trans_timer_.Reset();
-
-  int device_id = boost::get<platform::CUDAPlace>(place).GetDeviceId();
-  qvalue_tensor_ = &BoxWrapper::GetInstance()->GetQTensor(device_id);
 }
 
-void MiniBatchGpuPack::pack_pvinstance(const SlotPvInstance* pv_ins, int num) {
+void MiniBatchHostPack::pack_pvinstance(const SlotPvInstance* pv_ins, int num) {
   pv_num_ = num;
   buf_.h_ad_offset.resize(num + 1);
   buf_.h_ad_offset[0] = 0;
@@ -3663,7 +3660,7 @@ void MiniBatchGpuPack::pack_pvinstance(const SlotPvInstance* pv_ins, int num) {
   pack_instance(&ins_vec_[0], ins_number);
 }
 
-void MiniBatchGpuPack::pack_all_data(const SlotRecord* ins_vec, int num) {
+void MiniBatchHostPack::pack_all_data(const SlotRecord* ins_vec, int num) {
   int uint64_total_num = 0;
   int float_total_num = 0;
 
@@ -3732,7 +3729,7 @@ void MiniBatchGpuPack::pack_all_data(const SlotRecord* ins_vec, int num) {
   CHECK(float_total_num == static_cast<int>(buf_.h_float_lens.back()))
       << "float value length error";
 }
-void MiniBatchGpuPack::pack_uint64_data(const SlotRecord* ins_vec, int num) {
+void MiniBatchHostPack::pack_uint64_data(const SlotRecord* ins_vec, int num) {
   int uint64_total_num = 0;
 
   buf_.h_float_lens.clear();
@@ -3781,7 +3778,7 @@ void MiniBatchGpuPack::pack_uint64_data(const SlotRecord* ins_vec, int num) {
   CHECK(uint64_total_num == static_cast<int>(buf_.h_uint64_lens.back()))
       << "uint64 value length error";
 }
-void MiniBatchGpuPack::pack_float_data(const SlotRecord* ins_vec, int num) {
+void MiniBatchHostPack::pack_float_data(const SlotRecord* ins_vec, int num) {
   int float_total_num = 0;
 
   buf_.h_uint64_lens.clear();
@@ -3830,13 +3827,60 @@ void MiniBatchGpuPack::pack_float_data(const SlotRecord* ins_vec, int num) {
       << "float value length error";
 }
 
-void MiniBatchGpuPack::pack_instance(const SlotRecord* ins_vec, int num) {
+void MiniBatchHostPack::pack_uint64_overlay(
+    const SlotRecord* ins_vec, int num, const std::vector<uint16_t>& slots) {
+  auto box_ptr = BoxWrapper::GetInstance();
+  int uint64_total_num = 0;
+
+  buf_.h_uint64_lens.resize(num + 1);
+  buf_.h_uint64_lens[0] = 0;
+  for (int i = 0; i < num; ++i) {
+    auto r = ins_vec[i];
+    uint64_total_num += FeasignValuesOverlay::ValueNum(
+        r->slot_uint64_feasigns_, box_ptr->GetOverlayCandidate(r), slots);
+    buf_.h_uint64_lens[i + 1] = uint64_total_num;
+  }
+  if (enable_pv_) {
+    for (int i = 0; i < num; ++i) {
+      buf_.h_rank[i] = ins_vec[i]->rank;
+      buf_.h_cmatch[i] = ins_vec[i]->cmatch;
+    }
+  }
+
+  int uint64_cols = (used_uint64_num_ + 1);
+  buf_.h_uint64_offset.resize(uint64_cols * num);
+  buf_.h_uint64_keys.resize(uint64_total_num);
+
+  for (int i = 0; i < num; ++i) {
+    auto r = ins_vec[i];
+    FeasignValuesOverlay::Copy(
+        r->slot_uint64_feasigns_, box_ptr->GetOverlayCandidate(r), slots,
+        &buf_.h_uint64_keys[buf_.h_uint64_lens[i]],
+        &buf_.h_uint64_offset[i * uint64_cols]);
+  }
+}
+
+void MiniBatchHostPack::pack_instance(const SlotRecord* ins_vec, int num) {
   pack_timer_.Resume();
   ins_num_ = num;
   batch_ins_ = ins_vec;
   CHECK(used_uint64_num_ > 0 || used_float_num_ > 0);
-  // uint64 and float
-  if (used_uint64_num_ > 0 && used_float_num_ > 0) {
+  const std::vector<uint16_t>* overlay_slots = nullptr;
+  if (FLAGS_padbox_auc_runner_overlay && used_uint64_num_ > 0) {
+    overlay_slots = &BoxWrapper::GetInstance()->GetOverlaySlots();
+  }
+  if (overlay_slots != nullptr && !overlay_slots->empty()) {
+    // auc runner replaced slots, the records are not modified
+    if (used_float_num_ > 0) {
+      pack_float_data(ins_vec, num);
+    } else {
+      buf_.h_float_lens.clear();
+      buf_.h_float_keys.clear();
+      buf_.h_float_offset.clear();
+    }
+    pack_uint64_overlay(ins_vec, num, *overlay_slots);
+  } else if (used_uint64_num_ > 0 && used_float_num_ > 0) {
+    // uint64 and float
     pack_all_data(ins_vec, num);
   } else if (used_uint64_num_ > 0) {  // uint64
     pack_uint64_data(ins_vec, num);
@@ -3844,24 +3888,275 @@ void MiniBatchGpuPack::pack_instance(const SlotRecord* ins_vec, int num) {
     pack_float_data(ins_vec, num);
   }
   pack_timer_.Pause();
-  // to gpu
+}
+
+void MiniBatchHostPack::pack_slot_offsets(void) {
+  int cols = ins_num_ + 1;
+  int slot_num = static_cast<int>(used_slots_.size());
+  slot_offsets_.resize(static_cast<size_t>(slot_num) * cols);
+  // the slots are independent, a chunk of slots touches 64K offsets at least
+  int64_t grain = std::max(1, 65536 / cols);
+  ParallelFor(0, slot_num, grain, [this, cols](int64_t begin, int64_t end) {
+    for (int64_t j = begin; j < end; ++j) {
+      auto& slot = used_slots_[j];
+      const int* offset = nullptr;
+      int offset_cols = 0;
+      if (slot.is_uint64_value) {
+        offset = buf_.h_uint64_offset.data();
+        offset_cols = used_uint64_num_ + 1;
+      } else {
+        offset = buf_.h_float_offset.data();
+        offset_cols = used_float_num_ + 1;
+      }
+      offset += slot.slot_value_idx;
+      size_t* slot_offsets = &slot_offsets_[j * cols];
+      size_t total = 0;
+      slot_offsets[0] = 0;
+      for (int i = 0; i < ins_num_; ++i) {
+        total += offset[1] - offset[0];
+        slot_offsets[i + 1] = total;
+        offset += offset_cols;
+      }
+    }
+  });
+}
+
+void MiniBatchHostPack::copy_slot_values(int j, void* dest) const {
+  auto& slot = used_slots_[j];
+  const size_t* slot_offsets = &slot_offsets_[j * (ins_num_ + 1)];
+  const char* keys = nullptr;
+  const int* lens = nullptr;
+  const int* offset = nullptr;
+  int offset_cols = 0;
+  size_t value_size = 0;
+  if (slot.is_uint64_value) {
+    keys = reinterpret_cast<const char*>(buf_.h_uint64_keys.data());
+    lens = buf_.h_uint64_lens.data();
+    offset = buf_.h_uint64_offset.data();
+    offset_cols = used_uint64_num_ + 1;
+    value_size = sizeof(uint64_t);
+  } else {
+    keys = reinterpret_cast<const char*>(buf_.h_float_keys.data());
+    lens = buf_.h_float_lens.data();
+    offset = buf_.h_float_offset.data();
+    offset_cols = used_float_num_ + 1;
+    value_size = sizeof(float);
+  }
+  offset += slot.slot_value_idx;
+  char* out = reinterpret_cast<char*>(dest);
+  for (int i = 0; i < ins_num_; ++i) {
+    size_t num = slot_offsets[i + 1] - slot_offsets[i];
+    if (num > 0) {
+      memcpy(out + slot_offsets[i] * value_size,
+             keys + (lens[i] + offset[0]) * value_size, num * value_size);
+    }
+    offset += offset_cols;
+  }
+}
+
+MiniBatchPackPrefetcher::MiniBatchPackPrefetcher(
+    const std::vector<UsedSlotInfo>& infos, int depth, int thread_num,
+    bool pinned)
+    : thread_num_(std::max(1, thread_num)) {
+  depth = std::max(2, depth);
+  for (int i = 0; i < depth; ++i) {
+    packs_.emplace_back(new MiniBatchHostPack(infos, pinned));
+  }
+  ready_.resize(depth, false);
+}
+
+void MiniBatchPackPrefetcher::start(
+    const SlotRecord* records, const std::vector<std::pair<int, int>>& batches,
+    size_t begin) {
+  stop();
+  records_ = records;
+  batches_ = batches;
+  next_pack_ = begin;
+  next_consume_ = begin;
+  released_ = begin;
+  stop_ = false;
+  for (size_t i = 0; i < packs_.size(); ++i) {
+    packs_[i]->reset();
+    ready_[i] = false;
+  }
+  wait_timer_.Reset();
+  // the pack threads inherit the cpu affinity of the reader thread
+  for (int i = 0; i < thread_num_; ++i) {
+    threads_.emplace_back([this]() { run(); });
+  }
+}
+
+void MiniBatchPackPrefetcher::run(void) {
+  size_t depth = packs_.size();
+  while (true) {
+    size_t k = 0;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this, depth]() {
+        return stop_ || next_pack_ >= batches_.size() ||
+               next_pack_ < released_ + depth;
+      });
+      if (stop_ || next_pack_ >= batches_.size()) {
+        return;
+      }
+      k = next_pack_++;
+    }
+    auto* pack = packs_[k % depth].get();
+    auto& batch = batches_[k];
+    // the pack time of a pack is the time of its current batch
+    pack->reset();
+    pack->pack_instance(&records_[batch.first], batch.second);
+#if !(defined(PADDLE_WITH_CUDA) && defined(_LINUX))
+    // the host tensors are filled from the slot offsets
+    pack->pack_slot_offsets();
+#endif
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ready_[k % depth] = true;
+    }
+    cond_.notify_all();
+  }
+}
+
+MiniBatchHostPack* MiniBatchPackPrefetcher::next(void) {
+  size_t depth = packs_.size();
+  std::unique_lock<std::mutex> lock(mutex_);
+  // the pack returned last time can be refilled
+  released_ = next_consume_;
+  cond_.notify_all();
+  if (next_consume_ >= batches_.size()) {
+    return nullptr;
+  }
+  size_t idx = next_consume_ % depth;
+  if (!ready_[idx]) {
+    wait_timer_.Resume();
+    cond_.wait(lock, [this, idx]() { return ready_[idx] || stop_; });
+    wait_timer_.Pause();
+    CHECK(ready_[idx]) << "pack prefetcher stopped";
+  }
+  ready_[idx] = false;
+  ++next_consume_;
+  return packs_[idx].get();
+}
+
+void MiniBatchPackPrefetcher::stop(void) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  for (auto& t : threads_) {
+    t.join();
+  }
+  threads_.clear();
+}
+
+#if defined(PADDLE_WITH_CUDA) && defined(_LINUX)
+static void SetCPUAffinity(int tid) {
+  std::vector<int>& cores = boxps::get_train_cores();
+  if (cores.empty()) {
+    VLOG(0) << "not found binding read ins thread cores";
+    return;
+  }
+
+  size_t core_num = cores.size() / 2;
+  if (core_num < 8) {
+    return;
+  }
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  CPU_SET(cores[core_num + (tid % core_num)], &mask);
+  pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+}
+MiniBatchGpuPack::MiniBatchGpuPack(const paddle::platform::Place& place,
+                                   const std::vector<UsedSlotInfo>& infos) {
+  place_ = place;
+  //  paddle::platform::SetDeviceId(boost::get<platform::CUDAPlace>(place).GetDeviceId());
+  //  paddle::platform::CUDADeviceContext* context =
+  //      dynamic_cast<paddle::platform::CUDADeviceContext*>(platform::DeviceContextPool::Instance().Get(
+  //          place));
+  stream_ = dynamic_cast<platform::CUDADeviceContext*>(
+                platform::DeviceContextPool::Instance().Get(
+                    boost::get<platform::CUDAPlace>(place)))
+                ->stream();
+
+  used_float_num_ = 0;
+  used_uint64_num_ = 0;
+  sync_pack_.reset(new MiniBatchHostPack(infos, true));
+  host_ = sync_pack_.get();
+
+  used_slot_size_ = static_cast<int>(infos.size());
+  for (int i = 0; i < used_slot_size_; ++i) {
+    auto& info = infos[i];
+    if (info.type[0] == 'u') {
+      gpu_used_slots_.push_back({1, info.slot_value_idx});
+      ++used_uint64_num_;
+    } else {
+      gpu_used_slots_.push_back({0, info.slot_value_idx});
+      ++used_float_num_;
+    }
+  }
+  copy_host2device(&gpu_slots_, gpu_used_slots_.data(), gpu_used_slots_.size());
+
+  slot_buf_ptr_ = memory::AllocShared(place_, used_slot_size_ * sizeof(void*));
+
+  int device_id = boost::get<platform::CUDAPlace>(place).GetDeviceId();
+  VLOG(3) << "begin get batch pack device id: " << device_id;
+  qvalue_tensor_ = &BoxWrapper::GetInstance()->GetQTensor(device_id);
+  // sync
+  CUDA_CHECK(cudaStreamSynchronize(stream_));
+}
+
+MiniBatchGpuPack::~MiniBatchGpuPack() {}
+
+void MiniBatchGpuPack::reset(const paddle::platform::Place& place) {
+  place_ = place;
+  stream_ = dynamic_cast<platform::CUDADeviceContext*>(
+                platform::DeviceContextPool::Instance().Get(
+                    boost::get<platform::CUDAPlace>(place)))
+                ->stream();
+  sync_pack_->reset();
+  host_ = sync_pack_.get();
+  prefetch_pack_time_ = 0;
+  trans_timer_.Reset();
+
+  int device_id = boost::get<platform::CUDAPlace>(place).GetDeviceId();
+  qvalue_tensor_ = &BoxWrapper::GetInstance()->GetQTensor(device_id);
+}
+
+void MiniBatchGpuPack::pack_pvinstance(const SlotPvInstance* pv_ins, int num) {
+  sync_pack_->pack_pvinstance(pv_ins, num);
+  transfer(sync_pack_.get());
+}
+
+void MiniBatchGpuPack::pack_instance(const SlotRecord* ins_vec, int num) {
+  sync_pack_->pack_instance(ins_vec, num);
+  transfer(sync_pack_.get());
+}
+
+void MiniBatchGpuPack::transfer(MiniBatchHostPack* host) {
+  if (host != sync_pack_.get()) {
+    prefetch_pack_time_ += host->pack_time_span();
+  }
+  host_ = host;
   transfer_to_gpu();
 }
 
 void MiniBatchGpuPack::transfer_to_gpu(void) {
   trans_timer_.Resume();
-  if (enable_pv_) {
-    copy_host2device(&value_.d_ad_offset, buf_.h_ad_offset);
-    copy_host2device(&value_.d_rank, buf_.h_rank);
-    copy_host2device(&value_.d_cmatch, buf_.h_cmatch);
+  auto& buf = host_->value();
+  if (host_->enable_pv()) {
+    copy_host2device(&value_.d_ad_offset, buf.h_ad_offset);
+    copy_host2device(&value_.d_rank, buf.h_rank);
+    copy_host2device(&value_.d_cmatch, buf.h_cmatch);
   }
-  copy_host2device(&value_.d_uint64_lens, buf_.h_uint64_lens);
-  copy_host2device(&value_.d_uint64_keys, buf_.h_uint64_keys);
-  copy_host2device(&value_.d_uint64_offset, buf_.h_uint64_offset);
+  copy_host2device(&value_.d_uint64_lens, buf.h_uint64_lens);
+  copy_host2device(&value_.d_uint64_keys, buf.h_uint64_keys);
+  copy_host2device(&value_.d_uint64_offset, buf.h_uint64_offset);
 
-  copy_host2device(&value_.d_float_lens, buf_.h_float_lens);
-  copy_host2device(&value_.d_float_keys, buf_.h_float_keys);
-  copy_host2device(&value_.d_float_offset, buf_.h_float_offset);
+  copy_host2device(&value_.d_float_lens, buf.h_float_lens);
+  copy_host2device(&value_.d_float_keys, buf.h_float_keys);
+  copy_host2device(&value_.d_float_offset, buf.h_float_offset);
   CUDA_CHECK(cudaStreamSynchronize(stream_));
   trans_timer_.Pause();
 }
@@ -3870,14 +4165,16 @@ void MiniBatchGpuPack::transfer_to_gpu(void) {
 //=========================================
 // pack pcoc q to gpu
 void MiniBatchGpuPack::pack_qvalue(void) {
-  int len = ins_num_ * extend_dim_;
+  int ins_num = host_->ins_num();
+  const SlotRecord* batch_ins = host_->records();
+  int len = ins_num * extend_dim_;
   std::vector<float> qvalue;
   qvalue.resize(len);
 
   int off = 0;
   char* ptr = NULL;
-  for (int i = 0; i < ins_num_; ++i) {
-    ptr = reinterpret_cast<char*>(batch_ins_[i]);
+  for (int i = 0; i < ins_num; ++i) {
+    ptr = reinterpret_cast<char*>(batch_ins[i]);
     float* q = reinterpret_cast<float*>(&ptr[sizeof(SlotRecordObject)]);
     for (int k = 0; k < extend_dim_; ++k) {
       qvalue[off++] = q[k];
@@ -3895,12 +4192,13 @@ void MiniBatchGpuPack::pack_qvalue(void) {
 // store pcoc q value
 void MiniBatchGpuPack::store_qvalue(const std::vector<Tensor>& qvalue) {
   CHECK(static_cast<int>(qvalue.size()) == extend_dim_);
-  SlotRecord* batch_records = const_cast<SlotRecord*>(batch_ins_);
+  int ins_num = host_->ins_num();
+  SlotRecord* batch_records = const_cast<SlotRecord*>(host_->records());
   char* ptr = NULL;
   for (int i = 0; i < extend_dim_; ++i) {
-    CHECK(static_cast<int>(qvalue[i].numel()) == ins_num_);
+    CHECK(static_cast<int>(qvalue[i].numel()) == ins_num);
     const float* q = qvalue[i].data<float>();
-    for (int k = 0; k < ins_num_; ++k) {
+    for (int k = 0; k < ins_num; ++k) {
       ptr = reinterpret_cast<char*>(batch_records[k]);
       reinterpret_cast<float*>(&ptr[sizeof(SlotRecordObject)])[i] = q[k];
     }
@@ -21,6 +21,7 @@ limitations under the License. */
 #include <semaphore.h>
 
 #include <algorithm>
+#include <condition_variable>  // NOLINT
 #include <deque>
 #include <fstream>
 #include <future>  // NOLINT
@@ -44,6 +45,7 @@ limitations under the License. */
 #include "paddle/fluid/framework/lod_tensor.h"
 #include "paddle/fluid/framework/reader.h"
 #include "paddle/fluid/framework/variable.h"
+#include "paddle/fluid/platform/cpu_info.h"
 #include "paddle/fluid/platform/monitor.h"
 #include "paddle/fluid/platform/timer.h"
 #include "paddle/fluid/string/string_helper.h"
@@ -56,6 +58,7 @@ DECLARE_int32(padbox_slotrecord_extend_dim);
 DECLARE_bool(padbox_auc_runner_mode);
 DECLARE_bool(enable_slotrecord_reset_shrink);
 DECLARE_bool(enable_slotpool_wait_release);
+DECLARE_bool(padbox_numa_aware_placement);
 
 namespace paddle {
 namespace framework {
@@ -828,6 +831,8 @@ struct SlotRecordObject {
   uint64_t search_id;
   uint32_t rank;
   uint32_t cmatch;
+  // the numa node of the pool list the record comes from
+  uint32_t numa_node;
   std::string ins_id_;
   SlotValues<uint64_t> slot_uint64_feasigns_;
   SlotValues<float> slot_float_feasigns_;
@@ -847,8 +852,9 @@ inline SlotRecord make_slotrecord() {
       sizeof(float) * FLAGS_padbox_slotrecord_extend_dim +
       sizeof(AucRunnerInfo) * static_cast<int>(FLAGS_padbox_auc_runner_mode);
   void* p = malloc(slot_record_byte_size);
-  new (p) SlotRecordObject;
-  return reinterpret_cast<SlotRecordObject*>(p);
+  auto* record = new (p) SlotRecordObject;
+  record->numa_node = 0;
+  return record;
 }
 
 inline AucRunnerInfo* get_auc_runner_info(SlotRecord record) {
@@ -935,7 +941,15 @@ class SlotObjPool {
  public:
   SlotObjPool()
       : max_capacity_(FLAGS_padbox_record_pool_max_size),
-        alloc_(free_slotrecord) {
+        node_num_(FLAGS_padbox_numa_aware_placement
+                      ? platform::NumaNodeNum()
+                      : 1) {
+    // one list a numa node, so that a reused record and the values it keeps
+    // stay in the memory of the node it was first touched
+    for (int i = 0; i < node_num_; ++i) {
+      alloc_.emplace_back(
+          new SlotObjAllocator<SlotRecordObject>(free_slotrecord));
+    }
     ins_chan_ = MakeChannel<SlotRecord>();
     ins_chan_->SetBlockSize(OBJPOOL_BLOCK_SIZE);
     for (int i = 0; i < FLAGS_padbox_slotpool_thread_num; ++i) {
@@ -957,24 +971,25 @@ class SlotObjPool {
     return get(&(*output)[0], n);
   }
   void get(SlotRecord* output, int n) {
+    int node = (node_num_ > 1) ? platform::CurrentNumaNode() : 0;
+    auto& alloc = *alloc_[node];
     int size = 0;
     mutex_.lock();
-    int left = static_cast<int>(alloc_.capacity());
+    int left = static_cast<int>(alloc.capacity());
     if (left > 0) {
       size = (left >= n) ? n : left;
       for (int i = 0; i < size; ++i) {
-        output[i] = alloc_.acquire();
+        output[i] = alloc.acquire();
       }
     }
     mutex_.unlock();
     count_ += n;
-    if (size == n) {
-      return;
-    }
     for (int i = size; i < n; ++i) {
       output[i] = make_slotrecord();
+      output[i]->numa_node = node;
     }
   }
+  int node_num(void) const { return node_num_; }
   void put(std::vector<SlotRecord>* input) {
     size_t size = input->size();
     if (size == 0) {
@@ -1005,7 +1020,7 @@ class SlotObjPool {
         }
         mutex_.lock();
         for (auto& t : input) {
-          alloc_.release(t);
+          alloc_[t->numa_node % node_num_]->release(t);
         }
         mutex_.unlock();
       }
@@ -1016,7 +1031,9 @@ class SlotObjPool {
     platform::Timer timeline;
     timeline.Start();
     mutex_.lock();
-    alloc_.clear();
+    for (auto& alloc : alloc_) {
+      alloc->clear();
+    }
     mutex_.unlock();
     // wait release channel data
     if (FLAGS_enable_slotpool_wait_release) {
@@ -1029,8 +1046,11 @@ class SlotObjPool {
                  << ", span=" << timeline.ElapsedSec();
   }
   size_t capacity(void) {
+    size_t total = 0;
     mutex_.lock();
-    size_t total = alloc_.capacity();
+    for (auto& alloc : alloc_) {
+      total += alloc->capacity();
+    }
     mutex_.unlock();
     return total;
   }
@@ -1040,7 +1060,8 @@ class SlotObjPool {
   Channel<SlotRecord> ins_chan_;
   std::vector<std::thread> threads_;
   std::mutex mutex_;
-  SlotObjAllocator<SlotRecordObject> alloc_;
+  int node_num_;
+  std::vector<std::unique_ptr<SlotObjAllocator<SlotRecordObject>>> alloc_;
   bool disable_pool_;
   std::atomic<long> count_;  // NOLINT
 };
@@ -1242,6 +1263,68 @@ struct FeasignValuesReplacer {
   }
 };
 
+// The AUC runner overlay of a record: the values of the replaced slots are
+// taken from its candidate when the record is packed, instead of being
+// swapped into the record and back by FeasignValuesReplacer.
+struct FeasignValuesOverlay {
+  // The value number of fea seen through the overlay of slots_idx, which is
+  // sorted.
+  static size_t ValueNum(const FeasignValues& fea,
+                         const FeasignValuesCandidate& candidate,
+                         const std::vector<uint16_t>& slots_idx) {
+    size_t num = fea.slot_values.size();
+    size_t slot_num = fea.slot_offsets.size() - 1;
+    for (auto idx : slots_idx) {
+      if (idx >= slot_num) {
+        break;
+      }
+      num -= fea.slot_offsets[idx + 1] - fea.slot_offsets[idx];
+      num += candidate.feasign_values_.at(idx).size();
+    }
+    return num;
+  }
+
+  // Copy the values and the slot offsets of fea seen through the overlay,
+  // the slots between two replaced slots are copied at once.
+  template <typename OffsetT>
+  static void Copy(const FeasignValues& fea,
+                   const FeasignValuesCandidate& candidate,
+                   const std::vector<uint16_t>& slots_idx, uint64_t* values,
+                   OffsetT* offsets) {
+    const auto& src_offsets = fea.slot_offsets;
+    const uint64_t* src = fea.slot_values.data();
+    size_t slot_num = src_offsets.size() - 1;
+    size_t run_begin = 0;
+    int64_t diff = 0;
+    size_t k = 0;
+    for (size_t idx = 0; idx < slot_num; ++idx) {
+      offsets[idx] = static_cast<OffsetT>(src_offsets[idx] + diff);
+      if (k >= slots_idx.size() || slots_idx[k] != idx) {
+        continue;
+      }
+      size_t run = src_offsets[idx] - run_begin;
+      if (run > 0) {
+        memcpy(values, src + run_begin, run * sizeof(uint64_t));
+        values += run;
+      }
+      const auto& vals = candidate.feasign_values_.at(idx);
+      if (!vals.empty()) {
+        memcpy(values, vals.data(), vals.size() * sizeof(uint64_t));
+        values += vals.size();
+      }
+      diff += static_cast<int64_t>(vals.size()) -
+              static_cast<int64_t>(src_offsets[idx + 1] - src_offsets[idx]);
+      run_begin = src_offsets[idx + 1];
+      ++k;
+    }
+    offsets[slot_num] = static_cast<OffsetT>(src_offsets[slot_num] + diff);
+    size_t run = src_offsets[slot_num] - run_begin;
+    if (run > 0) {
+      memcpy(values, src + run_begin, run * sizeof(uint64_t));
+    }
+  }
+};
+
 struct AllSlotInfo {
   std::string slot;
   std::string type;
@@ -1303,11 +1386,11 @@ struct UsedSlotInfo {
   int total_dims_without_inductive;
   int inductive_shape_index;
 };
-#if defined(PADDLE_WITH_CUDA) && defined(_LINUX)
 struct UsedSlotGpuType {
   int is_uint64_value;
   int slot_value_idx;
 };
+#if defined(PADDLE_WITH_CUDA) && defined(_LINUX)
 #define CUDA_CHECK(val) CHECK(val == cudaSuccess)
 template <typename T>
 struct CudaBuffer {
@@ -1341,16 +1424,20 @@ struct CudaBuffer {
     malloc(size);
   }
 };
+#endif
 template <typename T>
 struct HostBuffer {
   T* host_buffer;
   size_t buf_size;
   size_t data_len;
+  // page locked for the copies to the gpu, plain host memory otherwise
+  bool pinned;
 
   HostBuffer<T>() {
     host_buffer = NULL;
     buf_size = 0;
     data_len = 0;
+    pinned = true;
   }
   ~HostBuffer<T>() { free(); }
 
@@ -1362,15 +1449,36 @@ struct HostBuffer {
 
   T& operator[](size_t i) { return host_buffer[i]; }
   const T& operator[](size_t i) const { return host_buffer[i]; }
+  void set_pinned(bool value) {
+    CHECK(host_buffer == NULL);
+    pinned = value;
+  }
   void malloc(size_t len) {
     buf_size = len;
-    CUDA_CHECK(cudaHostAlloc(reinterpret_cast<void**>(&host_buffer),
-                             buf_size * sizeof(T), cudaHostAllocDefault));
+#if defined(PADDLE_WITH_CUDA) && defined(_LINUX)
+    if (pinned) {
+      CUDA_CHECK(cudaHostAlloc(reinterpret_cast<void**>(&host_buffer),
+                               buf_size * sizeof(T), cudaHostAllocDefault));
+      CHECK(host_buffer != NULL);
+      return;
+    }
+#endif
+    void* ptr = NULL;
+    CHECK(posix_memalign(&ptr, 64, buf_size * sizeof(T)) == 0);
+    host_buffer = reinterpret_cast<T*>(ptr);
     CHECK(host_buffer != NULL);
   }
   void free() {
     if (host_buffer != NULL) {
-      CUDA_CHECK(cudaFreeHost(host_buffer));
+#if defined(PADDLE_WITH_CUDA) && defined(_LINUX)
+      if (pinned) {
+        CUDA_CHECK(cudaFreeHost(host_buffer));
+      } else {
+        ::free(host_buffer);
+      }
+#else
+      ::free(host_buffer);
+#endif
       host_buffer = NULL;
     }
     buf_size = 0;
@@ -1398,8 +1506,111 @@ struct BatchCPUValue {
   HostBuffer<int> h_rank;
   HostBuffer<int> h_cmatch;
   HostBuffer<int> h_ad_offset;
+
+  void set_pinned(bool pinned) {
+    h_uint64_lens.set_pinned(pinned);
+    h_uint64_keys.set_pinned(pinned);
+    h_uint64_offset.set_pinned(pinned);
+    h_float_lens.set_pinned(pinned);
+    h_float_keys.set_pinned(pinned);
+    h_float_offset.set_pinned(pinned);
+    h_rank.set_pinned(pinned);
+    h_cmatch.set_pinned(pinned);
+    h_ad_offset.set_pinned(pinned);
+  }
+};
+
+// The host stage of packing a batch: the values of the used slots of the
+// records are gathered into contiguous buffers, which the gpu pack copies to
+// the device, or which are copied into the host tensors of the slots.
+class MiniBatchHostPack {
+ public:
+  // the buffers of a pinned pack are page locked for the copies to the gpu
+  explicit MiniBatchHostPack(const std::vector<UsedSlotInfo>& infos,
+                             bool pinned = false);
+  void reset(void);
+  void pack_pvinstance(const SlotPvInstance* pv_ins, int num);
+  void pack_instance(const SlotRecord* ins_vec, int num);
+  // the value offsets of the instances in every used slot, computed for the
+  // slots in parallel, slot_offsets()[j * (ins_num + 1) + i] is the first
+  // value of the instance i in the used slot j
+  void pack_slot_offsets(void);
+  const std::vector<size_t>& slot_offsets(void) const { return slot_offsets_; }
+  // copy the packed values of the used slot j after pack_slot_offsets, the
+  // uint64 values are 8 bytes, the float values are 4 bytes
+  void copy_slot_values(int j, void* dest) const;
+
+  int ins_num(void) const { return ins_num_; }
+  int pv_num(void) const { return pv_num_; }
+  bool enable_pv(void) const { return enable_pv_; }
+  int used_uint64_num(void) const { return used_uint64_num_; }
+  int used_float_num(void) const { return used_float_num_; }
+  BatchCPUValue& value(void) { return buf_; }
+  const SlotRecord* records(void) const { return batch_ins_; }
+  SlotRecord* get_records(void) { return &ins_vec_[0]; }
+  // the pack time since the last reset
+  double pack_time_span(void) { return pack_timer_.ElapsedSec(); }
+
+ private:
+  void pack_all_data(const SlotRecord* ins_vec, int num);
+  void pack_uint64_data(const SlotRecord* ins_vec, int num);
+  void pack_float_data(const SlotRecord* ins_vec, int num);
+  // pack the uint64 slots with the auc runner replaced slots overlaid
+  void pack_uint64_overlay(const SlotRecord* ins_vec, int num,
+                           const std::vector<uint16_t>& slots);
+
+ private:
+  BatchCPUValue buf_;
+  int ins_num_ = 0;
+  int pv_num_ = 0;
+  bool enable_pv_ = false;
+  int used_float_num_ = 0;
+  int used_uint64_num_ = 0;
+  std::vector<UsedSlotGpuType> used_slots_;
+  std::vector<SlotRecord> ins_vec_;
+  const SlotRecord* batch_ins_ = nullptr;
+  std::vector<size_t> slot_offsets_;
+  platform::Timer pack_timer_;
 };
 
+// Packs the batches of a reader on the host ahead of the trainer. The host
+// packs make a ring, the pack threads fill them in the batch order and the
+// trainer takes them when they are ready.
+class MiniBatchPackPrefetcher {
+ public:
+  MiniBatchPackPrefetcher(const std::vector<UsedSlotInfo>& infos, int depth,
+                          int thread_num, bool pinned = false);
+  ~MiniBatchPackPrefetcher() { stop(); }
+  // pack the batches [begin, batches.size()) of the records
+  void start(const SlotRecord* records,
+             const std::vector<std::pair<int, int>>& batches, size_t begin);
+  // the host pack of the next batch, which is valid until the next call,
+  // nullptr after the last batch
+  MiniBatchHostPack* next(void);
+  void stop(void);
+  double wait_time_span(void) { return wait_timer_.ElapsedSec(); }
+
+ private:
+  void run(void);
+
+  int thread_num_;
+  std::vector<std::unique_ptr<MiniBatchHostPack>> packs_;
+  std::vector<bool> ready_;
+  const SlotRecord* records_ = nullptr;
+  std::vector<std::pair<int, int>> batches_;
+  // the next batch to pack, the next batch to hand off, and the number of
+  // batches whose packs can be refilled
+  size_t next_pack_ = 0;
+  size_t next_consume_ = 0;
+  size_t released_ = 0;
+  bool stop_ = true;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::vector<std::thread> threads_;
+  platform::Timer wait_timer_;
+};
+
+#if defined(PADDLE_WITH_CUDA) && defined(_LINUX)
 struct BatchGPUValue {
   CudaBuffer<int> d_uint64_lens;
   CudaBuffer<uint64_t> d_uint64_keys;
@@ -1423,27 +1634,35 @@ class MiniBatchGpuPack {
   void reset(const paddle::platform::Place& place);
   void pack_pvinstance(const SlotPvInstance* pv_ins, int num);
   void pack_instance(const SlotRecord* ins_vec, int num);
-  int ins_num() { return ins_num_; }
-  int pv_num() { return pv_num_; }
+  // copy a batch packed on the host to the gpu, the host pack is used until
+  // the next batch
+  void transfer(MiniBatchHostPack* host);
+  int ins_num() { return host_->ins_num(); }
+  int pv_num() { return host_->pv_num(); }
   BatchGPUValue& value() { return value_; }
-  BatchCPUValue& cpu_value() { return buf_; }
+  BatchCPUValue& cpu_value() { return host_->value(); }
   UsedSlotGpuType* get_gpu_slots(void) {
     return reinterpret_cast<UsedSlotGpuType*>(gpu_slots_.data());
   }
-  SlotRecord* get_records(void) { return &ins_vec_[0]; }
-  double pack_time_span(void) { return pack_timer_.ElapsedSec(); }
+  SlotRecord* get_records(void) { return host_->get_records(); }
+  // the pack time of the batches packed on the trainer thread and on the
+  // pack threads
+  double pack_time_span(void) {
+    return sync_pack_->pack_time_span() + prefetch_pack_time_;
+  }
   double trans_time_span(void) { return trans_timer_.ElapsedSec(); }
 
   // tensor gpu memory reused
   void resize_tensor(void) {
+    auto& buf = host_->value();
     if (used_float_num_ > 0) {
-      int float_total_len = buf_.h_float_lens.back();
+      int float_total_len = buf.h_float_lens.back();
       if (float_total_len > 0) {
         float_tensor_.mutable_data<float>({float_total_len, 1}, this->place_);
       }
     }
     if (used_uint64_num_ > 0) {
-      int uint64_total_len = buf_.h_uint64_lens.back();
+      int uint64_total_len = buf.h_uint64_lens.back();
       if (uint64_total_len > 0) {
         uint64_tensor_.mutable_data<int64_t>({uint64_total_len, 1},
                                              this->place_);
@@ -1472,10 +1691,7 @@ class MiniBatchGpuPack {
     }
   }
   const std::string& get_lineid(int idx) {
-    if (enable_pv_) {
-      return ins_vec_[idx]->ins_id_;
-    }
-    return batch_ins_[idx]->ins_id_;
+    return host_->records()[idx]->ins_id_;
   }
   // store pcoc q value
   void store_qvalue(const std::vector<Tensor>& qvalue);
@@ -1484,9 +1700,6 @@ class MiniBatchGpuPack {
 
  private:
   void transfer_to_gpu(void);
-  void pack_all_data(const SlotRecord* ins_vec, int num);
-  void pack_uint64_data(const SlotRecord* ins_vec, int num);
-  void pack_float_data(const SlotRecord* ins_vec, int num);
 
  public:
   template <typename T>
@@ -1507,21 +1720,19 @@ class MiniBatchGpuPack {
   paddle::platform::Place place_;
   cudaStream_t stream_;
   BatchGPUValue value_;
-  BatchCPUValue buf_;
-  int ins_num_ = 0;
-  int pv_num_ = 0;
+  // the host pack of the batches packed on the trainer thread, and the host
+  // pack of the current batch
+  std::unique_ptr<MiniBatchHostPack> sync_pack_;
+  MiniBatchHostPack* host_ = nullptr;
+  double prefetch_pack_time_ = 0;
 
-  bool enable_pv_ = false;
   int used_float_num_ = 0;
   int used_uint64_num_ = 0;
   int used_slot_size_ = 0;
 
   CudaBuffer<UsedSlotGpuType> gpu_slots_;
   std::vector<UsedSlotGpuType> gpu_used_slots_;
-  std::vector<SlotRecord> ins_vec_;
-  const SlotRecord* batch_ins_ = nullptr;
 
-  platform::Timer pack_timer_;
   platform::Timer trans_timer_;
 
   // uint64 tensor
@@ -1589,6 +1800,11 @@ class SlotPaddleBoxDataFeed : public DataFeed {
  public:
   SlotPaddleBoxDataFeed() { finish_start_ = false; }
   virtual ~SlotPaddleBoxDataFeed() {
+    if (prefetcher_ != nullptr) {
+      prefetcher_->stop();
+      LOG(WARNING) << "thread: " << thread_id_ << ", pack prefetch wait time: "
+                   << prefetcher_->wait_time_span() << "sec";
+    }
 #if defined(PADDLE_WITH_CUDA) && defined(_LINUX)
     if (pack_ != nullptr) {
       LOG(WARNING) << "gpu: "
@@ -1663,6 +1879,7 @@ class SlotPaddleBoxDataFeed : public DataFeed {
   virtual void LoadIntoMemoryByLib(void);
   void PutToFeedPvVec(const SlotPvInstance* pvs, int num);
   void PutToFeedSlotVec(const SlotRecord* recs, int num);
+  void PutToFeedHostPack(MiniBatchHostPack* pack);
   void BuildSlotBatchGPU(const int ins_num);
   void GetRankOffsetGPU(const int pv_num, const int ins_num);
   void GetRankOffset(const SlotPvInstance* pv_vec, int pv_num, int ins_number);
@@ -1705,8 +1922,6 @@ class SlotPaddleBoxDataFeed : public DataFeed {
   std::shared_ptr<FILE> fp_ = nullptr;
   ChannelObject<SlotRecord>* input_channel_ = nullptr;
 
-  std::vector<std::vector<float>> batch_float_feasigns_;
-  std::vector<std::vector<uint64_t>> batch_uint64_feasigns_;
   std::vector<std::vector<size_t>> offset_;
   std::vector<int> float_total_dims_without_inductives_;
   size_t float_total_dims_size_ = 0;
@@ -1720,6 +1935,10 @@ class SlotPaddleBoxDataFeed : public DataFeed {
 #if defined(PADDLE_WITH_CUDA) && defined(_LINUX)
   MiniBatchGpuPack* pack_ = nullptr;
 #endif
+  // the host pack of the batches packed on the reader thread
+  std::unique_ptr<MiniBatchHostPack> host_pack_;
+  std::unique_ptr<MiniBatchPackPrefetcher> prefetcher_;
+  bool prefetching_ = false;
   int offset_index_ = 0;
   std::vector<std::pair<int, int>> batch_offsets_;
   SlotPvInstance* pv_ins_ = nullptr;
@@ -0,0 +1,194 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/framework/data_feed.h"
+
+namespace paddle {
+namespace framework {
+
+#ifdef PADDLE_WITH_BOX_PS
+const int kRecordNum = 50;
+
+// uint64 slot s of record i holds (i + s) % 3 values i * 100 + s * 10 + k,
+// the float slot holds i % 2 values
+static std::vector<SlotRecord> MakeRecords() {
+  std::vector<SlotRecord> records;
+  for (int i = 0; i < kRecordNum; ++i) {
+    auto rec = make_slotrecord();
+    for (int s = 0; s < 2; ++s) {
+      std::vector<uint64_t> values;
+      for (int k = 0; k < (i + s) % 3; ++k) {
+        values.push_back(i * 100 + s * 10 + k);
+      }
+      rec->slot_uint64_feasigns_.add_values(values.data(), values.size());
+    }
+    std::vector<float> values(i % 2, i + 0.5f);
+    rec->slot_float_feasigns_.add_values(values.data(), values.size());
+    records.push_back(rec);
+  }
+  return records;
+}
+
+// the used slots are the second uint64 slot, the float slot and the first
+// uint64 slot
+static std::vector<UsedSlotInfo> MakeUsedSlots() {
+  std::vector<UsedSlotInfo> infos(3);
+  infos[0].slot_value_idx = 1;
+  infos[0].type = "uint64";
+  infos[1].slot_value_idx = 0;
+  infos[1].type = "float";
+  infos[2].slot_value_idx = 0;
+  infos[2].type = "uint64";
+  return infos;
+}
+
+static void CheckPack(MiniBatchHostPack* pack, int begin, int num) {
+  ASSERT_EQ(pack->ins_num(), num);
+  const auto& offsets = pack->slot_offsets();
+  ASSERT_EQ(offsets.size(), static_cast<size_t>(3 * (num + 1)));
+  for (int j = 0; j < 3; ++j) {
+    const size_t* slot_offsets = &offsets[j * (num + 1)];
+    std::vector<uint64_t> values(slot_offsets[num]);
+    pack->copy_slot_values(j, values.data());
+    const float* float_values = reinterpret_cast<const float*>(values.data());
+    for (int i = 0; i < num; ++i) {
+      int rec = begin + i;
+      int s = (j == 0) ? 1 : 0;
+      size_t expect_num = (j == 1) ? rec % 2 : (rec + s) % 3;
+      ASSERT_EQ(slot_offsets[i + 1] - slot_offsets[i], expect_num);
+      for (size_t k = 0; k < expect_num; ++k) {
+        if (j == 1) {
+          EXPECT_EQ(float_values[slot_offsets[i] + k], rec + 0.5f);
+        } else {
+          EXPECT_EQ(values[slot_offsets[i] + k], rec * 100 + s * 10 + k);
+        }
+      }
+    }
+  }
+}
+
+TEST(MiniBatchHostPack, pack_slot_offsets) {
+  auto records = MakeRecords();
+  MiniBatchHostPack pack(MakeUsedSlots());
+  pack.pack_instance(&records[7], 20);
+  pack.pack_slot_offsets();
+  CheckPack(&pack, 7, 20);
+  for (auto rec : records) {
+    free_slotrecord(rec);
+  }
+}
+
+TEST(MiniBatchPackPrefetcher, batch_order) {
+  auto records = MakeRecords();
+  std::vector<std::pair<int, int>> batches;
+  for (int begin = 0; begin < kRecordNum; begin += 7) {
+    batches.emplace_back(begin, std::min(7, kRecordNum - begin));
+  }
+  MiniBatchPackPrefetcher prefetcher(MakeUsedSlots(), 3, 2);
+  // restart in the middle of the batches, as a new pass does
+  for (size_t begin : {size_t(0), size_t(3)}) {
+    prefetcher.start(&records[0], batches, begin);
+    for (size_t k = begin; k < batches.size(); ++k) {
+      auto* pack = prefetcher.next();
+      ASSERT_TRUE(pack != nullptr);
+      pack->pack_slot_offsets();
+      CheckPack(pack, batches[k].first, batches[k].second);
+    }
+    EXPECT_TRUE(prefetcher.next() == nullptr);
+  }
+  prefetcher.start(&records[0], batches, 0);
+  prefetcher.next();
+  prefetcher.stop();
+  for (auto rec : records) {
+    free_slotrecord(rec);
+  }
+}
+
+// slot s of the record holds s % 3 values s * 10 + k
+static FeasignValues MakeFeasignValues(int slot_num) {
+  FeasignValues fea;
+  for (int s = 0; s < slot_num; ++s) {
+    std::vector<uint64_t> values;
+    for (int k = 0; k < s % 3; ++k) {
+      values.push_back(s * 10 + k);
+    }
+    fea.add_values(values.data(), values.size());
+  }
+  return fea;
+}
+
+// the overlay of the candidate on the slots must read as the record after
+// FeasignValuesReplacer::replace
+static void CheckOverlay(const FeasignValuesCandidate& candidate,
+                         const std::set<uint16_t>& slots) {
+  const int slot_num = 6;
+  FeasignValues fea = MakeFeasignValues(slot_num);
+  FeasignValues expect = fea;
+  FeasignValuesReplacer replacer;
+  int del_num = 0;
+  int add_num = 0;
+  replacer.replace(&expect, candidate.feasign_values_, slots, &del_num,
+                   &add_num);
+
+  std::vector<uint16_t> slots_idx(slots.begin(), slots.end());
+  size_t num = FeasignValuesOverlay::ValueNum(fea, candidate, slots_idx);
+  ASSERT_EQ(num, expect.slot_values.size());
+  // a guard value after the values catches a copy past the end
+  std::vector<uint64_t> values(num + 1, 12345);
+  std::vector<size_t> offsets(slot_num + 1);
+  FeasignValuesOverlay::Copy(fea, candidate, slots_idx, values.data(),
+                             offsets.data());
+  EXPECT_EQ(values.back(), 12345UL);
+  values.pop_back();
+  EXPECT_EQ(values, expect.slot_values);
+  for (int s = 0; s <= slot_num; ++s) {
+    EXPECT_EQ(offsets[s], expect.slot_offsets[s]);
+  }
+}
+
+TEST(FeasignValuesOverlay, empty_candidate) {
+  FeasignValuesCandidate candidate;
+  candidate.feasign_values_[1] = {};
+  candidate.feasign_values_[2] = {};
+  CheckOverlay(candidate, {1, 2});
+  CheckOverlay(FeasignValuesCandidate(), {});
+}
+
+TEST(FeasignValuesOverlay, replaced_last_slot) {
+  FeasignValuesCandidate candidate;
+  candidate.feasign_values_[0] = {7};
+  candidate.feasign_values_[5] = {8, 9, 10};
+  CheckOverlay(candidate, {0, 5});
+  candidate.feasign_values_[5] = {};
+  CheckOverlay(candidate, {0, 5});
+}
+
+TEST(FeasignValuesOverlay, adjacent_replaced_slots) {
+  FeasignValuesCandidate candidate;
+  candidate.feasign_values_[2] = {1, 2, 3};
+  candidate.feasign_values_[3] = {};
+  candidate.feasign_values_[4] = {4};
+  CheckOverlay(candidate, {2, 3, 4});
+}
+#endif
+
+}  // namespace framework
+}  // namespace paddle
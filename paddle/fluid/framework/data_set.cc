@@ -15,7 +15,12 @@
 #include "paddle/fluid/framework/data_set.h"
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iterator>
 #include <random>
+#include <sstream>
+#include <thread>  // NOLINT
 #include <unordered_map>
 #include <unordered_set>
 
@@ -26,6 +31,13 @@
 #include "paddle/fluid/framework/fleet/box_wrapper.h"
 #include "paddle/fluid/framework/fleet/fleet_wrapper.h"
 #include "paddle/fluid/framework/io/fs.h"
+#include "paddle/fluid/framework/shuffle_sender.h"
+#include "paddle/fluid/platform/cpu_info.h"
+#ifdef PADDLE_WITH_CUDA
+#include "paddle/fluid/platform/gpu_info.h"
+#endif
+#include "paddle/fluid/platform/hot_path_trace.h"
+#include "paddle/fluid/platform/metrics.h"
 #include "paddle/fluid/platform/monitor.h"
 #include "paddle/fluid/platform/timer.h"
 #include "xxhash.h"  // NOLINT
@@ -38,10 +50,55 @@
 DECLARE_bool(padbox_dataset_disable_shuffle);
 DECLARE_bool(padbox_dataset_disable_polling);
 DECLARE_bool(padbox_dataset_enable_unrollinstance);
+DECLARE_int32(global_shuffle_message_kb);
+DECLARE_int32(global_shuffle_max_inflight_mb);
 
 namespace paddle {
 namespace framework {
 
+size_t InsIdMergePartition(const std::string& ins_id, size_t partition_num) {
+  const uint64_t kMergePartitionSeed = 0x9e3779b97f4a7c15ULL;
+  return XXH64(ins_id.data(), ins_id.length(), kMergePartitionSeed) %
+         partition_num;
+}
+
+int64_t PlaceBatchesOnNodes(const std::vector<int64_t>& node_begin,
+                            const std::vector<int>& reader_nodes,
+                            std::vector<std::pair<int, int>>* offset) {
+  int node_num = static_cast<int>(node_begin.size()) - 1;
+  if (node_num <= 1 || offset->empty()) {
+    return 0;
+  }
+  std::vector<std::deque<size_t>> node_batches(node_num);
+  for (size_t i = 0; i < offset->size(); ++i) {
+    int node = node_num - 1;
+    while (node > 0 && node_begin[node] > (*offset)[i].first) {
+      --node;
+    }
+    node_batches[node].push_back(i);
+  }
+
+  int64_t remote_num = 0;
+  std::vector<std::pair<int, int>> placed;
+  placed.reserve(offset->size());
+  for (size_t i = 0; i < offset->size(); ++i) {
+    int node = reader_nodes[i % reader_nodes.size()];
+    int from = node;
+    while (node_batches[from].empty()) {
+      from = (from + 1) % node_num;
+    }
+    auto& batch = (*offset)[node_batches[from].front()];
+    node_batches[from].pop_front();
+    int64_t local_begin = std::max<int64_t>(batch.first, node_begin[node]);
+    int64_t local_end =
+        std::min<int64_t>(batch.first + batch.second, node_begin[node + 1]);
+    remote_num += batch.second - std::max<int64_t>(0, local_end - local_begin);
+    placed.push_back(batch);
+  }
+  offset->swap(placed);
+  return remote_num;
+}
+
 // constructor
 template <typename T>
 DatasetImpl<T>::DatasetImpl() {
@@ -406,16 +463,9 @@ void DatasetImpl<T>::GlobalShuffle(int thread_num) {
     return;
   }
 
-  // local shuffle
-  input_channel_->Close();
-  std::vector<T> data;
-  input_channel_->ReadAll(data);
-  std::shuffle(data.begin(), data.end(), fleet_ptr->LocalRandomEngine());
-  input_channel_->Open();
-  input_channel_->Write(std::move(data));
-  data.clear();
-  data.shrink_to_fit();
-
+  // the records of a block are shuffled as they are read instead of a
+  // local shuffle of the whole channel, the receivers mix the messages of
+  // all the senders anyway
   input_channel_->Close();
   input_channel_->SetBlockSize(fleet_send_batch_size_);
   VLOG(3) << "DatasetImpl<T>::GlobalShuffle() input_channel_ size "
@@ -430,43 +480,42 @@ void DatasetImpl<T>::GlobalShuffle(int thread_num) {
     }
   };
 
-  auto global_shuffle_func = [this, get_client_id]() {
+  // the sends to a trainer are bounded by the bytes in flight, so the
+  // serialization overlaps the sends without overwhelming the receivers
+  ShuffleSender sender(
+      trainer_num_,
+      static_cast<size_t>(FLAGS_global_shuffle_max_inflight_mb) << 20,
+      [fleet_ptr](int dest, const std::string& msg) {
+        return fleet_ptr->SendClientToClientMsg(0, dest, msg);
+      });
+  size_t message_bytes = static_cast<size_t>(FLAGS_global_shuffle_message_kb)
+                         << 10;
+
+  auto global_shuffle_func = [this, get_client_id, &sender, message_bytes]() {
     auto fleet_ptr = FleetWrapper::GetInstance();
+    // a message is allocated on its first record, so that a thread only
+    // holds buffers for the trainers it sends to
+    std::vector<std::unique_ptr<ShuffleMessage>> msgs(this->trainer_num_);
     std::vector<T> data;
     while (this->input_channel_->Read(data)) {
-      std::vector<paddle::framework::BinaryArchive> ars(this->trainer_num_);
+      std::shuffle(data.begin(), data.end(), fleet_ptr->LocalRandomEngine());
       for (auto& t : data) {
         auto client_id = get_client_id(t);
-        ars[client_id] << t;
-      }
-      std::vector<std::future<int32_t>> total_status;
-      std::vector<int> send_index(this->trainer_num_);
-      for (int i = 0; i < this->trainer_num_; ++i) {
-        send_index[i] = i;
-      }
-      std::shuffle(send_index.begin(), send_index.end(),
-                   fleet_ptr->LocalRandomEngine());
-      for (int index = 0; index < this->trainer_num_; ++index) {
-        int i = send_index[index];
-        if (ars[i].Length() == 0) {
-          continue;
+        if (msgs[client_id] == nullptr) {
+          msgs[client_id].reset(new ShuffleMessage(message_bytes));
+        }
+        auto& msg = *msgs[client_id];
+        msg.Append(t);
+        if (msg.Full()) {
+          sender.Send(client_id, msg.Finish());
+          msg.Reset();
         }
-        std::string msg(ars[i].Buffer(), ars[i].Length());
-        auto ret = fleet_ptr->SendClientToClientMsg(0, i, msg);
-        total_status.push_back(std::move(ret));
-      }
-      for (auto& t : total_status) {
-        t.wait();
       }
-      ars.clear();
-      ars.shrink_to_fit();
       data.clear();
-      data.shrink_to_fit();
-      // currently we find bottleneck is server not able to handle large data
-      // in time, so we can remove this sleep and set fleet_send_batch_size to
-      // 1024, and set server thread to 24.
-      if (fleet_send_sleep_seconds_ != 0) {
-        sleep(this->fleet_send_sleep_seconds_);
+    }
+    for (int i = 0; i < this->trainer_num_; ++i) {
+      if (msgs[i] != nullptr && !msgs[i]->Empty()) {
+        sender.Send(i, msgs[i]->Finish());
       }
     }
   };
@@ -484,8 +533,15 @@ void DatasetImpl<T>::GlobalShuffle(int thread_num) {
   }
   global_shuffle_threads.clear();
   global_shuffle_threads.shrink_to_fit();
+  int failed_num = sender.Finish();
+  if (failed_num != 0) {
+    LOG(WARNING) << "DatasetImpl<T>::GlobalShuffle() " << failed_num
+                 << " sends failed";
+  }
   input_channel_->Clear();
   timeline.Pause();
+  VLOG(3) << "DatasetImpl<T>::GlobalShuffle() peak inflight bytes="
+          << sender.peak_inflight_bytes();
   VLOG(3) << "DatasetImpl<T>::GlobalShuffle() end, cost time="
           << timeline.ElapsedSec() << " seconds";
 #endif
@@ -1011,6 +1067,179 @@ void MultiSlotDataset::GenerateLocalTablesUnlock(int table_id, int feadim,
   fleet_ptr_->PullSparseToLocal(table_id, feadim);
 }
 
+namespace {
+
+// InsIdMerger merges the records of an ins_id into one. Its scratch is
+// indexed by the slots and reused by all the ins_ids merged by a thread.
+class InsIdMerger {
+ public:
+  explicit InsIdMerger(const std::vector<bool>& use_slots_is_dense)
+      : is_dense_(use_slots_is_dense),
+        has_dense_uint64_(is_dense_.size(), false),
+        has_dense_float_(is_dense_.size(), false),
+        dense_uint64_(is_dense_.size()),
+        dense_float_(is_dense_.size()),
+        local_dense_uint64_(is_dense_.size()),
+        local_dense_float_(is_dense_.size()),
+        local_touched_(is_dense_.size(), false),
+        local_replace_(is_dense_.size(), false),
+        uint64_owner_(is_dense_.size(), -1),
+        float_owner_(is_dense_.size(), -1) {}
+
+  // Merge the records [begin, end) into rec, return false with the slot
+  // if a sparse slot is held by two records.
+  bool Merge(Record* begin, Record* end, Record* rec, uint16_t* conflict_slot) {
+    MergeDense(begin, end, rec);
+    bool ok = MergeSparse(begin, end, rec, conflict_slot);
+    Reset();
+    return ok;
+  }
+
+ private:
+  // The dense features of a slot are taken from the first record holding
+  // the slot, a later record replaces them if it holds a non zero value.
+  void MergeDense(Record* begin, Record* end, Record* rec) {
+    for (Record* r = begin; r != end; ++r) {
+      for (auto& feature : r->uint64_feasigns_) {
+        uint16_t slot = feature.slot();
+        if (!is_dense_[slot]) {
+          continue;
+        }
+        TouchLocal(slot);
+        local_dense_uint64_[slot].push_back(feature);
+        if (feature.sign().uint64_feasign_ != 0 || !has_dense_uint64_[slot]) {
+          local_replace_[slot] = true;
+        }
+      }
+      for (auto& feature : r->float_feasigns_) {
+        uint16_t slot = feature.slot();
+        if (!is_dense_[slot]) {
+          continue;
+        }
+        TouchLocal(slot);
+        local_dense_float_[slot].push_back(feature);
+        if (fabs(feature.sign().float_feasign_) >= 1e-6 ||
+            !has_dense_float_[slot]) {
+          local_replace_[slot] = true;
+        }
+      }
+      for (uint16_t slot : local_slots_) {
+        if (local_replace_[slot]) {
+          if (!local_dense_uint64_[slot].empty()) {
+            AddDenseSlot(slot);
+            dense_uint64_[slot].swap(local_dense_uint64_[slot]);
+            has_dense_uint64_[slot] = true;
+          } else {
+            AddDenseSlot(slot);
+            dense_float_[slot].swap(local_dense_float_[slot]);
+            has_dense_float_[slot] = true;
+          }
+        }
+        local_dense_uint64_[slot].clear();
+        local_dense_float_[slot].clear();
+        local_touched_[slot] = false;
+        local_replace_[slot] = false;
+      }
+      local_slots_.clear();
+    }
+    for (uint16_t slot : dense_slots_) {
+      rec->uint64_feasigns_.insert(rec->uint64_feasigns_.end(),
+                                   dense_uint64_[slot].begin(),
+                                   dense_uint64_[slot].end());
+    }
+    for (uint16_t slot : dense_slots_) {
+      rec->float_feasigns_.insert(rec->float_feasigns_.end(),
+                                  dense_float_[slot].begin(),
+                                  dense_float_[slot].end());
+    }
+  }
+
+  // A sparse slot is taken from the only record holding it.
+  bool MergeSparse(Record* begin, Record* end, Record* rec,
+                   uint16_t* conflict_slot) {
+    int index = 0;
+    for (Record* r = begin; r != end; ++r, ++index) {
+      if (!TakeSparse(&r->uint64_feasigns_, index, &uint64_owner_,
+                      &rec->uint64_feasigns_, conflict_slot) ||
+          !TakeSparse(&r->float_feasigns_, index, &float_owner_,
+                      &rec->float_feasigns_, conflict_slot)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool TakeSparse(std::vector<FeatureItem>* features, int index,
+                  std::vector<int>* owner, std::vector<FeatureItem>* out,
+                  uint16_t* conflict_slot) {
+    for (auto& feature : *features) {
+      uint16_t slot = feature.slot();
+      if (is_dense_[slot]) {
+        continue;
+      }
+      int& slot_owner = (*owner)[slot];
+      if (slot_owner >= 0 && slot_owner != index) {
+        *conflict_slot = slot;
+        return false;
+      }
+      if (slot_owner < 0) {
+        slot_owner = index;
+        owned_slots_.push_back(slot);
+      }
+      out->push_back(std::move(feature));
+    }
+    return true;
+  }
+
+  void TouchLocal(uint16_t slot) {
+    if (!local_touched_[slot]) {
+      local_touched_[slot] = true;
+      local_slots_.push_back(slot);
+    }
+  }
+
+  void AddDenseSlot(uint16_t slot) {
+    if (!has_dense_uint64_[slot] && !has_dense_float_[slot]) {
+      dense_slots_.push_back(slot);
+    }
+  }
+
+  void Reset() {
+    for (uint16_t slot : dense_slots_) {
+      dense_uint64_[slot].clear();
+      dense_float_[slot].clear();
+      has_dense_uint64_[slot] = false;
+      has_dense_float_[slot] = false;
+    }
+    dense_slots_.clear();
+    for (uint16_t slot : owned_slots_) {
+      uint64_owner_[slot] = -1;
+      float_owner_[slot] = -1;
+    }
+    owned_slots_.clear();
+  }
+
+  const std::vector<bool>& is_dense_;
+  // the dense features of the ins_id
+  std::vector<bool> has_dense_uint64_;
+  std::vector<bool> has_dense_float_;
+  std::vector<std::vector<FeatureItem>> dense_uint64_;
+  std::vector<std::vector<FeatureItem>> dense_float_;
+  std::vector<uint16_t> dense_slots_;
+  // the dense features of the record in merging
+  std::vector<std::vector<FeatureItem>> local_dense_uint64_;
+  std::vector<std::vector<FeatureItem>> local_dense_float_;
+  std::vector<bool> local_touched_;
+  std::vector<bool> local_replace_;
+  std::vector<uint16_t> local_slots_;
+  // the index of the record holding a sparse slot, -1 if none
+  std::vector<int> uint64_owner_;
+  std::vector<int> float_owner_;
+  std::vector<uint16_t> owned_slots_;
+};
+
+}  // namespace
+
 void MultiSlotDataset::MergeByInsId() {
   VLOG(3) << "MultiSlotDataset::MergeByInsId begin";
   if (!merge_by_insid_) {
@@ -1028,182 +1257,98 @@ void MultiSlotDataset::MergeByInsId() {
     }
   }
   CHECK(multi_output_channel_.size() != 0);  // NOLINT
-  auto channel_data = paddle::framework::MakeChannel<Record>();
-  VLOG(3) << "multi_output_channel_.size() " << multi_output_channel_.size();
-  for (size_t i = 0; i < multi_output_channel_.size(); ++i) {
-    std::vector<Record> vec_data;
-    multi_output_channel_[i]->Close();
-    multi_output_channel_[i]->ReadAll(vec_data);
-    channel_data->Write(std::move(vec_data));
-    vec_data.clear();
-    vec_data.shrink_to_fit();
-    multi_output_channel_[i]->Clear();
+  // the records are partitioned by the hash of ins_id, a thread merges the
+  // records of a partition into the output channel of the partition
+  size_t partition_num = multi_output_channel_.size();
+  VLOG(3) << "multi_output_channel_.size() " << partition_num;
+  // partitions[i][p] holds the records of channel i in partition p
+  std::vector<std::vector<std::vector<Record>>> partitions(
+      partition_num, std::vector<std::vector<Record>>(partition_num));
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < partition_num; ++i) {
+    threads.emplace_back([this, i, partition_num, &partitions]() {
+      std::vector<Record> vec_data;
+      multi_output_channel_[i]->Close();
+      multi_output_channel_[i]->ReadAll(vec_data);
+      multi_output_channel_[i]->Clear();
+      for (auto& rec : vec_data) {
+        size_t p = InsIdMergePartition(rec.ins_id_, partition_num);
+        partitions[i][p].push_back(std::move(rec));
+      }
+    });
   }
-  channel_data->Close();
-  std::vector<Record> recs;
-  recs.reserve(channel_data->Size());
-  channel_data->ReadAll(recs);
-  channel_data->Clear();
-  std::sort(recs.begin(), recs.end(), [](const Record& a, const Record& b) {
-    return a.ins_id_ < b.ins_id_;
-  });
-
-  std::vector<Record> results;
-  uint64_t drop_ins_num = 0;
-  std::unordered_set<uint16_t> all_int64;
-  std::unordered_set<uint16_t> all_float;
-  std::unordered_set<uint16_t> local_uint64;
-  std::unordered_set<uint16_t> local_float;
-  std::unordered_map<uint16_t, std::vector<FeatureItem>> all_dense_uint64;
-  std::unordered_map<uint16_t, std::vector<FeatureItem>> all_dense_float;
-  std::unordered_map<uint16_t, std::vector<FeatureItem>> local_dense_uint64;
-  std::unordered_map<uint16_t, std::vector<FeatureItem>> local_dense_float;
-  std::unordered_map<uint16_t, bool> dense_empty;
-
-  VLOG(3) << "recs.size() " << recs.size();
-  for (size_t i = 0; i < recs.size();) {
-    size_t j = i + 1;
-    while (j < recs.size() && recs[j].ins_id_ == recs[i].ins_id_) {
-      j++;
-    }
-    if (merge_size_ > 0 && j - i != merge_size_) {
-      drop_ins_num += j - i;
-      LOG(WARNING) << "drop ins " << recs[i].ins_id_ << " size=" << j - i
-                   << ", because merge_size=" << merge_size_;
-      i = j;
-      continue;
-    }
-
-    all_int64.clear();
-    all_float.clear();
-    all_dense_uint64.clear();
-    all_dense_float.clear();
-    bool has_conflict_slot = false;
-    uint16_t conflict_slot = 0;
-
-    Record rec;
-    rec.ins_id_ = recs[i].ins_id_;
-    rec.content_ = recs[i].content_;
-
-    for (size_t k = i; k < j; k++) {
-      dense_empty.clear();
-      local_dense_uint64.clear();
-      local_dense_float.clear();
-      for (auto& feature : recs[k].uint64_feasigns_) {
-        uint16_t slot = feature.slot();
-        if (!use_slots_is_dense[slot]) {
-          continue;
-        }
-        local_dense_uint64[slot].push_back(feature);
-        if (feature.sign().uint64_feasign_ != 0) {
-          dense_empty[slot] = false;
-        } else if (dense_empty.find(slot) == dense_empty.end() &&
-                   all_dense_uint64.find(slot) == all_dense_uint64.end()) {
-          dense_empty[slot] = true;
-        }
+  for (auto& t : threads) {
+    t.join();
+  }
+  threads.clear();
+
+  std::atomic<uint64_t> drop_ins_num{0};
+  std::atomic<uint64_t> results_num{0};
+  for (size_t p = 0; p < partition_num; ++p) {
+    threads.emplace_back([this, p, partition_num, &partitions, &use_slots,
+                          &use_slots_is_dense, &drop_ins_num, &results_num]() {
+      std::vector<Record> recs;
+      size_t recs_num = 0;
+      for (size_t i = 0; i < partition_num; ++i) {
+        recs_num += partitions[i][p].size();
       }
-      for (auto& feature : recs[k].float_feasigns_) {
-        uint16_t slot = feature.slot();
-        if (!use_slots_is_dense[slot]) {
-          continue;
-        }
-        local_dense_float[slot].push_back(feature);
-        if (fabs(feature.sign().float_feasign_) >= 1e-6) {
-          dense_empty[slot] = false;
-        } else if (dense_empty.find(slot) == dense_empty.end() &&
-                   all_dense_float.find(slot) == all_dense_float.end()) {
-          dense_empty[slot] = true;
-        }
+      recs.reserve(recs_num);
+      for (size_t i = 0; i < partition_num; ++i) {
+        std::move(partitions[i][p].begin(), partitions[i][p].end(),
+                  std::back_inserter(recs));
+        std::vector<Record>().swap(partitions[i][p]);
       }
-      for (auto& p : dense_empty) {
-        if (local_dense_uint64.find(p.first) != local_dense_uint64.end()) {
-          all_dense_uint64[p.first] = std::move(local_dense_uint64[p.first]);
-        } else if (local_dense_float.find(p.first) != local_dense_float.end()) {
-          all_dense_float[p.first] = std::move(local_dense_float[p.first]);
+      std::sort(recs.begin(), recs.end(),
+                [](const Record& a, const Record& b) {
+                  return a.ins_id_ < b.ins_id_;
+                });
+
+      std::vector<Record> results;
+      uint64_t drop_num = 0;
+      InsIdMerger merger(use_slots_is_dense);
+      for (size_t i = 0; i < recs.size();) {
+        size_t j = i + 1;
+        while (j < recs.size() && recs[j].ins_id_ == recs[i].ins_id_) {
+          j++;
         }
-      }
-    }
-    for (auto& f : all_dense_uint64) {
-      rec.uint64_feasigns_.insert(rec.uint64_feasigns_.end(), f.second.begin(),
-                                  f.second.end());
-    }
-    for (auto& f : all_dense_float) {
-      rec.float_feasigns_.insert(rec.float_feasigns_.end(), f.second.begin(),
-                                 f.second.end());
-    }
-
-    for (size_t k = i; k < j; k++) {
-      local_uint64.clear();
-      local_float.clear();
-      for (auto& feature : recs[k].uint64_feasigns_) {
-        uint16_t slot = feature.slot();
-        if (use_slots_is_dense[slot]) {
+        if (merge_size_ > 0 && j - i != merge_size_) {
+          drop_num += j - i;
+          LOG(WARNING) << "drop ins " << recs[i].ins_id_ << " size=" << j - i
+                       << ", because merge_size=" << merge_size_;
+          i = j;
           continue;
-        } else if (all_int64.find(slot) != all_int64.end()) {
-          has_conflict_slot = true;
-          conflict_slot = slot;
-          break;
         }
-        local_uint64.insert(slot);
-        rec.uint64_feasigns_.push_back(std::move(feature));
-      }
-      if (has_conflict_slot) {
-        break;
-      }
-      all_int64.insert(local_uint64.begin(), local_uint64.end());
 
-      for (auto& feature : recs[k].float_feasigns_) {
-        uint16_t slot = feature.slot();
-        if (use_slots_is_dense[slot]) {
-          continue;
-        } else if (all_float.find(slot) != all_float.end()) {
-          has_conflict_slot = true;
-          conflict_slot = slot;
-          break;
+        Record rec;
+        rec.ins_id_ = recs[i].ins_id_;
+        rec.content_ = recs[i].content_;
+        uint16_t conflict_slot = 0;
+        if (merger.Merge(&recs[i], &recs[0] + j, &rec, &conflict_slot)) {
+          results.push_back(std::move(rec));
+        } else {
+          LOG(WARNING) << "drop ins " << recs[i].ins_id_ << " size=" << j - i
+                       << ", because conflict_slot="
+                       << use_slots[conflict_slot];
+          drop_num += j - i;
         }
-        local_float.insert(slot);
-        rec.float_feasigns_.push_back(std::move(feature));
+        i = j;
       }
-      if (has_conflict_slot) {
-        break;
-      }
-      all_float.insert(local_float.begin(), local_float.end());
-    }
+      std::vector<Record>().swap(recs);
+      drop_ins_num += drop_num;
+      results_num += results.size();
 
-    if (has_conflict_slot) {
-      LOG(WARNING) << "drop ins " << recs[i].ins_id_ << " size=" << j - i
-                   << ", because conflict_slot=" << use_slots[conflict_slot];
-      drop_ins_num += j - i;
-    } else {
-      results.push_back(std::move(rec));
-    }
-    i = j;
+      auto fleet_ptr = FleetWrapper::GetInstance();
+      std::shuffle(results.begin(), results.end(),
+                   fleet_ptr->LocalRandomEngine());
+      multi_output_channel_[p]->Open();
+      multi_output_channel_[p]->Write(std::move(results));
+    });
   }
-  std::vector<Record>().swap(recs);
-  VLOG(3) << "results size " << results.size();
-  LOG(WARNING) << "total drop ins num: " << drop_ins_num;
-  results.shrink_to_fit();
-
-  auto fleet_ptr = FleetWrapper::GetInstance();
-  std::shuffle(results.begin(), results.end(), fleet_ptr->LocalRandomEngine());
-  channel_data->Open();
-  channel_data->Write(std::move(results));
-  channel_data->Close();
-  results.clear();
-  results.shrink_to_fit();
-  VLOG(3) << "channel data size " << channel_data->Size();
-  channel_data->SetBlockSize(channel_data->Size() / channel_num_ + 1);
-  VLOG(3) << "channel data block size " << channel_data->BlockSize();
-  for (size_t i = 0; i < multi_output_channel_.size(); ++i) {
-    std::vector<Record> vec_data;
-    channel_data->Read(vec_data);
-    multi_output_channel_[i]->Open();
-    multi_output_channel_[i]->Write(std::move(vec_data));
-    vec_data.clear();
-    vec_data.shrink_to_fit();
+  for (auto& t : threads) {
+    t.join();
   }
-  CHECK(channel_data->Size() == 0);  // NOLINT
-  channel_data->Clear();
+  VLOG(3) << "results size " << results_num;
+  LOG(WARNING) << "total drop ins num: " << drop_ins_num;
   VLOG(3) << "MultiSlotDataset::MergeByInsId end";
 }
 
@@ -1483,6 +1628,27 @@ inline paddle::framework::ThreadPool* GetShufflePool(int thread_num) {
   }
   return thread_pool.get();
 }
+// the cores of every numa node among cores, all the cpus of the nodes when
+// cores is empty
+static std::vector<std::vector<int>> GroupCoresByNuma(
+    const std::vector<int>& cores) {
+  std::vector<std::vector<int>> groups(platform::NumaNodeNum());
+  if (cores.empty()) {
+    for (size_t node = 0; node < groups.size(); ++node) {
+      groups[node] = platform::NumaNodeCpus(node);
+    }
+  } else {
+    for (int core : cores) {
+      groups[platform::CpuNumaNode(core)].push_back(core);
+    }
+  }
+  groups.erase(std::remove_if(groups.begin(), groups.end(),
+                              [](const std::vector<int>& group) {
+                                return group.empty();
+                              }),
+               groups.end());
+  return groups;
+}
 void PadBoxSlotDataset::CheckThreadPool(void) {
   wait_futures_.clear();
   if (thread_pool_ != nullptr && merge_pool_ != nullptr) {
@@ -1502,6 +1668,17 @@ void PadBoxSlotDataset::CheckThreadPool(void) {
   }
 
   std::vector<int>& cores = boxps::get_readins_cores();
+  if (SlotRecordPool().node_num() > 1) {
+    // a thread keeps to one node, so the records it takes from the pool and
+    // the values it parses into them are local
+    auto groups = GroupCoresByNuma(cores);
+    thread_pool_->SetCPUAffinity(groups);
+    merge_pool_->SetCPUAffinity(groups);
+    if (shuffle_pool_ != nullptr) {
+      shuffle_pool_->SetCPUAffinity(groups);
+    }
+    return;
+  }
   if (cores.empty()) {
     return;
   }
@@ -1638,7 +1815,14 @@ void PadBoxSlotDataset::MergeInsKeys(const Channel<SlotRecord>& in) {
           reinterpret_cast<SlotPaddleBoxDataFeed*>(readers_[0].get());
       size_t num = 0;
       std::vector<SlotRecord> datas;
+      static auto* merged = platform::MetricsRegistry::Instance().GetCounter(
+          "padbox_merge_ins_total", "the instances merged into the pass");
+      static auto* records = platform::MetricsRegistry::Instance().GetGauge(
+          "padbox_input_records", "the instances in memory of the pass");
       while (in->ReadOnce(datas, OBJPOOL_BLOCK_SIZE)) {
+        platform::TraceScope trace(platform::TraceEvent::kMergeIns,
+                                   datas.size());
+        merged->Increase(datas.size());
         timer.Resume();
         for (auto& rec : datas) {
           for (auto& idx : used_fea_index_) {
@@ -1654,6 +1838,7 @@ void PadBoxSlotDataset::MergeInsKeys(const Channel<SlotRecord>& in) {
         for (auto& t : datas) {
           input_records_.push_back(std::move(t));
         }
+        records->Set(input_records_.size());
         merge_mutex_.unlock();
         datas.clear();
         timer.Pause();
@@ -1769,7 +1954,12 @@ void PadBoxSlotDataset::ShuffleData(int thread_num) {
       PadBoxSlotDataConsumer* handler =
           reinterpret_cast<PadBoxSlotDataConsumer*>(data_consumer_);
       ShuffleResultWaitGroup wg;
+      static auto* sent = platform::MetricsRegistry::Instance().GetCounter(
+          "padbox_shuffle_send_ins_total", "the instances shuffled out");
       while (input_channel_->Read(data)) {
+        platform::TraceScope trace(platform::TraceEvent::kShuffleSend,
+                                   data.size());
+        sent->Increase(data.size());
         timer.Resume();
         for (auto& t : data) {
           int client_id = 0;
@@ -1892,6 +2082,10 @@ void PadBoxSlotDataset::ReceiveSuffleData(int client_id, const char* buf,
     return;
   }
 
+  platform::TraceScope trace(platform::TraceEvent::kShuffleReceive, len);
+  static auto* received = platform::MetricsRegistry::Instance().GetCounter(
+      "padbox_shuffle_receive_bytes_total", "the bytes shuffled in");
+  received->Increase(len);
   paddle::framework::BinaryArchive ar;
   ar.SetReadBuffer(const_cast<char*>(buf), len, nullptr);
 
@@ -2151,6 +2345,54 @@ void PadBoxSlotDataset::DynamicAdjustReadersNum(int thread_num) {
   PrepareTrain();
 }
 
+// The records are partitioned by the numa node of their pool list, which
+// keeps them shuffled in every node, and the batches of a node go to the
+// readers of the gpus on that node. A reader keeps the number of batches it
+// would get, the batches it has to take from another node are reported.
+void PadBoxSlotDataset::PlaceBatchesByNuma(
+    std::vector<std::pair<int, int>>* offset) {
+  int node_num = SlotRecordPool().node_num();
+  if (node_num <= 1 || offset->empty()) {
+    return;
+  }
+  platform::Timer timer;
+  timer.Start();
+
+  // the records of node n are [node_begin[n], node_begin[n + 1])
+  std::vector<int64_t> node_begin(node_num + 1, 0);
+  auto begin = input_records_.begin();
+  for (int node = 0; node < node_num - 1; ++node) {
+    begin = std::partition(begin, input_records_.end(),
+                           [node](const SlotRecord& rec) {
+                             return static_cast<int>(rec->numa_node) == node;
+                           });
+    node_begin[node + 1] = begin - input_records_.begin();
+  }
+  node_begin[node_num] = input_records_.size();
+
+  std::vector<int> reader_nodes(thread_num_, 0);
+#ifdef PADDLE_WITH_CUDA
+  int device_num = platform::GetCUDADeviceCount();
+  for (int i = 0; i < thread_num_ && i < device_num; ++i) {
+    reader_nodes[i] = platform::GetCUDANumaNode(i) % node_num;
+  }
+#endif
+  int64_t remote_num = PlaceBatchesOnNodes(node_begin, reader_nodes, offset);
+  timer.Pause();
+
+  static auto* remote = platform::MetricsRegistry::Instance().GetCounter(
+      "padbox_numa_remote_records",
+      "the instances packed by a reader from another numa node");
+  remote->Increase(remote_num);
+  std::ostringstream nodes;
+  for (int node = 0; node < node_num; ++node) {
+    nodes << " " << node_begin[node + 1] - node_begin[node];
+  }
+  VLOG(0) << "passid = " << pass_id_ << ", numa node records:" << nodes.str()
+          << ", remote records: " << remote_num << "/"
+          << input_records_.size() << ", span: " << timer.ElapsedSec();
+}
+
 // prepare train do something
 void PadBoxSlotDataset::PrepareTrain(void) {
   auto box_ptr = paddle::framework::BoxWrapper::GetInstance();
@@ -2180,6 +2422,7 @@ void PadBoxSlotDataset::PrepareTrain(void) {
                         ->GetBatchSize();
     compute_thread_batch_nccl(thread_num_, GetMemoryDataSize(), batchsize,
                               &offset);
+    PlaceBatchesByNuma(&offset);
     for (int i = 0; i < thread_num_; ++i) {
       reinterpret_cast<SlotPaddleBoxDataFeed*>(readers_[i].get())
           ->SetSlotRecord(&input_records_[0]);
@@ -2201,6 +2444,15 @@ void InputTableDataset::LoadIndexIntoMemory() {
   platform::Timer timer;
   timer.Start();
 
+  auto& input_table = BoxWrapper::GetInstance()->input_table_deque_.back();
+  if (!index_image_.empty()) {
+    input_table.LoadImage(index_image_, thread_num_);
+    timer.Pause();
+    VLOG(1) << "end LoadIndexIntoMemory() from image cost: "
+            << timer.ElapsedSec();
+    return;
+  }
+
   std::vector<std::shared_ptr<paddle::framework::DataFeed>> readers;
   size_t file_idx = 0;
   std::mutex mutex_for_pick_file;
@@ -2222,6 +2474,7 @@ void InputTableDataset::LoadIndexIntoMemory() {
   for (auto& f : wait_futures) {
     f.wait();
   }
+  input_table.Finalize(thread_num_);
   timer.Pause();
   VLOG(1) << "end LoadIndexIntoMemory() cost: " << timer.ElapsedSec();
 }
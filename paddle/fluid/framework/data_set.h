@@ -36,6 +36,20 @@ class PSAgentBase;
 namespace paddle {
 namespace framework {
 
+// The partition merging the records of an ins_id. The ins_ids are routed to
+// the trainers by their hash with seed 0, the partitions use another seed,
+// so that the ins_ids of a trainer spread over all the partitions.
+size_t InsIdMergePartition(const std::string& ins_id, size_t partition_num);
+
+// Reorder the batches in offset, so that batch i of reader i % reader num is
+// taken from the node of the reader while the node has batches left. The
+// records of node n are [node_begin[n], node_begin[n + 1]), reader_nodes
+// holds the node of every reader. Return the number of the records read by
+// a reader from another node.
+int64_t PlaceBatchesOnNodes(const std::vector<int64_t>& node_begin,
+                            const std::vector<int>& reader_nodes,
+                            std::vector<std::pair<int, int>>* offset);
+
 // Dataset is a abstract class, which defines user interfaces
 // Example Usage:
 //    Dataset* dataset = DatasetFactory::CreateDataset("InMemoryDataset")
@@ -53,6 +67,8 @@ class Dataset {
   // set file list
   virtual void SetFileList(const std::vector<std::string>& filelist) = 0;
   virtual void SetIndexFileList(const std::vector<std::string>& filelist) {}
+  // set the prebuilt image of the index, loaded instead of index files
+  virtual void SetIndexImage(const std::string& path) {}
   // set readers' num
   virtual void SetThreadNum(int thread_num) = 0;
   // set workers' num
@@ -152,7 +168,8 @@ class Dataset {
   virtual void DynamicAdjustChannelNum(int channel_num,
                                        bool discard_remaining_ins = false) = 0;
   virtual void DynamicAdjustReadersNum(int thread_num) = 0;
-  // set fleet send sleep seconds
+  // set fleet send sleep seconds, unused since the sends of GlobalShuffle
+  // are bounded by FLAGS_global_shuffle_max_inflight_mb
   virtual void SetFleetSendSleepSeconds(int seconds) = 0;
 
  protected:
@@ -403,6 +420,8 @@ class PadBoxSlotDataset : public DatasetImpl<SlotRecord> {
  protected:
   void MergeInsKeys(const Channel<SlotRecord>& in);
   void CheckThreadPool(void);
+  // give every reader the batches of the records on the numa node of its gpu
+  void PlaceBatchesByNuma(std::vector<std::pair<int, int>>* offset);
 
  protected:
   Channel<SlotRecord> shuffle_channel_ = nullptr;
@@ -440,10 +459,12 @@ class InputTableDataset : public PadBoxSlotDataset {
   virtual void SetIndexFileList(const std::vector<std::string>& filelist) {
     index_filelist_ = filelist;
   }
+  virtual void SetIndexImage(const std::string& path) { index_image_ = path; }
   virtual void LoadIndexIntoMemory();
 
  private:
   std::vector<std::string> index_filelist_;
+  std::string index_image_;
 };
 #endif
 
@@ -0,0 +1,297 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/framework/channel.h"
+#include "paddle/fluid/framework/data_set.h"
+#include "xxhash.h"  // NOLINT
+
+namespace paddle {
+namespace framework {
+
+// the ins_ids a trainer gets from the global shuffle by ins_id
+static std::vector<std::string> TrainerInsIds(int trainer_id,
+                                              int trainer_num) {
+  std::vector<std::string> ins_ids;
+  for (int k = 0; ins_ids.size() < 4000; ++k) {
+    std::string ins_id = "ins_" + std::to_string(k);
+    if (XXH64(ins_id.data(), ins_id.length(), 0) % trainer_num ==
+        static_cast<uint64_t>(trainer_id)) {
+      ins_ids.push_back(ins_id);
+    }
+  }
+  return ins_ids;
+}
+
+TEST(InsIdMergePartition, spread_over_partitions) {
+  // the partition num equal to, dividing and sharing a factor with the
+  // trainer num
+  for (auto& nums : std::vector<std::pair<int, size_t>>{
+           {4, 4}, {8, 4}, {4, 8}, {6, 4}}) {
+    int trainer_num = nums.first;
+    size_t partition_num = nums.second;
+    for (int trainer_id = 0; trainer_id < trainer_num; ++trainer_id) {
+      std::vector<int> counts(partition_num, 0);
+      for (auto& ins_id : TrainerInsIds(trainer_id, trainer_num)) {
+        size_t p = InsIdMergePartition(ins_id, partition_num);
+        ASSERT_LT(p, partition_num);
+        ++counts[p];
+      }
+      for (size_t p = 0; p < partition_num; ++p) {
+        // half of the average at least
+        EXPECT_GT(counts[p], 2000 / static_cast<int>(partition_num))
+            << "trainer " << trainer_id << " of " << trainer_num
+            << ", partition " << p;
+      }
+    }
+  }
+}
+
+// MultiSlotDataset with the output channels in reach of the test
+class MergeByInsIdDataset : public MultiSlotDataset {
+ public:
+  explicit MergeByInsIdDataset(int channel_num) {
+    SetDataFeedDesc(
+        "name: \"MultiSlotDataFeed\"\n"
+        "batch_size: 2\n"
+        "multi_slot_desc {\n"
+        "  slots { name: \"uint64_sparse\" type: \"uint64\" is_dense: false "
+        "is_used: true }\n"
+        "  slots { name: \"float_sparse\" type: \"float\" is_dense: false "
+        "is_used: true }\n"
+        "  slots { name: \"uint64_dense\" type: \"uint64\" is_dense: true "
+        "is_used: true }\n"
+        "  slots { name: \"float_dense\" type: \"float\" is_dense: true "
+        "is_used: true }\n"
+        "}\n");
+    SetChannelNum(channel_num);
+    SetMergeByInsId(2);
+    CreateChannel();
+  }
+
+  void Write(std::vector<Record> recs) {
+    size_t channel_num = multi_output_channel_.size();
+    std::vector<std::vector<Record>> channels(channel_num);
+    for (size_t i = 0; i < recs.size(); ++i) {
+      channels[i % channel_num].push_back(std::move(recs[i]));
+    }
+    for (size_t i = 0; i < channel_num; ++i) {
+      multi_output_channel_[i]->Write(std::move(channels[i]));
+    }
+  }
+
+  std::vector<Record> ReadAll() {
+    std::vector<Record> recs;
+    for (auto& channel : multi_output_channel_) {
+      std::vector<Record> part;
+      channel->Close();
+      channel->ReadAll(part);
+      std::move(part.begin(), part.end(), std::back_inserter(recs));
+    }
+    return recs;
+  }
+};
+
+static FeatureItem Uint64Feature(uint16_t slot, uint64_t value) {
+  FeatureKey key;
+  key.uint64_feasign_ = value;
+  return FeatureItem(key, slot);
+}
+
+static FeatureItem FloatFeature(uint16_t slot, float value) {
+  FeatureKey key;
+  // the features are compared by their bits
+  key.uint64_feasign_ = 0;
+  key.float_feasign_ = value;
+  return FeatureItem(key, slot);
+}
+
+const int kMergeInsNum = 500;
+
+// ins k is a group of the kind k % 5:
+// 0 merges a uint64 sparse and a float sparse record, the zero dense value
+//   of one of them does not replace the other,
+// 1 and 2 hold 3 and 1 records, dropped for merge_size 2,
+// 3 holds the uint64 sparse slot in both records, dropped for the conflict,
+// 4 takes the non zero dense values over the zero ones.
+// the records of a group are scattered over the input
+static std::vector<Record> MergeInsRecords(uint64_t* drop_num) {
+  std::vector<Record> recs;
+  *drop_num = 0;
+  for (int k = 0; k < kMergeInsNum; ++k) {
+    const int sizes[] = {2, 3, 1, 2, 2};
+    int size = sizes[k % 5];
+    if (k % 5 == 1 || k % 5 == 2 || k % 5 == 3) {
+      *drop_num += size;
+    }
+    for (int i = 0; i < size; ++i) {
+      Record rec;
+      rec.ins_id_ = "ins_" + std::to_string(k);
+      rec.content_ = "content_" + std::to_string(k);
+      bool first = i == 0;
+      switch (k % 5) {
+        case 0:
+          if (first) {
+            rec.uint64_feasigns_.push_back(Uint64Feature(0, k));
+          } else {
+            rec.float_feasigns_.push_back(FloatFeature(1, k + 0.5f));
+          }
+          rec.uint64_feasigns_.push_back(Uint64Feature(2, first ? k + 1 : 0));
+          break;
+        case 3:
+          rec.uint64_feasigns_.push_back(Uint64Feature(0, k + i));
+          break;
+        case 4:
+          rec.uint64_feasigns_.push_back(Uint64Feature(2, first ? 0 : k));
+          rec.float_feasigns_.push_back(FloatFeature(3, first ? k : 0.0f));
+          break;
+        default:
+          rec.uint64_feasigns_.push_back(Uint64Feature(0, k));
+      }
+      recs.push_back(std::move(rec));
+    }
+  }
+  std::reverse(recs.begin(), recs.end());
+  for (size_t i = 0; i < recs.size(); i += 3) {
+    std::swap(recs[i], recs[(i * 7919) % recs.size()]);
+  }
+  return recs;
+}
+
+// the features of a merged record follow the order of its records, which
+// the sort by ins_id leaves open, so they are compared in slot order
+static std::vector<std::pair<uint16_t, uint64_t>> SortedFeatures(
+    const Record& rec) {
+  std::vector<std::pair<uint16_t, uint64_t>> features;
+  for (auto& f : rec.uint64_feasigns_) {
+    features.emplace_back(f.slot(), f.sign().uint64_feasign_);
+  }
+  for (auto& f : rec.float_feasigns_) {
+    features.emplace_back(f.slot(), f.sign().uint64_feasign_);
+  }
+  std::sort(features.begin(), features.end());
+  return features;
+}
+
+// merge the fixture in partition_num partitions, return the merged
+// records by ins_id and the number of the dropped records
+static std::vector<Record> MergeInsInPartitions(int partition_num,
+                                                uint64_t* drop_num) {
+  MergeByInsIdDataset dataset(partition_num);
+  uint64_t expect_drop_num = 0;
+  std::vector<Record> input = MergeInsRecords(&expect_drop_num);
+  size_t input_num = input.size();
+  dataset.Write(std::move(input));
+  dataset.MergeByInsId();
+  std::vector<Record> recs = dataset.ReadAll();
+  std::sort(recs.begin(), recs.end(), [](const Record& a, const Record& b) {
+    return a.ins_id_ < b.ins_id_;
+  });
+  // every merged record takes 2 records of the input
+  *drop_num = input_num - 2 * recs.size();
+  EXPECT_EQ(*drop_num, expect_drop_num);
+  return recs;
+}
+
+TEST(MergeByInsId, partitions_match_serial) {
+  uint64_t serial_drop_num = 0;
+  std::vector<Record> serial = MergeInsInPartitions(1, &serial_drop_num);
+  ASSERT_EQ(serial.size(), static_cast<size_t>(kMergeInsNum / 5 * 2));
+  for (auto& rec : serial) {
+    int k = std::stoi(rec.ins_id_.substr(4));
+    ASSERT_TRUE(k % 5 == 0 || k % 5 == 4) << rec.ins_id_;
+    EXPECT_EQ(rec.content_, "content_" + std::to_string(k));
+    std::vector<FeatureItem> expect;
+    if (k % 5 == 0) {
+      expect = {Uint64Feature(0, k), FloatFeature(1, k + 0.5f),
+                Uint64Feature(2, k + 1)};
+    } else {
+      expect = {Uint64Feature(2, k), FloatFeature(3, k)};
+    }
+    Record expect_rec;
+    expect_rec.uint64_feasigns_ = expect;
+    EXPECT_EQ(SortedFeatures(rec), SortedFeatures(expect_rec))
+        << rec.ins_id_;
+  }
+
+  for (int partition_num : {2, 4, 7}) {
+    uint64_t drop_num = 0;
+    std::vector<Record> recs = MergeInsInPartitions(partition_num, &drop_num);
+    EXPECT_EQ(drop_num, serial_drop_num);
+    ASSERT_EQ(recs.size(), serial.size());
+    for (size_t i = 0; i < recs.size(); ++i) {
+      EXPECT_EQ(recs[i].ins_id_, serial[i].ins_id_);
+      EXPECT_EQ(recs[i].content_, serial[i].content_);
+      EXPECT_EQ(SortedFeatures(recs[i]), SortedFeatures(serial[i]))
+          << recs[i].ins_id_;
+    }
+  }
+}
+
+static std::vector<std::pair<int, int>> MakeBatches(int num, int size) {
+  std::vector<std::pair<int, int>> offset;
+  for (int i = 0; i < num; ++i) {
+    offset.emplace_back(i * size, size);
+  }
+  return offset;
+}
+
+TEST(PlaceBatchesOnNodes, batches_on_reader_nodes) {
+  // node 0 holds 4 batches of 10 records, node 1 and 2 hold 2, as many as
+  // their readers take
+  const std::vector<int64_t> node_begin = {0, 40, 60, 80};
+  const std::vector<int> reader_nodes = {0, 1, 0, 2};
+  auto offset = MakeBatches(8, 10);
+  EXPECT_EQ(PlaceBatchesOnNodes(node_begin, reader_nodes, &offset), 0);
+  ASSERT_EQ(offset.size(), 8UL);
+  std::vector<bool> placed(8, false);
+  for (size_t i = 0; i < offset.size(); ++i) {
+    int node = reader_nodes[i % reader_nodes.size()];
+    EXPECT_GE(offset[i].first, node_begin[node]) << i;
+    EXPECT_LE(offset[i].first + offset[i].second, node_begin[node + 1]) << i;
+    placed[offset[i].first / 10] = true;
+  }
+  EXPECT_EQ(placed, std::vector<bool>(8, true));
+}
+
+TEST(PlaceBatchesOnNodes, remote_batches) {
+  // the readers are on node 1, which holds the batches from record 60 on.
+  // they take the batches of node 0 after those, the batch at 50 has 5
+  // records on node 1
+  const std::vector<int64_t> node_begin = {0, 55, 80};
+  auto offset = MakeBatches(8, 10);
+  EXPECT_EQ(PlaceBatchesOnNodes(node_begin, {1, 1}, &offset), 55);
+  std::vector<int> begins;
+  for (auto& batch : offset) {
+    begins.push_back(batch.first);
+  }
+  EXPECT_EQ(begins, std::vector<int>({60, 70, 0, 10, 20, 30, 40, 50}));
+}
+
+TEST(PlaceBatchesOnNodes, single_node) {
+  auto offset = MakeBatches(8, 10);
+  EXPECT_EQ(PlaceBatchesOnNodes({0, 80}, {0, 0, 0}, &offset), 0);
+  EXPECT_EQ(offset, MakeBatches(8, 10));
+  offset.clear();
+  EXPECT_EQ(PlaceBatchesOnNodes({0, 40, 80}, {0, 1}, &offset), 0);
+  EXPECT_TRUE(offset.empty());
+}
+
+}  // namespace framework
+}  // namespace paddle
@@ -13,6 +13,9 @@ See the License for the specific language governing permissions and
 limitations under the License. */
 
 #include "paddle/fluid/framework/device_worker.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 
 DECLARE_bool(lineid_have_extend_info);
 DECLARE_bool(dump_filed_same_as_aibox);
@@ -69,6 +72,114 @@ std::string PrintLodTensor(Tensor* tensor, int64_t start, int64_t end) {
   return out_val;
 }
 
+static const double kDumpPow10[] = {1e0, 1e1, 1e2, 1e3, 1e4,
+                                    1e5, 1e6, 1e7, 1e8, 1e9};
+
+// Formats v exactly like printf("%g") (the default of std::ostream) and
+// returns the length. Values in the fixed notation range of %g are built from
+// an exactly scaled integer, the others fall back to snprintf.
+static size_t FormatDumpFloat(float v, char* buf) {
+  const double a = std::fabs(static_cast<double>(v));
+  if (!(a >= 1e-4 && a < 999999.5)) {
+    return snprintf(buf, 32, "%g", static_cast<double>(v));
+  }
+  // find e with 10^5 <= a * 10^(5 - e) < 10^6, the product is exact in
+  // double as 5^9 needs 21 bits and a float has 24
+  int e = 5;
+  double scaled = a;
+  while (scaled < 1e5 && e > -4) {
+    --e;
+    scaled = a * kDumpPow10[5 - e];
+  }
+  // round half to even, as printf does on the exact value
+  int64_t n = static_cast<int64_t>(std::nearbyint(scaled));
+  if (n >= 1000000) {
+    n = 100000;
+    ++e;
+  }
+  if (n < 100000 || e > 5) {
+    return snprintf(buf, 32, "%g", static_cast<double>(v));
+  }
+  char digits[6];
+  for (int i = 5; i >= 0; --i) {
+    digits[i] = static_cast<char>('0' + n % 10);
+    n /= 10;
+  }
+  int last = 5;
+  while (last > 0 && digits[last] == '0') {
+    --last;
+  }
+  char* p = buf;
+  if (v < 0) {
+    *p++ = '-';
+  }
+  if (e >= 0) {
+    for (int i = 0; i <= e; ++i) {
+      *p++ = digits[i];
+    }
+    if (last > e) {
+      *p++ = '.';
+      for (int i = e + 1; i <= last; ++i) {
+        *p++ = digits[i];
+      }
+    }
+  } else {
+    *p++ = '0';
+    *p++ = '.';
+    for (int i = -1; i > e; --i) {
+      *p++ = '0';
+    }
+    for (int i = 0; i <= last; ++i) {
+      *p++ = digits[i];
+    }
+  }
+  return p - buf;
+}
+
+static size_t FormatDumpUint64(uint64_t v, char* buf) {
+  char tmp[24];
+  size_t len = 0;
+  do {
+    tmp[len++] = static_cast<char>('0' + v % 10);
+    v /= 10;
+  } while (v != 0);
+  for (size_t i = 0; i < len; ++i) {
+    buf[i] = tmp[len - 1 - i];
+  }
+  return len;
+}
+
+void AppendLodTensor(const Tensor& tensor, int64_t start, int64_t end,
+                     std::string* out) {
+  if (start < 0 || end > tensor.numel()) {
+    VLOG(3) << "access violation";
+    out->append("access violation");
+    return;
+  }
+  char buf[64];
+  if (tensor.type() == proto::VarType::FP32) {
+    const float* data = tensor.data<float>();
+    for (int64_t i = start; i < end; ++i) {
+      buf[0] = ':';
+      out->append(buf, FormatDumpFloat(data[i], buf + 1) + 1);
+    }
+  } else if (tensor.type() == proto::VarType::INT64) {
+    const int64_t* data = tensor.data<int64_t>();
+    for (int64_t i = start; i < end; ++i) {
+      buf[0] = ':';
+      out->append(
+          buf, FormatDumpUint64(static_cast<uint64_t>(data[i]), buf + 1) + 1);
+    }
+  } else if (tensor.type() == proto::VarType::FP64) {
+    const double* data = tensor.data<double>();
+    for (int64_t i = start; i < end; ++i) {
+      out->append(buf, snprintf(buf, sizeof(buf), ":%g", data[i]));
+    }
+  } else {
+    out->append("unsupported type");
+  }
+}
+
 std::pair<int64_t, int64_t> GetTensorBound(LoDTensor* tensor, int index) {
   auto& dims = tensor->dims();
   if (tensor->lod().size() != 0) {
@@ -95,6 +206,132 @@ bool CheckValidOutput(LoDTensor* tensor, size_t batch_size) {
   return true;
 }
 
+DumpFieldBatch::~DumpFieldBatch() {
+#ifdef PADDLE_WITH_CUDA
+  if (event != nullptr) {
+    cudaEventDestroy(event);
+  }
+#endif
+}
+
+void DumpFieldBatch::Wait() {
+#ifdef PADDLE_WITH_CUDA
+  if (event != nullptr) {
+    PADDLE_ENFORCE_CUDA_SUCCESS(cudaEventSynchronize(event));
+  }
+#endif
+}
+
+static const uint32_t kDumpFieldBinaryMagic = 0x44465044;  // "DPFD"
+static const uint32_t kDumpFieldBinaryVersion = 1;
+
+template <typename T>
+static void AppendPod(const T& value, std::string* out) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void AppendStringColumn(const std::vector<std::string>& column,
+                               std::string* out) {
+  uint64_t offset = 0;
+  AppendPod(offset, out);
+  for (auto& str : column) {
+    offset += str.length();
+    AppendPod(offset, out);
+  }
+  for (auto& str : column) {
+    out->append(str);
+  }
+}
+
+// Binary columnar block, all integers in host byte order:
+//   uint32 magic, uint32 version, uint64 block bytes (magic included),
+//   uint64 ins_num, uint32 field_num,
+//   line id column, line extend column:
+//     uint64 offsets[ins_num + 1], chars
+//   per field:
+//     uint32 name length, name, int32 proto::VarType::Type,
+//     uint64 offsets[ins_num + 1] in elements, raw values
+static void FormatDumpFieldBinary(const DumpFieldBatch& batch,
+                                  std::string* out) {
+  size_t begin = out->length();
+  AppendPod(kDumpFieldBinaryMagic, out);
+  AppendPod(kDumpFieldBinaryVersion, out);
+  AppendPod(static_cast<uint64_t>(0), out);
+  AppendPod(static_cast<uint64_t>(batch.ins_index.size()), out);
+  AppendPod(static_cast<uint32_t>(batch.fields.size()), out);
+  AppendStringColumn(batch.lineids, out);
+  AppendStringColumn(batch.line_extends, out);
+  for (size_t k = 0; k < batch.fields.size(); ++k) {
+    LoDTensor* tensor = const_cast<LoDTensor*>(&batch.tensors[k]);
+    AppendPod(static_cast<uint32_t>(batch.fields[k].length()), out);
+    out->append(batch.fields[k]);
+    AppendPod(static_cast<int32_t>(tensor->type()), out);
+    size_t elem_size = SizeOfType(tensor->type());
+    uint64_t offset = 0;
+    AppendPod(offset, out);
+    for (size_t i : batch.ins_index) {
+      auto bound = GetTensorBound(tensor, i);
+      offset += bound.second - bound.first;
+      AppendPod(offset, out);
+    }
+    const char* data = reinterpret_cast<const char*>(tensor->data<void>());
+    for (size_t i : batch.ins_index) {
+      auto bound = GetTensorBound(tensor, i);
+      out->append(data + bound.first * elem_size,
+                  (bound.second - bound.first) * elem_size);
+    }
+  }
+  uint64_t block_bytes = out->length() - begin;
+  memcpy(&(*out)[begin + 2 * sizeof(uint32_t)], &block_bytes,
+         sizeof(block_bytes));
+}
+
+void FormatDumpFieldBatch(const DumpFieldBatch& batch, bool binary,
+                          std::string* out) {
+  if (binary) {
+    FormatDumpFieldBinary(batch, out);
+    return;
+  }
+  std::vector<std::string> names(batch.fields.size());
+  for (size_t k = 0; k < batch.fields.size(); ++k) {
+    const std::string& field = batch.fields[k];
+    size_t pos = field.find(".");
+    if (FLAGS_dump_filed_same_as_aibox && pos != std::string::npos) {
+      names[k] = field.substr(0, pos);
+    } else {
+      names[k] = field;
+    }
+  }
+  char buf[32];
+  for (size_t n = 0; n < batch.ins_index.size(); ++n) {
+    size_t line_begin = out->length();
+    out->append(batch.lineids[n]);
+    for (size_t k = 0; k < batch.fields.size(); ++k) {
+      LoDTensor* tensor = const_cast<LoDTensor*>(&batch.tensors[k]);
+      auto bound = GetTensorBound(tensor, batch.ins_index[n]);
+      out->append("\t");
+      out->append(names[k]);
+      if (!FLAGS_dump_filed_same_as_aibox) {
+        out->append(":");
+        out->append(buf, FormatDumpUint64(bound.second - bound.first, buf));
+      }
+      AppendLodTensor(*tensor, bound.first, bound.second, out);
+    }
+    if (out->length() == line_begin) {
+      continue;
+    }
+    if (batch.has_extend[n]) {
+      out->append("\t");
+      out->append(batch.line_extends[n]);
+    }
+    out->append("\n");
+  }
+  // DumpWork terminates every item with a new line
+  if (!out->empty() && out->back() == '\n') {
+    out->pop_back();
+  }
+}
+
 void DeviceWorker::DumpParam(const Scope& scope, const int batch_id) {
   std::ostringstream os;
   for (auto& param : *dump_param_) {
@@ -135,6 +372,10 @@ void DeviceWorker::DumpField(const Scope& scope, int dump_mode,
                                                    // 1: random with insid hash,
                                                    // 2: random with random
                                                    // number
+  if (field_queue_ != nullptr) {
+    DumpFieldAsync(scope, dump_mode, dump_interval);
+    return;
+  }
   size_t batch_size = device_reader_->GetCurBatchSize();
   std::vector<std::string> ars(batch_size);
   std::vector<bool> hit(batch_size, false);
@@ -225,5 +466,91 @@ void DeviceWorker::DumpField(const Scope& scope, int dump_mode,
   }
 }
 
+void DeviceWorker::DumpFieldAsync(const Scope& scope, int dump_mode,
+                                  int dump_interval) {
+  size_t batch_size = device_reader_->GetCurBatchSize();
+  auto batch = std::make_shared<DumpFieldBatch>();
+
+  std::default_random_engine engine(0);
+  std::uniform_int_distribution<size_t> dist(0U, INT_MAX);
+  for (size_t i = 0; i < batch_size; i++) {
+    size_t r = 0;
+    const std::string& lineid = device_reader_->GetLineId(i);
+    if (dump_mode == 1) {
+      r = XXH64(lineid.data(), lineid.length(), 0);
+    } else if (dump_mode == 2) {
+      r = dist(engine);
+    }
+    if (r % dump_interval != 0) {
+      continue;
+    }
+    batch->ins_index.push_back(i);
+    size_t pos = std::string::npos;
+    if (FLAGS_lineid_have_extend_info) {
+      pos = lineid.find(" ");
+    }
+    if (pos != std::string::npos) {
+      batch->lineids.push_back(lineid.substr(0, pos));
+      batch->line_extends.push_back(lineid.substr(pos + 1));
+      batch->has_extend.push_back(true);
+    } else {
+      batch->lineids.push_back(lineid);
+      batch->line_extends.push_back("");
+      batch->has_extend.push_back(false);
+    }
+  }
+  if (batch->ins_index.empty()) {
+    return;
+  }
+
+#ifdef PADDLE_WITH_CUDA
+  cudaStream_t stream = nullptr;
+#endif
+  for (auto& field : *dump_fields_) {
+    Variable* var = scope.FindVar(field);
+    if (var == nullptr) {
+      VLOG(0) << "Note: field[" << field
+              << "] cannot be find in scope, so it was skipped.";
+      continue;
+    }
+    LoDTensor* tensor = var->GetMutable<LoDTensor>();
+    if (!tensor->IsInitialized()) {
+      VLOG(0) << "Note: field[" << field
+              << "] is not initialized, so it was skipped.";
+      continue;
+    }
+    if (!CheckValidOutput(tensor, batch_size)) {
+      VLOG(0) << "Note: field[" << field << "] cannot pass check, so it was "
+                                            "skipped. Maybe the dimension is "
+                                            "wrong ";
+      continue;
+    }
+    batch->fields.push_back(field);
+    batch->tensors.emplace_back();
+    LoDTensor& snapshot = batch->tensors.back();
+    if (platform::is_gpu_place(tensor->place())) {
+#ifdef PADDLE_WITH_CUDA
+      // enqueued after the ops of this batch on the compute stream, the dump
+      // threads wait on the event instead of the training thread
+      auto* dev_ctx = static_cast<platform::CUDADeviceContext*>(
+          platform::DeviceContextPool::Instance().Get(tensor->place()));
+      TensorCopy(*tensor, platform::CUDAPinnedPlace(), *dev_ctx, &snapshot);
+      stream = dev_ctx->stream();
+#endif
+    } else {
+      TensorCopy(*tensor, platform::CPUPlace(), &snapshot);
+    }
+    snapshot.set_lod(tensor->lod());
+  }
+#ifdef PADDLE_WITH_CUDA
+  if (stream != nullptr) {
+    PADDLE_ENFORCE_CUDA_SUCCESS(
+        cudaEventCreateWithFlags(&batch->event, cudaEventDisableTiming));
+    PADDLE_ENFORCE_CUDA_SUCCESS(cudaEventRecord(batch->event, stream));
+  }
+#endif
+  field_queue_->Put(std::move(batch));
+}
+
 }  // namespace framework
 }  // namespace paddle
@@ -16,6 +16,7 @@ limitations under the License. */
 
 #include <atomic>
 #include <fstream>
+#include <future>  // NOLINT
 #include <map>
 #include <memory>
 #include <mutex>  // NOLINT
@@ -33,6 +34,7 @@ limitations under the License. */
 #include "paddle/fluid/framework/op_registry.h"
 #include "paddle/fluid/framework/program_desc.h"
 #include "paddle/fluid/framework/reader.h"
+#include "paddle/fluid/framework/threadpool.h"
 #include "paddle/fluid/framework/trainer_desc.pb.h"
 #include "paddle/fluid/framework/variable_helper.h"
 #include "paddle/fluid/operators/reader/blocking_queue.h"
@@ -60,9 +62,38 @@ namespace paddle {
 namespace framework {
 
 std::string PrintLodTensor(Tensor* tensor, int64_t start, int64_t end);
+// Same text as PrintLodTensor, appended to out without std::ostringstream.
+void AppendLodTensor(const Tensor& tensor, int64_t start, int64_t end,
+                     std::string* out);
 std::pair<int64_t, int64_t> GetTensorBound(LoDTensor* tensor, int index);
 bool CheckValidOutput(LoDTensor* tensor, size_t batch_size);
 
+// Raw snapshot of the fields dumped for one batch. The training thread only
+// copies the tensors (asynchronously for GPU), formatting and writing are
+// done by the dump threads of the trainer.
+struct DumpFieldBatch {
+  DumpFieldBatch() {}
+  ~DumpFieldBatch();
+  // wait until the device to host copies of the snapshot are finished
+  void Wait();
+
+  std::vector<std::string> lineids;
+  std::vector<std::string> line_extends;  // filled by lineid_have_extend_info
+  std::vector<bool> has_extend;
+  std::vector<size_t> ins_index;          // sampled instances of the batch
+  std::vector<std::string> fields;
+  std::vector<LoDTensor> tensors;  // CPU or CUDA pinned copies of fields
+#ifdef PADDLE_WITH_CUDA
+  cudaEvent_t event = nullptr;
+#endif
+};
+
+// Text format: one '\n' separated line per sampled instance, the same lines
+// DeviceWorker::DumpField writes. Binary format: one columnar block, see
+// device_worker.cc for the layout.
+void FormatDumpFieldBatch(const DumpFieldBatch& batch, bool binary,
+                          std::string* out);
+
 class FleetWrapper;
 
 #ifdef PADDLE_WITH_PSLIB
@@ -186,6 +217,11 @@ class DeviceWorker {
   virtual void SetChannelWriter(ChannelObject<std::string>* queue) {
     writer_.Reset(queue);
   }
+  // set by the trainer when dump fields are formatted asynchronously
+  virtual void SetDumpFieldBatchChannel(
+      ChannelObject<std::shared_ptr<DumpFieldBatch>>* queue) {
+    field_queue_ = queue;
+  }
   virtual void SetPlace(const paddle::platform::Place& place) {
     place_ = place;
   }
@@ -199,6 +235,8 @@ class DeviceWorker {
   virtual void DumpParam(const Scope& scope, const int batch_id);
   virtual void DumpField(const Scope& scope, int dump_mode,
                          int dump_interval = 10000);
+  virtual void DumpFieldAsync(const Scope& scope, int dump_mode,
+                              int dump_interval);
   Scope* root_scope_ = nullptr;
   Scope* thread_scope_;
   paddle::platform::Place place_;
@@ -218,6 +256,7 @@ class DeviceWorker {
   int dump_mode_ = 0;
   int dump_interval_ = 10000;
   ChannelWriter<std::string> writer_;
+  ChannelObject<std::shared_ptr<DumpFieldBatch>>* field_queue_ = nullptr;
 };
 
 class CPUWorkerBase : public DeviceWorker {
@@ -263,6 +302,8 @@ class HogwildWorker : public CPUWorkerBase {
   HogwildWorkerParameter param_;
   std::vector<std::string> skip_ops_;
   std::map<std::string, int> stat_var_name_map_;
+  // the program with the fused dense optimizers, which ops_ are created from
+  std::unique_ptr<ProgramDesc> fused_program_;
 };
 
 class DownpourWorker : public HogwildWorker {
@@ -283,8 +324,14 @@ class DownpourWorker : public HogwildWorker {
   void CopySparseTable();
   void CopyDenseTable();
   void CopyDenseVars();
+  // the scope of the feed vars of the batch in training
+  Scope* BatchScope() const {
+    return batch_scope_ != nullptr ? batch_scope_ : thread_scope_;
+  }
 
   DownpourWorkerParameter param_;
+  // the sparse tables by table id, resolved once in Initialize
+  std::map<uint64_t, TableParameter> sparse_tables_;
   // copy table
   CopyTableConfig copy_table_config_;
   std::vector<std::pair<uint64_t, uint64_t>> copy_sparse_tables_;
@@ -296,6 +343,9 @@ class DownpourWorker : public HogwildWorker {
   std::map<uint64_t, std::vector<uint64_t>> features_;
   // feasign embedding
   std::map<uint64_t, std::vector<std::vector<float>>> feature_values_;
+  // the index of every feasign into feature_values_ when the values are
+  // pulled for the unique feasigns, empty if they are pulled one by one
+  std::map<uint64_t, std::vector<size_t>> feature_value_index_;
   std::map<uint64_t, std::vector<std::string>> sparse_value_names_;
   // adjust ins weight
   AdjustInsWeightConfig adjust_ins_weight_config_;
@@ -336,6 +386,31 @@ class DownpourWorker : public HogwildWorker {
   std::vector<float> nid_show_;
   // std::map<uint64_t, uint64_t> table_dependency_;
   // std::vector<std::pair<uint64_t, uint64_t>> copy_dense_tables_;
+
+  // A batch read ahead in a scope of its own, with the sparse pull of its
+  // unique feasigns in flight.
+  struct SparsePrefetchBuffer {
+    Scope* scope = nullptr;
+    int batch_size = 0;
+    std::map<uint64_t, std::vector<uint64_t>> features;
+    std::map<uint64_t, std::vector<uint64_t>> unique_features;
+    std::map<uint64_t, std::vector<size_t>> value_index;
+    std::map<uint64_t, std::vector<std::vector<float>>> values;
+    std::vector<std::future<int32_t>> pull_status;
+    // the ins ids of the batch, for the error report of its ops
+    std::vector<std::string> ins_ids;
+  };
+  // Read the next batch into buffer and start its sparse pull, return the
+  // batch size.
+  int PrefetchBatch(SparsePrefetchBuffer* buffer);
+  // Wait for the sparse pull of buffer and make it the batch in training.
+  void TakePrefetchedBatch(SparsePrefetchBuffer* buffer);
+
+  // the scope of the feed vars and the ins ids of the batch in training
+  // when the batches are prefetched
+  Scope* batch_scope_ = nullptr;
+  std::vector<std::string> batch_ins_ids_;
+  SparsePrefetchBuffer prefetch_buffers_[2];
 };
 
 class DownpourWorkerOpt : public DownpourWorker {
@@ -583,12 +658,19 @@ class SectionWorker : public DeviceWorker {
 #endif
 
 #ifdef PADDLE_WITH_BOX_PS
+// Merge the merge_num grads of len floats by their mean, and apply adam to
+// param and its moments.
+void AsyncAdamKernel(const float* const* grads, size_t merge_num, size_t len,
+                     float lr, float beta1, float beta2, float epsilon,
+                     float* param, float* mom1, float* mom2);
+
 class BoxPSAsynDenseTable {
   typedef operators::reader::BlockingQueue<std::vector<LoDTensor>*>
       PSBufferQueue;
 
  public:
-  explicit BoxPSAsynDenseTable(const int device_num);
+  BoxPSAsynDenseTable(const int device_num,
+                      const BoxPSWorkerParameter& param);
   ~BoxPSAsynDenseTable();
 
   void Init(const Scope& root_scope,
@@ -603,6 +685,11 @@ class BoxPSAsynDenseTable {
   void AsyncUpdate();
 
  private:
+  // merge the grads of one param and apply adam to [begin, end)
+  void AdamUpdate(const std::vector<std::vector<LoDTensor>*>& grads,
+                  size_t merge_num, size_t param_idx, size_t begin,
+                  size_t end, float learning_rate);
+
   int device_num_ = 0;
   std::vector<std::vector<LoDTensor>> device_grads_;
   std::vector<std::string> async_param_list_;
@@ -614,6 +701,17 @@ class BoxPSAsynDenseTable {
   RWLock ps_lock_;
   std::thread* update_thread_ = nullptr;
   float base_lr_ = -1;
+
+  float beta1_ = 0.99;
+  float beta2_ = 0.9999;
+  float epsilon_ = 1e-8;
+  int update_thread_num_ = 1;
+  std::unique_ptr<ThreadPool> update_pool_ = nullptr;
+  // update lag: the grads found in the queue on every update
+  size_t update_num_ = 0;
+  size_t merge_total_ = 0;
+  size_t max_queue_depth_ = 0;
+  platform::Timer update_timer_;
 };
 
 class BoxPSWorker : public DeviceWorker {
@@ -15,6 +15,9 @@
 #include "paddle/fluid/framework/device_worker.h"
 
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
 
 #include "paddle/fluid/framework/lod_tensor.h"
 
@@ -50,6 +53,59 @@ TEST(LodTensor, PrintLodTensor) {
   ASSERT_EQ(res, ":0.1:0.2");
 }
 
+TEST(LodTensor, AppendLodTensor) {
+  const std::vector<float> values = {0.2f,    0.5f,   -1.f,      0.f,
+                                     1e-5f,   1e-4f,  123456.5f, 999999.5f,
+                                     3.1416f, 1e+10f, -0.000123f};
+  LoDTensor tensor1;
+  tensor1.Resize({static_cast<int64_t>(values.size())});
+  float* data = tensor1.mutable_data<float>(platform::CPUPlace());
+  std::copy(values.begin(), values.end(), data);
+  std::string res;
+  AppendLodTensor(tensor1, -1, 2, &res);
+  ASSERT_EQ(res, "access violation");
+  res.clear();
+  AppendLodTensor(tensor1, 0, values.size(), &res);
+  ASSERT_EQ(res, PrintLodTensor(&tensor1, 0, values.size()));
+
+  LoDTensor tensor2;
+  tensor2.Resize({2});
+  tensor2.mutable_data<int64_t>(platform::CPUPlace());
+  tensor2.data<int64_t>()[0] = 1;
+  tensor2.data<int64_t>()[1] = -2;
+  res.clear();
+  AppendLodTensor(tensor2, 0, 2, &res);
+  ASSERT_EQ(res, PrintLodTensor(&tensor2, 0, 2));
+}
+
+TEST(LodTensor, FormatDumpFieldBatch) {
+  DumpFieldBatch batch;
+  batch.ins_index = {1};
+  batch.lineids = {"ins1"};
+  batch.line_extends = {""};
+  batch.has_extend = {false};
+  batch.fields = {"pred"};
+  batch.tensors.resize(1);
+  batch.tensors[0].Resize({2, 2});
+  float* data = batch.tensors[0].mutable_data<float>(platform::CPUPlace());
+  data[0] = 0.1f;
+  data[1] = 0.2f;
+  data[2] = 0.3f;
+  data[3] = 0.4f;
+  std::string res;
+  FormatDumpFieldBatch(batch, false, &res);
+  ASSERT_EQ(res, "ins1\tpred:2:0.3:0.4");
+
+  res.clear();
+  FormatDumpFieldBatch(batch, true, &res);
+  uint64_t block_bytes = 0;
+  memcpy(&block_bytes, res.data() + 2 * sizeof(uint32_t), sizeof(uint64_t));
+  ASSERT_EQ(block_bytes, res.length());
+  float last = 0;
+  memcpy(&last, res.data() + res.length() - sizeof(float), sizeof(float));
+  ASSERT_EQ(last, 0.4f);
+}
+
 TEST(LodTensor, GetTensorBound) {
   LoD lod{{0, 2}};
   LoDTensor tensor;
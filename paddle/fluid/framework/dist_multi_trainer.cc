@@ -89,6 +89,10 @@ void DistMultiTrainer::InitDumpEnv() {
     dump_thread_.push_back(
         std::thread(std::bind(&TrainerBase::DumpWork, this, i)));
   }
+  InitDumpFieldFormatEnv();
+  for (int i = 0; i < thread_num_; ++i) {
+    workers_[i]->SetDumpFieldBatchChannel(field_queue_.get());
+  }
 }
 
 void DistMultiTrainer::InitTrainerEnv(const ProgramDesc &main_program,
@@ -14,9 +14,12 @@ limitations under the License. */
 
 #include <cstdlib>
 #include <ctime>
+#include <unordered_map>
 #include "paddle/fluid/framework/device_worker.h"
 #include "paddle/fluid/platform/cpu_helper.h"
 
+DECLARE_bool(downpour_prefetch_sparse);
+
 namespace paddle {
 namespace framework {
 class LoDTensor;
@@ -37,7 +40,8 @@ void DownpourWorker::Initialize(const TrainerDesc& desc) {
   for (int i = 0; i < param_.sparse_table_size(); ++i) {
     uint64_t table_id =
         static_cast<uint64_t>(param_.sparse_table(i).table_id());
-    TableParameter table = param_.sparse_table(i);
+    sparse_tables_[table_id] = param_.sparse_table(i);
+    const TableParameter& table = sparse_tables_[table_id];
     sparse_key_names_[table_id].resize(table.sparse_key_name_size());
     for (int j = 0; j < table.sparse_key_name_size(); ++j) {
       sparse_key_names_[table_id][j] = table.sparse_key_name(j);
@@ -129,17 +133,11 @@ void DownpourWorker::CollectLabelInfo(size_t table_idx) {
   uint64_t table_id = static_cast<uint64_t>(
       param_.program_config(0).pull_sparse_table_id(table_idx));
 
-  TableParameter table;
-  for (auto i : param_.sparse_table()) {
-    if (i.table_id() == table_id) {
-      table = i;
-      break;
-    }
-  }
+  Scope* scope = BatchScope();
   auto& feature = features_[table_id];
   auto& feature_label = feature_labels_[table_id];
   feature_label.resize(feature.size());
-  Variable* var = thread_scope_->FindVar(label_var_name_[table_id]);
+  Variable* var = scope->FindVar(label_var_name_[table_id]);
   LoDTensor* tensor = var->GetMutable<LoDTensor>();
   int64_t* label_ptr = tensor->data<int64_t>();
 
@@ -147,7 +145,7 @@ void DownpourWorker::CollectLabelInfo(size_t table_idx) {
   for (size_t i = 0; i < sparse_key_names_[table_id].size(); ++i) {
     VLOG(3) << "sparse_key_names_[" << i
             << "]: " << sparse_key_names_[table_id][i];
-    Variable* fea_var = thread_scope_->FindVar(sparse_key_names_[table_id][i]);
+    Variable* fea_var = scope->FindVar(sparse_key_names_[table_id][i]);
     if (fea_var == nullptr) {
       continue;
     }
@@ -156,8 +154,7 @@ void DownpourWorker::CollectLabelInfo(size_t table_idx) {
                              << sparse_key_names_[table_id][i] << " is null";
 
     // skip slots which do not have embedding
-    Variable* emb_var =
-        thread_scope_->FindVar(sparse_value_names_[table_id][i]);
+    Variable* emb_var = scope->FindVar(sparse_value_names_[table_id][i]);
     if (emb_var == nullptr) {
       continue;
     }
@@ -183,23 +180,22 @@ void DownpourWorker::CollectLabelInfo(size_t table_idx) {
 void DownpourWorker::FillSparseValue(size_t table_idx) {
   uint64_t table_id = static_cast<uint64_t>(
       param_.program_config(0).pull_sparse_table_id(table_idx));
+  const TableParameter& table = sparse_tables_[table_id];
 
-  TableParameter table;
-  for (auto i : param_.sparse_table()) {
-    if (i.table_id() == table_id) {
-      table = i;
-      break;
-    }
-  }
-
+  Scope* scope = BatchScope();
   auto& fea_value = feature_values_[table_id];
+  auto& value_index = feature_value_index_[table_id];
+  auto value_of = [&fea_value, &value_index](size_t fea_idx) {
+    return fea_value[value_index.empty() ? fea_idx : value_index[fea_idx]]
+        .data();
+  };
   auto fea_idx = 0u;
 
   std::vector<float> init_value(table.fea_dim());
   for (size_t i = 0; i < sparse_key_names_[table_id].size(); ++i) {
     std::string slot_name = sparse_key_names_[table_id][i];
     std::string emb_slot_name = sparse_value_names_[table_id][i];
-    Variable* var = thread_scope_->FindVar(slot_name);
+    Variable* var = scope->FindVar(slot_name);
     if (var == nullptr) {
       continue;
     }
@@ -207,7 +203,7 @@ void DownpourWorker::FillSparseValue(size_t table_idx) {
     CHECK(tensor != nullptr) << "tensor of var " << slot_name << " is null";
     int64_t* ids = tensor->data<int64_t>();
     int len = tensor->numel();
-    Variable* var_emb = thread_scope_->FindVar(emb_slot_name);
+    Variable* var_emb = scope->FindVar(emb_slot_name);
     if (var_emb == nullptr) {
       continue;
     }
@@ -237,11 +233,11 @@ void DownpourWorker::FillSparseValue(size_t table_idx) {
           }
           continue;
         }
-        memcpy(ptr + table.emb_dim() * index, fea_value[fea_idx].data(),
+        memcpy(ptr + table.emb_dim() * index, value_of(fea_idx),
                sizeof(float) * table.emb_dim());
         if (is_nid &&
             static_cast<size_t>(index) == tensor->lod()[0][nid_ins_index]) {
-          nid_show_.push_back(fea_value[fea_idx][0]);
+          nid_show_.push_back(value_of(fea_idx)[0]);
           ++nid_ins_index;
         }
         fea_idx++;
@@ -255,11 +251,11 @@ void DownpourWorker::FillSparseValue(size_t table_idx) {
           }
           continue;
         }
-        memcpy(ptr + table.emb_dim() * index, fea_value[fea_idx].data() + 2,
+        memcpy(ptr + table.emb_dim() * index, value_of(fea_idx) + 2,
                sizeof(float) * table.emb_dim());
         if (is_nid &&
             static_cast<size_t>(index) == tensor->lod()[0][nid_ins_index]) {
-          nid_show_.push_back(fea_value[fea_idx][0]);
+          nid_show_.push_back(value_of(fea_idx)[0]);
           ++nid_ins_index;
         }
         fea_idx++;
@@ -276,7 +272,7 @@ void DownpourWorker::AdjustInsWeight() {
     return;
   }
   Variable* nid_var =
-      thread_scope_->FindVar(adjust_ins_weight_config_.nid_slot());
+      BatchScope()->FindVar(adjust_ins_weight_config_.nid_slot());
   if (nid_var == nullptr) {
     VLOG(0) << "nid slot var " << adjust_ins_weight_config_.nid_slot()
             << " is nullptr, skip adjust ins weight";
@@ -289,7 +285,7 @@ void DownpourWorker::AdjustInsWeight() {
     return;
   }
   Variable* ins_weight_var =
-      thread_scope_->FindVar(adjust_ins_weight_config_.ins_weight_slot());
+      BatchScope()->FindVar(adjust_ins_weight_config_.ins_weight_slot());
   if (ins_weight_var == nullptr) {
     VLOG(0) << "ins weight var " << adjust_ins_weight_config_.ins_weight_slot()
             << " is nullptr, skip adjust ins weight";
@@ -501,13 +497,7 @@ void DownpourWorker::TrainFilesWithProfiler() {
          ++i) {
       uint64_t tid = static_cast<uint64_t>(
           param_.program_config(0).pull_sparse_table_id(i));
-      TableParameter table;
-      for (auto j : param_.sparse_table()) {
-        if (j.table_id() == tid) {
-          table = j;
-          break;
-        }
-      }
+      const TableParameter& table = sparse_tables_[tid];
       timeline.Start();
       fleet_ptr_->PullSparseVarsSync(
           *thread_scope_, tid, sparse_key_names_[tid], &features_[tid],
@@ -581,13 +571,7 @@ void DownpourWorker::TrainFilesWithProfiler() {
            ++i) {
         uint64_t tid = static_cast<uint64_t>(
             param_.program_config(0).push_sparse_table_id(i));
-        TableParameter table;
-        for (auto i : param_.sparse_table()) {
-          if (i.table_id() == tid) {
-            table = i;
-            break;
-          }
-        }
+        const TableParameter& table = sparse_tables_[tid];
         timeline.Start();
         fleet_ptr_->PushSparseVarsWithLabelAsync(
             *thread_scope_, tid, features_[tid], feature_labels_[tid],
@@ -740,9 +724,33 @@ void DownpourWorker::TrainFiles() {
   VLOG(3) << "Begin to train files";
   platform::SetNumThreads(1);
   device_reader_->Start();
+  // the reader runs a batch ahead when the sparse pull is prefetched, so the
+  // batches are pulled one by one when the fields of the reader are dumped
+  // or the tables are copied between the batches
+  bool prefetch = FLAGS_downpour_prefetch_sparse && !need_dump_field_ &&
+                  !copy_table_config_.need_copy();
+  int prefetch_index = 0;
+  if (prefetch) {
+    for (auto& buffer : prefetch_buffers_) {
+      buffer.scope = &thread_scope_->NewScope();
+      for (auto& name : device_reader_->GetUseSlotAlias()) {
+        buffer.scope->Var(name)->GetMutable<LoDTensor>();
+      }
+    }
+    PrefetchBatch(&prefetch_buffers_[prefetch_index]);
+  }
   int batch_cnt = 0;
   int cur_batch;
-  while ((cur_batch = device_reader_->Next()) > 0) {
+  while ((cur_batch = prefetch ? prefetch_buffers_[prefetch_index].batch_size
+                               : device_reader_->Next()) > 0) {
+    if (prefetch) {
+      // pull the next batch while this one runs
+      auto* buffer = &prefetch_buffers_[prefetch_index];
+      prefetch_index = 1 - prefetch_index;
+      PrefetchBatch(&prefetch_buffers_[prefetch_index]);
+      TakePrefetchedBatch(buffer);
+    }
+    Scope* scope = BatchScope();
     if (copy_table_config_.need_copy()) {
       if (batch_cnt % copy_table_config_.batch_num() == 0) {
         CopySparseTable();
@@ -755,16 +763,12 @@ void DownpourWorker::TrainFiles() {
          ++i) {
       uint64_t tid = static_cast<uint64_t>(
           param_.program_config(0).pull_sparse_table_id(i));
-      TableParameter table;
-      for (auto j : param_.sparse_table()) {
-        if (j.table_id() == tid) {
-          table = j;
-          break;
-        }
+      if (!prefetch) {
+        const TableParameter& table = sparse_tables_[tid];
+        fleet_ptr_->PullSparseVarsSync(
+            *thread_scope_, tid, sparse_key_names_[tid], &features_[tid],
+            &feature_values_[tid], table.fea_dim(), sparse_value_names_[tid]);
       }
-      fleet_ptr_->PullSparseVarsSync(
-          *thread_scope_, tid, sparse_key_names_[tid], &features_[tid],
-          &feature_values_[tid], table.fea_dim(), sparse_value_names_[tid]);
       CollectLabelInfo(i);
       FillSparseValue(i);
       auto nid_iter = std::find(sparse_value_names_[tid].begin(),
@@ -788,11 +792,15 @@ void DownpourWorker::TrainFiles() {
       if (!need_skip) {
 #ifdef PADDLE_WITH_PSLIB
         try {
-          op->Run(*thread_scope_, place_);
+          op->Run(*scope, place_);
         } catch (std::exception& e) {
           fprintf(stderr, "error message: %s\n", e.what());
-          auto& ins_id_vec = device_reader_->GetInsIdVec();
-          size_t batch_size = device_reader_->GetCurBatchSize();
+          // the reader is a batch ahead when the sparse pull is prefetched,
+          // the ins ids of the batch are kept with it
+          const auto& ins_id_vec =
+              prefetch ? batch_ins_ids_ : device_reader_->GetInsIdVec();
+          size_t batch_size =
+              prefetch ? cur_batch : device_reader_->GetCurBatchSize();
           std::string s = "";
           for (auto& ins_id : ins_id_vec) {
             if (s != "") s += ",";
@@ -828,14 +836,14 @@ void DownpourWorker::TrainFiles() {
           throw e;
         }
 #else
-        op->Run(*thread_scope_, place_);
+        op->Run(*scope, place_);
 #endif
       }
     }
 
     // check inf and nan
     for (std::string& var_name : check_nan_var_names_) {
-      Variable* var = thread_scope_->FindVar(var_name);
+      Variable* var = scope->FindVar(var_name);
       if (var == nullptr) {
         continue;
       }
@@ -857,15 +865,9 @@ void DownpourWorker::TrainFiles() {
            ++i) {
         uint64_t tid = static_cast<uint64_t>(
             param_.program_config(0).push_sparse_table_id(i));
-        TableParameter table;
-        for (auto i : param_.sparse_table()) {
-          if (i.table_id() == tid) {
-            table = i;
-            break;
-          }
-        }
+        const TableParameter& table = sparse_tables_[tid];
         fleet_ptr_->PushSparseVarsWithLabelAsync(
-            *thread_scope_, tid, features_[tid], feature_labels_[tid],
+            *scope, tid, features_[tid], feature_labels_[tid],
             sparse_key_names_[tid], sparse_grad_names_[tid], table.emb_dim(),
             &feature_grads_[tid], &push_sparse_status_, cur_batch, use_cvm_,
             dump_slot_, &sparse_push_keys_[tid], no_cvm_);
@@ -886,7 +888,7 @@ void DownpourWorker::TrainFiles() {
 
     if (need_to_push_dense_) {
       if (flag_partial_push_) {
-        Variable* var = (*thread_scope_).FindVar("cond_tag");
+        Variable* var = scope->FindVar("cond_tag");
         LoDTensor* tensor = var->GetMutable<LoDTensor>();
         // check type in python code
         int64_t* cond_value_batch = tensor->data<int64_t>();
@@ -974,9 +976,18 @@ void DownpourWorker::TrainFiles() {
     }
 
     PrintFetchVars();
-    thread_scope_->DropKids();
+    scope->DropKids();
     ++batch_cnt;
   }
+  if (prefetch) {
+    device_reader_->AssignFeedVar(*thread_scope_);
+    batch_scope_ = nullptr;
+    feature_value_index_.clear();
+    for (auto& buffer : prefetch_buffers_) {
+      thread_scope_->DeleteScope(buffer.scope);
+      buffer.scope = nullptr;
+    }
+  }
   if (need_dump_field_ || need_dump_param_) {
     writer_.Flush();
   }
@@ -987,5 +998,80 @@ void DownpourWorker::TrainFiles() {
   }
 }
 
+int DownpourWorker::PrefetchBatch(SparsePrefetchBuffer* buffer) {
+  device_reader_->AssignFeedVar(*buffer->scope);
+  buffer->batch_size = device_reader_->Next();
+  buffer->pull_status.clear();
+  if (buffer->batch_size <= 0) {
+    return buffer->batch_size;
+  }
+#ifdef PADDLE_WITH_PSLIB
+  buffer->ins_ids = device_reader_->GetInsIdVec();
+#endif
+  for (int i = 0; i < param_.program_config(0).pull_sparse_table_id_size();
+       ++i) {
+    uint64_t tid = static_cast<uint64_t>(
+        param_.program_config(0).pull_sparse_table_id(i));
+    // the feasigns are collected as PullSparseVarsSync does, and every
+    // unique feasign of the batch is pulled once
+    auto& features = buffer->features[tid];
+    auto& unique_features = buffer->unique_features[tid];
+    auto& value_index = buffer->value_index[tid];
+    features.clear();
+    unique_features.clear();
+    value_index.clear();
+    std::unordered_map<uint64_t, size_t> unique_index;
+    for (size_t j = 0; j < sparse_key_names_[tid].size(); ++j) {
+      Variable* var = buffer->scope->FindVar(sparse_key_names_[tid][j]);
+      if (var == nullptr ||
+          buffer->scope->FindVar(sparse_value_names_[tid][j]) == nullptr) {
+        continue;
+      }
+      const LoDTensor& tensor = var->Get<LoDTensor>();
+      const int64_t* ids = tensor.data<int64_t>();
+      for (int64_t k = 0; k < tensor.numel(); ++k) {
+        if (ids[k] == 0u) {
+          continue;
+        }
+        uint64_t id = static_cast<uint64_t>(ids[k]);
+        auto it = unique_index.emplace(id, unique_features.size()).first;
+        if (it->second == unique_features.size()) {
+          unique_features.push_back(id);
+        }
+        features.push_back(id);
+        value_index.push_back(it->second);
+      }
+    }
+    buffer->pull_status.push_back(fleet_ptr_->PullSparseKeysAsync(
+        tid, unique_features, &buffer->values[tid],
+        sparse_tables_[tid].fea_dim()));
+  }
+  return buffer->batch_size;
+}
+
+void DownpourWorker::TakePrefetchedBatch(SparsePrefetchBuffer* buffer) {
+  for (auto& status : buffer->pull_status) {
+    if (!status.valid()) {
+      continue;
+    }
+    status.wait();
+    int32_t ret = status.get();
+    if (ret != 0) {
+      LOG(ERROR) << "fleet pull sparse failed, status[" << ret << "]";
+      sleep(1);
+      exit(-1);
+    }
+  }
+  buffer->pull_status.clear();
+  for (auto& pair : buffer->features) {
+    uint64_t tid = pair.first;
+    features_[tid].swap(pair.second);
+    feature_values_[tid].swap(buffer->values[tid]);
+    feature_value_index_[tid].swap(buffer->value_index[tid]);
+  }
+  batch_scope_ = buffer->scope;
+  batch_ins_ids_.swap(buffer->ins_ids);
+}
+
 }  // end namespace framework
 }  // end namespace paddle
@@ -105,7 +105,8 @@ void DownpourWorkerOpt::Initialize(const TrainerDesc& desc) {
   for (int i = 0; i < param_.sparse_table_size(); ++i) {
     uint64_t table_id =
         static_cast<uint64_t>(param_.sparse_table(i).table_id());
-    TableParameter table = param_.sparse_table(i);
+    sparse_tables_[table_id] = param_.sparse_table(i);
+    const TableParameter& table = sparse_tables_[table_id];
     sparse_key_names_[table_id].resize(table.sparse_key_name_size());
     for (int j = 0; j < table.sparse_key_name_size(); ++j) {
       sparse_key_names_[table_id][j] = table.sparse_key_name(j);
@@ -262,13 +263,7 @@ void DownpourWorkerOpt::CreateThreadOperatorsWithRerank(
        ++i) {
     uint64_t tid =
         static_cast<uint64_t>(param_.program_config(0).pull_sparse_table_id(i));
-    TableParameter table;
-    for (auto j : param_.sparse_table()) {
-      if (j.table_id() == tid) {
-        table = j;
-        break;
-      }
-    }
+    const TableParameter& table = sparse_tables_[tid];
     if (table.is_async()) {
       async_tid_ = tid;
       async_index_ = i;
@@ -345,13 +340,7 @@ void DownpourWorkerOpt::TrainFiles() {
          ++i) {
       uint64_t tid = static_cast<uint64_t>(
           param_.program_config(0).pull_sparse_table_id(i));
-      TableParameter table;
-      for (auto j : param_.sparse_table()) {
-        if (j.table_id() == tid) {
-          table = j;
-          break;
-        }
-      }
+      const TableParameter& table = sparse_tables_[tid];
       if (table.is_local()) {
         fleet_ptr_->PullSparseVarsFromLocal(
             *thread_scope_, tid, sparse_key_names_[tid], &features_[tid],
@@ -443,13 +432,7 @@ void DownpourWorkerOpt::TrainFiles() {
            ++i) {
         uint64_t tid = static_cast<uint64_t>(
             param_.program_config(0).push_sparse_table_id(i));
-        TableParameter table;
-        for (auto i : param_.sparse_table()) {
-          if (i.table_id() == tid) {
-            table = i;
-            break;
-          }
-        }
+        const TableParameter& table = sparse_tables_[tid];
         fleet_ptr_->PushSparseVarsWithLabelAsync(
             *thread_scope_, tid, features_[tid], feature_labels_[tid],
             sparse_key_names_[tid], sparse_grad_names_[tid], table.emb_dim(),
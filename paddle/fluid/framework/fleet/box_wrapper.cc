@@ -15,6 +15,7 @@
 #include "paddle/fluid/framework/fleet/box_wrapper.h"
 
 #include <algorithm>
+#include <atomic>
 #include <ctime>
 #include <memory>
 #include <numeric>
@@ -28,6 +29,7 @@ DECLARE_bool(use_gpu_replica_cache);
 DECLARE_int32(gpu_replica_cache_dim);
 DECLARE_bool(enable_force_hbm_recyle);
 DECLARE_bool(enable_force_mem_recyle);
+DECLARE_int32(padbox_auc_shard_num);
 namespace paddle {
 namespace framework {
 
@@ -85,6 +87,116 @@ void BasicAucCalculator::add_unlock_data(double pred, int label,
   _table[label][pos] += sample_scale;
 }
 
+void BasicAucCalculator::check_unlock_data(double pred, int label) {
+  PADDLE_ENFORCE_GE(pred, 0.0, platform::errors::PreconditionNotMet(
+                                   "pred should be greater than 0"));
+  PADDLE_ENFORCE_LE(pred, 1.0, platform::errors::PreconditionNotMet(
+                                   "pred should be lower than 1"));
+  PADDLE_ENFORCE_EQ(
+      label * label, label,
+      platform::errors::PreconditionNotMet(
+          "label must be equal to 0 or 1, but its value is: %d", label));
+}
+
+static int GetAucShardSlot() {
+  static std::atomic<int> next_slot(0);
+  thread_local int slot = next_slot.fetch_add(1);
+  return slot;
+}
+
+void BasicAucCalculator::add_cpu_data(const float* pred, const int64_t* label,
+                                      const int64_t* mask,
+                                      const float* sample_scale,
+                                      int batch_size) {
+  thread_local std::vector<int> h_pos;
+  thread_local std::vector<int> h_weight;
+  h_pos.resize(batch_size);
+  h_weight.resize(batch_size);
+  int* pos = h_pos.data();
+  int* weight = h_weight.data();
+
+  // branch free passes over the whole batch, so that the compiler can
+  // vectorize them, instead of checking every prediction on its own
+  int invalid = 0;
+  for (int i = 0; i < batch_size; ++i) {
+    weight[i] = (mask == nullptr || mask[i] != 0) ? 1 : 0;
+    int ok = (pred[i] >= 0.0f) & (pred[i] <= 1.0f) &
+             ((label[i] & ~static_cast<int64_t>(1)) == 0);
+    invalid += weight[i] & (ok ^ 1);
+  }
+  if (invalid > 0) {
+    // report the first bad instance with the messages of add_unlock_data
+    for (int i = 0; i < batch_size; ++i) {
+      if (weight[i]) {
+        check_unlock_data(pred[i], label[i]);
+      }
+    }
+  }
+  // the masked rows are not validated, their preds may be out of [0, 1]
+  // or NaN, so the bucket is clamped with NaN taken as 0, and the masked
+  // rows add nothing to the errors
+  const double table_size = static_cast<double>(_table_size);
+  const double max_pos = static_cast<double>(_table_size - 1);
+  for (int i = 0; i < batch_size; ++i) {
+    double p = pred[i] > 0.0f ? static_cast<double>(pred[i]) * table_size : 0;
+    pos[i] = static_cast<int>(p < max_pos ? p : max_pos);
+  }
+  double abserr = 0;
+  double sqrerr = 0;
+  double pred_sum = 0;
+  for (int i = 0; i < batch_size; ++i) {
+    double p = weight[i] ? static_cast<double>(pred[i]) : 0.0;
+    double err = weight[i] ? p - static_cast<double>(label[i]) : 0.0;
+    double scale = sample_scale == nullptr ? 1.0 : sample_scale[i];
+    abserr += fabs(err);
+    sqrerr += err * err;
+    pred_sum += (weight[i] ? scale : 0.0) * p;
+  }
+
+  HistogramShard* shard = &_shards[GetAucShardSlot() % _shard_num];
+  std::lock_guard<std::mutex> lock(shard->mutex);
+  if (shard->table[0].empty()) {
+    shard->table[0].assign(_table_size, 0.0);
+    shard->table[1].assign(_table_size, 0.0);
+  }
+  double* table[2] = {shard->table[0].data(), shard->table[1].data()};
+  if (sample_scale == nullptr) {
+    for (int i = 0; i < batch_size; ++i) {
+      table[label[i] & 1][pos[i]] += weight[i];
+    }
+  } else {
+    for (int i = 0; i < batch_size; ++i) {
+      table[label[i] & 1][pos[i]] += weight[i] ? sample_scale[i] : 0.0f;
+    }
+  }
+  shard->abserr += abserr;
+  shard->sqrerr += sqrerr;
+  shard->pred += pred_sum;
+}
+
+void BasicAucCalculator::merge_shards() {
+  for (int k = 0; k < _shard_num; ++k) {
+    HistogramShard* shard = &_shards[k];
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    if (shard->table[0].empty()) {
+      continue;
+    }
+    for (int i = 0; i < _table_size; ++i) {
+      _table[0][i] += shard->table[0][i];
+      _table[1][i] += shard->table[1][i];
+    }
+    _local_abserr += shard->abserr;
+    _local_sqrerr += shard->sqrerr;
+    _local_pred += shard->pred;
+    // released here, the next pass allocates it again on first use
+    shard->table[0] = std::vector<double>();
+    shard->table[1] = std::vector<double>();
+    shard->abserr = 0;
+    shard->sqrerr = 0;
+    shard->pred = 0;
+  }
+}
+
 void BasicAucCalculator::add_data(const float* d_pred, const int64_t* d_label,
                                   int batch_size,
                                   const paddle::platform::Place& place) {
@@ -100,10 +212,7 @@ void BasicAucCalculator::add_data(const float* d_pred, const int64_t* d_label,
     cudaMemcpy(h_label.data(), d_label, sizeof(int64_t) * batch_size,
                cudaMemcpyDeviceToHost);
 
-    std::lock_guard<std::mutex> lock(_table_mutex);
-    for (int i = 0; i < batch_size; ++i) {
-      add_unlock_data(h_pred[i], h_label[i]);
-    }
+    add_cpu_data(h_pred.data(), h_label.data(), nullptr, nullptr, batch_size);
   }
 }
 
@@ -120,10 +229,8 @@ void BasicAucCalculator::add_sample_data(
   cudaMemcpy(h_label.data(), d_label, sizeof(int64_t) * batch_size,
              cudaMemcpyDeviceToHost);
 
-  std::lock_guard<std::mutex> lock(_table_mutex);
-  for (int i = 0; i < batch_size; ++i) {
-    add_unlock_data(h_pred[i], h_label[i], d_sample_scale[i]);
-  }
+  add_cpu_data(h_pred.data(), h_label.data(), nullptr, d_sample_scale.data(),
+               batch_size);
 }
 
 // add mask data
@@ -148,12 +255,8 @@ void BasicAucCalculator::add_mask_data(const float* d_pred,
     cudaMemcpy(h_mask.data(), d_mask, sizeof(int64_t) * batch_size,
                cudaMemcpyDeviceToHost);
 
-    std::lock_guard<std::mutex> lock(_table_mutex);
-    for (int i = 0; i < batch_size; ++i) {
-      if (h_mask[i]) {
-        add_unlock_data(h_pred[i], h_label[i]);
-      }
-    }
+    add_cpu_data(h_pred.data(), h_label.data(), h_mask.data(), nullptr,
+                 batch_size);
   }
 }
 
@@ -170,6 +273,8 @@ void BasicAucCalculator::init(int table_size, int max_batch_size) {
   for (int i = 0; i < 2; i++) {
     _table[i] = std::vector<double>();
   }
+  _shard_num = std::max(FLAGS_padbox_auc_shard_num, 1);
+  _shards.reset(new HistogramShard[_shard_num]);
   // init GPU memory
   if (_mode_collect_in_gpu) {
     for (int i = 0; i < platform::GetCUDADeviceCount(); ++i) {
@@ -198,6 +303,14 @@ void BasicAucCalculator::reset() {
   _local_abserr = 0;
   _local_sqrerr = 0;
   _local_pred = 0;
+  for (int k = 0; k < _shard_num; ++k) {
+    std::lock_guard<std::mutex> lock(_shards[k].mutex);
+    _shards[k].table[0] = std::vector<double>();
+    _shards[k].table[1] = std::vector<double>();
+    _shards[k].abserr = 0;
+    _shards[k].sqrerr = 0;
+    _shards[k].pred = 0;
+  }
   // reset GPU counter
   if (_mode_collect_in_gpu) {
     // backup orginal device
@@ -323,6 +436,8 @@ void BasicAucCalculator::compute() {
     collect_data_nccl();
     // copy from GPU0
     copy_data_d2h(0);
+  } else {
+    merge_shards();
   }
 
   double* table[2] = {&_table[0][0], &_table[1][0]};
@@ -440,6 +555,16 @@ void BoxWrapper::PullSparse(const paddle::platform::Place& place,
   } break
 
   CheckEmbedSizeIsValid(hidden_size - cvm_offset_, expand_embed_dim);
+  static auto* pull_keys = platform::MetricsRegistry::Instance().GetCounter(
+      "padbox_pull_sparse_keys_total", "the keys pulled from boxps");
+  static auto* pull_latency =
+      platform::MetricsRegistry::Instance().GetHistogram(
+          "padbox_pull_sparse_latency_ms", "the milliseconds of a sparse pull");
+  int64_t total_length = std::accumulate(
+      slot_lengths.begin(), slot_lengths.end(), static_cast<int64_t>(0));
+  pull_keys->Increase(total_length);
+  platform::ScopedLatency latency(pull_latency);
+  platform::TraceScope trace(platform::TraceEvent::kPullSparse, total_length);
   switch (embedx_dim_) {
     EMBEDX_CASE(0, PULLSPARSE_CASE(0););
     EMBEDX_CASE(8, PULLSPARSE_CASE(0); PULLSPARSE_CASE(1); PULLSPARSE_CASE(2);
@@ -511,6 +636,16 @@ void BoxWrapper::PushSparseGrad(const paddle::platform::Place& place,
   } break
 
   CheckEmbedSizeIsValid(hidden_size - cvm_offset_, expand_embed_dim);
+  static auto* push_keys = platform::MetricsRegistry::Instance().GetCounter(
+      "padbox_push_sparse_keys_total", "the keys pushed to boxps");
+  static auto* push_latency =
+      platform::MetricsRegistry::Instance().GetHistogram(
+          "padbox_push_sparse_latency_ms", "the milliseconds of a sparse push");
+  int64_t total_length = std::accumulate(
+      slot_lengths.begin(), slot_lengths.end(), static_cast<int64_t>(0));
+  push_keys->Increase(total_length);
+  platform::ScopedLatency latency(push_latency);
+  platform::TraceScope trace(platform::TraceEvent::kPushSparse, total_length);
   switch (embedx_dim_) {
     EMBEDX_CASE(0, PUSHSPARSE_CASE(0););
     EMBEDX_CASE(8, PUSHSPARSE_CASE(0); PUSHSPARSE_CASE(1); PUSHSPARSE_CASE(2);
@@ -578,6 +713,10 @@ void BoxWrapper::FeedPass(int date,
 }
 
 void BoxWrapper::BeginFeedPass(int date, boxps::PSAgentBase** agent) {
+  platform::TraceScope trace(platform::TraceEvent::kBeginFeedPass);
+  platform::MetricsRegistry::Instance()
+      .GetCounter("padbox_feed_pass_total", "the passes fed into boxps")
+      ->Increase();
   if (FLAGS_enable_force_mem_recyle) {
     SlotRecordPool().disable_pool(true);
   }
@@ -596,6 +735,7 @@ void BoxWrapper::BeginFeedPass(int date, boxps::PSAgentBase** agent) {
 }
 
 void BoxWrapper::EndFeedPass(boxps::PSAgentBase* agent) {
+  platform::TraceScope trace(platform::TraceEvent::kEndFeedPass);
   if (FLAGS_use_gpu_replica_cache) {
     auto& t = gpu_replica_cache.back();
     t.ToHBM();
@@ -731,6 +871,41 @@ void BoxWrapper::RecordReplaceBack(std::vector<SlotRecord>* records,
           << "add feasign num: " << add_num.sum();
 }
 
+void BoxWrapper::SetOverlay(const std::vector<SlotRecord>& records,
+                            const std::set<uint16_t>& slots) {
+  platform::Timer timer;
+  timer.Start();
+
+  std::lock_guard<std::mutex> lock(mutex4random_pool_);
+  // the candidates are resolved once a pass, the next pass may refill the
+  // random pools while the readers are still packing this one
+  if (overlay_candidates_.size() != records.size()) {
+    overlay_candidates_.resize(records.size());
+    std::vector<std::thread> threads;
+    for (int tid = 0; tid < auc_runner_thread_num_; ++tid) {
+      threads.push_back(std::thread([this, &records, tid]() {
+        size_t ins_num = records.size();
+        size_t start = tid * ins_num / auc_runner_thread_num_;
+        size_t end = (tid + 1) * ins_num / auc_runner_thread_num_;
+        for (size_t j = start; j < end; ++j) {
+          auto info = get_auc_runner_info(records[j]);
+          overlay_candidates_[info->record_id_] =
+              &random_ins_pool_list[info->pool_id_].GetUseReplaceId(
+                  info->replaced_id_);
+        }
+      }));
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+  overlay_slots_idx_.assign(slots.begin(), slots.end());
+
+  timer.Pause();
+  VLOG(0) << "SetOverlay of " << overlay_slots_idx_.size()
+          << " slots cost: " << timer.ElapsedMS();
+}
+
 void BoxWrapper::GetRandomReplace(std::vector<SlotRecord>* records) {
   VLOG(0) << "Begin GetRandomReplace";
   platform::Timer timer;
@@ -858,19 +1033,21 @@ class MultiTaskMetricMsg : public MetricMsg {
               "illegal batch size: batch_size[%lu] and pred_data[%lu]",
               batch_size, pred_data_list[i].size()));
     }
-    auto cal = GetCalculator();
-    std::lock_guard<std::mutex> lock(cal->table_mutex());
+    std::vector<float> pred_data(batch_size, 0.0);
+    std::vector<int64_t> mask_data(batch_size, 0);
     for (size_t i = 0; i < batch_size; ++i) {
       auto cmatch_rank_it =
           std::find(cmatch_rank_v.begin(), cmatch_rank_v.end(),
                     parse_cmatch_rank(cmatch_rank_data[i]));
       if (cmatch_rank_it != cmatch_rank_v.end()) {
-        cal->add_unlock_data(
-            pred_data_list[std::distance(cmatch_rank_v.begin(), cmatch_rank_it)]
-                          [i],
-            label_data[i]);
+        pred_data[i] = pred_data_list[std::distance(cmatch_rank_v.begin(),
+                                                    cmatch_rank_it)][i];
+        mask_data[i] = 1;
       }
     }
+    auto cal = GetCalculator();
+    cal->add_cpu_data(pred_data.data(), label_data.data(), mask_data.data(),
+                      nullptr, batch_size);
   }
 
  protected:
@@ -927,8 +1104,7 @@ class CmatchRankMetricMsg : public MetricMsg {
         platform::errors::PreconditionNotMet(
             "illegal batch size: cmatch_rank[%lu] and pred_data[%lu]",
             batch_size, pred_data.size()));
-    auto cal = GetCalculator();
-    std::lock_guard<std::mutex> lock(cal->table_mutex());
+    std::vector<int64_t> match_data(batch_size, 0);
     for (size_t i = 0; i < batch_size; ++i) {
       const auto& cur_cmatch_rank = parse_cmatch_rank(cmatch_rank_data[i]);
       for (size_t j = 0; j < cmatch_rank_v.size(); ++j) {
@@ -939,11 +1115,14 @@ class CmatchRankMetricMsg : public MetricMsg {
           is_matched = cmatch_rank_v[j] == cur_cmatch_rank;
         }
         if (is_matched) {
-          cal->add_unlock_data(pred_data[i], label_data[i]);
+          match_data[i] = 1;
           break;
         }
       }
     }
+    auto cal = GetCalculator();
+    cal->add_cpu_data(pred_data.data(), label_data.data(), match_data.data(),
+                      nullptr, batch_size);
   }
 
  protected:
@@ -1053,14 +1232,13 @@ class CmatchRankMaskMetricMsg : public MetricMsg {
               batch_size, mask_data.size()));
     }
 
-    auto cal = GetCalculator();
-    std::lock_guard<std::mutex> lock(cal->table_mutex());
+    std::vector<int64_t> match_data(batch_size, 0);
     for (size_t i = 0; i < batch_size; ++i) {
+      if (!mask_data.empty() && !mask_data[i]) {
+        continue;
+      }
       const auto& cur_cmatch_rank = parse_cmatch_rank(cmatch_rank_data[i]);
       for (size_t j = 0; j < cmatch_rank_v.size(); ++j) {
-        if (!mask_data.empty() && !mask_data[i]) {
-          continue;
-        }
         bool is_matched = false;
         if (ignore_rank_) {
           is_matched = cmatch_rank_v[j].first == cur_cmatch_rank.first;
@@ -1068,11 +1246,14 @@ class CmatchRankMaskMetricMsg : public MetricMsg {
           is_matched = cmatch_rank_v[j] == cur_cmatch_rank;
         }
         if (is_matched) {
-          cal->add_unlock_data(pred_data[i], label_data[i]);
+          match_data[i] = 1;
           break;
         }
       }
     }
+    auto cal = GetCalculator();
+    cal->add_cpu_data(pred_data.data(), label_data.data(), match_data.data(),
+                      nullptr, batch_size);
   }
 
  protected:
@@ -1180,6 +1361,13 @@ void BoxWrapper::PrintSyncTimer(int device, double train_span) {
                << ", boxps span:" << dev.boxps_push_timer.ElapsedSec()
                << ", dense nccl:" << dev.dense_nccl_timer.ElapsedSec()
                << ", sync stream:" << dev.dense_sync_timer.ElapsedSec()
+               << ", async dense push:" << dev.async_dense_timer.ElapsedSec()
+               << ", async dense queue avg:"
+               << (dev.async_dense_push_num > 0
+                       ? 1.0 * dev.async_dense_queue_depth /
+                             dev.async_dense_push_num
+                       : 0)
+               << ", max:" << dev.async_dense_max_depth
                << ", wrapper gpu memory:" << dev.GpuMemUsed() << "MB";
   dev.ResetTimer();
 }
@@ -39,9 +39,12 @@ limitations under the License. */
 
 #include "paddle/fluid/framework/data_feed.h"
 #include "paddle/fluid/framework/data_set.h"
+#include "paddle/fluid/framework/fleet/input_table.h"
 #include "paddle/fluid/framework/lod_tensor.h"
 #include "paddle/fluid/framework/scope.h"
 #include "paddle/fluid/platform/gpu_info.h"
+#include "paddle/fluid/platform/hot_path_trace.h"
+#include "paddle/fluid/platform/metrics.h"
 #include "paddle/fluid/platform/monitor.h"
 #include "paddle/fluid/platform/place.h"
 #include "paddle/fluid/platform/timer.h"
@@ -50,8 +53,10 @@ limitations under the License. */
 
 DECLARE_int32(fix_dayid);
 DECLARE_bool(padbox_auc_runner_mode);
+DECLARE_bool(padbox_auc_runner_overlay);
 DECLARE_bool(enable_dense_nccl_barrier);
 DECLARE_int32(padbox_dataset_shuffle_thread_num);
+DECLARE_string(padbox_hot_path_trace_dir);
 
 namespace paddle {
 namespace framework {
@@ -67,6 +72,13 @@ class BasicAucCalculator {
   // add single data in CPU with LOCK, deprecated
   void add_unlock_data(double pred, int label);
   void add_unlock_data(double pred, int label, float sample_scale);
+  // add a batch of host data without holding table_mutex: the predictions
+  // are validated and bucketed for the whole batch, then accumulated into the
+  // histogram shard of the calling thread which compute() merges. mask and
+  // sample_scale may be nullptr.
+  void add_cpu_data(const float* pred, const int64_t* label,
+                    const int64_t* mask, const float* sample_scale,
+                    int batch_size);
   // add batch data
   void add_data(const float* d_pred, const int64_t* d_label, int batch_size,
                 const paddle::platform::Place& place);
@@ -102,6 +114,8 @@ class BasicAucCalculator {
                           const int64_t* label, const float* pred,
                           const int64_t* mask, int len);
   void calculate_bucket_error();
+  void merge_shards();
+  void check_unlock_data(double pred, int label);
 
  protected:
   double _local_abserr = 0;
@@ -135,6 +149,19 @@ class BasicAucCalculator {
   static constexpr double kRelativeErrorBound = 0.05;
   static constexpr double kMaxSpan = 0.01;
   std::mutex _table_mutex;
+
+  // Histogram of the threads feeding add_cpu_data. Threads are spread over
+  // FLAGS_padbox_auc_shard_num shards, so the shard lock is uncontended as
+  // long as there are no more feeding threads than shards.
+  struct HistogramShard {
+    std::mutex mutex;
+    std::vector<double> table[2];
+    double abserr = 0;
+    double sqrerr = 0;
+    double pred = 0;
+  };
+  std::unique_ptr<HistogramShard[]> _shards;
+  int _shard_num = 0;
 };
 
 class GpuReplicaCache {
@@ -185,67 +212,6 @@ class GpuReplicaCache {
   std::vector<float> h_emb_;
 };
 
-class InputTable {
- public:
-  explicit InputTable(uint64_t dim) : dim_(dim), miss_(0) {
-    // add default vec 0 => [0, 0, ...]
-    std::vector<float> vec(dim_, 0);
-    AddIndexData("-", vec);
-  }
-
-  void AddIndexData(const std::string& key, const std::vector<float>& vec) {
-    PADDLE_ENFORCE_EQ(vec.size(), dim_);
-
-    table_mutex_.lock();
-    key_offset_.emplace(key, table_.size());
-    table_.insert(table_.end(), vec.begin(), vec.end());
-    table_mutex_.unlock();
-  }
-
-  uint64_t GetIndexOffset(const std::string& key) {
-    auto it = key_offset_.find(key);
-    if (it == key_offset_.end()) {
-      ++miss_;
-      return 0;
-    }
-
-    return it->second;
-  }
-
-  void LookupInput(uint64_t* keys, float* values, uint64_t num,
-                   size_t device_id) {
-    std::vector<uint64_t> d_keys;
-    std::vector<float> d_values;
-    d_keys.resize(num);
-    d_values.resize(num * dim_);
-
-    cudaSetDevice(device_id);
-    cudaMemcpy(d_keys.data(), keys, d_keys.size() * sizeof(uint64_t),
-               cudaMemcpyDeviceToHost);
-    for (size_t i = 0; i < num; ++i) {
-      memcpy(&d_values[i * dim_], &table_[d_keys[i]], dim_ * sizeof(float));
-    }
-    cudaMemcpy(values, d_values.data(), d_values.size() * sizeof(float),
-               cudaMemcpyHostToDevice);
-  }
-
-  size_t size() const { return key_offset_.size(); }
-
-  size_t miss() const { return miss_; }
-
-  size_t dim() const { return dim_; }
-
-  double CpuMemUsed(void) {
-    return (key_offset_.size() * dim_ * sizeof(float)) / 1024.0 / 1024.0;
-  }
-
- protected:
-  uint64_t dim_;
-  std::mutex table_mutex_;
-  std::unordered_map<std::string, uint64_t> key_offset_;
-  std::vector<float> table_;
-  std::atomic<size_t> miss_;
-};
 class DCacheBuffer {
  public:
   DCacheBuffer() : buf_(nullptr) {}
@@ -378,9 +344,14 @@ class BoxWrapper {
     platform::Timer boxps_push_timer;
     platform::Timer dense_nccl_timer;
     platform::Timer dense_sync_timer;
+    platform::Timer async_dense_timer;
 
     int64_t total_key_length = 0;
     int64_t dedup_key_length = 0;
+    // grads waiting in the async dense queue at every push
+    int64_t async_dense_push_num = 0;
+    int64_t async_dense_queue_depth = 0;
+    int64_t async_dense_max_depth = 0;
 
     void ResetTimer(void) {
       all_pull_timer.Reset();
@@ -389,6 +360,10 @@ class BoxWrapper {
       boxps_push_timer.Reset();
       dense_nccl_timer.Reset();
       dense_sync_timer.Reset();
+      async_dense_timer.Reset();
+      async_dense_push_num = 0;
+      async_dense_queue_depth = 0;
+      async_dense_max_depth = 0;
     }
     double GpuMemUsed(void) {
       size_t total = 0;
@@ -416,6 +391,14 @@ class BoxWrapper {
   }
   void SetDatasetName(const std::string& name) {}
   void SetInputTableDim(size_t dim) { input_table_dim_ = dim; }
+  // save the input table of the feeding pass as an image for
+  // InputTableDataset.set_index_image
+  void SaveInputTableImage(const std::string& path) {
+    PADDLE_ENFORCE_EQ(input_table_deque_.empty(), false,
+                      platform::errors::PreconditionNotMet(
+                          "No input table to save, call it in a feed pass"));
+    input_table_deque_.back().SaveImage(path);
+  }
   void FeedPass(int date, const std::vector<uint64_t>& feasgin_to_box);
   void BeginFeedPass(int date, boxps::PSAgentBase** agent);
   void EndFeedPass(boxps::PSAgentBase* agent);
@@ -572,6 +555,26 @@ class BoxWrapper {
     }
   }
 
+  // time the push of the async dense grads, queue_depth is the number of
+  // grads not applied yet when the push begins
+  void AsyncDenseTimer(const int deviceid, bool pause,
+                       int64_t queue_depth = 0) {
+    auto& dev = device_caches_[deviceid];
+    if (pause) {
+      dev.async_dense_timer.Pause();
+      return;
+    }
+    static auto* depth = platform::MetricsRegistry::Instance().GetGauge(
+        "padbox_async_dense_queue_depth",
+        "the async dense grads not applied when the last push begins");
+    depth->Set(queue_depth);
+    ++dev.async_dense_push_num;
+    dev.async_dense_queue_depth += queue_depth;
+    dev.async_dense_max_depth =
+        std::max(dev.async_dense_max_depth, queue_depth);
+    dev.async_dense_timer.Resume();
+  }
+
   void InitAfsAPI(const std::string& fs_name, const std::string& fs_ugi,
                   const std::string& conf_path) {
     file_manager_.reset(boxps::PaddleFileMgr::New());
@@ -740,6 +743,8 @@ class BoxWrapper {
     }
     record_replacers_.clear();
     last_slots_idx_.clear();
+    overlay_slots_idx_.clear();
+    overlay_candidates_.clear();
 
     timer.Pause();
     VLOG(0) << "PopAucRunnerResource cost: " << timer.ElapsedMS();
@@ -753,6 +758,18 @@ class BoxWrapper {
   void RecordReplaceBack(std::vector<SlotRecord>* records,
                          const std::set<uint16_t>& slots);
 
+  // overlay mode of the auc runner, the records keep their own feasigns and
+  // the readers take the replaced slots from the candidates of the records
+  void SetOverlay(const std::vector<SlotRecord>& records,
+                  const std::set<uint16_t>& slots);
+  const std::vector<uint16_t>& GetOverlaySlots() const {
+    return overlay_slots_idx_;
+  }
+  const FeasignValuesCandidate& GetOverlayCandidate(
+      const SlotRecord& record) const {
+    return *overlay_candidates_[get_auc_runner_info(record)->record_id_];
+  }
+
   // aucrunner
   void SetReplacedSlots(const std::set<uint16_t>& slot_index_to_replace) {
     for (int i = 0; i < auc_runner_thread_num_; ++i) {
@@ -770,6 +787,10 @@ class BoxWrapper {
   std::vector<FeasignValuesCandidateList> random_ins_pool_list;
   std::mutex mutex4random_pool_;
   std::set<std::string> slot_eval_set_;
+  // sorted slot index replaced in overlay mode
+  std::vector<uint16_t> overlay_slots_idx_;
+  // the candidate of every record, indexed by the record id
+  std::vector<const FeasignValuesCandidate*> overlay_candidates_;
   std::atomic<uint16_t> dataset_id_{0};
 };
 /**
@@ -827,6 +848,8 @@ class BoxHelper {
       box_ptr->PopAucRunnerResource();
     }
 #endif
+    platform::HotPathTrace::Instance().DumpPass(
+        FLAGS_padbox_hot_path_trace_dir);
   }
 #ifdef PADDLE_WITH_BOX_PS
   void LoadAucRunnerData(PadBoxSlotDataset* dataset,
@@ -970,6 +993,14 @@ class BoxHelper {
     auto& records = dataset->GetInputRecord();
     auto slot_idx = dataset->GetSlotsIdx(slots_to_replace);
 
+    if (FLAGS_padbox_auc_runner_overlay) {
+      if (box_ptr->last_slots_idx_.size() > 0) {
+        box_ptr->RecordReplaceBack(&records, box_ptr->last_slots_idx_);
+        box_ptr->last_slots_idx_.clear();
+      }
+      box_ptr->SetOverlay(records, slot_idx);
+      return;
+    }
     if (box_ptr->record_replacers_.size() != records.size()) {
       box_ptr->record_replacers_.resize(records.size());
     }
@@ -0,0 +1,159 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/fleet/box_wrapper.h"
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <thread>  // NOLINT
+#include <vector>
+
+DECLARE_int32(padbox_auc_shard_num);
+
+namespace paddle {
+namespace framework {
+
+#ifdef PADDLE_WITH_BOX_PS
+const int kTableSize = 1000;
+const int kBatchNum = 16;
+const int kBatchSize = 257;
+
+// batch b masks every seventh instance when b is odd and scales the
+// instances by 0.5 or 2 when b % 4 == 2, the scales keep the sums exact
+struct AucBatch {
+  std::vector<float> pred;
+  std::vector<int64_t> label;
+  std::vector<int64_t> mask;
+  std::vector<float> scale;
+
+  explicit AucBatch(int b) {
+    for (int i = 0; i < kBatchSize; ++i) {
+      int k = b * kBatchSize + i;
+      pred.push_back(static_cast<float>((k * 7919) % 1001) / 1000.0f);
+      label.push_back((k * 31 + b) % 3 == 0 ? 1 : 0);
+      mask.push_back(i % 7 != 0);
+      scale.push_back(i % 2 == 0 ? 0.5f : 2.0f);
+    }
+  }
+
+  void AddTo(BasicAucCalculator* calc, int b) const {
+    calc->add_cpu_data(pred.data(), label.data(),
+                       b % 2 == 1 ? mask.data() : nullptr,
+                       b % 4 == 2 ? scale.data() : nullptr, kBatchSize);
+  }
+};
+
+TEST(BasicAucCalculator, merge_shards) {
+  std::vector<AucBatch> batches;
+  for (int b = 0; b < kBatchNum; ++b) {
+    batches.emplace_back(b);
+  }
+
+  FLAGS_padbox_auc_shard_num = 1;
+  BasicAucCalculator expect;
+  expect.init(kTableSize);
+  for (int b = 0; b < kBatchNum; ++b) {
+    batches[b].AddTo(&expect, b);
+  }
+  expect.compute();
+
+  // every thread takes a shard of its own, and the calculator is reused
+  // after reset to check that the shards are cleared
+  const int thread_num = 4;
+  FLAGS_padbox_auc_shard_num = thread_num;
+  BasicAucCalculator calc;
+  calc.init(kTableSize);
+  for (int round = 0; round < 2; ++round) {
+    calc.reset();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_num; ++t) {
+      threads.emplace_back([&batches, &calc, t, thread_num]() {
+        for (int b = t; b < kBatchNum; b += thread_num) {
+          batches[b].AddTo(&calc, b);
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    calc.compute();
+
+    for (int i = 0; i < kTableSize; ++i) {
+      ASSERT_EQ(calc.get_negative()[i], expect.get_negative()[i]);
+      ASSERT_EQ(calc.get_postive()[i], expect.get_postive()[i]);
+    }
+    EXPECT_NEAR(calc.local_abserr(), expect.local_abserr(), 1e-6);
+    EXPECT_NEAR(calc.local_sqrerr(), expect.local_sqrerr(), 1e-6);
+    EXPECT_NEAR(calc.local_pred(), expect.local_pred(), 1e-6);
+    EXPECT_EQ(calc.size(), expect.size());
+    EXPECT_DOUBLE_EQ(calc.auc(), expect.auc());
+    EXPECT_NEAR(calc.mae(), expect.mae(), 1e-9);
+    EXPECT_NEAR(calc.predicted_ctr(), expect.predicted_ctr(), 1e-9);
+  }
+  FLAGS_padbox_auc_shard_num = 8;
+}
+
+// the masked rows may hold any pred, they leave the histogram and the
+// errors as if they were not in the batch
+TEST(BasicAucCalculator, masked_out_of_range_pred) {
+  const float bad_preds[] = {-1.0f, std::nanf(""), 2.0f,
+                             std::numeric_limits<float>::infinity(),
+                             -std::numeric_limits<float>::infinity()};
+  std::vector<float> pred;
+  std::vector<int64_t> label;
+  std::vector<int64_t> mask;
+  std::vector<float> scale;
+  std::vector<float> kept_pred;
+  std::vector<int64_t> kept_label;
+  std::vector<float> kept_scale;
+  for (int i = 0; i < 100; ++i) {
+    bool masked = i % 3 == 0;
+    float p = masked ? bad_preds[i % 5] : (i % 10) / 10.0f;
+    pred.push_back(p);
+    label.push_back(i % 2);
+    mask.push_back(!masked);
+    scale.push_back(masked ? std::nanf("") : 0.5f);
+    if (!masked) {
+      kept_pred.push_back(p);
+      kept_label.push_back(i % 2);
+      kept_scale.push_back(0.5f);
+    }
+  }
+  for (bool scaled : {false, true}) {
+    BasicAucCalculator calc;
+    calc.init(kTableSize);
+    calc.add_cpu_data(pred.data(), label.data(), mask.data(),
+                      scaled ? scale.data() : nullptr, pred.size());
+    calc.compute();
+    BasicAucCalculator expect;
+    expect.init(kTableSize);
+    expect.add_cpu_data(kept_pred.data(), kept_label.data(), nullptr,
+                        scaled ? kept_scale.data() : nullptr,
+                        kept_pred.size());
+    expect.compute();
+    EXPECT_EQ(calc.get_negative(), expect.get_negative());
+    EXPECT_EQ(calc.get_postive(), expect.get_postive());
+    EXPECT_DOUBLE_EQ(calc.local_abserr(), expect.local_abserr());
+    EXPECT_DOUBLE_EQ(calc.local_sqrerr(), expect.local_sqrerr());
+    EXPECT_DOUBLE_EQ(calc.local_pred(), expect.local_pred());
+    EXPECT_DOUBLE_EQ(calc.auc(), expect.auc());
+  }
+}
+#endif
+
+}  // namespace framework
+}  // namespace paddle
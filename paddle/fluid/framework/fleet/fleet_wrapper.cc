@@ -497,7 +497,16 @@ std::future<int32_t> FleetWrapper::PullSparseVarsAsync(
       fea_keys->push_back(static_cast<uint64_t>(ids[i]));
     }
   }
-  fea_values->resize(fea_keys->size() + 1);
+  return PullSparseKeysAsync(table_id, *fea_keys, fea_values, fea_value_dim);
+#endif
+  return std::future<int32_t>();
+}
+
+std::future<int32_t> FleetWrapper::PullSparseKeysAsync(
+    const uint64_t table_id, const std::vector<uint64_t>& fea_keys,
+    std::vector<std::vector<float>>* fea_values, int fea_value_dim) {
+#ifdef PADDLE_WITH_PSLIB
+  fea_values->resize(fea_keys.size() + 1);
   for (auto& t : *fea_values) {
     t.resize(fea_value_dim);
   }
@@ -506,7 +515,7 @@ std::future<int32_t> FleetWrapper::PullSparseVarsAsync(
     pull_result_ptr.push_back(t.data());
   }
   return pslib_ptr_->_worker_ptr->pull_sparse(
-      pull_result_ptr.data(), table_id, fea_keys->data(), fea_keys->size());
+      pull_result_ptr.data(), table_id, fea_keys.data(), fea_keys.size());
 #endif
   return std::future<int32_t>();
 }
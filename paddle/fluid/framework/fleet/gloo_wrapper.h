@@ -29,6 +29,7 @@ limitations under the License. */
 #include <gloo/allgather.h>
 #include <gloo/allreduce.h>
 #include <gloo/barrier.h>
+#include <gloo/broadcast.h>
 #include <gloo/rendezvous/context.h>
 #include <gloo/rendezvous/file_store.h>
 #include <gloo/rendezvous/http_store.h>
@@ -173,22 +174,7 @@ class GlooWrapper {
     gloo::AllreduceOptions opts(context_);
     opts.setInput(sendbuf.data(), sendbuf.size());
     opts.setOutput(recvbuf.data(), recvbuf.size());
-    if (mode == "sum") {
-      opts.setReduceFunction(
-          static_cast<void (*)(void*, const void*, const void*, size_t)>(
-              &gloo::sum<T>));
-    } else if (mode == "max") {
-      opts.setReduceFunction(
-          static_cast<void (*)(void*, const void*, const void*, size_t)>(
-              &gloo::max<T>));
-    } else if (mode == "min") {
-      opts.setReduceFunction(
-          static_cast<void (*)(void*, const void*, const void*, size_t)>(
-              &gloo::min<T>));
-    } else {
-      PADDLE_ENFORCE_EQ(0, 1, paddle::platform::errors::InvalidArgument(
-                                  "AllReduce mode not known: " + mode));
-    }
+    SetReduceFunction<T>(&opts, mode);
     gloo::allreduce(opts);
 #else
     LOG(WARNING) << "AllReduce does nothing when WITH_GLOO=OFF";
@@ -196,6 +182,34 @@ class GlooWrapper {
     return recvbuf;
   }
 
+  // Reduce the count elements of buffer of all the ranks in place.
+  template <typename T>
+  void AllReduce(T* buffer, size_t count, const std::string& mode = "sum") {
+    CHECK_EQ(is_initialized_, true);
+#ifdef PADDLE_WITH_GLOO
+    gloo::AllreduceOptions opts(context_);
+    opts.setOutput(buffer, count);
+    SetReduceFunction<T>(&opts, mode);
+    gloo::allreduce(opts);
+#else
+    LOG(WARNING) << "AllReduce does nothing when WITH_GLOO=OFF";
+#endif
+  }
+
+  // Copy the count elements of buffer of the root to the other ranks.
+  template <typename T>
+  void Broadcast(T* buffer, size_t count, int root) {
+    CHECK_EQ(is_initialized_, true);
+#ifdef PADDLE_WITH_GLOO
+    gloo::BroadcastOptions opts(context_);
+    opts.setOutput(buffer, count);
+    opts.setRoot(root);
+    gloo::broadcast(opts);
+#else
+    LOG(WARNING) << "Broadcast does nothing when WITH_GLOO=OFF";
+#endif
+  }
+
   template <typename T>
   std::vector<T> AllGather(T& input) {  // NOLINT
     CHECK_EQ(is_initialized_, true);
@@ -212,6 +226,29 @@ class GlooWrapper {
   }
 
  protected:
+#ifdef PADDLE_WITH_GLOO
+  template <typename T>
+  static void SetReduceFunction(gloo::AllreduceOptions* opts,
+                                const std::string& mode) {
+    if (mode == "sum") {
+      opts->setReduceFunction(
+          static_cast<void (*)(void*, const void*, const void*, size_t)>(
+              &gloo::sum<T>));
+    } else if (mode == "max") {
+      opts->setReduceFunction(
+          static_cast<void (*)(void*, const void*, const void*, size_t)>(
+              &gloo::max<T>));
+    } else if (mode == "min") {
+      opts->setReduceFunction(
+          static_cast<void (*)(void*, const void*, const void*, size_t)>(
+              &gloo::min<T>));
+    } else {
+      PADDLE_ENFORCE_EQ(0, 1, paddle::platform::errors::InvalidArgument(
+                                  "AllReduce mode not known: " + mode));
+    }
+  }
+#endif
+
   bool is_initialized_ = false;
 #ifdef PADDLE_WITH_GLOO
   std::shared_ptr<gloo::Context> context_ = nullptr;
@@ -0,0 +1,435 @@
+/* Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/framework/fleet/input_table.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>  // NOLINT
+
+#ifdef PADDLE_WITH_CUDA
+#include <cuda_runtime.h>
+#endif
+
+#include "paddle/fluid/platform/enforce.h"
+#include "paddle/fluid/platform/timer.h"
+
+namespace paddle {
+namespace framework {
+
+constexpr uint64_t InputTable::kImageMagic;
+constexpr uint64_t InputTable::kImageVersion;
+constexpr int InputTable::kShardBits;
+
+static constexpr size_t kImageAlign = 64;
+static constexpr size_t kPageSize = 4096;
+static constexpr uint64_t kPrefetchDistance = 8;
+
+static size_t AlignImage(size_t size) {
+  return (size + kImageAlign - 1) / kImageAlign * kImageAlign;
+}
+
+// staging buffers of the keys whose hash falls into the shard
+struct InputTable::Shard {
+  std::mutex mutex;
+  std::vector<uint64_t> hashes;
+  std::vector<uint64_t> key_offsets{0};
+  std::string keys;
+  std::vector<float> values;
+  // open addressing on local row + 1, 0 is an empty slot
+  std::vector<uint32_t> index;
+
+  size_t rows() const { return hashes.size(); }
+
+  void Rehash(size_t capacity) {
+    index.assign(capacity, 0);
+    const uint64_t mask = capacity - 1;
+    for (size_t row = 0; row < hashes.size(); ++row) {
+      uint64_t pos = hashes[row] & mask;
+      while (index[pos] != 0) {
+        pos = (pos + 1) & mask;
+      }
+      index[pos] = static_cast<uint32_t>(row + 1);
+    }
+  }
+};
+
+InputTable::InputTable(uint64_t dim)
+    : dim_(dim), miss_(0), shards_(new Shard[1 << kShardBits]) {
+  // add default vec 0 => [0, 0, ...]
+  std::vector<float> vec(dim_, 0);
+  AddIndexData("-", vec);
+}
+
+InputTable::~InputTable() {
+  if (mapped_ != nullptr) {
+    munmap(mapped_, image_bytes_);
+  }
+}
+
+// MurmurHash64A, the hashes are stored in the image so it must stay stable
+uint64_t InputTable::Hash(const char* str, size_t len) {
+  const uint64_t m = 0xc6a4a7935bd1e995ULL;
+  const int r = 47;
+  uint64_t h = 0x8445d61a4e774912ULL ^ (len * m);
+  const char* end = str + (len & ~static_cast<size_t>(7));
+  for (; str != end; str += 8) {
+    uint64_t k = 0;
+    memcpy(&k, str, sizeof(k));
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+  size_t tail = len & 7;
+  if (tail != 0) {
+    for (size_t i = tail; i > 0; --i) {
+      h ^= static_cast<uint64_t>(static_cast<uint8_t>(str[i - 1]))
+           << (8 * (i - 1));
+    }
+    h *= m;
+  }
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  // 0 marks an empty slot
+  return h == 0 ? 1 : h;
+}
+
+void InputTable::AddIndexData(const std::string& key,
+                              const std::vector<float>& vec) {
+  PADDLE_ENFORCE_EQ(vec.size(), dim_,
+                    platform::errors::InvalidArgument(
+                        "The dim of index data [%s] should be %lu, but got %lu",
+                        key, dim_, vec.size()));
+  PADDLE_ENFORCE_EQ(
+      header_ == nullptr, true,
+      platform::errors::PreconditionNotMet(
+          "Can not add index data [%s] after the input table is finalized",
+          key));
+  uint64_t hash = Hash(key.data(), key.size());
+  Shard* shard = &shards_[hash >> (64 - kShardBits)];
+
+  std::lock_guard<std::mutex> lock(shard->mutex);
+  if (shard->index.size() < 2 * (shard->rows() + 1)) {
+    shard->Rehash(std::max<size_t>(1024, 2 * shard->index.size()));
+  }
+  const uint64_t mask = shard->index.size() - 1;
+  uint64_t pos = hash & mask;
+  for (; shard->index[pos] != 0; pos = (pos + 1) & mask) {
+    size_t row = shard->index[pos] - 1;
+    if (shard->hashes[row] == hash &&
+        shard->key_offsets[row + 1] - shard->key_offsets[row] == key.size() &&
+        memcmp(&shard->keys[shard->key_offsets[row]], key.data(),
+               key.size()) == 0) {
+      return;
+    }
+  }
+  shard->index[pos] = static_cast<uint32_t>(shard->rows() + 1);
+  shard->hashes.push_back(hash);
+  shard->keys.append(key);
+  shard->key_offsets.push_back(shard->keys.size());
+  shard->values.insert(shard->values.end(), vec.begin(), vec.end());
+}
+
+size_t InputTable::Layout(uint64_t rows, uint64_t capacity,
+                          uint64_t key_bytes, size_t offsets[4]) const {
+  offsets[0] = AlignImage(sizeof(Header));
+  offsets[1] = AlignImage(offsets[0] + capacity * sizeof(Slot));
+  offsets[2] = AlignImage(offsets[1] + (rows + 1) * sizeof(uint64_t));
+  offsets[3] = AlignImage(offsets[2] + key_bytes);
+  return AlignImage(offsets[3] + rows * dim_ * sizeof(float));
+}
+
+void InputTable::SetImage(char* image) {
+  header_ = reinterpret_cast<const Header*>(image);
+  size_t offsets[4];
+  image_bytes_ = Layout(header_->rows, header_->capacity, header_->key_bytes,
+                        offsets);
+  slots_ = reinterpret_cast<const Slot*>(image + offsets[0]);
+  key_offsets_ = reinterpret_cast<const uint64_t*>(image + offsets[1]);
+  keys_ = image + offsets[2];
+  values_ = reinterpret_cast<const float*>(image + offsets[3]);
+}
+
+void InputTable::BuildImage(int thread_num) {
+  platform::Timer timer;
+  timer.Start();
+  const int shard_num = 1 << kShardBits;
+  // row 0 is the zero row for the missing keys, the shards follow in order
+  std::vector<uint64_t> row_base(shard_num + 1, 1);
+  std::vector<uint64_t> key_base(shard_num + 1, 0);
+  for (int i = 0; i < shard_num; ++i) {
+    row_base[i + 1] = row_base[i] + shards_[i].rows();
+    key_base[i + 1] = key_base[i] + shards_[i].keys.size();
+  }
+  const uint64_t rows = row_base[shard_num];
+  uint64_t capacity = 16;
+  while (capacity < 2 * rows) {
+    capacity <<= 1;
+  }
+  size_t offsets[4];
+  size_t bytes = Layout(rows, capacity, key_base[shard_num], offsets);
+  buffer_.reset(new char[bytes]);
+  char* image = buffer_.get();
+  Header* header = reinterpret_cast<Header*>(image);
+  memset(image, 0, offsets[0]);
+  header->magic = kImageMagic;
+  header->version = kImageVersion;
+  header->dim = dim_;
+  header->rows = rows;
+  header->capacity = capacity;
+  header->key_bytes = key_base[shard_num];
+  header->image_bytes = bytes;
+
+  Slot* slots = reinterpret_cast<Slot*>(image + offsets[0]);
+  uint64_t* key_offsets = reinterpret_cast<uint64_t*>(image + offsets[1]);
+  char* keys = image + offsets[2];
+  float* values = reinterpret_cast<float*>(image + offsets[3]);
+  key_offsets[0] = 0;
+  key_offsets[rows] = key_base[shard_num];
+  memset(values, 0, dim_ * sizeof(float));
+
+  thread_num = std::max(1, std::min(thread_num, shard_num));
+  std::vector<std::thread> threads;
+  // clear the slots first, they are filled concurrently by all shards
+  for (int t = 0; t < thread_num; ++t) {
+    threads.emplace_back([=]() {
+      uint64_t begin = capacity * t / thread_num;
+      uint64_t end = capacity * (t + 1) / thread_num;
+      memset(slots + begin, 0, (end - begin) * sizeof(Slot));
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  threads.clear();
+
+  std::atomic<int> next_shard(0);
+  const uint64_t mask = capacity - 1;
+  for (int t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&, this]() {
+      for (int i = next_shard++; i < shard_num; i = next_shard++) {
+        Shard* shard = &shards_[i];
+        const uint64_t base = row_base[i];
+        memcpy(values + base * dim_, shard->values.data(),
+               shard->values.size() * sizeof(float));
+        memcpy(keys + key_base[i], shard->keys.data(), shard->keys.size());
+        for (size_t row = 0; row < shard->rows(); ++row) {
+          key_offsets[base + row] = key_base[i] + shard->key_offsets[row];
+          uint64_t hash = shard->hashes[row];
+          for (uint64_t pos = hash & mask;; pos = (pos + 1) & mask) {
+            uint64_t empty = 0;
+            if (__atomic_compare_exchange_n(&slots[pos].hash, &empty, hash,
+                                            false, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+              slots[pos].row = base + row;
+              break;
+            }
+          }
+        }
+        // release the staging memory as soon as the shard is copied
+        std::vector<uint64_t>().swap(shard->hashes);
+        std::vector<uint64_t>().swap(shard->key_offsets);
+        std::string().swap(shard->keys);
+        std::vector<float>().swap(shard->values);
+        std::vector<uint32_t>().swap(shard->index);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  SetImage(image);
+  timer.Pause();
+  VLOG(0) << "input table finalized, keys: " << rows - 1
+          << ", capacity: " << capacity << ", memory: " << CpuMemUsed()
+          << "MB, cost: " << timer.ElapsedSec() << "s";
+}
+
+void InputTable::MapImage(const std::string& path, int thread_num) {
+  platform::Timer timer;
+  timer.Start();
+  int fd = open(path.c_str(), O_RDONLY);
+  PADDLE_ENFORCE_GE(fd, 0, platform::errors::Unavailable(
+                               "Failed to open input table image [%s]", path));
+  struct stat st;
+  PADDLE_ENFORCE_EQ(fstat(fd, &st), 0,
+                    platform::errors::Unavailable(
+                        "Failed to stat input table image [%s]", path));
+  size_t bytes = static_cast<size_t>(st.st_size);
+  PADDLE_ENFORCE_GE(bytes, sizeof(Header),
+                    platform::errors::InvalidArgument(
+                        "Input table image [%s] is truncated", path));
+  void* addr = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  PADDLE_ENFORCE_NE(addr, MAP_FAILED,
+                    platform::errors::Unavailable(
+                        "Failed to mmap input table image [%s]", path));
+  mapped_ = addr;
+  image_bytes_ = bytes;
+
+  const Header* header = reinterpret_cast<const Header*>(addr);
+  PADDLE_ENFORCE_EQ(header->magic, kImageMagic,
+                    platform::errors::InvalidArgument(
+                        "[%s] is not an input table image", path));
+  PADDLE_ENFORCE_EQ(header->version, kImageVersion,
+                    platform::errors::InvalidArgument(
+                        "Unsupported input table image version %lu of [%s]",
+                        header->version, path));
+  PADDLE_ENFORCE_EQ(header->dim, dim_,
+                    platform::errors::InvalidArgument(
+                        "The dim of input table image [%s] is %lu, but the "
+                        "input table dim is %lu",
+                        path, header->dim, dim_));
+  size_t offsets[4];
+  PADDLE_ENFORCE_EQ(
+      header->image_bytes == bytes &&
+          Layout(header->rows, header->capacity, header->key_bytes,
+                 offsets) == bytes,
+      true, platform::errors::InvalidArgument(
+                "Input table image [%s] is truncated", path));
+  madvise(addr, bytes, MADV_WILLNEED);
+  // fault the pages in from several threads, so that the first lookups do
+  // not pay for the disk reads one page at a time
+  thread_num = std::max(1, thread_num);
+  std::vector<std::thread> threads;
+  const char* image = reinterpret_cast<const char*>(addr);
+  for (int t = 0; t < thread_num; ++t) {
+    threads.emplace_back([=]() {
+      size_t pages = (bytes + kPageSize - 1) / kPageSize;
+      size_t begin = pages * t / thread_num * kPageSize;
+      size_t end = std::min(bytes, pages * (t + 1) / thread_num * kPageSize);
+      volatile char sum = 0;
+      for (size_t off = begin; off < end; off += kPageSize) {
+        sum += image[off];
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  SetImage(reinterpret_cast<char*>(addr));
+  // the staging data added before is replaced by the image
+  shards_.reset();
+  loaded_ = true;
+  timer.Pause();
+  VLOG(0) << "input table image [" << path << "] loaded, keys: " << size()
+          << ", memory: " << CpuMemUsed() << "MB, cost: " << timer.ElapsedSec()
+          << "s";
+}
+
+void InputTable::Finalize(int thread_num) {
+  std::call_once(finalize_once_, [this, thread_num]() {
+    BuildImage(thread_num);
+  });
+}
+
+void InputTable::LoadImage(const std::string& path, int thread_num) {
+  std::call_once(finalize_once_, [this, &path, thread_num]() {
+    MapImage(path, thread_num);
+  });
+  PADDLE_ENFORCE_EQ(loaded_, true,
+                    platform::errors::PreconditionNotMet(
+                        "Can not load input table image [%s], the input table "
+                        "is already finalized",
+                        path));
+}
+
+void InputTable::SaveImage(const std::string& path) {
+  Finalize();
+  FILE* fp = fopen(path.c_str(), "wb");
+  PADDLE_ENFORCE_NOT_NULL(
+      fp, platform::errors::Unavailable(
+              "Failed to open input table image [%s] for writing", path));
+  size_t written = fwrite(header_, 1, image_bytes_, fp);
+  int ret = fclose(fp);
+  PADDLE_ENFORCE_EQ(written == image_bytes_ && ret == 0, true,
+                    platform::errors::Unavailable(
+                        "Failed to write input table image [%s]", path));
+}
+
+bool InputTable::KeyEquals(uint64_t row, const std::string& key) const {
+  uint64_t begin = key_offsets_[row];
+  return key_offsets_[row + 1] - begin == key.size() &&
+         memcmp(keys_ + begin, key.data(), key.size()) == 0;
+}
+
+uint64_t InputTable::GetIndexOffset(const std::string& key) {
+  Finalize();
+  const uint64_t hash = Hash(key.data(), key.size());
+  const uint64_t mask = header_->capacity - 1;
+  for (uint64_t pos = hash & mask; slots_[pos].hash != 0;
+       pos = (pos + 1) & mask) {
+    if (slots_[pos].hash == hash && KeyEquals(slots_[pos].row, key)) {
+      return slots_[pos].row;
+    }
+  }
+  ++miss_;
+  return 0;
+}
+
+void InputTable::LookupInput(const uint64_t* rows, float* values,
+                             uint64_t num) {
+  Finalize();
+  const size_t bytes = dim_ * sizeof(float);
+  for (uint64_t i = 0; i < num; ++i) {
+    if (i + kPrefetchDistance < num) {
+      __builtin_prefetch(values_ + rows[i + kPrefetchDistance] * dim_);
+    }
+    memcpy(values + i * dim_, values_ + rows[i] * dim_, bytes);
+  }
+}
+
+void InputTable::LookupInput(uint64_t* keys, float* values, uint64_t num,
+                             size_t device_id) {
+#ifdef PADDLE_WITH_CUDA
+  thread_local std::vector<uint64_t> h_keys;
+  thread_local std::vector<float> h_values;
+  h_keys.resize(num);
+  h_values.resize(num * dim_);
+
+  cudaSetDevice(device_id);
+  cudaMemcpy(h_keys.data(), keys, num * sizeof(uint64_t),
+             cudaMemcpyDeviceToHost);
+  LookupInput(h_keys.data(), h_values.data(), num);
+  cudaMemcpy(values, h_values.data(), num * dim_ * sizeof(float),
+             cudaMemcpyHostToDevice);
+#else
+  PADDLE_THROW(platform::errors::Unimplemented(
+      "Device lookup of the input table requires CUDA"));
+#endif
+}
+
+size_t InputTable::size() const {
+  if (header_ != nullptr) {
+    return header_->rows - 1;
+  }
+  size_t rows = 0;
+  for (int i = 0; i < (1 << kShardBits); ++i) {
+    std::lock_guard<std::mutex> lock(shards_[i].mutex);
+    rows += shards_[i].rows();
+  }
+  return rows;
+}
+
+}  // end namespace framework
+}  // end namespace paddle
@@ -0,0 +1,116 @@
+/* Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <vector>
+
+namespace paddle {
+namespace framework {
+
+/**
+ * InputTable maps the string keys of the index files to rows of dim floats.
+ *
+ * Index readers insert concurrently into hash sharded staging buffers, then
+ * Finalize() lays the table out as one flat image:
+ *
+ *   header | slots | key offsets | key bytes | values
+ *
+ * slots is an open addressing table of (64 bit key hash, row) with linear
+ * probing, the key bytes are kept to verify hash collisions. SaveImage()
+ * writes the image as is and LoadImage() maps it back without parsing.
+ * Row 0 is an all zero row, it is returned for the missing keys.
+ */
+class InputTable {
+ public:
+  explicit InputTable(uint64_t dim);
+  ~InputTable();
+
+  // thread safe, the first value of a duplicated key is kept
+  void AddIndexData(const std::string& key, const std::vector<float>& vec);
+  // build the flat table from the added data, done only once
+  void Finalize(int thread_num = 1);
+  // write the finalized table to a local file
+  void SaveImage(const std::string& path);
+  // map a local image written by SaveImage instead of adding data, the
+  // pages are faulted in by thread_num threads
+  void LoadImage(const std::string& path, int thread_num = 1);
+
+  // return the row of key, 0 if the key is missing
+  uint64_t GetIndexOffset(const std::string& key);
+  // gather the values of rows into values on host
+  void LookupInput(const uint64_t* rows, float* values, uint64_t num);
+  // gather the values of device rows into device values
+  void LookupInput(uint64_t* keys, float* values, uint64_t num,
+                   size_t device_id);
+
+  size_t size() const;
+
+  size_t miss() const { return miss_; }
+
+  size_t dim() const { return dim_; }
+
+  double CpuMemUsed(void) const { return image_bytes_ / 1024.0 / 1024.0; }
+
+  static uint64_t Hash(const char* str, size_t len);
+
+ private:
+  struct Header {
+    uint64_t magic;
+    uint64_t version;
+    uint64_t dim;
+    uint64_t rows;
+    uint64_t capacity;
+    uint64_t key_bytes;
+    uint64_t image_bytes;
+  };
+  struct Slot {
+    uint64_t hash;
+    uint64_t row;
+  };
+  struct Shard;
+
+  static constexpr uint64_t kImageMagic = 0x454C424154504E49ULL;  // INPTABLE
+  static constexpr uint64_t kImageVersion = 1;
+  static constexpr int kShardBits = 6;
+
+  // compute the section offsets of an image and return its size
+  size_t Layout(uint64_t rows, uint64_t capacity, uint64_t key_bytes,
+                size_t offsets[4]) const;
+  void SetImage(char* image);
+  void BuildImage(int thread_num);
+  void MapImage(const std::string& path, int thread_num);
+  bool KeyEquals(uint64_t row, const std::string& key) const;
+
+  uint64_t dim_;
+  std::atomic<size_t> miss_;
+  std::unique_ptr<Shard[]> shards_;
+  std::once_flag finalize_once_;
+  bool loaded_ = false;
+  // image views, valid after Finalize or LoadImage
+  std::unique_ptr<char[]> buffer_;
+  void* mapped_ = nullptr;
+  size_t image_bytes_ = 0;
+  const Header* header_ = nullptr;
+  const Slot* slots_ = nullptr;
+  const uint64_t* key_offsets_ = nullptr;
+  const char* keys_ = nullptr;
+  const float* values_ = nullptr;
+};
+
+}  // end namespace framework
+}  // end namespace paddle
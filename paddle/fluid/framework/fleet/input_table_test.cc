@@ -0,0 +1,191 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/fleet/input_table.h"
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "paddle/fluid/platform/timer.h"
+
+namespace paddle {
+namespace framework {
+
+static std::string MakeKey(int i) {
+  return "index_key_" + std::to_string(static_cast<int64_t>(i) * 7919);
+}
+
+static std::vector<float> MakeValue(int i, size_t dim) {
+  std::vector<float> vec(dim);
+  for (size_t j = 0; j < dim; ++j) {
+    vec[j] = static_cast<float>(i) + 0.25f * j;
+  }
+  return vec;
+}
+
+static void AddKeys(InputTable* table, int num, int thread_num) {
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_num; ++t) {
+    threads.emplace_back([=]() {
+      for (int i = t; i < num; i += thread_num) {
+        table->AddIndexData(MakeKey(i), MakeValue(i, table->dim()));
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+static void CheckTable(InputTable* table, int num) {
+  const size_t dim = table->dim();
+  std::vector<uint64_t> rows(num);
+  for (int i = 0; i < num; ++i) {
+    rows[i] = table->GetIndexOffset(MakeKey(i));
+    ASSERT_NE(rows[i], 0UL);
+  }
+  std::vector<float> values(num * dim);
+  table->LookupInput(rows.data(), values.data(), num);
+  for (int i = 0; i < num; ++i) {
+    std::vector<float> expect = MakeValue(i, dim);
+    for (size_t j = 0; j < dim; ++j) {
+      ASSERT_EQ(values[i * dim + j], expect[j]);
+    }
+  }
+  // the missing keys and the default key both look up zeros
+  uint64_t missing[2] = {table->GetIndexOffset("missing_key"),
+                         table->GetIndexOffset("-")};
+  EXPECT_EQ(missing[0], 0UL);
+  EXPECT_EQ(table->miss(), 1UL);
+  std::vector<float> zeros(2 * dim, 1.0f);
+  table->LookupInput(missing, zeros.data(), 2);
+  for (auto v : zeros) {
+    EXPECT_EQ(v, 0.0f);
+  }
+}
+
+TEST(InputTable, AddAndLookup) {
+  const int num = 10000;
+  InputTable table(8);
+  AddKeys(&table, num, 4);
+  // duplicated keys keep the first value
+  table.AddIndexData(MakeKey(0), MakeValue(-1, 8));
+  table.Finalize(4);
+  EXPECT_EQ(table.size(), num + 1UL);
+  CheckTable(&table, num);
+}
+
+TEST(InputTable, SaveAndLoadImage) {
+  const int num = 10000;
+  const std::string path = ::testing::TempDir() + "input_table_test.image";
+  {
+    InputTable table(4);
+    AddKeys(&table, num, 2);
+    table.SaveImage(path);
+  }
+  InputTable table(4);
+  table.LoadImage(path, 4);
+  EXPECT_EQ(table.size(), num + 1UL);
+  CheckTable(&table, num);
+  std::remove(path.c_str());
+}
+
+TEST(InputTable, Hash) {
+  EXPECT_NE(InputTable::Hash("abc", 3), InputTable::Hash("abd", 3));
+  EXPECT_EQ(InputTable::Hash("abcdefghij", 10),
+            InputTable::Hash(std::string("abcdefghij").data(), 10));
+}
+
+// Compare with the std::unordered_map<std::string, uint64_t> table used
+// before, the memory of the map is estimated by its nodes and buckets.
+// The unit tests run it at a smoke size, build WITH_BENCHMARK to measure.
+TEST(InputTable, Benchmark) {
+#ifdef PADDLE_WITH_BENCHMARK
+  const int num = 1000000;
+#else
+  const int num = 10000;
+#endif
+  const size_t dim = 16;
+  const int thread_num = std::max(2U, std::thread::hardware_concurrency());
+
+  platform::Timer timer;
+  timer.Start();
+  std::unordered_map<std::string, uint64_t> key_offset;
+  std::vector<float> table_values;
+  std::mutex mutex;
+  {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_num; ++t) {
+      threads.emplace_back([&, t]() {
+        for (int i = t; i < num; i += thread_num) {
+          std::vector<float> vec = MakeValue(i, dim);
+          std::lock_guard<std::mutex> lock(mutex);
+          key_offset.emplace(MakeKey(i), table_values.size());
+          table_values.insert(table_values.end(), vec.begin(), vec.end());
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+  timer.Pause();
+  double map_sec = timer.ElapsedSec();
+  size_t map_bytes = key_offset.bucket_count() * sizeof(void*) +
+                     table_values.capacity() * sizeof(float);
+  for (auto& kv : key_offset) {
+    // node: next pointer, cached hash, key and value
+    map_bytes += 2 * sizeof(void*) + sizeof(kv);
+    if (kv.first.capacity() > 15) {
+      map_bytes += kv.first.capacity() + 1;
+    }
+  }
+
+  timer.Reset();
+  timer.Start();
+  InputTable table(dim);
+  AddKeys(&table, num, thread_num);
+  table.Finalize(thread_num);
+  timer.Pause();
+  double table_sec = timer.ElapsedSec();
+
+  const std::string path = ::testing::TempDir() + "input_table_bench.image";
+  table.SaveImage(path);
+  timer.Reset();
+  timer.Start();
+  InputTable mapped(dim);
+  mapped.LoadImage(path, thread_num);
+  timer.Pause();
+  double image_sec = timer.ElapsedSec();
+  std::remove(path.c_str());
+
+  LOG(INFO) << "unordered_map table load: " << map_sec
+            << "s, memory: " << map_bytes / 1024.0 / 1024.0 << "MB";
+  LOG(INFO) << "flat table load: " << table_sec
+            << "s, memory: " << table.CpuMemUsed() << "MB";
+  LOG(INFO) << "flat table image load: " << image_sec << "s";
+  // the default key "-" is counted by the input table
+  EXPECT_EQ(mapped.size(), key_offset.size() + 1);
+}
+
+}  // namespace framework
+}  // namespace paddle
@@ -15,11 +15,17 @@ limitations under the License. */
 #include "paddle/fluid/framework/data_type.h"
 #include "paddle/fluid/framework/device_worker.h"
 #include "paddle/fluid/framework/device_worker_factory.h"
+#include "paddle/fluid/framework/ir/graph.h"
+#include "paddle/fluid/framework/ir/pass.h"
+#include "paddle/fluid/framework/op_instruction_list.h"
 #include "paddle/fluid/operators/controlflow/conditional_block_op_helper.h"
 #include "paddle/fluid/operators/distributed/distributed.h"
 #include "paddle/fluid/platform/cpu_helper.h"
 #include "paddle/fluid/platform/lodtensor_printer.h"
 
+DECLARE_bool(enable_op_instruction_list);
+DECLARE_bool(hogwild_fuse_dense_optimizer);
+
 namespace paddle {
 namespace framework {
 
@@ -106,9 +112,40 @@ void HogwildWorker::BindingDataFeedMemory() {
   }
 }
 
+// Rewrite the dense optimizer ops of the program into the
+// fused_dense_optimizer ops, return nullptr if nothing is fused.
+static std::unique_ptr<ProgramDesc> FuseDenseOptimizerOps(
+    const ProgramDesc &program) {
+  ir::Graph graph(program);
+  auto fuse_pass =
+      ir::PassRegistry::Instance().Get("fuse_dense_optimizer_pass");
+  fuse_pass->Apply(&graph);
+  int fused_num = 0;
+  for (auto *node : graph.Nodes()) {
+    if (node->IsOp() && node->Op() != nullptr &&
+        node->Op()->Type() == "fused_dense_optimizer") {
+      ++fused_num;
+    }
+  }
+  if (fused_num == 0) {
+    return nullptr;
+  }
+  std::unique_ptr<ProgramDesc> fused_program(new ProgramDesc(program));
+  auto to_program_pass =
+      ir::PassRegistry::Instance().Get("graph_to_program_pass");
+  to_program_pass->SetNotOwned<ProgramDesc>("program", fused_program.get());
+  to_program_pass->Apply(&graph);
+  VLOG(3) << "fuse the dense optimizers into " << fused_num << " ops";
+  return fused_program;
+}
+
 void HogwildWorker::CreateDeviceResource(const ProgramDesc &main_prog) {
   CreateThreadScope(main_prog);
-  CreateThreadOperators(main_prog);
+  if (FLAGS_hogwild_fuse_dense_optimizer) {
+    fused_program_ = FuseDenseOptimizerOps(main_prog);
+  }
+  // the ops refer to the blocks of the program they are created from
+  CreateThreadOperators(fused_program_ ? *fused_program_ : main_prog);
 }
 
 void HogwildWorker::TrainFilesWithProfiler() {
@@ -196,18 +233,26 @@ void HogwildWorker::TrainFiles() {
 
   // how to accumulate fetched values here
   device_reader_->Start();
+  std::unique_ptr<OpInstructionList> instructions;
+  if (FLAGS_enable_op_instruction_list) {
+    instructions.reset(new OpInstructionList(ops_, skip_ops_));
+  }
   int cur_batch;
   while ((cur_batch = device_reader_->Next()) > 0) {
-    for (auto &op : ops_) {
-      bool need_skip = false;
-      for (auto t = 0u; t < skip_ops_.size(); ++t) {
-        if (op->Type().find(skip_ops_[t]) != std::string::npos) {
-          need_skip = true;
-          break;
+    if (instructions) {
+      instructions->Run(*thread_scope_, place_);
+    } else {
+      for (auto &op : ops_) {
+        bool need_skip = false;
+        for (auto t = 0u; t < skip_ops_.size(); ++t) {
+          if (op->Type().find(skip_ops_[t]) != std::string::npos) {
+            need_skip = true;
+            break;
+          }
+        }
+        if (!need_skip) {
+          op->Run(*thread_scope_, place_);
         }
-      }
-      if (!need_skip) {
-        op->Run(*thread_scope_, place_);
       }
     }
 
@@ -239,3 +284,6 @@ void HogwildWorker::PrintFetchVars() {
 
 }  // end namespace framework
 }  // end namespace paddle
+
+USE_PASS(fuse_dense_optimizer_pass);
+USE_PASS(graph_to_program_pass);
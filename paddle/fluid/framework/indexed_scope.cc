@@ -0,0 +1,87 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/indexed_scope.h"
+
+namespace paddle {
+namespace framework {
+
+int VarSlotTable::Intern(const std::string& name) {
+  auto it = slots_.find(name);
+  if (it != slots_.end()) {
+    return it->second;
+  }
+  int slot = static_cast<int>(names_.size());
+  slots_.emplace(name, slot);
+  names_.push_back(name);
+  return slot;
+}
+
+VarSlotTable::SlotMap VarSlotTable::Intern(const VariableNameMap& names) {
+  SlotMap slot_map;
+  slot_map.reserve(names.size());
+  for (auto& pair : names) {
+    std::vector<int> slots;
+    slots.reserve(pair.second.size());
+    for (auto& name : pair.second) {
+      slots.push_back(Intern(name));
+    }
+    slot_map.emplace_back(pair.first, std::move(slots));
+  }
+  return slot_map;
+}
+
+int VarSlotTable::Find(const std::string& name) const {
+  auto it = slots_.find(name);
+  return it == slots_.end() ? -1 : it->second;
+}
+
+void IndexedScope::Resolve(const Scope& scope) {
+  vars_.resize(table_->size());
+  for (size_t slot = 0; slot < vars_.size(); ++slot) {
+    vars_[slot] = scope.FindVar(table_->Name(static_cast<int>(slot)));
+  }
+  scope_ = &scope;
+}
+
+size_t IndexedScope::resolved_num() const {
+  size_t num = 0;
+  for (auto* var : vars_) {
+    if (var) {
+      ++num;
+    }
+  }
+  return num;
+}
+
+std::unique_ptr<RuntimeContext> IndexedScope::BuildRuntimeContext(
+    const VarSlotTable::SlotMap& inputs,
+    const VarSlotTable::SlotMap& outputs) const {
+  auto build = [this](const VarSlotTable::SlotMap& slot_map) {
+    VariableValueMap value_map;
+    for (auto& pair : slot_map) {
+      auto& vars = value_map[pair.first];
+      vars.reserve(pair.second.size());
+      for (int slot : pair.second) {
+        vars.push_back(vars_[slot]);
+      }
+    }
+    return value_map;
+  };
+  return std::unique_ptr<RuntimeContext>(
+      new RuntimeContext(build(inputs), build(outputs)));
+}
+
+}  // namespace framework
+}  // namespace paddle
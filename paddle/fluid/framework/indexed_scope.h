@@ -0,0 +1,88 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "paddle/fluid/framework/operator.h"
+#include "paddle/fluid/framework/scope.h"
+
+namespace paddle {
+namespace framework {
+
+/*
+ * VarSlotTable interns the variable names of a program into dense integer
+ * slots once, so that the lookups of a program run repeatedly index a
+ * vector instead of hashing the names up the scope chain.
+ */
+class VarSlotTable {
+ public:
+  // The slots of the arguments of an op, in the order of a VariableNameMap.
+  using SlotMap = std::vector<std::pair<std::string, std::vector<int>>>;
+
+  // Return the slot of name, a new slot if name is new.
+  int Intern(const std::string& name);
+  SlotMap Intern(const VariableNameMap& names);
+
+  // Return -1 if name is not interned.
+  int Find(const std::string& name) const;
+
+  const std::string& Name(int slot) const { return names_[slot]; }
+  size_t size() const { return names_.size(); }
+
+ private:
+  std::unordered_map<std::string, int> slots_;
+  std::vector<std::string> names_;
+};
+
+/*
+ * IndexedScope is a flat view of a scope for the slots of a VarSlotTable.
+ * Resolve looks every slot up in the scope and its ancestors once, a lookup
+ * is an index into a std::vector<Variable*> then, without any lock.
+ *
+ * The view does not see the variables created or erased after Resolve, the
+ * slots missing from the scope are nullptr.
+ */
+class IndexedScope {
+ public:
+  explicit IndexedScope(const VarSlotTable* table) : table_(table) {}
+
+  void Resolve(const Scope& scope);
+
+  // The scope of the last Resolve.
+  const Scope* scope() const { return scope_; }
+
+  Variable* Var(int slot) const { return vars_[slot]; }
+
+  // The number of the slots found in the scope and its ancestors.
+  size_t resolved_num() const;
+
+  // Build a runtime context as the one built for the scope by names.
+  std::unique_ptr<RuntimeContext> BuildRuntimeContext(
+      const VarSlotTable::SlotMap& inputs,
+      const VarSlotTable::SlotMap& outputs) const;
+
+ private:
+  const VarSlotTable* table_;
+  const Scope* scope_{nullptr};
+  std::vector<Variable*> vars_;
+};
+
+}  // namespace framework
+}  // namespace paddle
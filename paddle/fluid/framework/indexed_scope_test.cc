@@ -0,0 +1,137 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/indexed_scope.h"
+
+#include <chrono>  // NOLINT
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace paddle {
+namespace framework {
+
+TEST(IndexedScope, Resolve) {
+  Scope root;
+  auto* w = root.Var("w");
+  auto& scope = root.NewScope();
+  auto* x = scope.Var("x");
+
+  VarSlotTable table;
+  EXPECT_EQ(table.Intern("x"), 0);
+  EXPECT_EQ(table.Intern("w"), 1);
+  EXPECT_EQ(table.Intern("x"), 0);
+  auto slot_map = table.Intern(VariableNameMap{{"X", {"x", "y"}}});
+  ASSERT_EQ(slot_map.size(), 1UL);
+  EXPECT_EQ(slot_map[0].second, std::vector<int>({0, 2}));
+  EXPECT_EQ(table.Find("y"), 2);
+  EXPECT_EQ(table.Find("z"), -1);
+
+  IndexedScope indexed(&table);
+  indexed.Resolve(scope);
+  EXPECT_EQ(indexed.scope(), &scope);
+  EXPECT_EQ(indexed.Var(0), x);
+  // the parent fallback is resolved once
+  EXPECT_EQ(indexed.Var(1), w);
+  EXPECT_EQ(indexed.Var(2), nullptr);
+  EXPECT_EQ(indexed.resolved_num(), 2UL);
+
+  // the view does not see the new variables until it is resolved again
+  auto* y = scope.Var("y");
+  EXPECT_EQ(indexed.Var(2), nullptr);
+  indexed.Resolve(scope);
+  EXPECT_EQ(indexed.Var(2), y);
+
+  auto ctx = indexed.BuildRuntimeContext(
+      table.Intern(VariableNameMap{{"X", {"x", "w"}}}),
+      table.Intern(VariableNameMap{{"Out", {"y"}}}));
+  EXPECT_EQ(ctx->inputs.at("X"), std::vector<Variable*>({x, w}));
+  EXPECT_EQ(ctx->outputs.at("Out"), std::vector<Variable*>({y}));
+}
+
+// The ops of a CTR program read the parameters from the root scope and the
+// activations from the thread scope, a runtime context is built per op.
+// The unit tests run it at a smoke size, build WITH_BENCHMARK to measure.
+TEST(IndexedScope, Benchmark) {
+  const int param_num = 2000;
+  const int activation_num = 4000;
+#ifdef PADDLE_WITH_BENCHMARK
+  const int op_num = 4000;
+  const int steps = 20;
+#else
+  const int op_num = 200;
+  const int steps = 2;
+#endif
+
+  Scope root;
+  for (int i = 0; i < param_num; ++i) {
+    root.Var("fc_" + std::to_string(i) + ".w_0");
+  }
+  auto& scope = root.NewScope();
+  for (int i = 0; i < activation_num; ++i) {
+    scope.Var("fc_" + std::to_string(i) + ".tmp_0");
+  }
+
+  std::mt19937 rng(0);
+  std::vector<VariableNameMap> inputs(op_num);
+  std::vector<VariableNameMap> outputs(op_num);
+  for (int i = 0; i < op_num; ++i) {
+    inputs[i]["X"] = {"fc_" + std::to_string(rng() % activation_num) +
+                      ".tmp_0"};
+    inputs[i]["Y"] = {"fc_" + std::to_string(rng() % param_num) + ".w_0"};
+    outputs[i]["Out"] = {"fc_" + std::to_string(rng() % activation_num) +
+                         ".tmp_0"};
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (int step = 0; step < steps; ++step) {
+    for (int i = 0; i < op_num; ++i) {
+      RuntimeContext ctx(inputs[i], outputs[i], scope);
+      ASSERT_NE(ctx.inputs["Y"][0], nullptr);
+    }
+  }
+  double by_name_sec =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  VarSlotTable table;
+  std::vector<VarSlotTable::SlotMap> input_slots;
+  std::vector<VarSlotTable::SlotMap> output_slots;
+  for (int i = 0; i < op_num; ++i) {
+    input_slots.push_back(table.Intern(inputs[i]));
+    output_slots.push_back(table.Intern(outputs[i]));
+  }
+  IndexedScope indexed(&table);
+  start = std::chrono::steady_clock::now();
+  for (int step = 0; step < steps; ++step) {
+    indexed.Resolve(scope);
+    for (int i = 0; i < op_num; ++i) {
+      auto ctx = indexed.BuildRuntimeContext(input_slots[i], output_slots[i]);
+      ASSERT_NE(ctx->inputs["Y"][0], nullptr);
+    }
+  }
+  double by_slot_sec =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  LOG(INFO) << "runtime contexts of " << op_num << " ops, by name: "
+            << by_name_sec * 1e9 / steps / op_num
+            << " ns per op, by slot (resolved every step): "
+            << by_slot_sec * 1e9 / steps / op_num << " ns per op";
+}
+
+}  // namespace framework
+}  // namespace paddle
@@ -0,0 +1,251 @@
+/* Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/framework/ir/fuse_dense_optimizer_pass.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "paddle/fluid/framework/ir/graph_helper.h"
+#include "paddle/fluid/framework/ir/node.h"
+#include "paddle/fluid/framework/op_proto_maker.h"
+#include "paddle/fluid/platform/enforce.h"
+
+namespace paddle {
+namespace framework {
+namespace ir {
+
+const char kFusedDenseOptimizerType[] = "fused_dense_optimizer";
+
+// The in place inputs and outputs of the optimizers besides Param.
+static const std::vector<std::string>& GetStateNames(const std::string& type) {
+  static const std::unordered_map<std::string, std::vector<std::string>>
+      state_names = {{"sgd", {}},
+                     {"adagrad", {"Moment"}},
+                     {"adam", {"Moment1", "Moment2", "Beta1Pow", "Beta2Pow"}}};
+  return state_names.at(type);
+}
+
+static bool IsOptimizerType(const std::string& type) {
+  return type == "sgd" || type == "adam" || type == "adagrad";
+}
+
+static ir::Node* FindInputNode(ir::Node* op, const std::string& name) {
+  for (auto* in : op->inputs) {
+    if (in->IsVar() && in->Var() != nullptr && in->Name() == name) {
+      return in;
+    }
+  }
+  return nullptr;
+}
+
+static float GetFloatAttr(const OpDesc& op, const std::string& name) {
+  return op.HasAttr(name) ? BOOST_GET_CONST(float, op.GetAttr(name)) : 0.f;
+}
+
+static size_t InputSize(const OpDesc& op, const std::string& name) {
+  auto it = op.Inputs().find(name);
+  return it == op.Inputs().end() ? 0 : it->second.size();
+}
+
+// Whether the op reads name and writes name + "Out" in place.
+static bool IsInplaceVar(const OpDesc& op, const std::string& name) {
+  auto in = op.Inputs().find(name);
+  auto out = op.Outputs().find(name + "Out");
+  return in != op.Inputs().end() && out != op.Outputs().end() &&
+         in->second.size() == 1 && out->second.size() == 1 &&
+         in->second[0] == out->second[0];
+}
+
+bool FuseDenseOptimizerPass::IsFusable(ir::Node* node) const {
+  if (!node->IsOp() || node->Op() == nullptr ||
+      !IsOptimizerType(node->Op()->Type())) {
+    return false;
+  }
+  auto* op = node->Op();
+  std::vector<std::string> names = GetStateNames(op->Type());
+  names.push_back("Param");
+  for (auto& name : names) {
+    if (!IsInplaceVar(*op, name)) {
+      return false;
+    }
+  }
+  if (InputSize(*op, "Grad") != 1 || InputSize(*op, "LearningRate") != 1 ||
+      InputSize(*op, "Beta1Tensor") != 0 ||
+      InputSize(*op, "Beta2Tensor") != 0) {
+    return false;
+  }
+  auto* param = FindInputNode(node, op->Input("Param")[0]);
+  auto* grad = FindInputNode(node, op->Input("Grad")[0]);
+  if (param == nullptr || grad == nullptr ||
+      param->Var()->GetType() != proto::VarType::LOD_TENSOR ||
+      grad->Var()->GetType() != proto::VarType::LOD_TENSOR) {
+    return false;
+  }
+  auto dtype = param->Var()->GetDataType();
+  return dtype == proto::VarType::FP32 || dtype == proto::VarType::FP64;
+}
+
+bool FuseDenseOptimizerPass::HasDependency(
+    const std::vector<ir::Node*>& ops) const {
+  std::unordered_set<ir::Node*> op_set(ops.begin(), ops.end());
+  std::unordered_set<ir::Node*> visited;
+  std::vector<ir::Node*> stack;
+  for (auto* op : ops) {
+    stack.insert(stack.end(), op->outputs.begin(), op->outputs.end());
+  }
+  while (!stack.empty()) {
+    auto* node = stack.back();
+    stack.pop_back();
+    if (!visited.insert(node).second) {
+      continue;
+    }
+    if (op_set.count(node)) {
+      return true;
+    }
+    stack.insert(stack.end(), node->outputs.begin(), node->outputs.end());
+  }
+  return false;
+}
+
+ir::Node* FuseDenseOptimizerPass::FuseOptimizerOps(
+    const std::vector<ir::Node*>& ops, ir::Graph* graph) const {
+  auto* first = ops.front()->Op();
+  const std::string& type = first->Type();
+  std::vector<std::string> names = GetStateNames(type);
+  names.push_back("Param");
+
+  OpDesc fused_desc;
+  fused_desc.SetType(kFusedDenseOptimizerType);
+  std::vector<std::string> grads;
+  std::vector<std::string> role_vars;
+  for (auto* op : ops) {
+    grads.push_back(op->Op()->Input("Grad")[0]);
+    if (op->Op()->HasAttr(OpProtoAndCheckerMaker::OpRoleVarAttrName())) {
+      auto vars = BOOST_GET_CONST(
+          std::vector<std::string>,
+          op->Op()->GetAttr(OpProtoAndCheckerMaker::OpRoleVarAttrName()));
+      role_vars.insert(role_vars.end(), vars.begin(), vars.end());
+    }
+  }
+  fused_desc.SetInput("Grad", grads);
+  fused_desc.SetInput("LearningRate", first->Input("LearningRate"));
+  for (auto& name : names) {
+    std::vector<std::string> vars;
+    for (auto* op : ops) {
+      vars.push_back(op->Op()->Input(name)[0]);
+    }
+    fused_desc.SetInput(name, vars);
+    fused_desc.SetOutput(name + "Out", vars);
+  }
+  fused_desc.SetAttr("optimizer_type", type);
+  for (auto* name : {"beta1", "beta2", "epsilon"}) {
+    if (first->HasAttr(name)) {
+      fused_desc.SetAttr(name, first->GetAttr(name));
+    }
+  }
+  if (first->HasAttr(OpProtoAndCheckerMaker::OpRoleAttrName())) {
+    fused_desc.SetAttr(
+        OpProtoAndCheckerMaker::OpRoleAttrName(),
+        first->GetAttr(OpProtoAndCheckerMaker::OpRoleAttrName()));
+  }
+  fused_desc.SetAttr(OpProtoAndCheckerMaker::OpRoleVarAttrName(), role_vars);
+
+  auto* fused = graph->CreateOpNode(&fused_desc);
+  std::unordered_set<ir::Node*> fused_ins;
+  std::unordered_set<ir::Node*> fused_outs;
+  for (auto* op : ops) {
+    for (auto* in : op->inputs) {
+      auto& outs = in->outputs;
+      outs.erase(std::remove(outs.begin(), outs.end(), op), outs.end());
+      if (fused_ins.insert(in).second) {
+        outs.push_back(fused);
+        fused->inputs.push_back(in);
+      }
+    }
+    for (auto* out : op->outputs) {
+      auto& ins = out->inputs;
+      ins.erase(std::remove(ins.begin(), ins.end(), op), ins.end());
+      if (fused_outs.insert(out).second) {
+        ins.push_back(fused);
+        fused->outputs.push_back(out);
+      }
+    }
+  }
+  for (auto* op : ops) {
+    graph->RemoveNode(op);
+  }
+  return fused;
+}
+
+void FuseDenseOptimizerPass::ApplyImpl(ir::Graph* graph) const {
+  PADDLE_ENFORCE_NOT_NULL(
+      graph, platform::errors::InvalidArgument("Graph cannot be nullptr."));
+
+  // The optimizers of a group share the type, the learning rate, the data
+  // type and the attributes, a parameter or a state is updated once.
+  using GroupKey =
+      std::tuple<std::string, std::string, int, float, float, float>;
+  std::map<GroupKey, std::vector<ir::Node*>> groups;
+  std::unordered_set<std::string> updated_vars;
+  for (auto* node : TopologySortOperations(*graph)) {
+    if (!IsFusable(node)) {
+      continue;
+    }
+    auto* op = node->Op();
+    std::vector<std::string> names = GetStateNames(op->Type());
+    names.push_back("Param");
+    bool updated = false;
+    for (auto& name : names) {
+      updated = updated || updated_vars.count(op->Input(name)[0]);
+    }
+    if (updated) {
+      continue;
+    }
+    for (auto& name : names) {
+      updated_vars.insert(op->Input(name)[0]);
+    }
+    auto* param = FindInputNode(node, op->Input("Param")[0]);
+    GroupKey key(op->Type(), op->Input("LearningRate")[0],
+                 static_cast<int>(param->Var()->GetDataType()),
+                 GetFloatAttr(*op, "beta1"), GetFloatAttr(*op, "beta2"),
+                 GetFloatAttr(*op, "epsilon"));
+    groups[key].push_back(node);
+  }
+
+  int fused_num = 0;
+  for (auto& group : groups) {
+    auto& ops = group.second;
+    if (ops.size() < 2 || HasDependency(ops)) {
+      continue;
+    }
+    VLOG(3) << "fuse " << ops.size() << " " << std::get<0>(group.first)
+            << " ops with learning rate " << std::get<1>(group.first);
+    FuseOptimizerOps(ops, graph);
+    ++fused_num;
+  }
+  VLOG(3) << "fused " << fused_num << " groups of dense optimizers";
+}
+
+}  // namespace ir
+}  // namespace framework
+}  // namespace paddle
+
+REGISTER_PASS(fuse_dense_optimizer_pass,
+              paddle::framework::ir::FuseDenseOptimizerPass);
@@ -0,0 +1,70 @@
+/* Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "paddle/fluid/framework/ir/graph.h"
+#include "paddle/fluid/framework/ir/pass.h"
+
+namespace paddle {
+namespace framework {
+namespace ir {
+
+class Node;
+class Graph;
+
+/*
+* Fuse the sgd, adam and adagrad ops of the dense parameters into a
+* fused_dense_optimizer op for every optimizer, learning rate and
+* attributes, so that a Hogwild thread updates the parameters in one op.
+*
+* Before this pass:
+*
+*   grad_op1      grad_op2
+*      |             |
+*   adam_op1      adam_op2
+*
+* After this pass:
+*
+*   grad_op1      grad_op2
+*        \          /
+*    fused_dense_optimizer
+*
+* The optimizers of the sparse gradients are kept, and the optimizers of
+* which one depends on another are not fused.
+*/
+class FuseDenseOptimizerPass : public Pass {
+ public:
+  virtual ~FuseDenseOptimizerPass() {}
+
+ protected:
+  void ApplyImpl(ir::Graph* graph) const override;
+
+ private:
+  // Whether the op updates a dense LoDTensor in place.
+  bool IsFusable(ir::Node* node) const;
+
+  // Whether an op of ops depends on another op of ops.
+  bool HasDependency(const std::vector<ir::Node*>& ops) const;
+
+  ir::Node* FuseOptimizerOps(const std::vector<ir::Node*>& ops,
+                             ir::Graph* graph) const;
+};
+
+}  // namespace ir
+}  // namespace framework
+}  // namespace paddle
@@ -0,0 +1,140 @@
+/* Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/framework/ir/fuse_dense_optimizer_pass.h"
+
+#include <gtest/gtest.h>
+#include "paddle/fluid/framework/ir/graph_helper.h"
+#include "paddle/fluid/framework/ir/pass_tester_helper.h"
+
+namespace paddle {
+namespace framework {
+namespace ir {
+
+static VarDesc* AddVar(BlockDesc* block, const std::string& name,
+                       bool selected_rows = false) {
+  auto* var = block->Var(name);
+  var->SetType(selected_rows ? proto::VarType::SELECTED_ROWS
+                             : proto::VarType::LOD_TENSOR);
+  var->SetDataType(proto::VarType::FP32);
+  return var;
+}
+
+static void AddOptimizer(BlockDesc* block, const std::string& type,
+                         const std::string& param, const std::string& lr,
+                         bool sparse = false) {
+  std::string grad = param + "@GRAD";
+  AddVar(block, param)->SetPersistable(true);
+  AddVar(block, grad, sparse);
+  auto* op = block->AppendOp();
+  op->SetType(type);
+  op->SetInput("Param", {param});
+  op->SetInput("Grad", {grad});
+  op->SetInput("LearningRate", {lr});
+  op->SetOutput("ParamOut", {param});
+  std::vector<std::string> states;
+  if (type == "adam") {
+    states = {"Moment1", "Moment2", "Beta1Pow", "Beta2Pow"};
+    op->SetAttr("beta1", 0.9f);
+    op->SetAttr("beta2", 0.999f);
+    op->SetAttr("epsilon", 1e-8f);
+  } else if (type == "adagrad") {
+    states = {"Moment"};
+    op->SetAttr("epsilon", 1e-6f);
+  }
+  for (auto& state : states) {
+    std::string name = param + "_" + state;
+    AddVar(block, name)->SetPersistable(true);
+    op->SetInput(state, {name});
+    op->SetOutput(state + "Out", {name});
+  }
+}
+
+TEST(FuseDenseOptimizerPass, basic) {
+  ProgramDesc program;
+  auto* block = program.MutableBlock(0);
+  AddVar(block, "lr")->SetPersistable(true);
+  AddVar(block, "lr2")->SetPersistable(true);
+  for (auto* param : {"w0", "w1", "w2"}) {
+    AddOptimizer(block, "sgd", param, "lr");
+  }
+  // the sparse gradient and the other learning rate are not fused
+  AddOptimizer(block, "sgd", "emb", "lr", true);
+  AddOptimizer(block, "sgd", "w3", "lr2");
+  for (auto* param : {"a0", "a1"}) {
+    AddOptimizer(block, "adam", param, "lr");
+  }
+  for (auto* param : {"g0", "g1"}) {
+    AddOptimizer(block, "adagrad", param, "lr");
+  }
+
+  std::unique_ptr<Graph> graph(new Graph(program));
+  auto pass = PassRegistry::Instance().Get("fuse_dense_optimizer_pass");
+  graph.reset(pass->Apply(graph.release()));
+
+  EXPECT_EQ(GetNumOpNodes(graph, "sgd"), 2);
+  EXPECT_EQ(GetNumOpNodes(graph, "adam"), 0);
+  EXPECT_EQ(GetNumOpNodes(graph, "adagrad"), 0);
+  EXPECT_EQ(GetNumOpNodes(graph, "fused_dense_optimizer"), 3);
+  EXPECT_FALSE(HasCircle(*graph));
+  for (auto* node : graph->Nodes()) {
+    if (!node->IsOp() || node->Op()->Type() != "fused_dense_optimizer") {
+      continue;
+    }
+    auto* op = node->Op();
+    auto type = BOOST_GET_CONST(std::string, op->GetAttr("optimizer_type"));
+    if (type == "sgd") {
+      EXPECT_EQ(op->Input("Param"),
+                std::vector<std::string>({"w0", "w1", "w2"}));
+      EXPECT_EQ(op->Output("ParamOut"), op->Input("Param"));
+    } else if (type == "adam") {
+      EXPECT_EQ(op->Input("Beta1Pow"),
+                std::vector<std::string>({"a0_Beta1Pow", "a1_Beta1Pow"}));
+      EXPECT_EQ(op->Input("Grad"),
+                std::vector<std::string>({"a0@GRAD", "a1@GRAD"}));
+    } else {
+      EXPECT_EQ(type, "adagrad");
+      EXPECT_EQ(op->Input("Moment"),
+                std::vector<std::string>({"g0_Moment", "g1_Moment"}));
+      EXPECT_FLOAT_EQ(BOOST_GET_CONST(float, op->GetAttr("epsilon")), 1e-6f);
+    }
+  }
+}
+
+TEST(FuseDenseOptimizerPass, dependency) {
+  ProgramDesc program;
+  auto* block = program.MutableBlock(0);
+  AddVar(block, "lr")->SetPersistable(true);
+  AddOptimizer(block, "sgd", "w0", "lr");
+  // the gradient of w1 reads the w0 updated
+  AddVar(block, "w1@GRAD");
+  auto* scale = block->AppendOp();
+  scale->SetType("scale");
+  scale->SetInput("X", {"w0"});
+  scale->SetOutput("Out", {"w1@GRAD"});
+  AddOptimizer(block, "sgd", "w1", "lr");
+
+  std::unique_ptr<Graph> graph(new Graph(program));
+  auto pass = PassRegistry::Instance().Get("fuse_dense_optimizer_pass");
+  graph.reset(pass->Apply(graph.release()));
+
+  EXPECT_EQ(GetNumOpNodes(graph, "sgd"), 2);
+  EXPECT_EQ(GetNumOpNodes(graph, "fused_dense_optimizer"), 0);
+}
+
+}  // namespace ir
+}  // namespace framework
+}  // namespace paddle
+
+USE_PASS(fuse_dense_optimizer_pass);
@@ -15,6 +15,7 @@ limitations under the License. */
 #include "paddle/fluid/framework/lod_tensor.h"
 #include <stdint.h>
 #include <algorithm>
+#include <cstring>
 #include "paddle/fluid/framework/version.h"
 
 namespace paddle {
@@ -331,6 +332,83 @@ void DeserializeFromStream(std::istream &is, LoDTensor *tensor,
   TensorFromStream(is, static_cast<Tensor *>(tensor), dev_ctx);
 }
 
+template <typename T>
+static void ReadFromMemory(const char **pos, const char *end, T *value,
+                           size_t size = sizeof(T)) {
+  PADDLE_ENFORCE_LE(
+      size, static_cast<size_t>(end - *pos),
+      platform::errors::Unavailable(
+          "An error occurred while loading model parameters. "
+          "Please check whether the model file is complete or damaged."));
+  memcpy(value, *pos, size);
+  *pos += size;
+}
+
+void DeserializeMetaFromMemory(const char **pos, const char *end,
+                               LoDTensor *tensor, proto::VarType::Type *type,
+                               const char **data) {
+  {
+    // the 1st field, unit32_t version for LoDTensor
+    uint32_t version;
+    ReadFromMemory(pos, end, &version);
+    PADDLE_ENFORCE_EQ(framework::IsTensorVersionSupported(version), true,
+                      platform::errors::InvalidArgument(
+                          "Tensor version %u is not supported.", version));
+    PADDLE_ENFORCE_EQ(
+        version, 0U,
+        platform::errors::InvalidArgument(
+            "Deserialize to tensor failed, maybe the loaded file is "
+            "not a paddle model(expected file format: 0, but %u found).",
+            version));
+  }
+  {
+    // the 2st field, LoD information
+    uint64_t lod_level;
+    ReadFromMemory(pos, end, &lod_level);
+    auto &lod = *tensor->mutable_lod();
+    lod.resize(lod_level);
+    for (uint64_t i = 0; i < lod_level; ++i) {
+      uint64_t size;
+      ReadFromMemory(pos, end, &size);
+      std::vector<size_t> tmp(size / sizeof(size_t));
+      ReadFromMemory(pos, end, tmp.data(), size);
+      lod[i] = tmp;
+    }
+  }
+  // the 3st filed, Tensor
+  uint32_t version;
+  ReadFromMemory(pos, end, &version);
+  PADDLE_ENFORCE_EQ(
+      version, 0U,
+      platform::errors::InvalidArgument(
+          "tensor version %u is not supported, Only version 0 is supported",
+          version));
+  proto::VarType::TensorDesc desc;
+  int32_t size;
+  ReadFromMemory(pos, end, &size);
+  PADDLE_ENFORCE_EQ(size >= 0 && size <= end - *pos, true,
+                    platform::errors::Unavailable(
+                        "An error occurred while loading model parameters. "
+                        "Please check whether the model file is complete or "
+                        "damaged."));
+  PADDLE_ENFORCE_EQ(
+      desc.ParseFromArray(*pos, size), true,
+      platform::errors::InvalidArgument("Cannot parse tensor desc"));
+  *pos += size;
+
+  std::vector<int64_t> dims(desc.dims().begin(), desc.dims().end());
+  tensor->Resize(framework::make_ddim(dims));
+  *type = desc.data_type();
+  size_t data_size = tensor->numel() * framework::SizeOfType(*type);
+  PADDLE_ENFORCE_LE(
+      data_size, static_cast<size_t>(end - *pos),
+      platform::errors::Unavailable(
+          "An error occurred while loading model parameters. "
+          "Please check whether the model file is complete or damaged."));
+  *data = *pos;
+  *pos += data_size;
+}
+
 std::vector<LoDTensor> LoDTensor::SplitLoDTensor(
     const std::vector<platform::Place> places) const {
   PADDLE_ENFORCE_GT(places.size(), 0,
@@ -246,6 +246,17 @@ void DeserializeFromStream(std::istream& is, LoDTensor* tensor,
                            const size_t& seek,
                            const std::vector<int64_t>& shape);
 
+/*
+ * Desiralize the LoD and the meta of a LoDTensor serialized by
+ * SerializeToStream from the memory [*pos, end) without copying its data.
+ * The LoD and dims of tensor are set, *type and *data are the data type and
+ * the address of the tensor data in the memory, *pos is moved past the
+ * data. The caller decides whether to copy or to alias the data.
+ */
+void DeserializeMetaFromMemory(const char** pos, const char* end,
+                               LoDTensor* tensor, proto::VarType::Type* type,
+                               const char** data);
+
 /*
  * Convert between length-based LoD and offset-based LoD.
  * The implementation of LoDTensor class use offset-based LoD.
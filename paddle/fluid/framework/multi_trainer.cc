@@ -95,6 +95,10 @@ void MultiTrainer::InitDumpEnv() {
     dump_thread_.push_back(
         std::thread(std::bind(&TrainerBase::DumpWork, this, i)));
   }
+  InitDumpFieldFormatEnv();
+  for (int i = 0; i < thread_num_; ++i) {
+    workers_[i]->SetDumpFieldBatchChannel(field_queue_.get());
+  }
 }
 
 // call only after all resources are set in current trainer
@@ -47,12 +47,38 @@ void NaiveExecutor::Run() {
 #ifdef PADDLE_WITH_MKLDNN
   platform::AttachPointerHashToMKLDNNKey(this, place_);
 #endif
-  for (auto &op : ops_) {
+  if (static_memory_plan_ && !static_memory_planner_) {
+    static_memory_planner_.reset(new StaticMemoryPlanner(
+        place_, ops_, static_memory_plan_skip_vars_));
+  }
+  auto *planner = static_memory_planner_ && static_memory_planner_->enabled()
+                      ? static_memory_planner_.get()
+                      : nullptr;
+  bool recording = planner && planner->recording();
+  if (planner) {
+    planner->PreRun(scope_);
+  }
+  for (size_t i = 0; i < ops_.size(); ++i) {
+    auto &op = ops_[i];
     VLOG(4) << std::this_thread::get_id() << " run "
             << op->DebugStringEx(scope_) << " on scope " << scope_;
     op->SetIsCalledByExecutor(false);
     op->Run(*scope_, place_);
+    if (recording) {
+      planner->Record(i, scope_);
+    }
   }
+  if (planner) {
+    planner->PostRun(scope_);
+  }
+}
+
+void NaiveExecutor::EnableStaticMemoryPlan(
+    const std::vector<std::string> &skip_vars) {
+  static_memory_plan_ = true;
+  static_memory_plan_skip_vars_.clear();
+  static_memory_plan_skip_vars_.insert(skip_vars.begin(), skip_vars.end());
+  static_memory_planner_.reset();
 }
 
 void NaiveExecutor::CreateVariables(const ProgramDesc &desc, int block_id,
@@ -129,6 +155,7 @@ void NaiveExecutor::CleanFeedFetchOps() {
     }
   }
   ops_.swap(ops);
+  static_memory_planner_.reset();
 }
 
 NaiveExecutor::~NaiveExecutor() {
@@ -16,11 +16,13 @@
 
 #include <memory>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 #include "paddle/fluid/framework/operator.h"
 #include "paddle/fluid/framework/program_desc.h"
 #include "paddle/fluid/framework/scope.h"
+#include "paddle/fluid/framework/static_memory_planner.h"
 #include "paddle/fluid/platform/device_context.h"
 
 namespace paddle {
@@ -62,6 +64,10 @@ class NaiveExecutor {
 
   void CleanFeedFetchOps();
 
+  // Lay the intermediate tensors out in one arena planned by the first run,
+  // the skip_vars (the feed and fetch targets) are left to the allocator.
+  void EnableStaticMemoryPlan(const std::vector<std::string>& skip_vars);
+
  protected:
   void CreateOps(const ProgramDesc& desc, int block_id,
                  bool with_feed_fetch_ops);
@@ -71,6 +77,11 @@ class NaiveExecutor {
   // Catch the required resource to avoid recreate.
   std::vector<std::unique_ptr<OperatorBase>> ops_;
   Scope* scope_;
+
+  bool static_memory_plan_{false};
+  std::unordered_set<std::string> static_memory_plan_skip_vars_;
+  // created by the first run, after the ops are final
+  std::unique_ptr<StaticMemoryPlanner> static_memory_planner_;
 };
 
 }  // namespace framework
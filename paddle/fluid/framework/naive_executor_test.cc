@@ -15,6 +15,9 @@
 #include "paddle/fluid/framework/naive_executor.h"
 #include <gtest/gtest.h>
 #include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
 #include "paddle/fluid/framework/op_registry.h"
 #include "paddle/fluid/framework/program_desc.h"
 
@@ -64,6 +67,140 @@ TEST(NaiveExecutor, Basic) {
   }
 }
 
+TEST(NaiveExecutor, StaticMemoryPlan) {
+  // e = ((a + b) + a) + b, with the temporaries c and d
+  ProgramDesc program;
+  auto* main_block = program.MutableBlock(0);
+  for (auto* name : {"a", "b", "c", "d", "e"}) {
+    main_block->Var(name)->SetType(proto::VarType::LOD_TENSOR);
+  }
+  auto append_add = [&](const std::string& x, const std::string& y,
+                        const std::string& out) {
+    auto* add = main_block->AppendOp();
+    add->SetType("elementwise_add");
+    add->SetInput("X", {x});
+    add->SetInput("Y", {y});
+    add->SetOutput("Out", {out});
+  };
+  append_add("a", "b", "c");
+  append_add("c", "a", "d");
+  append_add("d", "b", "e");
+
+  auto place = platform::CPUPlace();
+  NaiveExecutor exe(place);
+  exe.Prepare(nullptr, program, 0, false);
+  exe.EnableStaticMemoryPlan({"a", "b", "e"});
+  auto* a_tensor = exe.FindTensor("a");
+  auto* b_tensor = exe.FindTensor("b");
+  auto* c_tensor = exe.FindTensor("c");
+  auto* d_tensor = exe.FindTensor("d");
+  auto* e_tensor = exe.FindTensor("e");
+
+  auto run = [&](int n) {
+    a_tensor->Resize({1, n});
+    b_tensor->Resize({1, n});
+    auto* a_data = a_tensor->mutable_data<float>(place);
+    auto* b_data = b_tensor->mutable_data<float>(place);
+    for (int i = 0; i < n; i++) {
+      a_data[i] = i;
+      b_data[i] = 0.1 * i;
+    }
+    exe.Run();
+    auto* e_data = e_tensor->data<float>();
+    for (int i = 0; i < n; i++) {
+      EXPECT_NEAR(e_data[i], 2.2 * i, 1e-3);
+    }
+  };
+
+  // the first run records, c and d get the slices of the arena
+  run(64);
+  ASSERT_TRUE(c_tensor->IsInitialized());
+  ASSERT_TRUE(d_tensor->IsInitialized());
+  EXPECT_FALSE(c_tensor->IsSharedBufferWith(*d_tensor));
+  auto* c_ptr = c_tensor->data<float>();
+  auto* d_ptr = d_tensor->data<float>();
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(c_ptr) %
+                StaticMemoryPlanner::kAlignment,
+            0UL);
+
+  // a planned run reuses the slices, a smaller batch fits into them
+  run(64);
+  EXPECT_EQ(c_tensor->data<float>(), c_ptr);
+  EXPECT_EQ(d_tensor->data<float>(), d_ptr);
+  run(16);
+  EXPECT_EQ(c_tensor->data<float>(), c_ptr);
+
+  // a larger batch is planned again
+  run(1024);
+  run(1024);
+  run(1024);
+  EXPECT_GE(c_tensor->memory_size(), 1024 * sizeof(float));
+}
+
+// An allocation at a fixed address, the address is reused after it is freed.
+static std::shared_ptr<memory::Allocation> AllocAtFixedAddress() {
+  static float data[16];
+  alignas(memory::Allocation) static char buf[sizeof(memory::Allocation)];
+  auto* allocation =
+      new (buf) memory::Allocation(data, sizeof(data), platform::CPUPlace());
+  return std::shared_ptr<memory::Allocation>(
+      allocation, [](memory::Allocation* a) { a->~Allocation(); });
+}
+
+TEST(StaticMemoryPlanner, ReusedHolderAddress) {
+  // c = a + a, d = c + c, e = a + a, f = e + e, c and e are never live at
+  // the same time, e gets the address of the holder of c after c is freed
+  ProgramDesc program;
+  auto* main_block = program.MutableBlock(0);
+  auto append_add = [&](const std::string& x, const std::string& out) {
+    auto* add = main_block->AppendOp();
+    add->SetType("elementwise_add");
+    add->SetInput("X", {x});
+    add->SetInput("Y", {x});
+    add->SetOutput("Out", {out});
+  };
+  append_add("a", "c");
+  append_add("c", "d");
+  append_add("a", "e");
+  append_add("e", "f");
+  std::vector<std::unique_ptr<OperatorBase>> ops;
+  for (auto* op_desc : main_block->AllOps()) {
+    ops.emplace_back(OpRegistry::CreateOp(*op_desc));
+  }
+
+  auto place = platform::CPUPlace();
+  Scope scope;
+  auto* a = scope.Var("a")->GetMutable<LoDTensor>();
+  a->Resize({16});
+  a->mutable_data<float>(place);
+  auto* c = scope.Var("c")->GetMutable<LoDTensor>();
+  auto* e = scope.Var("e")->GetMutable<LoDTensor>();
+  scope.Var("d")->GetMutable<LoDTensor>();
+  scope.Var("f")->GetMutable<LoDTensor>();
+
+  StaticMemoryPlanner planner(place, ops, {"a", "d", "f"});
+  ASSERT_TRUE(planner.recording());
+  planner.PreRun(&scope);
+  c->Resize({16});
+  c->ResetHolderWithType(AllocAtFixedAddress(), proto::VarType::FP32);
+  planner.Record(0, &scope);
+  planner.Record(1, &scope);
+  c->clear();
+  e->Resize({16});
+  e->ResetHolderWithType(AllocAtFixedAddress(), proto::VarType::FP32);
+  planner.Record(2, &scope);
+  planner.Record(3, &scope);
+  planner.PostRun(&scope);
+
+  // c and e are planned in two groups, which share the offset of the arena
+  EXPECT_EQ(planner.planned_var_num(), 2UL);
+  ASSERT_TRUE(c->IsInitialized());
+  ASSERT_TRUE(e->IsInitialized());
+  EXPECT_FALSE(c->IsSharedBufferWith(*e));
+  EXPECT_EQ(c->data<float>(), e->data<float>());
+  EXPECT_EQ(planner.arena_size(), StaticMemoryPlanner::kAlignment);
+}
+
 }  // namespace framework
 }  // namespace paddle
 
@@ -0,0 +1,231 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/op_instruction_list.h"
+
+#include <utility>
+
+#include "gflags/gflags.h"
+#include "paddle/fluid/framework/lod_tensor.h"
+#include "paddle/fluid/framework/selected_rows.h"
+#include "paddle/fluid/platform/gpu_info.h"
+#include "paddle/fluid/platform/profiler.h"
+
+DECLARE_bool(benchmark);
+DECLARE_bool(check_nan_inf);
+DECLARE_bool(enable_unused_var_check);
+DECLARE_bool(fast_check_nan_inf);
+
+namespace paddle {
+namespace framework {
+
+static bool RunAsUsual() {
+  return platform::IsProfileEnabled() || FLAGS_benchmark ||
+         FLAGS_check_nan_inf || FLAGS_enable_unused_var_check ||
+         FLAGS_fast_check_nan_inf;
+}
+
+static bool IsTensorVar(const Variable& var) {
+  return var.IsInitialized() &&
+         (var.IsType<LoDTensor>() || var.IsType<SelectedRows>());
+}
+
+OpInstructionList::OpInstructionList(
+    const std::vector<OperatorBase*>& ops,
+    const std::vector<std::string>& skip_ops) {
+  for (auto* op : ops) {
+    bool need_skip = false;
+    for (auto& skip_op : skip_ops) {
+      if (op->Type().find(skip_op) != std::string::npos) {
+        need_skip = true;
+        break;
+      }
+    }
+    if (!need_skip) {
+      ops_.push_back(op);
+      op_slots_.emplace_back(slot_table_.Intern(op->Inputs()),
+                             slot_table_.Intern(op->Outputs()));
+    }
+  }
+}
+
+size_t OpInstructionList::prepared_op_num() const {
+  size_t num = 0;
+  for (auto& instruction : instructions_) {
+    if (instruction.kernel_op) {
+      ++num;
+    }
+  }
+  return num;
+}
+
+void OpInstructionList::ResetKernels(size_t begin) {
+  for (size_t i = begin; i < ops_.size(); ++i) {
+    auto* kernel_op = dynamic_cast<const OperatorWithKernel*>(ops_[i]);
+    if (kernel_op) {
+      kernel_op->ResetCachedKernel();
+    }
+  }
+}
+
+void OpInstructionList::Invalidate(bool reset_kernels) {
+  if (reset_kernels) {
+    ResetKernels(0);
+  }
+  instructions_.clear();
+  scope_ = nullptr;
+  warmup_runs_ = 0;
+  frozen_ = false;
+}
+
+void OpInstructionList::Freeze(const Scope& scope,
+                               const platform::Place& place) {
+  auto& pool = platform::DeviceContextPool::Instance();
+  indexed_scope_.Resolve(scope);
+  instructions_.clear();
+  instructions_.reserve(ops_.size());
+  for (size_t i = 0; i < ops_.size(); ++i) {
+    auto* op = ops_[i];
+    Instruction instruction;
+    instruction.op = op;
+    instruction.kernel_op = nullptr;
+    instruction.dev_ctx = nullptr;
+    auto* kernel_op = dynamic_cast<const OperatorWithKernel*>(op);
+    if (kernel_op && kernel_op->IsPrepared() && Complete(i)) {
+      instruction.ctx = indexed_scope_.BuildRuntimeContext(
+          op_slots_[i].first, op_slots_[i].second);
+      for (auto& pair : op_slots_[i].first) {
+        for (int slot : pair.second) {
+          auto* var = indexed_scope_.Var(slot);
+          if (var == nullptr || !IsTensorVar(*var)) continue;
+          auto* tensor = GetLoDTensorOrSelectedRowsValueFromVar(*var);
+          if (!tensor->IsInitialized()) continue;
+          instruction.watches.push_back({slot, var, var->Type(),
+                                         tensor->type(), tensor->place(),
+                                         tensor->layout()});
+        }
+      }
+      instruction.kernel_op = kernel_op;
+      instruction.dev_ctx = pool.Get(kernel_op->GetExecutionPlace(place));
+    }
+    instructions_.emplace_back(std::move(instruction));
+  }
+  scope_ = &scope;
+  place_ = place;
+  frozen_ = true;
+  VLOG(3) << "Freeze " << prepared_op_num() << " of " << ops_.size()
+          << " ops into instructions, " << indexed_scope_.resolved_num()
+          << " of " << slot_table_.size() << " variables are resolved";
+}
+
+void OpInstructionList::Rebind(const Scope& scope) {
+  indexed_scope_.Resolve(scope);
+  for (size_t i = 0; i < instructions_.size(); ++i) {
+    auto& instruction = instructions_[i];
+    if (instruction.kernel_op == nullptr) continue;
+    if (!Complete(i)) {
+      instruction.kernel_op = nullptr;
+      instruction.ctx.reset();
+      continue;
+    }
+    instruction.ctx = indexed_scope_.BuildRuntimeContext(
+        op_slots_[i].first, op_slots_[i].second);
+    for (auto& watch : instruction.watches) {
+      watch.var = indexed_scope_.Var(watch.slot);
+    }
+  }
+  scope_ = &scope;
+  VLOG(3) << "Rebind the instructions to scope " << &scope;
+}
+
+bool OpInstructionList::Complete(size_t i) const {
+  // a variable created after the resolve is not seen by the context
+  for (auto* slot_map : {&op_slots_[i].first, &op_slots_[i].second}) {
+    for (auto& pair : *slot_map) {
+      for (int slot : pair.second) {
+        if (indexed_scope_.Var(slot) == nullptr &&
+            slot_table_.Name(slot) != kEmptyVarName) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+bool OpInstructionList::Matches(const Instruction& instruction) const {
+  for (auto& watch : instruction.watches) {
+    if (!watch.var->IsInitialized() || watch.var->Type() != watch.var_type) {
+      return false;
+    }
+    auto* tensor = GetLoDTensorOrSelectedRowsValueFromVar(*watch.var);
+    if (!tensor->IsInitialized()) continue;
+    if (tensor->type() != watch.type || !(tensor->place() == watch.place) ||
+        tensor->layout() != watch.layout) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void OpInstructionList::Run(const Scope& scope,
+                            const platform::Place& place) {
+  if (frozen_ && !(place_ == place)) {
+    Invalidate();
+  } else if (frozen_ && scope_ != &scope) {
+    Rebind(scope);
+  }
+  if (!frozen_ || RunAsUsual()) {
+    for (auto* op : ops_) {
+      op->Run(scope, place);
+    }
+    if (!frozen_ && ++warmup_runs_ >= kWarmupRuns && !RunAsUsual()) {
+      Freeze(scope, place);
+    }
+    return;
+  }
+
+#ifdef PADDLE_WITH_CUDA
+  if (platform::is_gpu_place(place)) {
+    platform::SetDeviceId(BOOST_GET_CONST(platform::CUDAPlace, place).device);
+  }
+#endif
+  for (size_t i = 0; i < instructions_.size(); ++i) {
+    auto& instruction = instructions_[i];
+    if (instruction.kernel_op == nullptr) {
+      instruction.op->Run(scope, place);
+      continue;
+    }
+    if (Matches(instruction)) {
+      instruction.kernel_op->RunPrepared(scope, *instruction.ctx,
+                                         *instruction.dev_ctx);
+      continue;
+    }
+    VLOG(3) << "The inputs of " << instruction.op->Type()
+            << " changed, invalidate the instructions";
+    // the ops before keep their kernels, a reset kernel is prepared by two
+    // usual runs
+    Invalidate();
+    ResetKernels(i);
+    for (size_t j = i; j < ops_.size(); ++j) {
+      ops_[j]->Run(scope, place);
+    }
+    // the step counts as a warmup step
+    warmup_runs_ = 1;
+    return;
+  }
+}
+
+}  // namespace framework
+}  // namespace paddle
@@ -0,0 +1,115 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "paddle/fluid/framework/indexed_scope.h"
+#include "paddle/fluid/framework/operator.h"
+#include "paddle/fluid/framework/scope.h"
+#include "paddle/fluid/platform/device_context.h"
+#include "paddle/fluid/platform/place.h"
+
+namespace paddle {
+namespace framework {
+
+/*
+ * OpInstructionList runs the ops of a device worker step after step, and
+ * freezes them into a flat list of instructions after kWarmupRuns steps.
+ *
+ * The instruction of an op whose kernel is chosen and whose inputs need no
+ * data transform holds the variables of the runtime context, the kernel
+ * and the device context, it is replayed by OperatorWithKernel::RunPrepared
+ * without the scope lookups, the kernel choice and the data transform
+ * checks of OperatorBase::Run. The other ops run as usual.
+ *
+ * The data type, place and layout of the inputs are checked before an
+ * instruction is replayed. A change invalidates the list, the kernels are
+ * chosen again by the next steps, which freeze the list again. A different
+ * place invalidates the list too. The shapes may change from step to step,
+ * they are inferred by every replay.
+ *
+ * The variable names of the ops are interned into the slots of an
+ * IndexedScope, every variable is looked up once by a freeze. A different
+ * scope rebinds the instructions to its variables.
+ *
+ * The profiler and the debug flags (check_nan_inf, benchmark, ...) run the
+ * ops as usual.
+ */
+class OpInstructionList {
+ public:
+  static constexpr int kWarmupRuns = 2;
+
+  // The ops whose types contain one of skip_ops are not run.
+  OpInstructionList(const std::vector<OperatorBase*>& ops,
+                    const std::vector<std::string>& skip_ops = {});
+
+  void Run(const Scope& scope, const platform::Place& place);
+
+  // Drop the instructions, reset_kernels makes the ops choose their kernels
+  // again.
+  void Invalidate(bool reset_kernels = false);
+
+  bool frozen() const { return frozen_; }
+  // The number of the ops replayed by the instructions.
+  size_t prepared_op_num() const;
+
+ private:
+  struct InputWatch {
+    int slot;
+    const Variable* var;
+    int var_type;
+    proto::VarType::Type type;
+    platform::Place place;
+    DataLayout layout;
+  };
+
+  struct Instruction {
+    OperatorBase* op;
+    // nullptr if the op runs as usual
+    const OperatorWithKernel* kernel_op;
+    std::unique_ptr<RuntimeContext> ctx;
+    const platform::DeviceContext* dev_ctx;
+    std::vector<InputWatch> watches;
+  };
+
+  void Freeze(const Scope& scope, const platform::Place& place);
+  // Make the ops from the begin-th one choose their kernels again.
+  void ResetKernels(size_t begin);
+  // Bind the instructions to the variables of another scope, the watches
+  // keep the data types, places and layouts seen by the freeze.
+  void Rebind(const Scope& scope);
+  // Whether the variables of the i-th op are all in the indexed scope.
+  bool Complete(size_t i) const;
+  bool Matches(const Instruction& instruction) const;
+
+  std::vector<OperatorBase*> ops_;
+  // the slots of the inputs and the outputs of ops_
+  VarSlotTable slot_table_;
+  std::vector<std::pair<VarSlotTable::SlotMap, VarSlotTable::SlotMap>>
+      op_slots_;
+  IndexedScope indexed_scope_{&slot_table_};
+  std::vector<Instruction> instructions_;
+  const Scope* scope_{nullptr};
+  platform::Place place_;
+  int warmup_runs_{0};
+  bool frozen_{false};
+};
+
+}  // namespace framework
+}  // namespace paddle
@@ -0,0 +1,189 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/op_instruction_list.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/framework/op_registry.h"
+#include "paddle/fluid/framework/program_desc.h"
+
+USE_OP(elementwise_add);
+
+namespace paddle {
+namespace framework {
+
+template <typename T>
+static void FillInputs(Scope* scope, int n) {
+  platform::CPUPlace place;
+  auto* a = scope->Var("a")->GetMutable<LoDTensor>();
+  auto* b = scope->Var("b")->GetMutable<LoDTensor>();
+  a->Resize({n});
+  b->Resize({n});
+  auto* a_data = a->mutable_data<T>(place);
+  auto* b_data = b->mutable_data<T>(place);
+  for (int i = 0; i < n; ++i) {
+    a_data[i] = i;
+    b_data[i] = 10 * i;
+  }
+}
+
+template <typename T>
+static void CheckOutput(const Scope& scope, int n) {
+  // d = (a + b) + a
+  auto& d = scope.FindVar("d")->Get<LoDTensor>();
+  ASSERT_EQ(d.numel(), n);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(d.data<T>()[i], static_cast<T>(12 * i));
+  }
+}
+
+TEST(OpInstructionList, FreezeAndInvalidate) {
+  ProgramDesc program;
+  auto* block = program.MutableBlock(0);
+  auto append_add = [&](const std::string& x, const std::string& y,
+                        const std::string& out) {
+    auto* op = block->AppendOp();
+    op->SetType("elementwise_add");
+    op->SetInput("X", {x});
+    op->SetInput("Y", {y});
+    op->SetOutput("Out", {out});
+  };
+  append_add("a", "b", "c");
+  append_add("c", "a", "d");
+  append_add("d", "d", "skipped");
+
+  std::vector<std::unique_ptr<OperatorBase>> ops;
+  std::vector<OperatorBase*> op_ptrs;
+  for (auto* op_desc : block->AllOps()) {
+    ops.emplace_back(OpRegistry::CreateOp(*op_desc));
+    op_ptrs.push_back(ops.back().get());
+  }
+  OpInstructionList instructions(op_ptrs, {"elementwise_add_skip"});
+  OpInstructionList skip_all(op_ptrs, {"add"});
+
+  Scope scope;
+  for (auto* name : {"a", "b", "c", "d", "skipped"}) {
+    scope.Var(name)->GetMutable<LoDTensor>();
+  }
+  platform::CPUPlace place;
+
+  for (int step = 0; step < OpInstructionList::kWarmupRuns; ++step) {
+    EXPECT_FALSE(instructions.frozen());
+    FillInputs<float>(&scope, 4);
+    instructions.Run(scope, place);
+    CheckOutput<float>(scope, 4);
+  }
+  EXPECT_TRUE(instructions.frozen());
+  EXPECT_EQ(instructions.prepared_op_num(), 3UL);
+
+  // the replay infers the changed shapes
+  FillInputs<float>(&scope, 16);
+  instructions.Run(scope, place);
+  EXPECT_TRUE(instructions.frozen());
+  CheckOutput<float>(scope, 16);
+
+  // another data type chooses the kernels again, the step counts as a
+  // warmup step
+  FillInputs<double>(&scope, 8);
+  instructions.Run(scope, place);
+  EXPECT_FALSE(instructions.frozen());
+  CheckOutput<double>(scope, 8);
+  FillInputs<double>(&scope, 8);
+  instructions.Run(scope, place);
+  EXPECT_TRUE(instructions.frozen());
+  CheckOutput<double>(scope, 8);
+
+  // another scope rebinds the instructions
+  Scope other;
+  for (auto* name : {"a", "b", "c", "d", "skipped"}) {
+    other.Var(name)->GetMutable<LoDTensor>();
+  }
+  FillInputs<double>(&other, 2);
+  instructions.Run(other, place);
+  EXPECT_TRUE(instructions.frozen());
+  CheckOutput<double>(other, 2);
+  CheckOutput<double>(scope, 8);
+
+  // the skipped ops are never run
+  Scope empty;
+  for (auto* name : {"a", "b", "c", "d", "skipped"}) {
+    empty.Var(name)->GetMutable<LoDTensor>();
+  }
+  skip_all.Run(empty, place);
+  EXPECT_FALSE(empty.FindVar("d")->Get<LoDTensor>().IsInitialized());
+}
+
+TEST(OpInstructionList, InvalidateInTheMiddle) {
+  ProgramDesc program;
+  auto* block = program.MutableBlock(0);
+  // c = a + b, e = d + d, the data type of d changes
+  auto* add = block->AppendOp();
+  add->SetType("elementwise_add");
+  add->SetInput("X", {"a"});
+  add->SetInput("Y", {"b"});
+  add->SetOutput("Out", {"c"});
+  add = block->AppendOp();
+  add->SetType("elementwise_add");
+  add->SetInput("X", {"d"});
+  add->SetInput("Y", {"d"});
+  add->SetOutput("Out", {"e"});
+
+  std::vector<std::unique_ptr<OperatorBase>> ops;
+  std::vector<OperatorBase*> op_ptrs;
+  for (auto* op_desc : block->AllOps()) {
+    ops.emplace_back(OpRegistry::CreateOp(*op_desc));
+    op_ptrs.push_back(ops.back().get());
+  }
+  OpInstructionList instructions(op_ptrs);
+
+  Scope scope;
+  for (auto* name : {"a", "b", "c", "d", "e"}) {
+    scope.Var(name)->GetMutable<LoDTensor>();
+  }
+  platform::CPUPlace place;
+  auto fill_d = [&](bool is_double) {
+    auto* d = scope.Var("d")->GetMutable<LoDTensor>();
+    d->Resize({3});
+    if (is_double) {
+      d->mutable_data<double>(place)[0] = 1;
+    } else {
+      d->mutable_data<float>(place)[0] = 1;
+    }
+  };
+
+  FillInputs<float>(&scope, 4);
+  fill_d(false);
+  for (int step = 0; step < OpInstructionList::kWarmupRuns; ++step) {
+    instructions.Run(scope, place);
+  }
+  EXPECT_TRUE(instructions.frozen());
+  EXPECT_EQ(instructions.prepared_op_num(), 2UL);
+
+  // the second op mismatches, the first one keeps its kernel
+  fill_d(true);
+  instructions.Run(scope, place);
+  EXPECT_FALSE(instructions.frozen());
+  EXPECT_EQ(scope.FindVar("e")->Get<LoDTensor>().data<double>()[0], 2);
+  instructions.Run(scope, place);
+  EXPECT_TRUE(instructions.frozen());
+  EXPECT_EQ(instructions.prepared_op_num(), 2UL);
+  EXPECT_EQ(scope.FindVar("e")->Get<LoDTensor>().data<double>()[0], 2);
+}
+
+}  // namespace framework
+}  // namespace paddle
@@ -1186,6 +1186,31 @@ void OperatorWithKernel::RunImpl(const Scope& scope,
   }
 }
 
+void OperatorWithKernel::RunPrepared(
+    const Scope& scope, const RuntimeContext& ctx,
+    const platform::DeviceContext& dev_ctx) const {
+  try {
+    if (!all_kernels_must_compute_runtime_shape_) {
+      RuntimeInferShapeContext infer_shape_ctx(*this, ctx);
+      this->InferShape(&infer_shape_ctx);
+    }
+    (*kernel_func_)(ExecutionContext(*this, scope, dev_ctx, ctx));
+  } catch (platform::EnforceNotMet& exception) {
+    LOG(WARNING) << kernel_type_->place_ << " " << DebugStringEx(&scope);
+    framework::InsertCallStackInfo(Type(), Attrs(), &exception);
+    throw std::move(exception);
+  }
+}
+
+void OperatorWithKernel::ResetCachedKernel() const {
+  std::lock_guard<std::mutex> lock(cache_update_mutex_);
+  kernel_type_.reset();
+  kernel_func_.reset();
+  runtime_ctx_.reset();
+  pre_scope_ = nullptr;
+  need_prepare_data_ = true;
+}
+
 void OperatorWithKernel::ChooseKernel(const RuntimeContext& ctx,
                                       const Scope& scope,
                                       const platform::Place& place) const {
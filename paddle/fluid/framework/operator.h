@@ -521,6 +521,19 @@ class OperatorWithKernel : public OperatorBase {
     return kernel_type_->place_;
   }
 
+  // Whether the kernel is chosen and the inputs need no data transform, the
+  // op can be replayed by RunPrepared then.
+  bool IsPrepared() const { return kernel_func_ && !need_prepare_data_; }
+
+  // Infer the shape and run the chosen kernel with a runtime context built
+  // for scope, used by OpInstructionList to replay the prepared ops.
+  void RunPrepared(const Scope& scope, const RuntimeContext& ctx,
+                   const platform::DeviceContext& dev_ctx) const;
+
+  // Drop the chosen kernel and the cached runtime context, the next run
+  // chooses the kernel and checks the data transform again.
+  void ResetCachedKernel() const;
+
  private:
   void RunImpl(const Scope& scope, const platform::Place& place) const final;
   void RunImpl(const Scope& scope, const platform::Place& place,
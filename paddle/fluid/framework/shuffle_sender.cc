@@ -0,0 +1,154 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/shuffle_sender.h"
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <utility>
+
+namespace paddle {
+namespace framework {
+
+// the room for the last record of a full message
+static constexpr size_t kShuffleMessageSlack = 64 * 1024;
+
+ShuffleMessage::ShuffleMessage(size_t bytes) : bytes_(bytes) { Reset(); }
+
+const std::string& ShuffleMessage::Finish() {
+  if (ar_.Buffer() == &msg_[0]) {
+    msg_.resize(ar_.Length());
+  } else {
+    // a record outgrew the string
+    msg_.assign(ar_.Buffer(), ar_.Length());
+  }
+  return msg_;
+}
+
+void ShuffleMessage::Reset() {
+  // the string keeps its storage, only the tail after the last message is
+  // filled by the resize
+  msg_.resize(std::max(msg_.size(), bytes_ + kShuffleMessageSlack));
+  ar_.SetWriteBuffer(&msg_[0], msg_.size(), nullptr);
+}
+
+ShuffleSender::ShuffleSender(int dest_num, size_t max_inflight_bytes,
+                             SendFunc send_func)
+    : send_func_(std::move(send_func)),
+      max_inflight_bytes_(max_inflight_bytes),
+      inflight_bytes_(dest_num, 0) {
+  complete_thread_ = std::thread([this] { CompleteLoop(); });
+}
+
+ShuffleSender::~ShuffleSender() { Finish(); }
+
+void ShuffleSender::Send(int dest, const std::string& msg) {
+  size_t bytes = msg.size();
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    credit_cv_.wait(lock, [this, dest, bytes] {
+      return inflight_bytes_[dest] == 0 ||
+             inflight_bytes_[dest] + bytes <= max_inflight_bytes_;
+    });
+    inflight_bytes_[dest] += bytes;
+    peak_inflight_bytes_ =
+        std::max(peak_inflight_bytes_, inflight_bytes_[dest]);
+  }
+  auto status = send_func_(dest, msg);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.push_back(PendingSend{dest, bytes, std::move(status)});
+  }
+  pending_cv_.notify_one();
+}
+
+void ShuffleSender::CompleteLoop() {
+  // the sends in flight to every trainer, oldest first
+  std::vector<std::deque<PendingSend>> pending(inflight_bytes_.size());
+  size_t pending_num = 0;
+  bool progress = true;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (pending_num == 0) {
+        pending_cv_.wait(lock,
+                         [this] { return !pending_.empty() || finished_; });
+        if (pending_.empty()) {
+          return;
+        }
+      } else if (!progress) {
+        pending_cv_.wait_for(lock, std::chrono::microseconds(100),
+                             [this] { return !pending_.empty(); });
+      }
+      for (auto& send : pending_) {
+        pending[send.dest].push_back(std::move(send));
+        ++pending_num;
+      }
+      pending_.clear();
+    }
+    // a receiver handles the messages of a sender in order, so only the
+    // oldest send to every trainer is polled. the trainers return their
+    // credits apart, a slow one does not hold back the others
+    progress = false;
+    for (auto& sends : pending) {
+      while (!sends.empty()) {
+        auto& send = sends.front();
+        int32_t ret = 0;
+        if (send.status.valid()) {
+          if (send.status.wait_for(std::chrono::seconds(0)) !=
+              std::future_status::ready) {
+            break;
+          }
+          ret = send.status.get();
+        }
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          inflight_bytes_[send.dest] -= send.bytes;
+          if (ret != 0) {
+            LOG(WARNING) << "global shuffle send to " << send.dest
+                         << " failed, status[" << ret << "]";
+            ++failed_num_;
+          }
+        }
+        sends.pop_front();
+        --pending_num;
+        progress = true;
+      }
+    }
+    if (progress) {
+      credit_cv_.notify_all();
+    }
+  }
+}
+
+int ShuffleSender::Finish() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = true;
+  }
+  pending_cv_.notify_one();
+  if (complete_thread_.joinable()) {
+    complete_thread_.join();
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  return failed_num_;
+}
+
+size_t ShuffleSender::peak_inflight_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return peak_inflight_bytes_;
+}
+
+}  // namespace framework
+}  // namespace paddle
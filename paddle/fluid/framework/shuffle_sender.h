@@ -0,0 +1,117 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <functional>
+#include <future>  // NOLINT
+#include <mutex>   // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "paddle/fluid/framework/archive.h"
+
+namespace paddle {
+namespace framework {
+
+/*
+ * ShuffleMessage serializes the records to a trainer into the storage of a
+ * string, which the transport reads in place. The archive takes a buffer
+ * of its own only if a record outgrows the slack of the string, then the
+ * message is copied once.
+ */
+class ShuffleMessage {
+ public:
+  // The message is full when it holds bytes.
+  explicit ShuffleMessage(size_t bytes);
+
+  ShuffleMessage(const ShuffleMessage&) = delete;
+  ShuffleMessage& operator=(const ShuffleMessage&) = delete;
+
+  template <class T>
+  void Append(const T& record) {
+    ar_ << record;
+  }
+
+  bool Empty() { return ar_.Length() == 0; }
+  bool Full() { return ar_.Length() >= bytes_; }
+  size_t Length() { return ar_.Length(); }
+
+  // The records appended since the last Reset, valid until the next
+  // Append or Reset.
+  const std::string& Finish();
+  void Reset();
+
+ private:
+  size_t bytes_;
+  std::string msg_;
+  BinaryArchive ar_;
+};
+
+/*
+ * ShuffleSender streams the messages of a global shuffle to the trainers.
+ * A trainer has at most max_inflight_bytes of messages in flight, which
+ * are sent but not handled by the receiver yet. Send blocks for the credit
+ * of its trainer instead of sleeping, and the completion thread returns
+ * the credits of every trainer as its sends finish, so that the
+ * serialization, the sends and the receives overlap.
+ */
+class ShuffleSender {
+ public:
+  // Send msg to trainer dest, the future is set when the receiver has
+  // handled the message. msg is not used after the function returns.
+  using SendFunc =
+      std::function<std::future<int32_t>(int dest, const std::string& msg)>;
+
+  ShuffleSender(int dest_num, size_t max_inflight_bytes, SendFunc send_func);
+  ~ShuffleSender();
+
+  // Send msg to dest. A message larger than max_inflight_bytes is sent
+  // when nothing else is in flight to dest.
+  void Send(int dest, const std::string& msg);
+
+  // Wait for all the sends, return the number of the failed ones.
+  int Finish();
+
+  // the most bytes ever in flight to a trainer
+  size_t peak_inflight_bytes() const;
+
+ private:
+  struct PendingSend {
+    int dest;
+    size_t bytes;
+    std::future<int32_t> status;
+  };
+
+  void CompleteLoop();
+
+  SendFunc send_func_;
+  size_t max_inflight_bytes_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable credit_cv_;
+  std::condition_variable pending_cv_;
+  std::vector<size_t> inflight_bytes_;
+  size_t peak_inflight_bytes_{0};
+  std::deque<PendingSend> pending_;
+  bool finished_{false};
+  int failed_num_{0};
+  std::thread complete_thread_;
+};
+
+}  // namespace framework
+}  // namespace paddle
@@ -0,0 +1,423 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/shuffle_sender.h"
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace paddle {
+namespace framework {
+
+TEST(ShuffleMessage, InPlace) {
+  ShuffleMessage msg(16);
+  EXPECT_TRUE(msg.Empty());
+  for (uint64_t i = 0; i < 3; ++i) {
+    msg.Append(i);
+  }
+  EXPECT_TRUE(msg.Full());
+  const std::string& data = msg.Finish();
+  ASSERT_EQ(data.size(), 3 * sizeof(uint64_t));
+  const char* storage = data.data();
+
+  BinaryArchive ar;
+  ar.SetReadBuffer(const_cast<char*>(data.data()), data.size(), nullptr);
+  for (uint64_t i = 0; i < 3; ++i) {
+    EXPECT_EQ(ar.Get<uint64_t>(), i);
+  }
+
+  // the next message is written into the same storage
+  msg.Reset();
+  EXPECT_TRUE(msg.Empty());
+  msg.Append(std::string(10, 'a'));
+  EXPECT_EQ(msg.Finish().data(), storage);
+
+  // a record larger than the string is copied once
+  msg.Reset();
+  std::string large(1 << 20, 'b');
+  msg.Append(large);
+  ar.SetReadBuffer(const_cast<char*>(msg.Finish().data()),
+                   msg.Finish().size(), nullptr);
+  EXPECT_EQ(ar.Get<std::string>(), large);
+}
+
+TEST(ShuffleSender, Credit) {
+  const int dest_num = 2;
+  const size_t max_inflight_bytes = 100;
+  std::mutex mutex;
+  std::vector<std::promise<int32_t>> promises;
+  std::atomic<int> sent{0};
+  ShuffleSender sender(dest_num, max_inflight_bytes,
+                       [&](int dest, const std::string& msg) {
+                         std::lock_guard<std::mutex> lock(mutex);
+                         promises.emplace_back();
+                         ++sent;
+                         return promises.back().get_future();
+                       });
+  std::thread producer([&sender] {
+    for (int i = 0; i < 10; ++i) {
+      sender.Send(i % dest_num, std::string(40, 'a'));
+    }
+  });
+  // two messages of a destination fit in the credit
+  while (sent < 4) {
+    std::this_thread::yield();
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(sent, 4);
+  for (int i = 0; i < 10; ++i) {
+    while (sent <= i) {
+      std::this_thread::yield();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    promises[i].set_value(i == 9 ? -1 : 0);
+  }
+  producer.join();
+  EXPECT_EQ(sender.Finish(), 1);
+  EXPECT_EQ(sender.peak_inflight_bytes(), 80UL);
+}
+
+// a trainer that does not ack leaves the credits of the others alone
+TEST(ShuffleSender, CreditPerDest) {
+  const int dest_num = 2;
+  const size_t max_inflight_bytes = 100;
+  std::mutex mutex;
+  std::vector<std::deque<std::promise<int32_t>>> promises(dest_num);
+  std::atomic<int> sent_to_1{0};
+  ShuffleSender sender(dest_num, max_inflight_bytes,
+                       [&](int dest, const std::string& msg) {
+                         std::lock_guard<std::mutex> lock(mutex);
+                         promises[dest].emplace_back();
+                         if (dest == 1) {
+                           ++sent_to_1;
+                         }
+                         return promises[dest].back().get_future();
+                       });
+  std::thread producer([&sender] {
+    sender.Send(0, std::string(40, 'a'));
+    for (int i = 0; i < 3; ++i) {
+      sender.Send(1, std::string(40, 'a'));
+    }
+  });
+  while (sent_to_1 < 2) {
+    std::this_thread::yield();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    promises[1][0].set_value(0);
+  }
+  // the third send to trainer 1 takes the returned credit while the send
+  // to trainer 0 is still in flight
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (sent_to_1 < 3 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(sent_to_1, 3);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    promises[0][0].set_value(0);
+  }
+  producer.join();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 1; i < promises[1].size(); ++i) {
+      promises[1][i].set_value(0);
+    }
+  }
+  EXPECT_EQ(sender.Finish(), 0);
+}
+
+// The trainers of the loopback benchmark are processes connected by unix
+// sockets, a socket for every direction. The receiver acks every message
+// on the socket of the message after it is handled, so that the writes of
+// the messages never wait for the writes of the acks.
+namespace {
+
+enum FrameType : uint32_t { kData = 0, kAck = 1, kDone = 2 };
+
+bool ReadFull(int fd, void* buf, size_t len) {
+  char* p = static_cast<char*>(buf);
+  while (len > 0) {
+    ssize_t n = read(fd, p, len);
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+void WriteFull(int fd, const void* buf, size_t len) {
+  const char* p = static_cast<const char*>(buf);
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    PADDLE_ENFORCE_GT(n, 0, platform::errors::Unavailable("write failed"));
+    p += n;
+    len -= n;
+  }
+}
+
+void WriteFrame(int fd, uint32_t type, const char* data, uint32_t len) {
+  uint32_t header[2] = {type, len};
+  WriteFull(fd, header, sizeof(header));
+  if (len > 0) {
+    WriteFull(fd, data, len);
+  }
+}
+
+class LoopbackTrainer {
+ public:
+  // out_fds[i] sends the messages to trainer i, in_fds[i] receives the
+  // messages from trainer i.
+  LoopbackTrainer(int rank, std::vector<int> out_fds, std::vector<int> in_fds)
+      : rank_(rank),
+        out_fds_(std::move(out_fds)),
+        in_fds_(std::move(in_fds)),
+        peers_(out_fds_.size()) {
+    for (size_t i = 0; i < peers_.size(); ++i) {
+      peers_[i].reset(new Peer);
+      if (static_cast<int>(i) != rank_) {
+        threads_.emplace_back([this, i] { AckLoop(i); });
+        threads_.emplace_back([this, i] { ReceiveLoop(i); });
+      }
+    }
+  }
+
+  std::future<int32_t> Send(int dest, const std::string& msg) {
+    if (dest == rank_) {
+      received_bytes_ += msg.size();
+      std::promise<int32_t> promise;
+      promise.set_value(0);
+      return promise.get_future();
+    }
+    auto& peer = *peers_[dest];
+    std::future<int32_t> status;
+    {
+      std::lock_guard<std::mutex> lock(peer.ack_mutex);
+      peer.acks.emplace_back();
+      status = peer.acks.back().get_future();
+    }
+    WriteFrame(out_fds_[dest], kData, msg.data(), msg.size());
+    return status;
+  }
+
+  // Wait for all the trainers to finish sending and stop the threads,
+  // return the bytes received.
+  uint64_t Close() {
+    for (size_t i = 0; i < peers_.size(); ++i) {
+      if (static_cast<int>(i) != rank_) {
+        WriteFrame(out_fds_[i], kDone, nullptr, 0);
+      }
+    }
+    {
+      std::unique_lock<std::mutex> lock(done_mutex_);
+      done_cv_.wait(lock, [this] {
+        return done_num_ == static_cast<int>(peers_.size()) - 1;
+      });
+    }
+    for (size_t i = 0; i < peers_.size(); ++i) {
+      if (static_cast<int>(i) != rank_) {
+        shutdown(out_fds_[i], SHUT_RDWR);
+        shutdown(in_fds_[i], SHUT_RDWR);
+      }
+    }
+    for (auto& t : threads_) {
+      t.join();
+    }
+    return received_bytes_;
+  }
+
+ private:
+  struct Peer {
+    std::mutex ack_mutex;
+    std::deque<std::promise<int32_t>> acks;
+  };
+
+  void AckLoop(int dest) {
+    auto& peer = *peers_[dest];
+    uint32_t header[2];
+    while (ReadFull(out_fds_[dest], header, sizeof(header))) {
+      std::lock_guard<std::mutex> lock(peer.ack_mutex);
+      peer.acks.front().set_value(0);
+      peer.acks.pop_front();
+    }
+  }
+
+  // the messages are counted instead of deserialized
+  void ReceiveLoop(int src) {
+    std::string msg;
+    uint32_t header[2];
+    while (ReadFull(in_fds_[src], header, sizeof(header))) {
+      if (header[0] == kDone) {
+        std::lock_guard<std::mutex> lock(done_mutex_);
+        ++done_num_;
+        done_cv_.notify_all();
+        continue;
+      }
+      msg.resize(header[1]);
+      if (!ReadFull(in_fds_[src], &msg[0], msg.size())) {
+        break;
+      }
+      received_bytes_ += msg.size();
+      WriteFrame(in_fds_[src], kAck, nullptr, 0);
+    }
+  }
+
+  int rank_;
+  std::vector<int> out_fds_;
+  std::vector<int> in_fds_;
+  std::vector<std::unique_ptr<Peer>> peers_;
+  std::vector<std::thread> threads_;
+  std::atomic<uint64_t> received_bytes_{0};
+  std::mutex done_mutex_;
+  std::condition_variable done_cv_;
+  int done_num_{0};
+};
+
+const int kTrainerNum = 4;
+// the unit tests run a smoke size, build WITH_BENCHMARK to measure
+#ifdef PADDLE_WITH_BENCHMARK
+const int kMessageNum = 200;
+#else
+const int kMessageNum = 10;
+#endif
+const size_t kMessageBytes = 64 * 1024;
+
+// Every trainer sends kMessageNum messages to every trainer, the blocking
+// baseline waits for the messages of a round before the next one as
+// GlobalShuffle did. Return the seconds of trainer 0.
+double RunLoopback(bool streaming) {
+  // fds[i][j][0] is the end of trainer i to send to trainer j, and
+  // fds[i][j][1] is the end of trainer j
+  std::vector<std::vector<std::array<int, 2>>> fds(
+      kTrainerNum, std::vector<std::array<int, 2>>(kTrainerNum, {{-1, -1}}));
+  for (int i = 0; i < kTrainerNum; ++i) {
+    for (int j = 0; j < kTrainerNum; ++j) {
+      if (i != j) {
+        PADDLE_ENFORCE_EQ(
+            socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i][j].data()), 0,
+            platform::errors::Unavailable("socketpair failed"));
+      }
+    }
+  }
+  std::vector<pid_t> children;
+  int rank = 0;
+  for (int i = 1; i < kTrainerNum; ++i) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      rank = i;
+      break;
+    }
+    children.push_back(pid);
+  }
+  std::vector<int> out_fds(kTrainerNum, -1);
+  std::vector<int> in_fds(kTrainerNum, -1);
+  for (int i = 0; i < kTrainerNum; ++i) {
+    for (int j = 0; j < kTrainerNum; ++j) {
+      if (i == j) {
+        continue;
+      }
+      if (i == rank) {
+        out_fds[j] = fds[i][j][0];
+      } else {
+        close(fds[i][j][0]);
+      }
+      if (j == rank) {
+        in_fds[i] = fds[i][j][1];
+      } else {
+        close(fds[i][j][1]);
+      }
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  uint64_t received_bytes = 0;
+  {
+    LoopbackTrainer trainer(rank, out_fds, in_fds);
+    std::string msg(kMessageBytes, 'a');
+    if (streaming) {
+      ShuffleSender sender(kTrainerNum, 4 * kMessageBytes,
+                           [&trainer](int dest, const std::string& msg) {
+                             return trainer.Send(dest, msg);
+                           });
+      for (int i = 0; i < kMessageNum; ++i) {
+        for (int dest = 0; dest < kTrainerNum; ++dest) {
+          sender.Send((dest + rank) % kTrainerNum, msg);
+        }
+      }
+      EXPECT_EQ(sender.Finish(), 0);
+    } else {
+      for (int i = 0; i < kMessageNum; ++i) {
+        std::vector<std::future<int32_t>> status;
+        for (int dest = 0; dest < kTrainerNum; ++dest) {
+          status.push_back(trainer.Send((dest + rank) % kTrainerNum, msg));
+        }
+        for (auto& s : status) {
+          s.wait();
+        }
+      }
+    }
+    received_bytes = trainer.Close();
+  }
+  double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+  for (int i = 0; i < kTrainerNum; ++i) {
+    if (i != rank) {
+      close(out_fds[i]);
+      close(in_fds[i]);
+    }
+  }
+  uint64_t expected_bytes =
+      static_cast<uint64_t>(kMessageNum) * kMessageBytes * kTrainerNum;
+  if (rank != 0) {
+    _exit(received_bytes == expected_bytes ? 0 : 1);
+  }
+  EXPECT_EQ(received_bytes, expected_bytes);
+  for (pid_t pid : children) {
+    int status = 0;
+    waitpid(pid, &status, 0);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+  return seconds;
+}
+
+}  // namespace
+
+TEST(ShuffleSender, LoopbackBenchmark) {
+  double blocking_sec = RunLoopback(false);
+  double streaming_sec = RunLoopback(true);
+  double mb = static_cast<double>(kMessageNum) * kMessageBytes * kTrainerNum /
+              (1 << 20);
+  LOG(INFO) << kTrainerNum << " trainers send " << mb
+            << " MB each, blocking rounds: " << mb / blocking_sec
+            << " MB/s, streaming with credits: " << mb / streaming_sec
+            << " MB/s";
+}
+
+}  // namespace framework
+}  // namespace paddle
@@ -0,0 +1,356 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/static_memory_planner.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "paddle/fluid/memory/malloc.h"
+
+namespace paddle {
+namespace framework {
+
+namespace {
+
+// A slice of the arena, it keeps the arena alive.
+class ArenaSliceAllocation : public memory::Allocation {
+ public:
+  ArenaSliceAllocation(std::shared_ptr<memory::Allocation> arena,
+                       size_t offset, size_t size)
+      : Allocation(static_cast<char*>(arena->ptr()) + offset, size,
+                   arena->place()),
+        arena_(std::move(arena)) {}
+
+ private:
+  std::shared_ptr<memory::Allocation> arena_;
+};
+
+size_t AlignUp(size_t size) {
+  return (size + StaticMemoryPlanner::kAlignment - 1) /
+         StaticMemoryPlanner::kAlignment * StaticMemoryPlanner::kAlignment;
+}
+
+bool HasControlFlowOrMKLDNN(const OperatorBase& op) {
+  if (op.HasAttr("sub_block") || op.HasAttr("sub_blocks")) {
+    return true;
+  }
+  return op.HasAttr("use_mkldnn") && op.Attr<bool>("use_mkldnn");
+}
+
+}  // namespace
+
+StaticMemoryPlanner::StaticMemoryPlanner(
+    const platform::Place& place,
+    const std::vector<std::unique_ptr<OperatorBase>>& ops,
+    const std::unordered_set<std::string>& skip_vars)
+    : place_(place), ops_(ops) {
+  // the first access of every variable, true for a write
+  std::unordered_map<std::string, bool> first_write;
+  std::unordered_map<std::string, size_t> last_use;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    auto& op = *ops[i];
+    if (HasControlFlowOrMKLDNN(op)) {
+      VLOG(3) << "Static memory plan is disabled by op " << op.Type();
+      state_ = kDisabled;
+      return;
+    }
+    for (auto& pair : op.Inputs()) {
+      for (auto& name : pair.second) {
+        first_write.emplace(name, false);
+        last_use[name] = i;
+      }
+    }
+    for (auto& pair : op.Outputs()) {
+      for (auto& name : pair.second) {
+        if (first_write.emplace(name, true).second) {
+          candidate_ids_.emplace(name, -1);
+        }
+        last_use[name] = i;
+      }
+    }
+  }
+  for (auto& pair : first_write) {
+    auto& name = pair.first;
+    if (!pair.second || name == kEmptyVarName || skip_vars.count(name)) {
+      candidate_ids_.erase(name);
+    }
+  }
+  // the def of a candidate is the op writing it first
+  for (size_t i = 0; i < ops.size(); ++i) {
+    for (auto& pair : ops[i]->Outputs()) {
+      for (auto& name : pair.second) {
+        auto it = candidate_ids_.find(name);
+        if (it != candidate_ids_.end() && it->second < 0) {
+          it->second = static_cast<int>(candidates_.size());
+          Candidate candidate;
+          candidate.name = name;
+          candidate.def = i;
+          candidate.last_use = last_use[name];
+          candidates_.emplace_back(std::move(candidate));
+        }
+      }
+    }
+  }
+  ResetRecord();
+}
+
+size_t StaticMemoryPlanner::planned_var_num() const {
+  size_t num = 0;
+  for (auto& group : groups_) {
+    num += group.members.size();
+  }
+  return num;
+}
+
+LoDTensor* StaticMemoryPlanner::LocalTensor(Scope* scope,
+                                            const std::string& name) const {
+  auto* var = scope->FindLocalVar(name);
+  if (var == nullptr || !var->IsType<LoDTensor>()) {
+    return nullptr;
+  }
+  return var->GetMutable<LoDTensor>();
+}
+
+int StaticMemoryPlanner::Find(int idx) {
+  while (candidates_[idx].parent != idx) {
+    candidates_[idx].parent = candidates_[candidates_[idx].parent].parent;
+    idx = candidates_[idx].parent;
+  }
+  return idx;
+}
+
+void StaticMemoryPlanner::Union(int a, int b) {
+  a = Find(a);
+  b = Find(b);
+  if (a != b) {
+    candidates_[std::max(a, b)].parent = std::min(a, b);
+  }
+}
+
+void StaticMemoryPlanner::ResetRecord() {
+  for (size_t i = 0; i < candidates_.size(); ++i) {
+    auto& candidate = candidates_[i];
+    candidate.parent = static_cast<int>(i);
+    candidate.bytes = 0;
+    candidate.excluded = false;
+    candidate.holders.clear();
+  }
+  holder_owners_.clear();
+  foreign_holders_.clear();
+}
+
+void StaticMemoryPlanner::ClearCandidates(Scope* scope) {
+  for (auto& candidate : candidates_) {
+    auto* tensor = LocalTensor(scope, candidate.name);
+    if (tensor) {
+      tensor->clear();
+    }
+  }
+  groups_.clear();
+  arena_.reset();
+}
+
+void StaticMemoryPlanner::PreRun(Scope* scope) {
+  if (state_ == kRecording) {
+    // drop the tensors of the previous runs to record the exact sizes
+    ClearCandidates(scope);
+    ResetRecord();
+  }
+}
+
+void StaticMemoryPlanner::Record(size_t op_idx, Scope* scope) {
+  auto record = [&](const std::string& name) {
+    auto it = candidate_ids_.find(name);
+    if (it != candidate_ids_.end()) {
+      auto* tensor = LocalTensor(scope, name);
+      if (tensor == nullptr || !tensor->IsInitialized()) {
+        return;
+      }
+      auto& candidate = candidates_[it->second];
+      if (!(tensor->place() == place_)) {
+        candidate.excluded = true;
+        return;
+      }
+      auto& holder_ptr = tensor->Holder();
+      auto* holder = holder_ptr.get();
+      auto& owner = holder_owners_[holder];
+      if (owner.holder.lock() != holder_ptr) {
+        // the first sight of the holder, the candidates seen at its address
+        // before are not live any more and do not share memory with this one
+        owner.holder = holder_ptr;
+        owner.owner = it->second;
+      }
+      Union(owner.owner, it->second);
+      if (std::find(candidate.holders.begin(), candidate.holders.end(),
+                    holder) == candidate.holders.end()) {
+        candidate.holders.push_back(holder);
+      }
+      candidate.bytes = std::max(candidate.bytes, holder->size());
+      candidate.type = tensor->type();
+      return;
+    }
+    auto* var = scope->FindVar(name);
+    if (var && var->IsType<LoDTensor>() &&
+        var->Get<LoDTensor>().IsInitialized()) {
+      foreign_holders_.insert(var->Get<LoDTensor>().Holder().get());
+    }
+  };
+  auto& op = *ops_[op_idx];
+  for (auto& pair : op.Inputs()) {
+    for (auto& name : pair.second) {
+      record(name);
+    }
+  }
+  for (auto& pair : op.Outputs()) {
+    for (auto& name : pair.second) {
+      record(name);
+    }
+  }
+}
+
+void StaticMemoryPlanner::Plan(Scope* scope) {
+  std::unordered_map<int, size_t> root_groups;
+  std::vector<bool> excluded;
+  for (size_t i = 0; i < candidates_.size(); ++i) {
+    auto& candidate = candidates_[i];
+    if (candidate.holders.empty()) {
+      continue;
+    }
+    int root = Find(static_cast<int>(i));
+    auto it = root_groups.find(root);
+    if (it == root_groups.end()) {
+      it = root_groups.emplace(root, groups_.size()).first;
+      Group group;
+      group.bytes = 0;
+      group.def = candidate.def;
+      group.last_use = candidate.last_use;
+      groups_.emplace_back(std::move(group));
+      excluded.push_back(false);
+    }
+    auto& group = groups_[it->second];
+    group.members.push_back(static_cast<int>(i));
+    group.bytes = std::max(group.bytes, candidate.bytes);
+    group.def = std::min(group.def, candidate.def);
+    group.last_use = std::max(group.last_use, candidate.last_use);
+    bool foreign = candidate.excluded;
+    for (auto* holder : candidate.holders) {
+      foreign = foreign || foreign_holders_.count(holder);
+    }
+    if (foreign) {
+      excluded[it->second] = true;
+    }
+  }
+  std::vector<Group> groups;
+  for (size_t i = 0; i < groups_.size(); ++i) {
+    if (!excluded[i] && groups_[i].bytes > 0) {
+      groups.emplace_back(std::move(groups_[i]));
+    }
+  }
+  groups_.swap(groups);
+
+  // place the larger groups first, every group at the lowest offset free
+  // of the placed groups whose lifetimes overlap with it
+  std::vector<size_t> order(groups_.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+    return groups_[a].bytes > groups_[b].bytes;
+  });
+  std::vector<size_t> placed;
+  size_t arena_size = 0;
+  size_t total_bytes = 0;
+  for (size_t idx : order) {
+    auto& group = groups_[idx];
+    std::vector<const Group*> overlaps;
+    for (size_t other : placed) {
+      auto& placed_group = groups_[other];
+      if (placed_group.def <= group.last_use &&
+          group.def <= placed_group.last_use) {
+        overlaps.push_back(&placed_group);
+      }
+    }
+    std::sort(overlaps.begin(), overlaps.end(),
+              [](const Group* a, const Group* b) {
+                return a->offset < b->offset;
+              });
+    size_t offset = 0;
+    for (auto* other : overlaps) {
+      if (offset + group.bytes <= other->offset) {
+        break;
+      }
+      offset = std::max(offset, AlignUp(other->offset + other->bytes));
+    }
+    group.offset = offset;
+    placed.push_back(idx);
+    arena_size = std::max(arena_size, AlignUp(offset + group.bytes));
+    total_bytes += AlignUp(group.bytes);
+  }
+  if (arena_size == 0) {
+    groups_.clear();
+    return;
+  }
+
+  // release the recorded tensors before the arena is allocated
+  for (auto& group : groups_) {
+    for (int member : group.members) {
+      LocalTensor(scope, candidates_[member].name)->clear();
+    }
+  }
+  arena_ = memory::AllocShared(place_, arena_size);
+  for (auto& group : groups_) {
+    group.slice = std::make_shared<ArenaSliceAllocation>(
+        arena_, group.offset, group.bytes);
+    for (int member : group.members) {
+      LocalTensor(scope, candidates_[member].name)
+          ->ResetHolderWithType(group.slice, candidates_[member].type);
+    }
+  }
+  VLOG(3) << "Static memory plan of " << planned_var_num() << " variables in "
+          << groups_.size() << " groups, the arena takes " << arena_size
+          << " bytes of " << total_bytes << " bytes";
+}
+
+void StaticMemoryPlanner::PostRun(Scope* scope) {
+  if (state_ == kRecording) {
+    Plan(scope);
+    state_ = kPlanned;
+    return;
+  }
+  if (state_ != kPlanned) {
+    return;
+  }
+  for (auto& group : groups_) {
+    for (int member : group.members) {
+      auto* tensor = LocalTensor(scope, candidates_[member].name);
+      if (tensor == nullptr || tensor->Holder() != group.slice) {
+        VLOG(3) << "Variable " << candidates_[member].name
+                << " does not use the static memory plan";
+        if (++replan_num_ >= kMaxReplanNum) {
+          LOG(WARNING) << "Static memory plan is disabled after "
+                       << replan_num_ << " failed plans";
+          ClearCandidates(scope);
+          state_ = kDisabled;
+        } else {
+          state_ = kRecording;
+        }
+        return;
+      }
+    }
+  }
+}
+
+}  // namespace framework
+}  // namespace paddle
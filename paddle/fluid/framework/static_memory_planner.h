@@ -0,0 +1,137 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "paddle/fluid/framework/operator.h"
+#include "paddle/fluid/framework/scope.h"
+#include "paddle/fluid/memory/allocation/allocator.h"
+#include "paddle/fluid/platform/place.h"
+
+namespace paddle {
+namespace framework {
+
+/*
+ * StaticMemoryPlanner lays the intermediate tensors of a NaiveExecutor
+ * program out in one preallocated arena.
+ *
+ * The candidates are the variables local to the executor scope whose first
+ * access in the op sequence is a write, except the skipped ones (the feed
+ * and fetch targets). The lifetime of a candidate spans from its first
+ * write to its last access.
+ *
+ * The first run records the size every candidate tensor reaches and which
+ * candidates share their memory (reshape, in-place ops). The groups sharing
+ * a holder get one slice of the arena each, the groups with overlapping
+ * lifetimes never overlap in the arena. The slices are bound to the tensors
+ * before the next run, so mutable_data reuses them and the ops do not
+ * allocate. A group sharing memory with a variable which is not a candidate
+ * is left to the allocator.
+ *
+ * A planned run checks that every tensor still uses its slice. Otherwise
+ * (a larger batch, a different sequence length) the next run records and
+ * plans again, the planner gives up after kMaxReplanNum failed plans.
+ *
+ * The programs with control flow ops or MKLDNN kernels are not planned.
+ * The intermediate tensors are overwritten by the later ops of a planned
+ * run, only the skipped variables keep their values after the run.
+ */
+class StaticMemoryPlanner {
+ public:
+  static constexpr size_t kAlignment = 256;
+  static constexpr int kMaxReplanNum = 3;
+
+  StaticMemoryPlanner(const platform::Place& place,
+                      const std::vector<std::unique_ptr<OperatorBase>>& ops,
+                      const std::unordered_set<std::string>& skip_vars);
+
+  bool enabled() const { return state_ != kDisabled; }
+  // Whether the next run records the tensors.
+  bool recording() const { return state_ == kRecording; }
+
+  // Called before the ops of a run.
+  void PreRun(Scope* scope);
+  // Called after the op_idx-th op of a recording run.
+  void Record(size_t op_idx, Scope* scope);
+  // Called after the ops of a run, to plan after a recording run or to
+  // check a planned run.
+  void PostRun(Scope* scope);
+
+  size_t arena_size() const { return arena_ ? arena_->size() : 0; }
+  size_t planned_var_num() const;
+
+ private:
+  enum State { kRecording, kPlanned, kDisabled };
+
+  struct Candidate {
+    std::string name;
+    size_t def;
+    size_t last_use;
+    // recorded by a recording run
+    int parent;
+    size_t bytes;
+    proto::VarType::Type type;
+    // seen as a tensor on another place
+    bool excluded;
+    std::vector<const memory::Allocation*> holders;
+  };
+
+  struct Group {
+    std::vector<int> members;
+    size_t bytes;
+    size_t def;
+    size_t last_use;
+    size_t offset;
+    std::shared_ptr<memory::Allocation> slice;
+  };
+
+  LoDTensor* LocalTensor(Scope* scope, const std::string& name) const;
+  int Find(int idx);
+  void Union(int a, int b);
+  void ResetRecord();
+  void Plan(Scope* scope);
+  // Clear the candidate tensors, which releases their slices.
+  void ClearCandidates(Scope* scope);
+
+  const platform::Place place_;
+  State state_{kRecording};
+  int replan_num_{0};
+
+  const std::vector<std::unique_ptr<OperatorBase>>& ops_;
+  std::vector<Candidate> candidates_;
+  std::unordered_map<std::string, int> candidate_ids_;
+
+  struct HolderOwner {
+    // an address freed and allocated again is another holder
+    std::weak_ptr<memory::Allocation> holder;
+    int owner;
+  };
+
+  // the holders seen in a recording run, with the candidate seen first
+  std::unordered_map<const memory::Allocation*, HolderOwner> holder_owners_;
+  // the holders of the variables which are not candidates
+  std::unordered_set<const memory::Allocation*> foreign_holders_;
+
+  std::shared_ptr<memory::Allocation> arena_;
+  std::vector<Group> groups_;
+};
+
+}  // namespace framework
+}  // namespace paddle
@@ -14,6 +14,8 @@
 
 #include "paddle/fluid/framework/threadpool.h"
 
+#include <algorithm>
+
 #include "gflags/gflags.h"
 #include "paddle/fluid/platform/enforce.h"
 
@@ -46,11 +48,23 @@ void ThreadPool::Init() {
   }
 }
 
-ThreadPool::ThreadPool(int num_threads) : running_(true) {
+// The pool and the deque of the current thread, nullptr if the thread is
+// not a thread of a pool.
+static thread_local ThreadPool* current_pool = nullptr;
+static thread_local int current_index = -1;
+
+// The rounds a thread looks for a task before it sleeps.
+static constexpr int kSpinRounds = 64;
+
+ThreadPool::ThreadPool(int num_threads, const std::vector<int>& cores)
+    : cores_(cores), running_(true) {
+  PADDLE_ENFORCE_GT(num_threads, 0, platform::errors::InvalidArgument(
+                                        "The number of threads is 0."));
+  queues_.reset(new TaskQueue[num_threads]);
   threads_.resize(num_threads);
-  for (auto& thread : threads_) {
-    // TODO(Yancey1989): binding the thread on the specify CPU number
-    thread.reset(new std::thread(std::bind(&ThreadPool::TaskLoop, this)));
+  for (int i = 0; i < num_threads; ++i) {
+    threads_[i].reset(
+        new std::thread(std::bind(&ThreadPool::TaskLoop, this, i)));
   }
 }
 
@@ -68,30 +82,193 @@ ThreadPool::~ThreadPool() {
   }
 }
 
-void ThreadPool::TaskLoop() {
+void ThreadPool::Enqueue(Task task) {
+  if (!running_) {
+    PADDLE_THROW(platform::errors::Unavailable(
+        "Task is enqueued into stopped ThreadPool."));
+  }
+  size_t index = current_pool == this
+                     ? static_cast<size_t>(current_index)
+                     : next_queue_.fetch_add(1) % threads_.size();
+  auto& queue = queues_[index];
+  // counted before it is pushed, so that pending_ is never negative
+  pending_.fetch_add(1);
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+    queue.size.store(queue.tasks.size());
+  }
+  Notify(1);
+}
+
+void ThreadPool::EnqueueBatch(std::vector<Task>* tasks) {
+  if (tasks->empty()) {
+    return;
+  }
+  if (!running_) {
+    PADDLE_THROW(platform::errors::Unavailable(
+        "Task is enqueued into stopped ThreadPool."));
+  }
+  size_t num = tasks->size();
+  size_t queue_num = std::min(num, threads_.size());
+  size_t first = next_queue_.fetch_add(queue_num);
+  pending_.fetch_add(static_cast<int64_t>(num));
+  // the contiguous tasks go into one deque
+  size_t begin = 0;
+  for (size_t i = 0; i < queue_num; ++i) {
+    size_t end = begin + num / queue_num + (i < num % queue_num ? 1 : 0);
+    auto& queue = queues_[(first + i) % threads_.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    for (size_t j = begin; j < end; ++j) {
+      queue.tasks.push_back(std::move((*tasks)[j]));
+    }
+    queue.size.store(queue.tasks.size());
+    begin = end;
+  }
+  tasks->clear();
+  Notify(num);
+}
+
+void ThreadPool::Notify(size_t num) {
+  // A thread increases idle_ before it checks pending_ under mutex_, the
+  // lock makes sure it either sees the new tasks or is woken up.
+  if (idle_.load() == 0) {
+    return;
+  }
+  { std::lock_guard<std::mutex> lock(mutex_); }
+  if (num == 1) {
+    scheduled_.notify_one();
+  } else {
+    scheduled_.notify_all();
+  }
+}
+
+bool ThreadPool::Pop(int index, Task* task) {
+  int num = static_cast<int>(threads_.size());
+  for (int k = 0; k < num; ++k) {
+    auto& queue = queues_[(index + k) % num];
+    if (queue.size.load(std::memory_order_relaxed) == 0) {
+      continue;
+    }
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+      continue;
+    }
+    if (k == 0) {
+      *task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    } else {
+      *task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    }
+    queue.size.store(queue.tasks.size());
+    pending_.fetch_sub(1);
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::TaskLoop(int index) {
+  current_pool = this;
+  current_index = index;
+  if (!cores_.empty()) {
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cores_[index % cores_.size()], &mask);
+    pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+  }
+  Task task;
   while (true) {
-    Task task;
+    bool found = Pop(index, &task);
+    for (int i = 0; !found && i < kSpinRounds && pending_.load() > 0; ++i) {
+      std::this_thread::yield();
+      found = Pop(index, &task);
+    }
+    if (found) {
+      // run the task
+      task();
+      continue;
+    }
 
-    {
-      std::unique_lock<std::mutex> lock(mutex_);
-      scheduled_.wait(
-          lock, [this] { return !this->tasks_.empty() || !this->running_; });
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.fetch_add(1);
+    scheduled_.wait(
+        lock, [this] { return this->pending_.load() > 0 || !this->running_; });
+    idle_.fetch_sub(1);
+    if (!running_ && pending_.load() == 0) {
+      return;
+    }
+  }
+}
 
-      if (!running_ && tasks_.empty()) {
-        return;
-      }
+void ThreadPool::ParallelFor(int64_t begin, int64_t end, int64_t grain_size,
+                             const std::function<void(int64_t, int64_t)>& fn) {
+  if (begin >= end) {
+    return;
+  }
+  grain_size = std::max<int64_t>(grain_size, 1);
+  int64_t range = end - begin;
+  int64_t chunk_num = std::min<int64_t>(
+      (range + grain_size - 1) / grain_size,
+      static_cast<int64_t>(threads_.size()) * 4);
+  if (chunk_num <= 1) {
+    fn(begin, end);
+    return;
+  }
+  int64_t chunk_size = (range + chunk_num - 1) / chunk_num;
+  chunk_num = (range + chunk_size - 1) / chunk_size;
 
-      if (tasks_.empty()) {
-        PADDLE_THROW(platform::errors::Unavailable(
-            "Current thread has no task to Run."));
+  // The chunks are taken by the helper tasks and the calling thread, a
+  // helper which starts after all the chunks are taken does nothing, so
+  // that only the running chunks are waited for.
+  struct State {
+    std::atomic<int64_t> next{0};
+    std::atomic<int64_t> done{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable finished;
+  };
+  auto state = std::make_shared<State>();
+  const auto* func = &fn;
+  auto run_chunks = [state, func, begin, end, chunk_size, chunk_num]() {
+    int64_t chunk;
+    while ((chunk = state->next.fetch_add(1)) < chunk_num) {
+      if (!state->failed) {
+        int64_t chunk_begin = begin + chunk * chunk_size;
+        try {
+          (*func)(chunk_begin, std::min(end, chunk_begin + chunk_size));
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(state->mutex);
+          if (!state->failed) {
+            state->error = std::current_exception();
+            state->failed = true;
+          }
+        }
+      }
+      if (state->done.fetch_add(1) + 1 == chunk_num) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->finished.notify_all();
       }
-
-      // pop a task from the task queue
-      task = std::move(tasks_.front());
-      tasks_.pop();
     }
-    // run the task
-    task();
+  };
+
+  size_t helper_num =
+      std::min(threads_.size(), static_cast<size_t>(chunk_num - 1));
+  std::vector<Task> tasks;
+  tasks.reserve(helper_num);
+  for (size_t i = 0; i < helper_num; ++i) {
+    tasks.emplace_back(MakeTask(run_chunks));
+  }
+  EnqueueBatch(&tasks);
+  run_chunks();
+  {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(
+        lock, [&state, chunk_num] { return state->done == chunk_num; });
+  }
+  if (state->error) {
+    std::rethrow_exception(state->error);
   }
 }
 
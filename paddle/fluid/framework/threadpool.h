@@ -14,12 +14,14 @@ limitations under the License. */
 
 #pragma once
 
+#include <atomic>
 #include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <future>  // NOLINT
 #include <memory>
 #include <mutex>  // NOLINT
-#include <queue>
 #include <thread>  // NOLINT
 #include <utility>
 #include <vector>
@@ -48,11 +50,16 @@ struct ExceptionHandler {
   }
 };
 
-// ThreadPool maintains a queue of tasks, and runs them using a fixed
-// number of threads.
+// ThreadPool runs tasks using a fixed number of threads. Every thread owns
+// a deque of tasks, a task submitted by a thread of the pool is pushed into
+// the deque of the thread, the other tasks are spread over the deques round
+// robin. A thread runs the tasks of its deque in order, and steals the tasks
+// of the other deques when its deque is empty, so that fine-grained tasks do
+// not contend on one lock. A pool of one thread runs the tasks in order.
 class ThreadPool {
  public:
-  explicit ThreadPool(int num_threads);
+  // The thread i is pinned to cores[i % cores.size()] if cores is not empty.
+  explicit ThreadPool(int num_threads, const std::vector<int>& cores = {});
 
   using Task = std::packaged_task<std::unique_ptr<platform::EnforceNotMet>()>;
 
@@ -73,37 +80,39 @@ class ThreadPool {
   template <typename Callback>
   std::future<std::unique_ptr<platform::EnforceNotMet>> RunAndGetException(
       Callback fn) {
-    Task task([fn]() -> std::unique_ptr<platform::EnforceNotMet> {
-      try {
-        fn();
-      } catch (platform::EnforceNotMet& ex) {
-        CHECK(false) << "Unexpected exception is catched in thread pool: "
-                     << ex.what();
-        return std::unique_ptr<platform::EnforceNotMet>(
-            new platform::EnforceNotMet(ex));
-      } catch (const std::exception& e) {
-        CHECK(false) << "Unexpected exception is catched in thread pool: "
-                     << e.what();
-        PADDLE_THROW(platform::errors::Fatal(
-            "Unexpected exception is catched in thread pool. All "
-            "throwable exception in Paddle should be an EnforceNotMet."
-            "The exception is:\n %s.",
-            e.what()));
-      }
-      return nullptr;
-    });
+    Task task = MakeTask(fn);
     std::future<std::unique_ptr<platform::EnforceNotMet>> f = task.get_future();
-    {
-      std::unique_lock<std::mutex> lock(mutex_);
-      if (!running_) {
-        PADDLE_THROW(platform::errors::Unavailable(
-            "Task is enqueued into stopped ThreadPool."));
-      }
-      tasks_.push(std::move(task));
-    }
-    scheduled_.notify_one();
+    Enqueue(std::move(task));
     return f;
   }
+
+  // RunBatch pushes the tasks fn(0), ..., fn(num - 1) at once, it takes the
+  // lock of every deque once instead of once per task.
+  template <typename Callback>
+  std::vector<std::future<void>> RunBatch(size_t num, Callback fn) {
+    std::vector<Task> tasks;
+    std::vector<std::future<void>> fs;
+    tasks.reserve(num);
+    fs.reserve(num);
+    for (size_t i = 0; i < num; ++i) {
+      tasks.emplace_back(MakeTask([fn, i]() { fn(i); }));
+      fs.emplace_back(std::async(std::launch::deferred,
+                                 ExceptionHandler(tasks.back().get_future())));
+    }
+    EnqueueBatch(&tasks);
+    return fs;
+  }
+
+  // ParallelFor calls fn(chunk_begin, chunk_end) for the chunks of
+  // [begin, end), every chunk but the last one holds grain_size indices at
+  // least, and returns when all the chunks are done. The calling thread runs
+  // chunks too, so that a task of the pool may call ParallelFor. The first
+  // exception thrown by fn is rethrown.
+  void ParallelFor(int64_t begin, int64_t end, int64_t grain_size,
+                   const std::function<void(int64_t, int64_t)>& fn);
+
+  int num_threads() const { return static_cast<int>(threads_.size()); }
+
   // binding cpu cores
   void SetCPUAffinity(const std::vector<int>& cores, bool one_by_one = false) {
     if (cores.empty()) {
@@ -114,6 +123,7 @@ class ThreadPool {
     CPU_ZERO(&mask);
     if (one_by_one) {
       for (size_t i = 0; i < threads_.size(); ++i) {
+        CPU_ZERO(&mask);
         CPU_SET(cores[i % core_num], &mask);
         pthread_setaffinity_np(threads_[i]->native_handle(), sizeof(mask),
                                &mask);
@@ -129,13 +139,74 @@ class ThreadPool {
     }
     // VLOG(0) << "binding read ins thread_id = " << tid << ", cpunum = " <<
   }
+  // binding the thread i to the cores of thread_cores[i % size]
+  void SetCPUAffinity(const std::vector<std::vector<int>>& thread_cores) {
+    if (thread_cores.empty()) {
+      return;
+    }
+    for (size_t i = 0; i < threads_.size(); ++i) {
+      auto& cores = thread_cores[i % thread_cores.size()];
+      if (cores.empty()) {
+        continue;
+      }
+      cpu_set_t mask;
+      CPU_ZERO(&mask);
+      for (int core : cores) {
+        CPU_SET(core, &mask);
+      }
+      pthread_setaffinity_np(threads_[i]->native_handle(), sizeof(mask),
+                             &mask);
+    }
+  }
 
  private:
   DISABLE_COPY_AND_ASSIGN(ThreadPool);
 
+  // The tasks of a thread, the owner pops the front, the thieves pop the
+  // back.
+  struct TaskQueue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+    // the size of tasks, read without the lock to skip the empty deques
+    std::atomic<size_t> size{0};
+    // keeps the queues of two threads off one cache line, alignas is not
+    // honored by new before C++17
+    char padding[64];
+  };
+
+  template <typename Callback>
+  static Task MakeTask(Callback fn) {
+    return Task([fn]() -> std::unique_ptr<platform::EnforceNotMet> {
+      try {
+        fn();
+      } catch (platform::EnforceNotMet& ex) {
+        CHECK(false) << "Unexpected exception is catched in thread pool: "
+                     << ex.what();
+        return std::unique_ptr<platform::EnforceNotMet>(
+            new platform::EnforceNotMet(ex));
+      } catch (const std::exception& e) {
+        CHECK(false) << "Unexpected exception is catched in thread pool: "
+                     << e.what();
+        PADDLE_THROW(platform::errors::Fatal(
+            "Unexpected exception is catched in thread pool. All "
+            "throwable exception in Paddle should be an EnforceNotMet."
+            "The exception is:\n %s.",
+            e.what()));
+      }
+      return nullptr;
+    });
+  }
+
+  void Enqueue(Task task);
+  void EnqueueBatch(std::vector<Task>* tasks);
+  // Wake up the sleeping threads for num new tasks.
+  void Notify(size_t num);
+  // Pop a task of the deque index, or steal one from the other deques.
+  bool Pop(int index, Task* task);
+
   // The constructor starts threads to run TaskLoop, which retrieves
-  // and runs tasks from the queue.
-  void TaskLoop();
+  // and runs tasks from the deques.
+  void TaskLoop(int index);
 
   // Init is called by GetInstance.
   static void Init();
@@ -145,10 +216,16 @@ class ThreadPool {
   static std::once_flag init_flag_;
 
   std::vector<std::unique_ptr<std::thread>> threads_;
+  std::vector<int> cores_;
 
-  std::queue<Task> tasks_;
+  std::unique_ptr<TaskQueue[]> queues_;
+  // the tasks pushed and not popped yet
+  std::atomic<int64_t> pending_{0};
+  // the threads waiting for scheduled_
+  std::atomic<int> idle_{0};
+  std::atomic<size_t> next_queue_{0};
+  std::atomic<bool> running_;
   std::mutex mutex_;
-  bool running_;
   std::condition_variable scheduled_;
 };
 
@@ -171,6 +248,12 @@ std::future<void> Async(Callback callback) {
   return ThreadPool::GetInstance()->Run(callback);
 }
 
+// Run fn over [begin, end) by the singleton of ThreadPool.
+inline void ParallelFor(int64_t begin, int64_t end, int64_t grain_size,
+                        const std::function<void(int64_t, int64_t)>& fn) {
+  ThreadPool::GetInstance()->ParallelFor(begin, end, grain_size, fn);
+}
+
 template <typename Callback>
 std::future<void> AsyncIO(Callback callback) {
   return ThreadPoolIO::GetInstanceIO()->Run(callback);
@@ -14,6 +14,9 @@ limitations under the License. */
 
 #include <gtest/gtest.h>
 #include <atomic>
+#include <chrono>  // NOLINT
+#include <queue>
+#include <vector>
 
 #include "paddle/fluid/framework/threadpool.h"
 
@@ -59,3 +62,209 @@ TEST(ThreadPool, ConcurrentRun) {
   }
   EXPECT_EQ(sum, ((n + 1) * n) / 2);
 }
+
+TEST(ThreadPool, SingleThreadOrder) {
+  framework::ThreadPool pool(1);
+  std::vector<int> order;
+  std::vector<std::future<void>> fs;
+  for (int i = 0; i < 100; ++i) {
+    fs.push_back(pool.Run([&order, i]() { order.push_back(i); }));
+  }
+  for (auto& f : fs) {
+    f.wait();
+  }
+  ASSERT_EQ(order.size(), 100UL);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(order[i], i);
+  }
+}
+
+TEST(ThreadPool, RunBatch) {
+  framework::ThreadPool pool(4);
+  std::atomic<int> sum(0);
+  int n = 1000;
+  auto fs = pool.RunBatch(n, [&sum](size_t i) { sum.fetch_add(i + 1); });
+  ASSERT_EQ(fs.size(), static_cast<size_t>(n));
+  for (auto& f : fs) {
+    f.wait();
+  }
+  EXPECT_EQ(sum, ((n + 1) * n) / 2);
+}
+
+TEST(ThreadPool, ParallelFor) {
+  framework::ThreadPool pool(4);
+  std::vector<std::atomic<int>> hits(10007);
+  for (auto& hit : hits) {
+    hit = 0;
+  }
+  pool.ParallelFor(0, hits.size(), 16, [&hits](int64_t begin, int64_t end) {
+    EXPECT_LT(begin, end);
+    for (int64_t i = begin; i < end; ++i) {
+      hits[i].fetch_add(1);
+    }
+  });
+  for (auto& hit : hits) {
+    EXPECT_EQ(hit, 1);
+  }
+
+  // the tasks of the pool call ParallelFor on the same pool
+  std::atomic<int64_t> sum(0);
+  auto fs = pool.RunBatch(8, [&pool, &sum](size_t) {
+    pool.ParallelFor(0, 1000, 1, [&sum](int64_t begin, int64_t end) {
+      for (int64_t i = begin; i < end; ++i) {
+        sum.fetch_add(i);
+      }
+    });
+  });
+  for (auto& f : fs) {
+    f.wait();
+  }
+  EXPECT_EQ(sum, 8 * 999 * 1000 / 2);
+
+  EXPECT_THROW(pool.ParallelFor(0, 100, 1,
+                                [](int64_t begin, int64_t end) {
+                                  if (begin <= 50 && 50 < end) {
+                                    PADDLE_THROW(
+                                        paddle::platform::errors::Fatal(
+                                            "Fail on index 50."));
+                                  }
+                                }),
+               paddle::platform::EnforceNotMet);
+}
+
+// The pool of one locked queue which ThreadPool replaced, as the baseline
+// of the benchmark.
+class SingleQueuePool {
+ public:
+  explicit SingleQueuePool(int num_threads) {
+    for (int i = 0; i < num_threads; ++i) {
+      threads_.emplace_back([this]() {
+        while (true) {
+          framework::ThreadPool::Task task;
+          {
+            std::unique_lock<std::mutex> lock(mutex_);
+            scheduled_.wait(lock,
+                            [this] { return !tasks_.empty() || !running_; });
+            if (tasks_.empty()) {
+              return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop();
+          }
+          task();
+        }
+      });
+    }
+  }
+
+  ~SingleQueuePool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_ = false;
+    }
+    scheduled_.notify_all();
+    for (auto& t : threads_) {
+      t.join();
+    }
+  }
+
+  template <typename Callback>
+  std::future<void> Run(Callback fn) {
+    framework::ThreadPool::Task task(
+        [fn]() -> std::unique_ptr<paddle::platform::EnforceNotMet> {
+          fn();
+          return nullptr;
+        });
+    auto f = task.get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push(std::move(task));
+    }
+    scheduled_.notify_one();
+    return std::async(std::launch::deferred,
+                      framework::ExceptionHandler(std::move(f)));
+  }
+
+ private:
+  std::vector<std::thread> threads_;
+  std::queue<framework::ThreadPool::Task> tasks_;
+  std::mutex mutex_;
+  bool running_{true};
+  std::condition_variable scheduled_;
+};
+
+// Fine-grained tasks, as the per-shard merges, submitted by several
+// threads at once.
+template <typename Pool>
+double SubmitTasks(Pool* pool, int submit_threads, int tasks_per_thread) {
+  std::atomic<int64_t> sum(0);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < submit_threads; ++t) {
+    threads.emplace_back([pool, &sum, tasks_per_thread]() {
+      std::vector<std::future<void>> fs;
+      fs.reserve(tasks_per_thread);
+      for (int i = 0; i < tasks_per_thread; ++i) {
+        fs.push_back(pool->Run([&sum, i]() { sum.fetch_add(i); }));
+      }
+      for (auto& f : fs) {
+        f.wait();
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(sum, static_cast<int64_t>(submit_threads) * tasks_per_thread *
+                     (tasks_per_thread - 1) / 2);
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+// The unit tests run it at a smoke size, build WITH_BENCHMARK to measure.
+TEST(ThreadPool, Benchmark) {
+  const int num_threads = 8;
+  const int submit_threads = 4;
+#ifdef PADDLE_WITH_BENCHMARK
+  const int tasks_per_thread = 50000;
+#else
+  const int tasks_per_thread = 1000;
+#endif
+  const int total = submit_threads * tasks_per_thread;
+
+  double single_queue_sec = 0;
+  {
+    SingleQueuePool pool(num_threads);
+    single_queue_sec = SubmitTasks(&pool, submit_threads, tasks_per_thread);
+  }
+  framework::ThreadPool pool(num_threads);
+  double work_stealing_sec =
+      SubmitTasks(&pool, submit_threads, tasks_per_thread);
+
+  std::atomic<int64_t> sum(0);
+  auto start = std::chrono::steady_clock::now();
+  auto fs = pool.RunBatch(total, [&sum](size_t i) { sum.fetch_add(i); });
+  for (auto& f : fs) {
+    f.wait();
+  }
+  double batch_sec =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  start = std::chrono::steady_clock::now();
+  pool.ParallelFor(0, total, 1024, [&sum](int64_t begin, int64_t end) {
+    sum.fetch_add(end - begin);
+  });
+  double parallel_for_sec =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  LOG(INFO) << total << " tasks by " << num_threads
+            << " threads, single queue: " << single_queue_sec * 1e9 / total
+            << " ns per task, work stealing: "
+            << work_stealing_sec * 1e9 / total
+            << " ns per task, batched: " << batch_sec * 1e9 / total
+            << " ns per task, parallel for: "
+            << parallel_for_sec * 1e9 / total << " ns per index";
+}
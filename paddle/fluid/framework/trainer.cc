@@ -15,6 +15,9 @@ limitations under the License. */
 #include "paddle/fluid/framework/trainer.h"
 #include "io/fs.h"
 
+DECLARE_bool(enable_async_dump_field);
+DECLARE_bool(dump_field_binary_format);
+
 namespace paddle {
 namespace framework {
 
@@ -44,6 +47,11 @@ void TrainerBase::ParseDumpConfig(const TrainerDesc& desc) {
   }
 
   if (desc.dump_param_size() != 0) {
+    PADDLE_ENFORCE_EQ(
+        FLAGS_enable_async_dump_field && FLAGS_dump_field_binary_format, false,
+        platform::errors::InvalidArgument(
+            "Dump param is not supported with the binary dump field format, "
+            "please set FLAGS_dump_field_binary_format to false."));
     need_dump_param_ = true;
     dump_param_.resize(desc.dump_param_size());
     for (int i = 0; i < desc.dump_param_size(); ++i) {
@@ -52,6 +60,13 @@ void TrainerBase::ParseDumpConfig(const TrainerDesc& desc) {
   }
 }
 
+static void WriteDumpBuffer(const std::string& buffer, FILE* fp) {
+  size_t write_count = fwrite_unlocked(buffer.data(), 1, buffer.length(), fp);
+  if (write_count != buffer.length()) {
+    VLOG(3) << "dump text failed";
+  }
+}
+
 void TrainerBase::DumpWork(int tid) {
 #ifdef _LINUX
   int err_no = 0;
@@ -59,23 +74,76 @@ void TrainerBase::DumpWork(int tid) {
   std::string path = GetDumpPath(tid);
 
   std::shared_ptr<FILE> fp = fs_open_write(path, &err_no, dump_converter_);
-  while (1) {
-    std::string out_str;
-    if (!queue_->Get(out_str)) {
-      break;
-    }
-    out_str.append("\n");
-    size_t write_count =
-        fwrite_unlocked(out_str.data(), 1, out_str.length(), fp.get());
-    if (write_count != out_str.length()) {
-      VLOG(3) << "dump text failed";
-      continue;
+  // coalesce the dumped items so the file is written in large chunks
+  // instead of one fwrite per line
+  const size_t kDumpBufferSize = 4 * 1024 * 1024;
+  const size_t kDumpReadBatch = 256;
+  // binary blocks are self delimited, text items are lines. only the
+  // trainers that set up the field format channel write binary blocks, the
+  // others push text lines whatever the flags say
+  const bool binary =
+      field_queue_ != nullptr && FLAGS_dump_field_binary_format;
+  std::vector<std::string> items;
+  std::string buffer;
+  buffer.reserve(kDumpBufferSize);
+  while (queue_->ReadOnce(items, kDumpReadBatch) > 0) {
+    for (auto& item : items) {
+      buffer.append(item);
+      if (!binary) {
+        buffer.append("\n");
+      }
+      if (buffer.length() >= kDumpBufferSize) {
+        WriteDumpBuffer(buffer, fp.get());
+        buffer.clear();
+      }
     }
   }
+  if (!buffer.empty()) {
+    WriteDumpBuffer(buffer, fp.get());
+  }
 #endif
 }
 
+void TrainerBase::InitDumpFieldFormatEnv() {
+  if (!FLAGS_enable_async_dump_field || !need_dump_field_) {
+    return;
+  }
+  // bounded, so that slow dump threads throttle the workers instead of
+  // piling up field snapshots in host memory
+  const int kSnapshotsPerDumpThread = 8;
+  field_queue_ = MakeChannel<std::shared_ptr<DumpFieldBatch>>(
+      kSnapshotsPerDumpThread * dump_thread_num_);
+  for (int i = 0; i < dump_thread_num_; i++) {
+    format_thread_.push_back(
+        std::thread(std::bind(&TrainerBase::DumpFieldFormatWork, this, i)));
+  }
+  VLOG(0) << "init async dump field format thread num=" << dump_thread_num_
+          << ", binary=" << FLAGS_dump_field_binary_format;
+}
+
+void TrainerBase::DumpFieldFormatWork(int tid) {
+  std::shared_ptr<DumpFieldBatch> batch;
+  while (field_queue_->Get(batch)) {
+    batch->Wait();
+    std::string out;
+    FormatDumpFieldBatch(*batch, FLAGS_dump_field_binary_format, &out);
+    // release the pinned snapshot before blocking on the write queue
+    batch.reset();
+    if (!out.empty()) {
+      queue_->Put(std::move(out));
+    }
+  }
+}
+
 void TrainerBase::FinalizeDumpEnv() {
+  if (field_queue_ != nullptr) {
+    field_queue_->Close();
+    for (auto& th : format_thread_) {
+      th.join();
+    }
+    format_thread_.clear();
+    field_queue_.reset();
+  }
   queue_->Close();
   for (auto& th : dump_thread_) {
     th.join();
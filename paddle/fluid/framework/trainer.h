@@ -66,10 +66,14 @@ class TrainerBase {
   virtual Scope* GetWorkerScope(int thread_id) = 0;
   virtual void InitDumpEnv() = 0;
   virtual void DumpWork(int tid);
+  virtual void DumpFieldFormatWork(int tid);
 
  protected:
   virtual std::string GetDumpPath(int tid) = 0;
   virtual void ParseDumpConfig(const TrainerDesc& trainer_desc);
+  // start the threads formatting the field snapshots of the device workers,
+  // no-op unless FLAGS_enable_async_dump_field
+  virtual void InitDumpFieldFormatEnv();
   virtual void FinalizeDumpEnv();
 
   Scope* root_scope_;
@@ -88,6 +92,9 @@ class TrainerBase {
   int dump_thread_num_;
   std::vector<std::thread> dump_thread_;
   std::shared_ptr<paddle::framework::ChannelObject<std::string>> queue_;
+  std::shared_ptr<ChannelObject<std::shared_ptr<DumpFieldBatch>>>
+      field_queue_;
+  std::vector<std::thread> format_thread_;
 };
 
 // general trainer for async execution
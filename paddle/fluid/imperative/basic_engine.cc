@@ -31,6 +31,7 @@
 #include "paddle/fluid/platform/profiler.h"
 
 DECLARE_bool(sort_sum_gradient);
+DECLARE_bool(inplace_sum_gradient);
 
 namespace paddle {
 namespace imperative {
@@ -120,6 +121,8 @@ void BasicEngine::PrepareGradAccumulators(const OpBase& op) {
       if (!accumulator) {
         if (FLAGS_sort_sum_gradient) {
           accumulator.reset(new SortedGradientAccumulator(var.get()));
+        } else if (FLAGS_inplace_sum_gradient) {
+          accumulator.reset(new InplaceGradientAccumulator(var.get()));
         } else {
           accumulator.reset(new EagerGradientAccumulator(var.get()));
         }
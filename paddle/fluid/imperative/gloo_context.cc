@@ -0,0 +1,201 @@
+//   Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/imperative/gloo_context.h"
+
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+#include "paddle/fluid/framework/tensor_util.h"
+#include "paddle/fluid/string/split.h"
+#include "paddle/fluid/string/string_helper.h"
+
+namespace paddle {
+namespace imperative {
+#if defined(PADDLE_WITH_GLOO)
+void GLOOParallelContext::Init() {
+  auto gloo = framework::GlooWrapper::GetInstance();
+  if (!gloo->IsInitialized()) {
+    PADDLE_ENFORCE_GT(strategy_.trainer_endpoints_.size(), 0UL,
+                      platform::errors::InvalidArgument(
+                          "The trainer endpoints should not be empty."));
+    auto addr = paddle::string::Split(strategy_.trainer_endpoints_[0], ':');
+    PADDLE_ENFORCE_EQ(
+        addr.size(), 2UL,
+        platform::errors::InvalidArgument(
+            "The endpoint should contain host and port, but got %s.",
+            strategy_.trainer_endpoints_[0]));
+    gloo->SetRank(strategy_.local_rank_);
+    gloo->SetSize(strategy_.nranks_);
+    gloo->SetHttpStore(addr[0], std::stoi(addr[1]), "worker");
+    gloo->Init();
+  }
+  PADDLE_ENFORCE_EQ(
+      gloo->Size(), strategy_.nranks_,
+      platform::errors::PreconditionNotMet(
+          "The gloo has %d ranks, but the parallel strategy has %d ranks.",
+          gloo->Size(), strategy_.nranks_));
+  PADDLE_ENFORCE_EQ(
+      gloo->Rank(), strategy_.local_rank_,
+      platform::errors::PreconditionNotMet(
+          "The gloo rank is %d, but the local rank of the parallel strategy "
+          "is %d.",
+          gloo->Rank(), strategy_.local_rank_));
+  VLOG(3) << "init gloo parallel context, rank " << gloo->Rank() << " of "
+          << gloo->Size();
+}
+
+void GLOOParallelContext::AllReduce(const framework::Tensor &src,
+                                    framework::Tensor *dst) {
+  PADDLE_ENFORCE_EQ(
+      platform::is_cpu_place(src.place()), true,
+      platform::errors::Unimplemented(
+          "GLOOParallelContext only supports the tensors on CPUPlace."));
+  if (&src != dst) {
+    framework::TensorCopySync(src, src.place(), dst);
+  }
+  auto gloo = framework::GlooWrapper::GetInstance();
+  auto place = dst->place();
+  size_t numel = static_cast<size_t>(dst->numel());
+  switch (dst->type()) {
+    case framework::proto::VarType::FP32:
+      gloo->AllReduce(dst->mutable_data<float>(place), numel);
+      break;
+    case framework::proto::VarType::FP64:
+      gloo->AllReduce(dst->mutable_data<double>(place), numel);
+      break;
+    case framework::proto::VarType::INT32:
+      gloo->AllReduce(dst->mutable_data<int>(place), numel);
+      break;
+    case framework::proto::VarType::INT64:
+      gloo->AllReduce(dst->mutable_data<int64_t>(place), numel);
+      break;
+    default:
+      PADDLE_THROW(platform::errors::Unimplemented(
+          "Data type (%s) is not supported when it allreduces tensors by "
+          "gloo.",
+          framework::DataTypeToString(dst->type())));
+  }
+}
+
+// The rows and the values of every rank are broadcast into their slices of
+// dst in the rank order, the same as the SelectedRows allreduce of nccl.
+void GLOOParallelContext::AllReduce(const framework::SelectedRows &src,
+                                    framework::SelectedRows *dst) {
+  VLOG(3) << "SelectedRows AllReduce start";
+  const auto &src_tensor = src.value();
+  const auto &place = src_tensor.place();
+  PADDLE_ENFORCE_EQ(
+      platform::is_cpu_place(place), true,
+      platform::errors::Unimplemented(
+          "GLOOParallelContext only supports the tensors on CPUPlace."));
+  auto gloo = framework::GlooWrapper::GetInstance();
+  auto dtype = src_tensor.type();
+
+  // 1. Gather the rows number of all the ranks
+  const auto &src_rows = src.rows();
+  int64_t local_rows_num = static_cast<int64_t>(src_rows.size());
+  auto rows_num_vector = gloo->AllGather(local_rows_num);
+  auto rows_num =
+      std::accumulate(rows_num_vector.begin(), rows_num_vector.end(),
+                      static_cast<int64_t>(0));
+  dst->set_height(src.height());
+
+  VLOG(3) << "Gather rows: " << string::join_strings(rows_num_vector, ',')
+          << ", total rows number: " << rows_num
+          << ", height: " << src.height();
+
+  auto *dst_rows = dst->mutable_rows();
+  dst_rows->resize(rows_num);
+  auto *dst_tensor = dst->mutable_value();
+  auto dims = src_tensor.dims();
+  auto feature_size =
+      framework::product(framework::slice_ddim(dims, 1, dims.size()));
+  dims[0] = rows_num;
+  dst_tensor->Resize(dims);
+  auto *dst_tensor_ptr =
+      reinterpret_cast<uint8_t *>(dst_tensor->mutable_data(place, dtype));
+  auto sizeof_dtype = framework::SizeOfType(dtype);
+  size_t row_bytes = feature_size * sizeof_dtype;
+
+  // 2. Broadcast the rows and the tensor data of every rank
+  int64_t row_offset = 0;
+  for (int i = 0; i < static_cast<int>(rows_num_vector.size()); ++i) {
+    int64_t rows_num_i = rows_num_vector[i];
+    if (rows_num_i == 0) {
+      continue;
+    }
+    int64_t *dst_rows_ptr = dst_rows->data() + row_offset;
+    uint8_t *dst_tensor_ptr_i = dst_tensor_ptr + row_offset * row_bytes;
+    if (i == gloo->Rank()) {
+      std::memcpy(dst_rows_ptr, src_rows.data(),
+                  rows_num_i * sizeof(int64_t));
+      std::memcpy(dst_tensor_ptr_i, src_tensor.data<void>(),
+                  rows_num_i * row_bytes);
+    }
+    gloo->Broadcast(dst_rows_ptr, rows_num_i, i);
+    gloo->Broadcast(dst_tensor_ptr_i, rows_num_i * row_bytes, i);
+    row_offset += rows_num_i;
+  }
+
+  VLOG(3) << "Original SelectedRows rows: "
+          << string::join_strings(src_rows, ',');
+  VLOG(3) << "Result SelectedRows rows: "
+          << string::join_strings(*dst_rows, ',');
+}
+
+void GLOOParallelContext::AllReduceByStream(const framework::Variable &src,
+                                            framework::Variable *dst,
+                                            int ring_id, bool use_calc_stream) {
+  if (src.IsType<framework::LoDTensor>()) {
+    if (!dst->IsType<framework::LoDTensor>()) {
+      dst->Clear();
+    }
+    AllReduce(src.Get<framework::LoDTensor>(),
+              dst->GetMutable<framework::LoDTensor>());
+  } else if (src.IsType<framework::SelectedRows>()) {
+    if (&src != dst) {
+      if (!dst->IsType<framework::SelectedRows>()) {
+        dst->Clear();
+      }
+      AllReduce(src.Get<framework::SelectedRows>(),
+                dst->GetMutable<framework::SelectedRows>());
+    } else {
+      // SelectedRows cannot be allreduce in-place
+      framework::Variable tmp_dst;
+      AllReduce(src.Get<framework::SelectedRows>(),
+                tmp_dst.GetMutable<framework::SelectedRows>());
+      *dst = std::move(tmp_dst);
+    }
+  } else {
+    PADDLE_THROW(platform::errors::InvalidArgument(
+        "Unsupported variable type %s for imperative allreduce, only "
+        "LoDTensor and SelectedRows are supported.",
+        platform::demangle(framework::ToTypeName(src.Type()))));
+  }
+}
+
+#if defined(PADDLE_WITH_NCCL)
+paddle::platform::CUDADeviceContext *GLOOParallelContext::GetDeviceContext(
+    int ring_id) {
+  PADDLE_THROW(platform::errors::Unimplemented(
+      "GLOOParallelContext has no CUDADeviceContext, the collectives of "
+      "gloo run on CPUPlace."));
+}
+#endif
+#endif
+
+}  //  namespace imperative
+}  //  namespace paddle
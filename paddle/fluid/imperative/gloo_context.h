@@ -0,0 +1,61 @@
+//   Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <string>
+
+#include "paddle/fluid/framework/fleet/gloo_wrapper.h"
+#include "paddle/fluid/framework/lod_tensor.h"
+#include "paddle/fluid/framework/selected_rows.h"
+#include "paddle/fluid/framework/variable.h"
+#include "paddle/fluid/imperative/nccl_context.h"
+
+namespace paddle {
+namespace imperative {
+
+#if defined(PADDLE_WITH_GLOO)
+// The ParallelContext of the CPU places, the collectives run on the
+// GlooWrapper singleton. If the GlooWrapper has been initialized, e.g. by
+// fleet, Init reuses it, otherwise the ranks rendezvous through the http
+// store served at the first trainer endpoint.
+class GLOOParallelContext : public ParallelContext {
+ public:
+  explicit GLOOParallelContext(const ParallelStrategy& strategy,
+                               const platform::Place& place)
+      : ParallelContext(strategy, place) {}
+
+  ~GLOOParallelContext() {}
+
+  void Init() override;
+
+  // The collectives of gloo are synchronous, ring_id and use_calc_stream
+  // are ignored.
+  void AllReduceByStream(const framework::Variable& src,
+                         framework::Variable* dst, int ring_id,
+                         bool use_calc_stream) override;
+
+#if defined(PADDLE_WITH_NCCL)
+  paddle::platform::CUDADeviceContext* GetDeviceContext(int ring_id) override;
+#endif
+
+ protected:
+  void AllReduce(const framework::Tensor& src, framework::Tensor* dst);
+
+  void AllReduce(const framework::SelectedRows& src,
+                 framework::SelectedRows* dst);
+};
+#endif
+
+}  //  namespace imperative
+}  //  namespace paddle
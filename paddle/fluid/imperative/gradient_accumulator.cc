@@ -14,13 +14,18 @@
 
 #include "paddle/fluid/imperative/gradient_accumulator.h"
 
+#include <Eigen/Dense>
 #include <algorithm>
+#include <cstring>
+#include <future>  // NOLINT
 #include <memory>
 #include <utility>
 
+#include "gflags/gflags.h"
 #include "paddle/fluid/framework/framework.pb.h"
 #include "paddle/fluid/framework/lod_tensor.h"
 #include "paddle/fluid/framework/selected_rows.h"
+#include "paddle/fluid/framework/threadpool.h"
 #include "paddle/fluid/imperative/layer.h"
 #include "paddle/fluid/operators/math/blas.h"
 #include "paddle/fluid/operators/math/math_function.h"
@@ -29,9 +34,179 @@
 #include "paddle/fluid/platform/float16.h"
 #include "paddle/fluid/platform/profiler.h"
 
+DECLARE_int32(inner_op_parallelism);
+DECLARE_double(sparse_gradient_dense_ratio);
+
 namespace paddle {
 namespace imperative {
 
+// A thread of the parallel adds takes at least this number of elements.
+static constexpr int64_t kMinNumelPerThread = 64 * 1024;
+
+// The number of threads to process numel elements, at most
+// FLAGS_inner_op_parallelism.
+static int64_t ParallelThreadNum(int64_t numel) {
+  if (FLAGS_inner_op_parallelism <= 1) {
+    return 1;
+  }
+  return std::max<int64_t>(
+      1, std::min<int64_t>(FLAGS_inner_op_parallelism,
+                           numel / kMinNumelPerThread));
+}
+
+// Run func(thread_id) for every thread id in [0, thread_num), the thread 0
+// runs in the caller.
+template <typename Func>
+static void RunParallel(int64_t thread_num, const Func& func) {
+  std::vector<std::future<void>> fs;
+  for (int64_t i = 1; i < thread_num; ++i) {
+    fs.push_back(framework::Async([&func, i] { func(i); }));
+  }
+  func(0);
+  for (auto& f : fs) {
+    f.wait();
+  }
+}
+
+// y += x with the SIMD packets of Eigen, split into the ranges of threads.
+template <typename T>
+static void ParallelAddTo(int64_t numel, const T* x, T* y) {
+  using Array = Eigen::Array<T, Eigen::Dynamic, 1>;
+  int64_t thread_num = ParallelThreadNum(numel);
+  // a range starts at a cache line mostly
+  constexpr int64_t kAlign = 64;
+  int64_t chunk = (numel + thread_num - 1) / thread_num;
+  chunk = (chunk + kAlign - 1) / kAlign * kAlign;
+  RunParallel(thread_num, [=](int64_t i) {
+    int64_t begin = std::min(numel, i * chunk);
+    int64_t end = std::min(numel, begin + chunk);
+    if (begin < end) {
+      Eigen::Map<Array>(y + begin, end - begin) +=
+          Eigen::Map<const Array>(x + begin, end - begin);
+    }
+  });
+}
+
+// Add the rows of src to the rows dst_index of dst, or copy them where
+// assign is set. The rows are split into the threads by the destination,
+// so the duplicated rows of src are added by the same thread in order.
+template <typename T>
+static void ParallelAddRows(const T* src, int64_t width,
+                            const std::vector<int64_t>& dst_index,
+                            const std::vector<bool>& assign, T* dst) {
+  using Array = Eigen::Array<T, Eigen::Dynamic, 1>;
+  int64_t rows = static_cast<int64_t>(dst_index.size());
+  int64_t thread_num = ParallelThreadNum(rows * width);
+  RunParallel(thread_num, [&](int64_t thread_id) {
+    for (int64_t i = 0; i < rows; ++i) {
+      if (dst_index[i] % thread_num != thread_id) {
+        continue;
+      }
+      Eigen::Map<Array> dst_row(dst + dst_index[i] * width, width);
+      Eigen::Map<const Array> src_row(src + i * width, width);
+      if (assign.empty() || !assign[i]) {
+        dst_row += src_row;
+      } else {
+        dst_row = src_row;
+      }
+    }
+  });
+}
+
+static int64_t RowWidth(const framework::Tensor& value) {
+  const auto& dims = value.dims();
+  return framework::product(framework::slice_ddim(dims, 1, dims.size()));
+}
+
+// Resize the value of a SelectedRows to rows, the old rows are kept. The
+// capacity grows twice at least, so that appending the rows is amortized.
+template <typename T>
+static T* ResizeRows(framework::Tensor* value, framework::DDim dims,
+                     int64_t old_rows, int64_t rows,
+                     const platform::Place& place) {
+  int64_t width = framework::product(framework::slice_ddim(dims, 1,
+                                                           dims.size()));
+  dims[0] = rows;
+  if (value->memory_size() >= rows * width * sizeof(T)) {
+    return value->Resize(dims).mutable_data<T>(place);
+  }
+  auto capacity_dims = dims;
+  capacity_dims[0] = std::max(rows, 2 * old_rows);
+  framework::Tensor grown;
+  T* data = grown.Resize(capacity_dims).mutable_data<T>(place);
+  if (old_rows > 0) {
+    std::memcpy(data, value->data<T>(), old_rows * width * sizeof(T));
+  }
+  value->ShareDataWith(grown.Resize(dims));
+  return data;
+}
+
+// Merge the rows of src into dst in place, row_index maps a row of dst to
+// its index in the value of dst, the rows of dst are unique.
+template <typename T>
+static void MergeRowsInPlace(
+    const framework::SelectedRows& src, framework::SelectedRows* dst,
+    std::unordered_map<int64_t, int64_t>* row_index) {
+  const auto& src_rows = src.rows();
+  const auto& src_value = src.value();
+  auto* dst_rows = dst->mutable_rows();
+  int64_t old_rows = static_cast<int64_t>(dst_rows->size());
+  PADDLE_ENFORCE_EQ(
+      old_rows, static_cast<int64_t>(row_index->size()),
+      platform::errors::PreconditionNotMet(
+          "The rows of the SelectedRows to merge into should be unique."));
+
+  std::vector<int64_t> dst_index(src_rows.size());
+  std::vector<bool> assign(src_rows.size(), false);
+  for (size_t i = 0; i < src_rows.size(); ++i) {
+    PADDLE_ENFORCE_EQ(
+        src_rows[i] >= 0 && src_rows[i] < dst->height(), true,
+        platform::errors::InvalidArgument(
+            "The row %d of SelectedRows is out of the height %d.",
+            src_rows[i], dst->height()));
+    auto it = row_index->emplace(src_rows[i], dst_rows->size());
+    if (it.second) {
+      dst_rows->push_back(src_rows[i]);
+      assign[i] = true;
+    }
+    dst_index[i] = it.first->second;
+  }
+  T* dst_data =
+      ResizeRows<T>(dst->mutable_value(), src_value.dims(), old_rows,
+                    static_cast<int64_t>(dst_rows->size()), src_value.place());
+  ParallelAddRows(src_value.data<T>(), RowWidth(src_value), dst_index, assign,
+                  dst_data);
+}
+
+// Add the rows of src to the dense tensor dst in place.
+template <typename T>
+static void AddRowsToTensor(const framework::SelectedRows& src,
+                            framework::Tensor* dst) {
+  const auto& src_rows = src.rows();
+  int64_t height = dst->dims()[0];
+  std::vector<int64_t> dst_index(src_rows.begin(), src_rows.end());
+  for (auto row : dst_index) {
+    PADDLE_ENFORCE_EQ(
+        row >= 0 && row < height, true,
+        platform::errors::InvalidArgument(
+            "The row %d of SelectedRows is out of the height %d.", row,
+            height));
+  }
+  ParallelAddRows(src.value().data<T>(), RowWidth(src.value()), dst_index,
+                  std::vector<bool>(), dst->mutable_data<T>(dst->place()));
+}
+
+// Convert src into a dense tensor of the height of src.
+template <typename T>
+static void SelectedRowsToTensor(const framework::SelectedRows& src,
+                                 framework::Tensor* dst) {
+  auto dims = src.value().dims();
+  dims[0] = src.height();
+  T* data = dst->Resize(dims).mutable_data<T>(src.value().place());
+  std::memset(data, 0, dst->numel() * sizeof(T));
+  AddRowsToTensor<T>(src, dst);
+}
+
 static void MoveOrCopyVar(framework::Variable* dst, framework::Variable* src,
                           bool force_copy) {
   if (!force_copy) {
@@ -73,6 +248,10 @@ class TensorAddFunctor : public boost::static_visitor<> {
       : numel_(numel), x_(x), y_(y) {}
 
   void operator()(const platform::CPUPlace& place) {
+    if (ParallelThreadNum(numel_) > 1) {
+      ParallelAddTo(numel_, x_, y_);
+      return;
+    }
     platform::CPUDeviceContext* ctx = dynamic_cast<platform::CPUDeviceContext*>(
         platform::DeviceContextPool::Instance().Get(place));
     auto blas = operators::math::GetBlas<platform::CPUDeviceContext, T>(*ctx);
@@ -363,6 +542,29 @@ static platform::Place GetPlaceOfVar(
   return place;
 }
 
+// The gradient of a stop gradient var is zero, of the dims of var.
+static void SetStopGradientZero(const std::shared_ptr<VariableWrapper>& var,
+                                VariableWrapper* dst_var,
+                                const platform::Place& place) {
+  if (!dst_var->Var().IsInitialized() ||
+      !dst_var->Var().Get<framework::LoDTensor>().IsInitialized()) {
+    VLOG(6) << "Set StopGradient Grad: " << dst_var->Name() << " as zero ";
+    auto* dev_ctx = platform::DeviceContextPool::Instance().Get(place);
+    if (!dst_var->Var().IsInitialized()) {
+      auto* tensor = dst_var->MutableVar()->GetMutable<framework::LoDTensor>();
+      VLOG(6) << "Dims of " << dst_var->Name() << " is set as: "
+              << var->Var().Get<framework::LoDTensor>().dims();
+      tensor->Resize(var->Var().Get<framework::LoDTensor>().dims());
+      tensor->mutable_data(place, var->DataType());
+      operators::math::set_constant(*dev_ctx, tensor, 0.0);
+    } else {
+      auto* tensor = dst_var->MutableVar()->GetMutable<framework::LoDTensor>();
+      tensor->mutable_data(place, var->DataType());
+      operators::math::set_constant(*dev_ctx, tensor, 0.0);
+    }
+  }
+}
+
 void GradientAccumulator::AccumulateGrad() {
   /**
    * If the gradient has been calculated by previous graph,
@@ -433,25 +635,7 @@ void EagerGradientAccumulator::SumGrad(std::shared_ptr<VariableWrapper> var,
       VariableWrapperAdd(var, dst_var, unchange_input);
     }
   } else {
-    if (!dst_var->Var().IsInitialized() ||
-        !dst_var->Var().Get<framework::LoDTensor>().IsInitialized()) {
-      VLOG(6) << "Set StopGradient Grad: " << dst_var->Name() << " as zero ";
-      auto* dev_ctx = platform::DeviceContextPool::Instance().Get(place);
-      if (!dst_var->Var().IsInitialized()) {
-        auto* tensor =
-            dst_var->MutableVar()->GetMutable<framework::LoDTensor>();
-        VLOG(6) << "Dims of " << dst_var->Name() << " is set as: "
-                << var->Var().Get<framework::LoDTensor>().dims();
-        tensor->Resize(var->Var().Get<framework::LoDTensor>().dims());
-        tensor->mutable_data(place, var->DataType());
-        operators::math::set_constant(*dev_ctx, tensor, 0.0);
-      } else {
-        auto* tensor =
-            dst_var->MutableVar()->GetMutable<framework::LoDTensor>();
-        tensor->mutable_data(place, var->DataType());
-        operators::math::set_constant(*dev_ctx, tensor, 0.0);
-      }
-    }
+    SetStopGradientZero(var, dst_var, place);
   }
 
   // Type may be changed after OP run, such as VarTypeInference
@@ -565,25 +749,7 @@ void SortedGradientAccumulator::SumGrad(std::shared_ptr<VariableWrapper> var,
       tmp_grad_vars_.clear();
     }
   } else {
-    if (!dst_var->Var().IsInitialized() ||
-        !dst_var->Var().Get<framework::LoDTensor>().IsInitialized()) {
-      VLOG(6) << "Set StopGradient Grad: " << var->Name() << " as zero";
-      auto* dev_ctx = platform::DeviceContextPool::Instance().Get(place);
-      if (!dst_var->Var().IsInitialized()) {
-        auto* tensor =
-            dst_var->MutableVar()->GetMutable<framework::LoDTensor>();
-        VLOG(6) << "Dims of " << dst_var->Name() << " is set as: "
-                << var->Var().Get<framework::LoDTensor>().dims();
-        tensor->Resize(var->Var().Get<framework::LoDTensor>().dims());
-        tensor->mutable_data(place, var->DataType());
-        operators::math::set_constant(*dev_ctx, tensor, 0.0);
-      } else {
-        auto* tensor =
-            dst_var->MutableVar()->GetMutable<framework::LoDTensor>();
-        tensor->mutable_data(place, var->DataType());
-        operators::math::set_constant(*dev_ctx, tensor, 0.0);
-      }
-    }
+    SetStopGradientZero(var, dst_var, place);
     // looks like tmp_grad_vars will not have any member but just in case
     tmp_grad_vars_.clear();
   }
@@ -595,5 +761,105 @@ void SortedGradientAccumulator::SumGrad(std::shared_ptr<VariableWrapper> var,
   }
 }
 
+template <typename T>
+void InplaceGradientAccumulator::MaybeToDense(framework::Variable* dst) {
+  auto& dst_selected_rows = dst->Get<framework::SelectedRows>();
+  int64_t height = dst_selected_rows.height();
+  if (height <= 0 ||
+      static_cast<double>(row_index_.size()) <
+          FLAGS_sparse_gradient_dense_ratio * height) {
+    return;
+  }
+  VLOG(6) << "Convert the gradient of " << row_index_.size() << " rows in "
+          << height << " into LoDTensor";
+  framework::Variable new_dst;
+  SelectedRowsToTensor<T>(dst_selected_rows,
+                          new_dst.GetMutable<framework::LoDTensor>());
+  *dst = std::move(new_dst);
+  row_index_.clear();
+}
+
+template <typename T>
+void InplaceGradientAccumulator::InplaceSumGrad(
+    const std::shared_ptr<VariableWrapper>& var, VariableWrapper* dst_var,
+    bool unchange_input) {
+  auto* src = var->MutableVar();
+  auto* dst = dst_var->MutableVar();
+  if (CurCnt() == 0) {
+    if (src->IsType<framework::LoDTensor>()) {
+      MoveOrCopyVar(dst, src, unchange_input);
+      return;
+    }
+    // merge the duplicated rows, so that the rows of dst are unique
+    auto& src_selected_rows = src->Get<framework::SelectedRows>();
+    dst->Clear();
+    row_index_.clear();
+    auto* dst_selected_rows = dst->GetMutable<framework::SelectedRows>();
+    dst_selected_rows->set_height(src_selected_rows.height());
+    MergeRowsInPlace<T>(src_selected_rows, dst_selected_rows, &row_index_);
+    MaybeToDense<T>(dst);
+    return;
+  }
+
+  if (dst->IsType<framework::LoDTensor>()) {
+    if (src->IsType<framework::LoDTensor>()) {
+      TensorAdd(*src, dst);
+    } else {
+      AddRowsToTensor<T>(src->Get<framework::SelectedRows>(),
+                         dst->GetMutable<framework::LoDTensor>());
+    }
+  } else if (src->IsType<framework::LoDTensor>()) {
+    framework::Variable new_dst;
+    MoveOrCopyVar(&new_dst, src, unchange_input);
+    AddRowsToTensor<T>(dst->Get<framework::SelectedRows>(),
+                       new_dst.GetMutable<framework::LoDTensor>());
+    *dst = std::move(new_dst);
+    row_index_.clear();
+  } else {
+    MergeRowsInPlace<T>(src->Get<framework::SelectedRows>(),
+                        dst->GetMutable<framework::SelectedRows>(),
+                        &row_index_);
+    MaybeToDense<T>(dst);
+  }
+}
+
+void InplaceGradientAccumulator::SumGrad(std::shared_ptr<VariableWrapper> var,
+                                         size_t trace_id,
+                                         bool unchange_input) {
+  if (var->HasGradNode()) {
+    unchange_input = true;
+  }
+
+  auto* dst_var = Var();
+  platform::Place place = GetPlaceOfVar(var);
+  if (!dst_var->OverridedStopGradient()) {
+    const auto& src = var->Var();
+    auto data_type =
+        src.IsType<framework::LoDTensor>()
+            ? src.Get<framework::LoDTensor>().type()
+            : src.Get<framework::SelectedRows>().value().type();
+    bool is_cpu = platform::is_cpu_place(place);
+    if (is_cpu && data_type == framework::proto::VarType::FP32) {
+      InplaceSumGrad<float>(var, dst_var, unchange_input);
+    } else if (is_cpu && data_type == framework::proto::VarType::FP64) {
+      InplaceSumGrad<double>(var, dst_var, unchange_input);
+    } else if (CurCnt() == 0) {
+      MoveOrCopyVar(dst_var->MutableVar(), var->MutableVar(), unchange_input);
+    } else {
+      VariableWrapperAdd(var, dst_var, unchange_input);
+    }
+  } else {
+    SetStopGradientZero(var, dst_var, place);
+  }
+
+  if (dst_var->Var().IsType<framework::LoDTensor>()) {
+    dst_var->SetType(framework::proto::VarType::LOD_TENSOR);
+  } else if (dst_var->Var().IsType<framework::SelectedRows>()) {
+    dst_var->SetType(framework::proto::VarType::SELECTED_ROWS);
+  }
+
+  IncreaseCurCnt();
+}
+
 }  // namespace imperative
 }  // namespace paddle
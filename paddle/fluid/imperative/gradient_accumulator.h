@@ -15,6 +15,7 @@
 #pragma once
 
 #include <memory>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -170,5 +171,31 @@ class SortedGradientAccumulator : public GradientAccumulator {
   std::vector<SavedVarInfo> tmp_grad_vars_;
 };
 
+// Sum the gradients on CPUPlace in place. A LoDTensor gradient is added to
+// the destination by the parallel adds, and the SelectedRows gradients are
+// merged into a SelectedRows of unique rows through the hash index of its
+// rows, which turns into a LoDTensor once the rows cover
+// FLAGS_sparse_gradient_dense_ratio of the height. The gradients on the
+// other places are summed as EagerGradientAccumulator does.
+class InplaceGradientAccumulator : public GradientAccumulator {
+ public:
+  using GradientAccumulator::GradientAccumulator;
+
+  void SumGrad(std::shared_ptr<VariableWrapper> var, size_t trace_id,
+               bool unchange_input) override;
+
+ private:
+  template <typename T>
+  void InplaceSumGrad(const std::shared_ptr<VariableWrapper>& var,
+                      VariableWrapper* dst_var, bool unchange_input);
+
+  // Turn the SelectedRows destination into a LoDTensor when it is dense.
+  template <typename T>
+  void MaybeToDense(framework::Variable* dst);
+
+  // The index of a row in the value of the SelectedRows destination.
+  std::unordered_map<int64_t, int64_t> row_index_;
+};
+
 }  // namespace imperative
 }  // namespace paddle
@@ -335,7 +335,8 @@ static void OpBaseRunImpl(const framework::OperatorBase& op,
                           const NameVarMap<VarType>& ins,
                           const NameVarMap<VarType>& outs,
                           const framework::AttributeMap& attrs,
-                          const platform::Place& place) {
+                          const platform::Place& place,
+                          std::unique_ptr<PreparedOp>* cached_op = nullptr) {
   auto* op_kernel = dynamic_cast<const framework::OperatorWithKernel*>(&op);
   PADDLE_ENFORCE_NOT_NULL(
       op_kernel, platform::errors::PermissionDenied(
@@ -356,9 +357,18 @@ static void OpBaseRunImpl(const framework::OperatorBase& op,
   }
 
   VLOG(5) << LayerDebugString(op.Type(), ins, outs);
-  auto prepared_op = PreparedOp::Prepare(ins, outs, *op_kernel, place, attrs);
-
-  prepared_op.Run(ins, outs, attrs);
+  if (cached_op == nullptr) {
+    auto prepared_op =
+        PreparedOp::Prepare(ins, outs, *op_kernel, place, attrs);
+    prepared_op.Run(ins, outs, attrs);
+  } else if (*cached_op) {
+    (*cached_op)->PrepareInputs(ins);
+    (*cached_op)->Run(ins, outs, attrs);
+  } else {
+    cached_op->reset(new PreparedOp(
+        PreparedOp::Prepare(ins, outs, *op_kernel, place, attrs)));
+    (*cached_op)->Run(ins, outs, attrs);
+  }
 
   VLOG(4) << LayerDebugString(op.Type(), ins, outs);
 }
@@ -379,6 +389,15 @@ void OpBase::Run(const framework::OperatorBase& op,
   OpBaseRunImpl<VariableWrapper>(op, ins, outs, attrs, place);
 }
 
+void OpBase::Run(const framework::OperatorBase& op,
+                 const NameVarMap<VarBase>& ins,
+                 const NameVarMap<VarBase>& outs,
+                 const framework::AttributeMap& attrs,
+                 const platform::Place& place,
+                 std::unique_ptr<PreparedOp>* prepared_op) {
+  OpBaseRunImpl<VarBase>(op, ins, outs, attrs, place, prepared_op);
+}
+
 static void ClearNoNeedBufferInputs(OpBase* op) {
   auto& inferer = op->Info().NoNeedBufferVarsInferer();
   if (!inferer) return;
@@ -27,6 +27,8 @@
 namespace paddle {
 namespace imperative {
 
+class PreparedOp;
+
 // TODO(zjl): to support py_func layer
 class OpBase {
  public:
@@ -162,6 +164,15 @@ class OpBase {
                   const framework::AttributeMap& attrs,
                   const platform::Place& place);
 
+  // Run op with the kernel in *prepared_op, which is prepared by an op of
+  // the same signature before, or is prepared here when it is empty.
+  static void Run(const framework::OperatorBase& op,
+                  const NameVarMap<VarBase>& ins,
+                  const NameVarMap<VarBase>& outs,
+                  const framework::AttributeMap& attrs,
+                  const platform::Place& place,
+                  std::unique_ptr<PreparedOp>* prepared_op);
+
  private:
   static const std::string& UnknownOpType() {
     static std::string kUnknownOpType{"unknown"};
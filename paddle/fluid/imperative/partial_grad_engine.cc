@@ -34,6 +34,7 @@
 #include "paddle/fluid/string/string_helper.h"
 
 DECLARE_bool(sort_sum_gradient);
+DECLARE_bool(inplace_sum_gradient);
 
 namespace paddle {
 namespace imperative {
@@ -329,6 +330,9 @@ class GradientAccumulationInfo {
         if (sort_gradient_) {
           accumulator_.reset(
               new SortedGradientAccumulator(grad_var_->SharedVar().get()));
+        } else if (FLAGS_inplace_sum_gradient) {
+          accumulator_.reset(
+              new InplaceGradientAccumulator(grad_var_->SharedVar().get()));
         } else {
           accumulator_.reset(
               new EagerGradientAccumulator(grad_var_->SharedVar().get()));
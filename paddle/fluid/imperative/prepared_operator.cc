@@ -63,9 +63,14 @@ static void PrepareData(const platform::Place& place,
 
 PreparedOp::PreparedOp(const framework::OperatorBase& op,
                        const framework::RuntimeContext& ctx,
+                       const framework::OpKernelType& kernel_type,
                        const framework::OperatorWithKernel::OpKernelFunc& func,
                        platform::DeviceContext* dev_ctx)
-    : op_(op), ctx_(ctx), func_(func), dev_ctx_(dev_ctx) {}
+    : op_(op),
+      ctx_(ctx),
+      kernel_type_(kernel_type),
+      func_(func),
+      dev_ctx_(dev_ctx) {}
 
 template <typename VarType>
 PreparedOp PrepareOpImpl(const NameVarMap<VarType>& ins,
@@ -123,7 +128,8 @@ PreparedOp PrepareOpImpl(const NameVarMap<VarType>& ins,
   }
 
   PrepareData<VarType>(place, ins, op, expected_kernel_key);
-  return PreparedOp(op, ctx, kernel_iter->second, dev_ctx);
+  return PreparedOp(op, ctx, expected_kernel_key, kernel_iter->second,
+                    dev_ctx);
 }
 
 PreparedOp PreparedOp::Prepare(const NameVarMap<VarBase>& ins,
@@ -142,6 +148,18 @@ PreparedOp PreparedOp::Prepare(const NameVarMap<VariableWrapper>& ins,
   return PrepareOpImpl<VariableWrapper>(ins, outs, op, place, attrs);
 }
 
+void PreparedOp::PrepareInputs(const NameVarMap<VarBase>& ins) const {
+  PrepareData<VarBase>(dev_ctx_->GetPlace(), ins,
+                       static_cast<const framework::OperatorWithKernel&>(op_),
+                       kernel_type_);
+}
+
+void PreparedOp::PrepareInputs(const NameVarMap<VariableWrapper>& ins) const {
+  PrepareData<VariableWrapper>(
+      dev_ctx_->GetPlace(), ins,
+      static_cast<const framework::OperatorWithKernel&>(op_), kernel_type_);
+}
+
 template <typename VarType>
 static void PreparedOpRunImpl(
     const framework::OperatorBase& op, const framework::RuntimeContext& ctx,
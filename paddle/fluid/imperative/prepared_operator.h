@@ -43,6 +43,7 @@ class PreparedOp {
  public:
   PreparedOp(const framework::OperatorBase& op,
              const framework::RuntimeContext& ctx,
+             const framework::OpKernelType& kernel_type,
              const framework::OperatorWithKernel::OpKernelFunc& func,
              platform::DeviceContext* dev_ctx);
 
@@ -58,6 +59,12 @@ class PreparedOp {
                             const platform::Place& place,
                             const framework::AttributeMap& attrs);
 
+  // Transform the inputs to the kernel prepared before, so that a
+  // PreparedOp can be reused by the ops of the same inputs signature.
+  void PrepareInputs(const NameVarMap<VarBase>& ins) const;
+
+  void PrepareInputs(const NameVarMap<VariableWrapper>& ins) const;
+
   void Run(const NameVarMap<VarBase>& in, const NameVarMap<VarBase>& out,
            const framework::AttributeMap& attrs);
 
@@ -67,7 +74,8 @@ class PreparedOp {
 
  private:
   const framework::OperatorBase& op_;
-  const framework::RuntimeContext& ctx_;
+  framework::RuntimeContext ctx_;
+  framework::OpKernelType kernel_type_;
   framework::OperatorWithKernel::OpKernelFunc func_;
   platform::DeviceContext* dev_ctx_;
 };
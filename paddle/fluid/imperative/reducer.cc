@@ -17,52 +17,105 @@
 namespace paddle {
 namespace imperative {
 
-#if defined(PADDLE_WITH_NCCL)
+#if defined(PADDLE_WITH_NCCL) || defined(PADDLE_WITH_GLOO)
 std::shared_ptr<Reducer> Reducer::s_instance_ = NULL;
 
-// context is used to select the stream for concat
-void Group::ConcatTensors(const platform::CUDADeviceContext &context) {
-  switch (dtype_) {
+template <typename DeviceContext>
+static void ConcatTensorsWithType(
+    const DeviceContext &context,
+    const std::vector<framework::Tensor> &dense_tensors_,
+    framework::Variable *p_dense_contents,
+    framework::proto::VarType::Type type) {
+  switch (type) {
     case framework::proto::VarType::FP16:
-      ConcatTensorsForAllReduce<platform::float16>(context, dense_tensors_,
-                                                   &dense_contents_);
+      ConcatTensorsForAllReduce<DeviceContext, platform::float16>(
+          context, dense_tensors_, p_dense_contents);
       break;
     case framework::proto::VarType::FP32:
-      ConcatTensorsForAllReduce<float>(context, dense_tensors_,
-                                       &dense_contents_);
+      ConcatTensorsForAllReduce<DeviceContext, float>(context, dense_tensors_,
+                                                      p_dense_contents);
       break;
     case framework::proto::VarType::FP64:
-      ConcatTensorsForAllReduce<double>(context, dense_tensors_,
-                                        &dense_contents_);
+      ConcatTensorsForAllReduce<DeviceContext, double>(context, dense_tensors_,
+                                                       p_dense_contents);
       break;
     default:
       PADDLE_THROW(platform::errors::Unimplemented(
           "Data type (%s) is not supported when it concats tensors for "
           "allreduce.",
-          framework::DataTypeToString(dtype_)));
+          framework::DataTypeToString(type)));
   }
 }
 
-// context is used to select the stream for split
-void Group::SplitTensors(const platform::CUDADeviceContext &context) {
-  switch (dtype_) {
+template <typename DeviceContext>
+static void SplitTensorsWithType(
+    const DeviceContext &context, framework::Variable *p_dense_contents,
+    std::vector<framework::Tensor> *p_dense_tensors,
+    framework::proto::VarType::Type type) {
+  switch (type) {
     case framework::proto::VarType::FP16:
-      SplitTensorsForAllReduce<platform::float16>(context, &dense_contents_,
-                                                  &dense_tensors_);
+      SplitTensorsForAllReduce<DeviceContext, platform::float16>(
+          context, p_dense_contents, p_dense_tensors);
       break;
     case framework::proto::VarType::FP32:
-      SplitTensorsForAllReduce<float>(context, &dense_contents_,
-                                      &dense_tensors_);
+      SplitTensorsForAllReduce<DeviceContext, float>(context, p_dense_contents,
+                                                     p_dense_tensors);
       break;
     case framework::proto::VarType::FP64:
-      SplitTensorsForAllReduce<double>(context, &dense_contents_,
-                                       &dense_tensors_);
+      SplitTensorsForAllReduce<DeviceContext, double>(
+          context, p_dense_contents, p_dense_tensors);
       break;
     default:
       PADDLE_THROW(platform::errors::Unimplemented(
           "Data type (%s) is not supported when it splits tensors for "
           "allreduce.",
-          framework::DataTypeToString(dtype_)));
+          framework::DataTypeToString(type)));
+  }
+}
+
+// context is used to select the stream for concat
+void Group::ConcatTensors(const platform::DeviceContext &context) {
+  auto place = context.GetPlace();
+  if (platform::is_gpu_place(place)) {
+#if defined(PADDLE_WITH_NCCL)
+    ConcatTensorsWithType(
+        static_cast<const platform::CUDADeviceContext &>(context),
+        dense_tensors_, &dense_contents_, dtype_);
+#else
+    PADDLE_THROW(platform::errors::PermissionDenied(
+        "Paddle can't concat grad tensors since it's not compiled with NCCL,"
+        "Please recompile or reinstall Paddle with NCCL support."));
+#endif
+  } else if (platform::is_cpu_place(place)) {
+    ConcatTensorsWithType(
+        static_cast<const platform::CPUDeviceContext &>(context),
+        dense_tensors_, &dense_contents_, dtype_);
+  } else {
+    PADDLE_THROW(platform::errors::Unimplemented(
+        "Concat grad tensor not supported on place (%s)", place));
+  }
+}
+
+// context is used to select the stream for split
+void Group::SplitTensors(const platform::DeviceContext &context) {
+  auto place = context.GetPlace();
+  if (platform::is_gpu_place(place)) {
+#if defined(PADDLE_WITH_NCCL)
+    SplitTensorsWithType(
+        static_cast<const platform::CUDADeviceContext &>(context),
+        &dense_contents_, &dense_tensors_, dtype_);
+#else
+    PADDLE_THROW(platform::errors::PermissionDenied(
+        "Paddle can't split grad tensor since it's not compiled with NCCL,"
+        "Please recompile or reinstall Paddle with NCCL support."));
+#endif
+  } else if (platform::is_cpu_place(place)) {
+    SplitTensorsWithType(
+        static_cast<const platform::CPUDeviceContext &>(context),
+        &dense_contents_, &dense_tensors_, dtype_);
+  } else {
+    PADDLE_THROW(platform::errors::Unimplemented(
+        "Split grad tensor not supported on place (%s)", place));
   }
 }
 
@@ -105,15 +158,25 @@ Reducer::Reducer(const std::vector<std::shared_ptr<imperative::VarBase>> &vars,
               this->AddDistHook(grad, global_var_index);
             })));
   }
-  // create streams
-  compute_stream_ = static_cast<platform::CUDADeviceContext *>(
-                        platform::DeviceContextPool::Instance().Get(place_))
-                        ->stream();
-  comm_stream_ = platform::NCCLCommContext::Instance().Get(0, place_)->stream();
-  // create events
-  CreateGroupEvents(group_indices.size());
-  comm_enent_ = platform::CudaEventResourcePool::Instance().New(
-      BOOST_GET_CONST(platform::CUDAPlace, place_).device);
+  if (platform::is_gpu_place(place_)) {
+#if defined(PADDLE_WITH_NCCL)
+    // create streams
+    compute_stream_ = static_cast<platform::CUDADeviceContext *>(
+                          platform::DeviceContextPool::Instance().Get(place_))
+                          ->stream();
+    comm_stream_ =
+        platform::NCCLCommContext::Instance().Get(0, place_)->stream();
+    // create events
+    CreateGroupEvents(group_indices.size());
+    comm_enent_ = platform::CudaEventResourcePool::Instance().New(
+        BOOST_GET_CONST(platform::CUDAPlace, place_).device);
+#endif
+  }
+#if defined(PADDLE_WITH_GLOO)
+  if (platform::is_cpu_place(place_)) {
+    comm_pool_.reset(new ::ThreadPool(1));
+  }
+#endif
 
   std::call_once(once_flag_, []() {
     std::atexit([]() { Reducer::GetInstance()->ReleaseReducer(); });
@@ -121,13 +184,22 @@ Reducer::Reducer(const std::vector<std::shared_ptr<imperative::VarBase>> &vars,
 }
 
 void Reducer::ReleaseReducer() {
+#if defined(PADDLE_WITH_NCCL)
   for (auto &event : events_) {
     event.reset();
   }
   comm_enent_.reset();
+#endif
+#if defined(PADDLE_WITH_GLOO)
+  comm_pool_.reset();
+#endif
 }
 
 void Reducer::CreateGroupEvents(int group_num) {
+#if defined(PADDLE_WITH_NCCL)
+  if (!platform::is_gpu_place(place_)) {
+    return;
+  }
   // release old events
   for (auto &event : events_) {
     event.reset();
@@ -138,6 +210,7 @@ void Reducer::CreateGroupEvents(int group_num) {
     event = platform::CudaEventResourcePool::Instance().New(
         BOOST_GET_CONST(platform::CUDAPlace, place_).device);
   }
+#endif
 }
 
 void Reducer::InitializeDenseGroups(
@@ -309,34 +382,78 @@ void Reducer::MarkGroupReady(size_t group_index) {
     return;
   }
 
-  PADDLE_ENFORCE_CUDA_SUCCESS(
-      cudaEventRecord(events_[group_index].get(), compute_stream_));
-  PADDLE_ENFORCE_CUDA_SUCCESS(
-      cudaStreamWaitEvent(comm_stream_, events_[group_index].get(), 0));
+#if defined(PADDLE_WITH_NCCL)
+  if (platform::is_gpu_place(place_)) {
+    PADDLE_ENFORCE_CUDA_SUCCESS(
+        cudaEventRecord(events_[group_index].get(), compute_stream_));
+    PADDLE_ENFORCE_CUDA_SUCCESS(
+        cudaStreamWaitEvent(comm_stream_, events_[group_index].get(), 0));
+  }
+#endif
 
   for (; next_group_ < groups_.size() && groups_[next_group_].pending_ == 0;
        ++next_group_) {
-    auto &group = groups_[next_group_];
-    if (group.is_sparse_) {
-      VLOG(3) << "sparse group [" << next_group_ << "] start allreduce...";
-      parallel_ctx_->AllReduceByStream(*group.sparse_contents_,
-                                       group.sparse_contents_, 0, false);
-    } else {
-      VLOG(3) << "dense group [" << next_group_ << "] start allreduce...";
-      // Select common commstream to concat tensors
-      // group.dense_tensors ---> group.dense_contents_
-      group.ConcatTensors(*parallel_ctx_->GetDeviceContext(0));
-
-      // Start allreduce
-      parallel_ctx_->AllReduceByStream(group.dense_contents_,
-                                       &(group.dense_contents_), 0, false);
-      // Select common commstream to split tensors
-      // group.dense_contents_ ---> group.dense_tensors
-      group.SplitTensors(*parallel_ctx_->GetDeviceContext(0));
+#if defined(PADDLE_WITH_GLOO)
+    if (platform::is_cpu_place(place_)) {
+      // The collectives of gloo are synchronous, so they run on comm_pool_
+      // while the backward goes on, FinalizeBackward waits for them.
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++comm_op_count_;
+      }
+      size_t run_group = next_group_;
+      comm_pool_->enqueue([this, run_group] {
+        std::exception_ptr exception = nullptr;
+        try {
+          FusedAllReduceSchedule(run_group);
+        } catch (...) {
+          exception = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (exception != nullptr && comm_exception_ == nullptr) {
+          comm_exception_ = exception;
+        }
+        --comm_op_count_;
+        cv_.notify_all();
+      });
+      continue;
     }
+#endif
+    FusedAllReduceSchedule(next_group_);
   }
 }
 
+void Reducer::FusedAllReduceSchedule(size_t group_index) {
+  auto &group = groups_[group_index];
+  if (group.is_sparse_) {
+    VLOG(3) << "sparse group [" << group_index << "] start allreduce...";
+    parallel_ctx_->AllReduceByStream(*group.sparse_contents_,
+                                     group.sparse_contents_, 0, false);
+    return;
+  }
+  VLOG(3) << "dense group [" << group_index << "] start allreduce...";
+  // Select common commstream to concat tensors, the CPUDeviceContext
+  // for CPUPlace.
+  const platform::DeviceContext *dev_ctx = nullptr;
+#if defined(PADDLE_WITH_NCCL)
+  if (platform::is_gpu_place(place_)) {
+    dev_ctx = parallel_ctx_->GetDeviceContext(0);
+  }
+#endif
+  if (dev_ctx == nullptr) {
+    dev_ctx = platform::DeviceContextPool::Instance().Get(place_);
+  }
+  // group.dense_tensors ---> group.dense_contents_
+  group.ConcatTensors(*dev_ctx);
+
+  // Start allreduce
+  parallel_ctx_->AllReduceByStream(group.dense_contents_,
+                                   &(group.dense_contents_), 0, false);
+  // Select common commstream to split tensors
+  // group.dense_contents_ ---> group.dense_tensors
+  group.SplitTensors(*dev_ctx);
+}
+
 std::vector<std::vector<size_t>> Reducer::RebuildGruops() {
   std::reverse(rebuild_vars_.begin(), rebuild_vars_.end());
   std::reverse(rebuild_var_indices_.begin(), rebuild_var_indices_.end());
@@ -351,9 +468,25 @@ std::vector<std::vector<size_t>> Reducer::RebuildGruops() {
 }
 
 void Reducer::FinalizeBackward() {
-  PADDLE_ENFORCE_CUDA_SUCCESS(cudaEventRecord(comm_enent_.get(), comm_stream_));
-  PADDLE_ENFORCE_CUDA_SUCCESS(
-      cudaStreamWaitEvent(compute_stream_, comm_enent_.get(), 0));
+#if defined(PADDLE_WITH_NCCL)
+  if (platform::is_gpu_place(place_)) {
+    PADDLE_ENFORCE_CUDA_SUCCESS(
+        cudaEventRecord(comm_enent_.get(), comm_stream_));
+    PADDLE_ENFORCE_CUDA_SUCCESS(
+        cudaStreamWaitEvent(compute_stream_, comm_enent_.get(), 0));
+  }
+#endif
+#if defined(PADDLE_WITH_GLOO)
+  if (platform::is_cpu_place(place_)) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return comm_op_count_ == 0; });
+    if (comm_exception_ != nullptr) {
+      auto exception = comm_exception_;
+      comm_exception_ = nullptr;
+      std::rethrow_exception(exception);
+    }
+  }
+#endif
   if (!has_rebuilt_group_) {
     VLOG(3) << "Start rebuilding the groups";
     auto rebuild_group_indices = RebuildGruops();
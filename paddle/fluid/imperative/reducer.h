@@ -15,8 +15,11 @@
 #pragma once
 
 #include <algorithm>
+#include <condition_variable>  // NOLINT
+#include <exception>
 #include <iostream>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -26,30 +29,37 @@
 #include "paddle/fluid/imperative/variable_wrapper.h"
 #include "paddle/fluid/memory/memory.h"
 
-#if defined(PADDLE_WITH_NCCL)
-#include "paddle/fluid/imperative/all_reduce.h"
+#if defined(PADDLE_WITH_NCCL) || defined(PADDLE_WITH_GLOO)
+#include "paddle/fluid/imperative/nccl_context.h"
 #include "paddle/fluid/operators/math/concat_and_split.h"
 #include "paddle/fluid/operators/strided_memcpy.h"
+#endif
+
+#if defined(PADDLE_WITH_NCCL)
+#include "paddle/fluid/imperative/all_reduce.h"
 #include "paddle/fluid/platform/cuda_resource_pool.h"
 #endif
 
+#if defined(PADDLE_WITH_GLOO)
+#include <ThreadPool.h>
+#endif
+
 namespace paddle {
 namespace imperative {
 
-#if defined(PADDLE_WITH_NCCL)
-template <typename T>
+#if defined(PADDLE_WITH_NCCL) || defined(PADDLE_WITH_GLOO)
+template <typename DeviceContext, typename T>
 void ConcatTensorsForAllReduce(
-    const platform::CUDADeviceContext& context,
+    const DeviceContext& context,
     const std::vector<framework::Tensor>& dense_tensors_,
     framework::Variable* p_dense_contents) {
-  operators::math::ConcatFunctor<platform::CUDADeviceContext, T>
-      concat_functor_;
+  operators::math::ConcatFunctor<DeviceContext, T> concat_functor_;
   concat_functor_(context, dense_tensors_, 0,
                   p_dense_contents->GetMutable<framework::LoDTensor>());
 }
 
-template <typename T>
-void SplitTensorsForAllReduce(const platform::CUDADeviceContext& context,
+template <typename DeviceContext, typename T>
+void SplitTensorsForAllReduce(const DeviceContext& context,
                               framework::Variable* p_dense_contents,
                               std::vector<framework::Tensor>* p_dense_tensors) {
   auto* in = p_dense_contents->GetMutable<framework::LoDTensor>();
@@ -67,8 +77,7 @@ void SplitTensorsForAllReduce(const platform::CUDADeviceContext& context,
   if (p_dense_tensors->size() < 10) {
     operators::StridedMemcpyWithAxis0<T>(context, *in, shape_refer, &outs);
   } else {
-    operators::math::SplitFunctor<platform::CUDADeviceContext, T>
-        split_functor_;
+    operators::math::SplitFunctor<DeviceContext, T> split_functor_;
     split_functor_(context, *in, shape_refer, 0, &outs);
   }
 }
@@ -99,10 +108,10 @@ class Group {
   framework::proto::VarType::Type dtype_;
 
   // context is used to select the stream for concat
-  void ConcatTensors(const platform::CUDADeviceContext& context);
+  void ConcatTensors(const platform::DeviceContext& context);
 
   // context is used to select the stream for split
-  void SplitTensors(const platform::CUDADeviceContext& context);
+  void SplitTensors(const platform::DeviceContext& context);
 
   friend std::ostream& operator<<(std::ostream&, const Group&);
 };
@@ -137,6 +146,9 @@ class Reducer {
 
   void MarkGroupReady(size_t group_index);
 
+  // Run concat + allreduce + split of the group
+  void FusedAllReduceSchedule(size_t group_index);
+
   void FinalizeBackward();
 
   void ReleaseReducer();
@@ -179,11 +191,24 @@ class Reducer {
   std::shared_ptr<imperative::ParallelContext> parallel_ctx_;
   std::vector<VariableLocator> variable_locators_;
 
+#if defined(PADDLE_WITH_NCCL)
   // Following variables are to help sync stream
   std::vector<std::shared_ptr<platform::CudaEventObject>> events_;
   std::shared_ptr<platform::CudaEventObject> comm_enent_;
   cudaStream_t compute_stream_;
   cudaStream_t comm_stream_;
+#endif
+
+#if defined(PADDLE_WITH_GLOO)
+  // Following variables are to help run the allreduce of CPUPlace
+  // asynchronously. One thread keeps the order of the collectives the same
+  // on all the ranks.
+  std::unique_ptr<::ThreadPool> comm_pool_{nullptr};
+  size_t comm_op_count_{0};
+  std::exception_ptr comm_exception_{nullptr};
+  std::mutex mutex_;
+  std::condition_variable cv_;
+#endif
 
   // Following variables are to help rebuild group
   bool has_rebuilt_group_{false};
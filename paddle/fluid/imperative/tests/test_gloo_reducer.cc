@@ -0,0 +1,196 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+#include "paddle/fluid/framework/io/fs.h"
+#include "paddle/fluid/imperative/gloo_context.h"
+#include "paddle/fluid/imperative/reducer.h"
+
+namespace paddle {
+namespace imperative {
+
+#if defined(PADDLE_WITH_GLOO)
+const int kTrainerNum = 3;
+const std::vector<int64_t> kVarSizes = {3, 5, 7, 11, 13};
+
+static float SumOfRanks() { return kTrainerNum * (kTrainerNum + 1) / 2.f; }
+
+static void FillGrads(const std::vector<std::shared_ptr<VarBase>>& vars,
+                      int rank) {
+  for (size_t i = 0; i < vars.size(); ++i) {
+    auto* grad = vars[i]->MutableGradVar()->GetMutable<framework::LoDTensor>();
+    auto* data = grad->mutable_data<float>(platform::CPUPlace());
+    for (int64_t j = 0; j < grad->numel(); ++j) {
+      data[j] = (rank + 1) * (i + 1.f);
+    }
+  }
+}
+
+static bool CheckGrads(const std::vector<std::shared_ptr<VarBase>>& vars) {
+  for (size_t i = 0; i < vars.size(); ++i) {
+    const auto& grad =
+        vars[i]->GradVarBase()->Var().Get<framework::LoDTensor>();
+    const float* data = grad.data<float>();
+    for (int64_t j = 0; j < grad.numel(); ++j) {
+      if (data[j] != SumOfRanks() * (i + 1.f)) {
+        LOG(ERROR) << "grad " << i << " [" << j << "] is " << data[j];
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static bool CheckContext(ParallelContext* ctx, int rank) {
+  framework::Variable dense;
+  auto* tensor = dense.GetMutable<framework::LoDTensor>();
+  tensor->Resize({4});
+  auto* data = tensor->mutable_data<float>(platform::CPUPlace());
+  for (int i = 0; i < 4; ++i) {
+    data[i] = (rank + 1) * (i + 1.f);
+  }
+  ctx->AllReduceByStream(dense, &dense, 0, false);
+  for (int i = 0; i < 4; ++i) {
+    if (data[i] != SumOfRanks() * (i + 1.f)) {
+      LOG(ERROR) << "dense allreduce [" << i << "] is " << data[i];
+      return false;
+    }
+  }
+
+  // rank r sends r + 1 rows whose values are r
+  framework::Variable sparse;
+  auto* rows = sparse.GetMutable<framework::SelectedRows>();
+  rows->set_height(100);
+  for (int i = 0; i <= rank; ++i) {
+    rows->mutable_rows()->push_back(rank * 10 + i);
+  }
+  auto* value = rows->mutable_value();
+  value->Resize({rank + 1, 2});
+  auto* value_data = value->mutable_data<float>(platform::CPUPlace());
+  for (int i = 0; i < 2 * (rank + 1); ++i) {
+    value_data[i] = rank;
+  }
+  ctx->AllReduceByStream(sparse, &sparse, 0, false);
+  const auto& result = sparse.Get<framework::SelectedRows>();
+  size_t offset = 0;
+  for (int r = 0; r < kTrainerNum; ++r) {
+    for (int i = 0; i <= r; ++i, ++offset) {
+      if (result.rows()[offset] != r * 10 + i ||
+          result.value().data<float>()[offset * 2] != r) {
+        LOG(ERROR) << "sparse allreduce row " << offset << " is "
+                   << result.rows()[offset];
+        return false;
+      }
+    }
+  }
+  return offset == result.rows().size();
+}
+
+static bool RunRank(int rank, const std::string& store_path) {
+  auto gloo = framework::GlooWrapper::GetInstance();
+  gloo->SetTimeoutSeconds(60, 60);
+  gloo->SetRank(rank);
+  gloo->SetSize(kTrainerNum);
+  gloo->SetPrefix("test_gloo_reducer");
+  gloo->SetIface("lo");
+  gloo->SetHdfsStore(store_path, "", "");
+
+  ParallelStrategy strategy;
+  strategy.nranks_ = kTrainerNum;
+  strategy.local_rank_ = rank;
+  gloo->Init();
+  auto ctx =
+      std::make_shared<GLOOParallelContext>(strategy, platform::CPUPlace());
+  ctx->Init();
+  if (!CheckContext(ctx.get(), rank)) {
+    return false;
+  }
+
+  std::vector<std::shared_ptr<VarBase>> vars;
+  for (size_t i = 0; i < kVarSizes.size(); ++i) {
+    auto var = std::make_shared<VarBase>(true, "w" + std::to_string(i));
+    auto* param = var->MutableVar()->GetMutable<framework::LoDTensor>();
+    param->Resize({kVarSizes[i]});
+    param->mutable_data<float>(platform::CPUPlace());
+    auto* grad = var->MutableGradVar()->GetMutable<framework::LoDTensor>();
+    grad->Resize({kVarSizes[i]});
+    vars.push_back(var);
+  }
+  std::vector<bool> is_sparse_gradient(vars.size(), false);
+  // 40 bytes make the groups {w0, w1, w2}, {w3}, {w4}
+  std::vector<size_t> group_size_limits = {40};
+  auto group_indices =
+      AssignGroupBySize(vars, is_sparse_gradient, group_size_limits);
+  if (group_indices.size() != 3) {
+    LOG(ERROR) << "assign " << group_indices.size() << " groups";
+    return false;
+  }
+  std::reverse(group_indices.begin(), group_indices.end());
+  auto reducer = Reducer::SetInstance(vars, group_indices, is_sparse_gradient,
+                                      ctx, group_size_limits);
+
+  // the groups are rebuilt after the first batch
+  for (int batch = 0; batch < 3; ++batch) {
+    FillGrads(vars, rank);
+    reducer->PrepareForBackward();
+    for (size_t i = vars.size(); i > 0; --i) {
+      reducer->AddDistHook(vars[i - 1]->GradVarBase()->SharedVar().get(),
+                           i - 1);
+    }
+    if (!CheckGrads(vars)) {
+      LOG(ERROR) << "batch " << batch << " is wrong";
+      return false;
+    }
+  }
+  return true;
+}
+
+TEST(TestGlooReducer, TestMultiProcess) {
+  std::string store_path = ::testing::TempDir() + "test_gloo_reducer_store_" +
+                           std::to_string(getpid());
+  std::vector<pid_t> children;
+  int rank = 0;
+  for (int i = 1; i < kTrainerNum; ++i) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      rank = i;
+      break;
+    }
+    children.push_back(pid);
+  }
+  bool ok = RunRank(rank, store_path);
+  if (rank != 0) {
+    _exit(ok ? 0 : 1);
+  }
+  EXPECT_TRUE(ok);
+  for (pid_t pid : children) {
+    int status = 0;
+    waitpid(pid, &status, 0);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+  framework::fs_remove(store_path);
+}
+#endif
+
+}  // namespace imperative
+}  // namespace paddle
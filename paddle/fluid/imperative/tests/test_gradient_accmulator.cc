@@ -15,12 +15,16 @@
 #include <memory>
 #include <type_traits>
 #include <vector>
+#include "gflags/gflags.h"
 #include "gtest/gtest.h"
 #include "paddle/fluid/framework/variable.h"
 #include "paddle/fluid/imperative/gradient_accumulator.h"
 #include "paddle/fluid/memory/memcpy.h"
 #include "paddle/fluid/operators/math/math_function.h"
 
+DECLARE_int32(inner_op_parallelism);
+DECLARE_double(sparse_gradient_dense_ratio);
+
 namespace imperative = paddle::imperative;
 namespace platform = paddle::platform;
 namespace framework = paddle::framework;
@@ -365,5 +369,112 @@ TEST(test_gradient_accumulator, test_unchange_input) {
   }
 }
 
+// The dense values of a LoDTensor or SelectedRows var on CPU.
+static std::vector<float> DenseValues(const framework::Variable& var) {
+  if (var.IsType<framework::LoDTensor>()) {
+    const auto& tensor = var.Get<framework::LoDTensor>();
+    return std::vector<float>(tensor.data<float>(),
+                              tensor.data<float>() + tensor.numel());
+  }
+  const auto& selected_rows = var.Get<framework::SelectedRows>();
+  const auto& value = selected_rows.value();
+  int64_t width = value.numel() / value.dims()[0];
+  std::vector<float> ret(selected_rows.height() * width, 0);
+  for (size_t i = 0; i < selected_rows.rows().size(); ++i) {
+    for (int64_t j = 0; j < width; ++j) {
+      ret[selected_rows.rows()[i] * width + j] +=
+          value.data<float>()[i * width + j];
+    }
+  }
+  return ret;
+}
+
+// Sum the grads with the inplace or the eager accumulator.
+static framework::Variable SumGrads(
+    bool inplace, const std::vector<framework::Variable>& grads,
+    bool unchange_input) {
+  auto g_var = std::make_shared<VariableWrapper>("g_var");
+  g_var->SetOverridedStopGradient(false);
+  std::unique_ptr<GradientAccumulator> accumulator;
+  if (inplace) {
+    accumulator.reset(new InplaceGradientAccumulator(g_var.get()));
+  } else {
+    accumulator.reset(new EagerGradientAccumulator(g_var.get()));
+  }
+  for (size_t i = 0; i < grads.size(); ++i) {
+    accumulator->IncreaseRefCnt();
+  }
+  for (size_t i = 0; i < grads.size(); ++i) {
+    auto var = std::make_shared<VariableWrapper>("tmp");
+    CopyVar(grads[i], var->MutableVar());
+    accumulator->SumGrad(var, i, unchange_input);
+    if (unchange_input) {
+      EXPECT_TRUE(IsEqualVar(var->Var(), grads[i]));
+    }
+  }
+  EXPECT_TRUE(accumulator->SumGradCompleted());
+  accumulator->AccumulateGrad();
+  return std::move(*g_var->MutableVar());
+}
+
+static void TestInplaceGradientAccumulator(const framework::DDim& dims,
+                                           int64_t row_number) {
+  platform::CPUPlace place;
+  for (int mask = 0; mask < 8; ++mask) {
+    std::vector<framework::Variable> grads;
+    for (int i = 0; i < 3; ++i) {
+      if (mask & (1 << i)) {
+        grads.push_back(RandomTensor<float>(dims, place));
+      } else {
+        grads.push_back(RandomSelectedRows<float>(dims, place, row_number));
+      }
+    }
+    for (auto unchange_input : {false, true}) {
+      auto expected = SumGrads(false, grads, unchange_input);
+      auto result = SumGrads(true, grads, unchange_input);
+      ASSERT_EQ(DenseValues(expected), DenseValues(result));
+    }
+  }
+}
+
+TEST(test_gradient_accumulator, test_inplace_sum_gradient) {
+  TestInplaceGradientAccumulator({10, 20}, 30);
+  TestInplaceGradientAccumulator({10, 20}, 3);
+
+  auto parallelism = FLAGS_inner_op_parallelism;
+  FLAGS_inner_op_parallelism = 4;
+  TestInplaceGradientAccumulator({1000, 300}, 700);
+  TestInplaceGradientAccumulator({1000, 300}, 100);
+  FLAGS_inner_op_parallelism = parallelism;
+}
+
+TEST(test_gradient_accumulator, test_inplace_sparse_to_dense) {
+  platform::CPUPlace place;
+  framework::DDim dims{10, 20};
+  auto ratio = FLAGS_sparse_gradient_dense_ratio;
+  // 7 unique rows of 10 are touched
+  std::vector<framework::Variable> grads = {
+      RandomSelectedRows<float>(dims, place, 4),
+      RandomSelectedRows<float>(dims, place, 4)};
+  auto* rows1 = grads[0].GetMutable<framework::SelectedRows>();
+  auto* rows2 = grads[1].GetMutable<framework::SelectedRows>();
+  *rows1->mutable_rows() = {0, 2, 4, 2};
+  *rows2->mutable_rows() = {1, 3, 5, 7};
+
+  FLAGS_sparse_gradient_dense_ratio = 0.5;
+  auto dense = SumGrads(true, grads, true);
+  ASSERT_TRUE(dense.IsType<framework::LoDTensor>());
+  ASSERT_EQ(DenseValues(dense), DenseValues(SumGrads(false, grads, true)));
+
+  FLAGS_sparse_gradient_dense_ratio = 2;
+  auto sparse = SumGrads(true, grads, true);
+  ASSERT_TRUE(sparse.IsType<framework::SelectedRows>());
+  // the rows are merged
+  ASSERT_EQ(sparse.Get<framework::SelectedRows>().rows(),
+            std::vector<int64_t>({0, 2, 4, 1, 3, 5, 7}));
+  ASSERT_EQ(DenseValues(sparse), DenseValues(dense));
+  FLAGS_sparse_gradient_dense_ratio = ratio;
+}
+
 }  // namespace imperative
 }  // namespace paddle
@@ -20,14 +20,14 @@
 #include "glog/logging.h"
 #include "gtest/gtest.h"
 
-#if defined(PADDLE_WITH_NCCL)
+#if defined(PADDLE_WITH_NCCL) || defined(PADDLE_WITH_GLOO)
 #include "paddle/fluid/imperative/reducer.h"
 #endif
 
 namespace paddle {
 namespace imperative {
 
-#if defined(PADDLE_WITH_NCCL)
+#if defined(PADDLE_WITH_NCCL) || defined(PADDLE_WITH_GLOO)
 TEST(TestGroup, TestPrintGroupMessage) {
   Group group;
   std::stringstream stream1, stream2;
@@ -60,6 +60,43 @@ TEST(TestGroup, TestPrintGroupMessage) {
   ASSERT_STREQ(stream2.str().c_str(), head.c_str());
 }
 
+TEST(TestGroup, TestConcatSplitOnCPU) {
+  platform::CPUPlace place;
+  platform::CPUDeviceContext context(place);
+  Group group;
+  group.dtype_ = framework::proto::VarType::FP32;
+  std::vector<int64_t> lengths = {2, 3, 4};
+  std::vector<framework::LoDTensor> tensors(lengths.size());
+  float value = 0;
+  for (size_t i = 0; i < lengths.size(); ++i) {
+    auto* data = tensors[i].Resize({lengths[i]}).mutable_data<float>(place);
+    for (int64_t j = 0; j < lengths[i]; ++j) {
+      data[j] = value++;
+    }
+    group.dense_tensors_.push_back(framework::Tensor());
+    group.dense_tensors_.back().ShareDataWith(tensors[i]);
+    group.length_.push_back(lengths[i]);
+    group.all_length_ += lengths[i];
+  }
+  auto* contents = group.dense_contents_.GetMutable<framework::LoDTensor>();
+  auto* contents_data =
+      contents->Resize({group.all_length_}).mutable_data<float>(place);
+
+  group.ConcatTensors(context);
+  for (int64_t i = 0; i < group.all_length_; ++i) {
+    ASSERT_EQ(contents_data[i], i);
+    contents_data[i] *= 2;
+  }
+
+  group.SplitTensors(context);
+  value = 0;
+  for (auto& tensor : tensors) {
+    for (int64_t j = 0; j < tensor.numel(); ++j) {
+      ASSERT_EQ(tensor.data<float>()[j], 2 * value++);
+    }
+  }
+}
+
 #endif
 
 }  // namespace imperative
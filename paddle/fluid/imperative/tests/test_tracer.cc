@@ -18,16 +18,20 @@
 
 #include <paddle/fluid/framework/op_registry.h>
 
+#include <algorithm>
 #include <memory>
 #include <set>
 #include <string>
 #include <vector>
 
+#include "gflags/gflags.h"
 #include "gtest/gtest.h"
 #include "paddle/fluid/imperative/basic_engine.h"
 #include "paddle/fluid/imperative/tracer.h"
 #include "paddle/fluid/memory/memcpy.h"
 
+DECLARE_int32(tracer_op_cache_capacity);
+
 namespace imperative = paddle::imperative;
 namespace platform = paddle::platform;
 namespace framework = paddle::framework;
@@ -506,6 +510,69 @@ TEST(test_tracer, test_var_op_destruction) {
 #endif
 }
 
+static std::shared_ptr<VarBase> FilledVar(const std::string& name,
+                                          float value) {
+  auto var = std::make_shared<VarBase>(true, name);
+  auto* tensor = var->MutableVar()->GetMutable<framework::LoDTensor>();
+  tensor->Resize({2, 5});
+  auto* data = tensor->mutable_data<float>(platform::CPUPlace());
+  std::fill(data, data + tensor->numel(), value);
+  return var;
+}
+
+TEST(test_tracer, test_op_cache) {
+  auto capacity = FLAGS_tracer_op_cache_capacity;
+  FLAGS_tracer_op_cache_capacity = 2;
+  imperative::Tracer tracer;
+  platform::CPUPlace place;
+  auto trace_add = [&](float x, float y, int axis, bool stop_gradient) {
+    auto x_in = FilledVar("x_in", x);
+    auto y_in = FilledVar("y_in", y);
+    x_in->SetOverridedStopGradient(stop_gradient);
+    auto vout = std::make_shared<VarBase>(true, "vout");
+    imperative::NameVarBaseMap ins = {var_pair("X", vb_vector(1, x_in)),
+                                      var_pair("Y", vb_vector(1, y_in))};
+    imperative::NameVarBaseMap outs = {var_pair("Out", vb_vector(1, vout))};
+    framework::AttributeMap attrs;
+    attrs["axis"] = axis;
+    tracer.TraceOp("elementwise_add", ins, outs, attrs, place, true);
+    const auto& out_tensor = vout->Var().Get<framework::LoDTensor>();
+    EXPECT_EQ(out_tensor.numel(), 10);
+    for (int i = 0; i < out_tensor.numel(); ++i) {
+      EXPECT_EQ(out_tensor.data<float>()[i], x + y);
+    }
+    return vout;
+  };
+
+  trace_add(1, 2, -1, true);
+  ASSERT_EQ(tracer.OpCacheSize(), 1UL);
+  // the cached op runs with the new inputs
+  auto vout = trace_add(3, 4, -1, false);
+  ASSERT_EQ(tracer.OpCacheSize(), 1UL);
+  ASSERT_EQ(vout->GradVarBase()->GradOpNum(), 1UL);
+  vout = trace_add(5, 6, -1, true);
+  ASSERT_EQ(vout->GradVarBase()->GradOpNum(), 0UL);
+
+  // another attribute makes another signature
+  trace_add(1, 2, 0, true);
+  ASSERT_EQ(tracer.OpCacheSize(), 2UL);
+  // the full cache is cleared
+  auto x_in = FilledVar("x_in", 1);
+  auto vout2 = std::make_shared<VarBase>(true, "vout2");
+  imperative::NameVarBaseMap ins = {var_pair("X", vb_vector(1, x_in))};
+  imperative::NameVarBaseMap outs = {var_pair("Out", vb_vector(1, vout2))};
+  framework::AttributeMap reduce_attrs;
+  reduce_attrs["reduce_all"] = true;
+  tracer.TraceOp("reduce_sum", ins, outs, reduce_attrs, place, true);
+  ASSERT_EQ(tracer.OpCacheSize(), 1UL);
+  ASSERT_EQ(vout2->Var().Get<framework::LoDTensor>().data<float>()[0], 10);
+
+  FLAGS_tracer_op_cache_capacity = 0;
+  trace_add(1, 2, -1, true);
+  ASSERT_EQ(tracer.OpCacheSize(), 1UL);
+  FLAGS_tracer_op_cache_capacity = capacity;
+}
+
 }  // namespace imperative
 }  // namespace paddle
 
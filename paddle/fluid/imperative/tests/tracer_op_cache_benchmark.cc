@@ -0,0 +1,92 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "gtest/gtest.h"
+#include "paddle/fluid/framework/op_registry.h"
+#include "paddle/fluid/imperative/tracer.h"
+#include "paddle/fluid/platform/timer.h"
+
+DECLARE_int32(tracer_op_cache_capacity);
+
+DEFINE_int32(tracer_bench_numel, 8, "Number of elements of the operands.");
+// a smoke test size for ctest, pass --tracer_bench_repeat=100000 to measure
+DEFINE_int32(tracer_bench_repeat, 100, "Number of the traced ops.");
+
+namespace paddle {
+namespace imperative {
+
+static std::shared_ptr<VarBase> CreateVar(const std::string& name,
+                                          int64_t numel, float value) {
+  auto var = std::make_shared<VarBase>(true, name);
+  auto* tensor = var->MutableVar()->GetMutable<framework::LoDTensor>();
+  tensor->Resize({numel});
+  auto* data = tensor->mutable_data<float>(platform::CPUPlace());
+  std::fill(data, data + numel, value);
+  return var;
+}
+
+// The microseconds of tracing an elementwise_add of small operands.
+static double TraceAddUs(int cache_capacity, bool stop_gradient) {
+  FLAGS_tracer_op_cache_capacity = cache_capacity;
+  Tracer tracer;
+  platform::CPUPlace place;
+  auto x = CreateVar("x", FLAGS_tracer_bench_numel, 1);
+  auto y = CreateVar("y", FLAGS_tracer_bench_numel, 2);
+  x->SetOverridedStopGradient(stop_gradient);
+  NameVarBaseMap ins = {{"X", {x}}, {"Y", {y}}};
+
+  platform::Timer timer;
+  timer.Start();
+  for (int i = 0; i < FLAGS_tracer_bench_repeat; ++i) {
+    auto out = std::make_shared<VarBase>(true, "out");
+    NameVarBaseMap outs = {{"Out", {out}}};
+    framework::AttributeMap attrs;
+    attrs["axis"] = -1;
+    tracer.TraceOp("elementwise_add", ins, outs, std::move(attrs), place,
+                   true);
+    if (i == 0) {
+      const auto& tensor = out->Var().Get<framework::LoDTensor>();
+      EXPECT_EQ(tensor.numel(), FLAGS_tracer_bench_numel);
+      EXPECT_EQ(tensor.data<float>()[0], 3);
+    }
+  }
+  timer.Pause();
+  return timer.ElapsedUS() / FLAGS_tracer_bench_repeat;
+}
+
+TEST(tracer_op_cache_benchmark, elementwise_add) {
+  auto capacity = FLAGS_tracer_op_cache_capacity;
+  for (bool stop_gradient : {true, false}) {
+    // warm up the allocator and the kernels
+    TraceAddUs(0, stop_gradient);
+    double uncached_us = TraceAddUs(0, stop_gradient);
+    double cached_us = TraceAddUs(1024, stop_gradient);
+    LOG(INFO) << "=== elementwise_add numel=" << FLAGS_tracer_bench_numel
+              << " stop_gradient=" << stop_gradient << " ===";
+    LOG(INFO) << "trace uncached: " << uncached_us
+              << " us/op, cached: " << cached_us << " us/op";
+  }
+  FLAGS_tracer_op_cache_capacity = capacity;
+}
+
+}  // namespace imperative
+}  // namespace paddle
+
+USE_OP(elementwise_add);
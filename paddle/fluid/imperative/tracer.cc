@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 #include "paddle/fluid/imperative/tracer.h"
+#include <algorithm>
 #include <set>
 #include <unordered_set>
 #include <utility>
@@ -24,6 +25,7 @@
 DECLARE_bool(use_mkldnn);
 DECLARE_string(tracer_mkldnn_ops_on);
 DECLARE_string(tracer_mkldnn_ops_off);
+DECLARE_int32(tracer_op_cache_capacity);
 
 namespace paddle {
 namespace imperative {
@@ -56,6 +58,140 @@ static void PassStopGradient(const NameVarBaseMap& outs, bool generate_grad) {
   }
 }
 
+template <typename T>
+static void AppendKey(const T& value, std::string* key) {
+  key->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void AppendKey(const std::string& value, std::string* key) {
+  AppendKey(value.size(), key);
+  key->append(value);
+}
+
+static void AppendKey(const platform::Place& place, std::string* key) {
+  AppendKey(place.which(), key);
+  if (platform::is_gpu_place(place)) {
+    AppendKey(BOOST_GET_CONST(platform::CUDAPlace, place).device, key);
+  } else if (platform::is_xpu_place(place)) {
+    AppendKey(BOOST_GET_CONST(platform::XPUPlace, place).device, key);
+  }
+}
+
+// Append the value of an attribute to the key, returns false for the block
+// attributes, whose ops are not cached.
+class AttrKeyVisitor : public boost::static_visitor<bool> {
+ public:
+  explicit AttrKeyVisitor(std::string* key) : key_(key) {}
+
+  bool operator()(const boost::blank&) const { return true; }
+
+  bool operator()(framework::BlockDesc*) const { return false; }
+
+  bool operator()(const std::vector<framework::BlockDesc*>&) const {
+    return false;
+  }
+
+  bool operator()(const std::string& value) const {
+    AppendKey(value, key_);
+    return true;
+  }
+
+  bool operator()(const std::vector<std::string>& value) const {
+    AppendKey(value.size(), key_);
+    for (auto& item : value) {
+      AppendKey(item, key_);
+    }
+    return true;
+  }
+
+  bool operator()(const std::vector<bool>& value) const {
+    AppendKey(value.size(), key_);
+    for (bool item : value) {
+      AppendKey(item, key_);
+    }
+    return true;
+  }
+
+  template <typename T>
+  bool operator()(const std::vector<T>& value) const {
+    AppendKey(value.size(), key_);
+    key_->append(reinterpret_cast<const char*>(value.data()),
+                 value.size() * sizeof(T));
+    return true;
+  }
+
+  template <typename T>
+  bool operator()(const T& value) const {
+    AppendKey(value, key_);
+    return true;
+  }
+
+ private:
+  std::string* key_;
+};
+
+static void AppendVarsKey(const NameVarBaseMap& vars, bool with_tensor,
+                          std::string* key) {
+  for (const auto& pair : vars) {
+    AppendKey(pair.first, key);
+    AppendKey(pair.second.size(), key);
+    if (!with_tensor) {
+      continue;
+    }
+    for (const auto& var : pair.second) {
+      if (var == nullptr || !var->Var().IsInitialized()) {
+        AppendKey(-1, key);
+        continue;
+      }
+      AppendKey(var->Var().Type(), key);
+      const auto* tensor = GetTensorFromVar(var->Var());
+      if (tensor == nullptr || !tensor->IsInitialized()) {
+        AppendKey(-1, key);
+        continue;
+      }
+      AppendKey(static_cast<int>(tensor->type()), key);
+      AppendKey(static_cast<int>(tensor->layout()), key);
+      AppendKey(tensor->place(), key);
+    }
+  }
+}
+
+// The signature of a traced op, which decides the checked attributes and
+// the kernel of the op: the type, the attributes, the place, the input
+// variable types, data types, layouts and places, and the output slots.
+// Returns false if the op can not be cached.
+static bool OpCacheKey(const std::string& type, const NameVarBaseMap& ins,
+                       const NameVarBaseMap& outs,
+                       const framework::AttributeMap& attrs,
+                       const platform::Place& place, std::string* key) {
+  key->clear();
+  AppendKey(type, key);
+  AppendKey(place, key);
+  AppendVarsKey(ins, true, key);
+  AppendVarsKey(outs, false, key);
+
+  // the order of an unordered_map differs with the insertion order
+  std::vector<const framework::AttributeMap::value_type*> sorted_attrs;
+  sorted_attrs.reserve(attrs.size());
+  for (const auto& attr : attrs) {
+    sorted_attrs.push_back(&attr);
+  }
+  std::sort(sorted_attrs.begin(), sorted_attrs.end(),
+            [](const framework::AttributeMap::value_type* a,
+               const framework::AttributeMap::value_type* b) {
+              return a->first < b->first;
+            });
+  AttrKeyVisitor visitor(key);
+  for (const auto* attr : sorted_attrs) {
+    AppendKey(attr->first, key);
+    AppendKey(attr->second.which(), key);
+    if (!boost::apply_visitor(visitor, attr->second)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void Tracer::TraceOp(const std::string& type, const NameVarBaseMap& ins,
                      const NameVarBaseMap& outs, framework::AttributeMap attrs,
                      const platform::Place& place, bool trace_backward) {
@@ -73,21 +209,54 @@ void Tracer::TraceOp(const std::string& type, const NameVarBaseMap& ins,
       attrs["use_mkldnn"] = !is_off;
     }
   }
-  auto op = framework::OpRegistry::CreateOp(type, {}, {}, {}, false);
-  const auto& op_info = op->Info();
-  auto* attr_checker = op_info.Checker();
-  if (attr_checker) {
-    attr_checker->Check(&attrs, true);
-  }
-
   NameVarBaseMap new_ins = ins;
   if (enable_autocast_) {
     VLOG(5) << "Auto mixed precision run operator: " << type;
     new_ins = AutoCastInputs(type, ins);
   }
 
+  // The ops of a cached signature reuse the op, the checked attributes and
+  // the kernel. MKLDNN kernels read the attributes of the op, which are
+  // not cached.
+  std::string cache_key;
+  bool use_cache = FLAGS_tracer_op_cache_capacity > 0 && !FLAGS_use_mkldnn &&
+                   OpCacheKey(type, new_ins, outs, attrs, place, &cache_key);
+  std::shared_ptr<framework::OperatorBase> op;
+  std::unique_ptr<PreparedOp>* prepared_op = nullptr;
+  const framework::AttributeMap* op_attrs = &attrs;
+  auto cache_iter = use_cache ? op_cache_.find(cache_key) : op_cache_.end();
+  if (cache_iter != op_cache_.end()) {
+    VLOG(5) << "Reuse the cached op and kernel of " << type;
+    op = cache_iter->second.op;
+    op_attrs = &cache_iter->second.attrs;
+    prepared_op = &cache_iter->second.prepared_op;
+  } else {
+    op = framework::OpRegistry::CreateOp(type, {}, {}, {}, false);
+    const auto& op_info = op->Info();
+    auto* attr_checker = op_info.Checker();
+    if (attr_checker) {
+      attr_checker->Check(&attrs, true);
+    }
+    if (use_cache) {
+      if (op_cache_.size() >=
+          static_cast<size_t>(FLAGS_tracer_op_cache_capacity)) {
+        VLOG(3) << "Clear the " << op_cache_.size() << " cached ops";
+        op_cache_.clear();
+      }
+      auto& cached_op = op_cache_[cache_key];
+      cached_op.op = op;
+      cached_op.attrs = attrs;
+      op_attrs = &cached_op.attrs;
+      prepared_op = &cached_op.prepared_op;
+    }
+  }
+
   try {
-    OpBase::Run(*op, new_ins, outs, attrs, place);
+    if (prepared_op) {
+      OpBase::Run(*op, new_ins, outs, *op_attrs, place, prepared_op);
+    } else {
+      OpBase::Run(*op, new_ins, outs, *op_attrs, place);
+    }
   } catch (platform::EnforceNotMet& exception) {
     framework::AppendErrorOpHint(type, &exception);
     throw std::move(exception);
@@ -106,11 +275,11 @@ void Tracer::TraceOp(const std::string& type, const NameVarBaseMap& ins,
 
   if (enable_program_desc_tracing_) {
     VLOG(5) << "Trace op " << type << " into ProgramDesc";
-    program_desc_tracer_->InsertOp(type, new_ins, outs, attrs);
+    program_desc_tracer_->InsertOp(type, new_ins, outs, *op_attrs);
   }
 
   if (ComputeRequiredGrad(new_ins, outs, trace_backward)) {
-    CreateGradOpNode(*op, new_ins, outs, attrs, place);
+    CreateGradOpNode(*op, new_ins, outs, *op_attrs, place);
   } else {
     VLOG(3) << "No Grad to track for Op: " << type;
   }
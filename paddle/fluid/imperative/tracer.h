@@ -25,6 +25,7 @@
 #include "paddle/fluid/imperative/basic_engine.h"
 #include "paddle/fluid/imperative/jit/program_desc_tracer.h"
 #include "paddle/fluid/imperative/layer.h"
+#include "paddle/fluid/imperative/prepared_operator.h"
 #include "paddle/fluid/platform/macros.h"
 
 namespace paddle {
@@ -102,7 +103,18 @@ class Tracer {
 
   bool IsAutoCastEnabled() const { return enable_autocast_; }
 
+  size_t OpCacheSize() const { return op_cache_.size(); }
+
  private:
+  // The op, the checked attributes and the kernel of the traced ops of the
+  // same signature, which are reused when FLAGS_tracer_op_cache_capacity is
+  // positive.
+  struct CachedOp {
+    std::shared_ptr<framework::OperatorBase> op;
+    framework::AttributeMap attrs;
+    std::unique_ptr<PreparedOp> prepared_op;
+  };
+
   std::unique_ptr<BasicEngine> basic_engine_;
   std::unique_ptr<jit::ProgramDescTracer> program_desc_tracer_;
   bool enable_program_desc_tracing_{false};
@@ -110,6 +122,7 @@ class Tracer {
   platform::Place expected_place_;
   bool has_grad_{true};
   bool enable_autocast_{false};
+  std::unordered_map<std::string, CachedOp> op_cache_;
 };
 
 // To access static variable current_tracer
@@ -114,6 +114,8 @@ AnalysisConfig::AnalysisConfig(const AnalysisConfig &other) {
   CP_MEMBER(memory_pool_init_size_mb_);
 
   CP_MEMBER(enable_memory_optim_);
+  CP_MEMBER(static_memory_plan_);
+  CP_MEMBER(shared_weights_);
   // TensorRT related.
   CP_MEMBER(use_tensorrt_);
   CP_MEMBER(tensorrt_workspace_size_);
@@ -439,6 +441,8 @@ std::string AnalysisConfig::SerializeInfoCache() {
   ss << tensorrt_min_subgraph_size_;
 
   ss << enable_memory_optim_;
+  ss << static_memory_plan_;
+  ss << shared_weights_;
 
   ss << use_mkldnn_;
   ss << mkldnn_cache_capacity_;
@@ -503,6 +507,16 @@ bool AnalysisConfig::enable_memory_optim() const {
   return enable_memory_optim_;
 }
 
+void AnalysisConfig::EnableStaticMemoryPlan(bool x) {
+  static_memory_plan_ = x;
+  Update();
+}
+
+void AnalysisConfig::EnableSharedWeights(bool x) {
+  shared_weights_ = x;
+  Update();
+}
+
 void AnalysisConfig::SetModelBuffer(const char *prog_buffer,
                                     size_t prog_buffer_size,
                                     const char *param_buffer,
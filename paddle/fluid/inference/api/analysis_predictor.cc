@@ -18,7 +18,9 @@
 #include <fstream>
 #include <memory>
 #include <set>
+#include <sstream>
 #include <string>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 #include "paddle/fluid/framework/feed_fetch_method.h"
@@ -161,6 +163,30 @@ bool AnalysisPredictor::Init(
   // Get the feed_target_names and fetch_target_names
   PrepareFeedFetch();
 
+  if (config_.static_memory_plan_enabled()) {
+    std::vector<std::string> skip_vars;
+    for (auto &item : idx2feeds_) {
+      skip_vars.push_back(item.second);
+    }
+    for (auto &item : idx2fetches_) {
+      skip_vars.push_back(item.second);
+    }
+    executor_->EnableStaticMemoryPlan(skip_vars);
+  }
+
+  if (config_.shared_weights_enabled()) {
+    for (auto *var : inference_program_->Block(0).AllVars()) {
+      if (var->Persistable() && var->Name() != "feed" &&
+          var->Name() != "fetch") {
+        persistable_names_.push_back(var->Name());
+      }
+    }
+    if (!status_is_cloned_) {
+      FreezeSharedWeights();
+    }
+    CheckSharedWeights();
+  }
+
   return true;
 }
 
@@ -325,6 +351,7 @@ bool AnalysisPredictor::Run(const std::vector<PaddleTensor> &inputs,
   // Run the inference program
   // if share variables, we need not create variables
   executor_->Run();
+  CheckSharedWeights();
 
   // get fetch variable
   if (!GetFetch(output_data, scope)) {
@@ -774,6 +801,7 @@ bool AnalysisPredictor::ZeroCopyRun() {
 #endif
 
   executor_->Run();
+  CheckSharedWeights();
   // Fix TensorArray reuse not cleaned bug.
   tensor_array_batch_cleaner_.CollectTensorArrays(sub_scope_);
   tensor_array_batch_cleaner_.ResetTensorArray();
@@ -1005,10 +1033,90 @@ AnalysisPredictor::~AnalysisPredictor() {
 std::unique_ptr<PaddlePredictor> AnalysisPredictor::Clone() {
   std::lock_guard<std::mutex> lk(clone_mutex_);
   auto *x = new AnalysisPredictor(config_);
+  x->shared_weights_ = shared_weights_;
   x->Init(scope_, inference_program_);
   return std::unique_ptr<PaddlePredictor>(x);
 }
 
+void AnalysisPredictor::FreezeSharedWeights() {
+  auto weights = std::make_shared<SharedWeights>();
+  for (auto &name : scope_->LocalVarNames()) {
+    auto *var = scope_->FindLocalVar(name);
+    if (!var->IsType<framework::LoDTensor>()) continue;
+    auto &tensor = var->Get<framework::LoDTensor>();
+    if (!tensor.IsInitialized()) continue;
+    weights->names.push_back(name);
+    weights->tensors.push_back(&tensor);
+    weights->holders.push_back(tensor.Holder().get());
+  }
+  VLOG(3) << "Freeze " << weights->names.size() << " shared weights";
+  shared_weights_ = weights;
+}
+
+void AnalysisPredictor::CheckSharedWeights() const {
+  if (!shared_weights_) return;
+  auto &weights = *shared_weights_;
+  for (size_t i = 0; i < weights.tensors.size(); ++i) {
+    PADDLE_ENFORCE_EQ(
+        weights.tensors[i]->Holder().get() == weights.holders[i], true,
+        platform::errors::PreconditionNotMet(
+            "The shared weight %s is reallocated by a run, the weights "
+            "shared by the predictor clones must be read-only.",
+            weights.names[i]));
+  }
+  for (auto &name : persistable_names_) {
+    PADDLE_ENFORCE_EQ(
+        sub_scope_->FindLocalVar(name) == nullptr, true,
+        platform::errors::PreconditionNotMet(
+            "The persistable variable %s is created in the scope of a "
+            "predictor, it must be held by the shared root scope.",
+            name));
+  }
+}
+
+PredictorMemoryReport AnalysisPredictor::GetMemoryReport() const {
+  PredictorMemoryReport report;
+  std::unordered_set<const void *> shared_holders;
+  for (auto &name : scope_->LocalVarNames()) {
+    auto *var = scope_->FindLocalVar(name);
+    if (!var->IsType<framework::LoDTensor>()) continue;
+    auto &holder = var->Get<framework::LoDTensor>().Holder();
+    if (!holder) continue;
+    ++report.shared_var_num;
+    if (shared_holders.insert(holder.get()).second) {
+      report.shared_bytes += holder->size();
+    }
+  }
+  // The private tensors may be slices of one arena, the overlapping ranges
+  // are counted once.
+  std::vector<std::pair<uintptr_t, uintptr_t>> ranges;
+  for (auto &name : sub_scope_->LocalVarNames()) {
+    auto *var = sub_scope_->FindLocalVar(name);
+    if (!var->IsType<framework::LoDTensor>()) continue;
+    auto &holder = var->Get<framework::LoDTensor>().Holder();
+    if (!holder || shared_holders.count(holder.get())) continue;
+    ++report.private_var_num;
+    auto begin = reinterpret_cast<uintptr_t>(holder->ptr());
+    ranges.emplace_back(begin, begin + holder->size());
+  }
+  std::sort(ranges.begin(), ranges.end());
+  uintptr_t end = 0;
+  for (auto &range : ranges) {
+    if (range.second <= end) continue;
+    report.private_bytes += range.second - std::max(range.first, end);
+    end = range.second;
+  }
+  return report;
+}
+
+std::string PredictorMemoryReport::DebugString() const {
+  std::stringstream ss;
+  ss << "shared: " << shared_bytes << " bytes in " << shared_var_num
+     << " tensors, private: " << private_bytes << " bytes in "
+     << private_var_num << " tensors";
+  return ss.str();
+}
+
 std::string AnalysisPredictor::GetSerializedProgram() const {
   return inference_program_->Proto()->SerializeAsString();
 }
@@ -49,6 +49,20 @@ using inference::analysis::Analyzer;
 using framework::proto::ProgramDesc;
 using framework::NaiveExecutor;
 
+///
+/// \brief The memory held by the tensors of a predictor. The shared bytes
+/// are held by the root scope which all the clones of a predictor reference,
+/// the private bytes by the scope of the predictor itself.
+///
+struct PredictorMemoryReport {
+  uint64_t shared_bytes{0};
+  uint64_t private_bytes{0};
+  size_t shared_var_num{0};
+  size_t private_var_num{0};
+
+  std::string DebugString() const;
+};
+
 ///
 /// \class AnalysisPredictor
 ///
@@ -217,6 +231,14 @@ class AnalysisPredictor : public PaddlePredictor {
   ///
   std::unique_ptr<PaddlePredictor> Clone() override;
   ///
+  /// \brief Get the bytes of the tensors shared with the clones and the
+  /// bytes of the tensors private to this predictor. The tensors sharing
+  /// memory are counted once.
+  ///
+  /// \return the memory report of this predictor
+  ///
+  PredictorMemoryReport GetMemoryReport() const;
+  ///
   /// \brief Get the scope used by predictor
   ///
   /// \return scope
@@ -347,6 +369,17 @@ class AnalysisPredictor : public PaddlePredictor {
   ///
   void MkldnnPostReset();
 
+  ///
+  /// \brief Record the holders of the persistable tensors in the root scope,
+  /// which are shared by all the clones when the shared weights mode is on.
+  ///
+  void FreezeSharedWeights();
+  ///
+  /// \brief Enforce that the shared weights are not modified and that the
+  /// scope of this predictor holds no persistable variable.
+  ///
+  void CheckSharedWeights() const;
+
 #if PADDLE_WITH_TENSORRT
   ///
   /// \brief save calibration table
@@ -412,6 +445,16 @@ class AnalysisPredictor : public PaddlePredictor {
   std::vector<std::map<std::string, std::vector<int>>> batch_var_shapes_;
   int predictor_id_;
 
+  // The persistable tensors of the root scope and their holders when they
+  // were frozen, shared by the clones in the shared weights mode.
+  struct SharedWeights {
+    std::vector<std::string> names;
+    std::vector<const framework::LoDTensor *> tensors;
+    std::vector<const void *> holders;
+  };
+  std::shared_ptr<const SharedWeights> shared_weights_;
+  std::vector<std::string> persistable_names_;
+
  private:
   // Some status here that help to determine the status inside the predictor.
   bool status_is_cloned_{false};
@@ -194,6 +194,43 @@ TEST(AnalysisPredictor, Clone) {
   }
 }
 
+TEST(AnalysisPredictor, SharedWeights) {
+  AnalysisConfig config;
+  config.SetModel(FLAGS_dirname);
+  config.SwitchIrOptim(true);
+  config.EnableSharedWeights();
+
+  std::vector<std::unique_ptr<PaddlePredictor>> predictors;
+  predictors.emplace_back(CreatePaddlePredictor(config));
+  for (int i = 1; i < 3; i++) {
+    predictors.emplace_back(predictors.front()->Clone());
+  }
+
+  int64_t data[4] = {1, 2, 3, 4};
+  PaddleTensor tensor;
+  tensor.shape = std::vector<int>({4, 1});
+  tensor.data.Reset(data, sizeof(data));
+  tensor.dtype = PaddleDType::INT64;
+  std::vector<PaddleTensor> inputs(4, tensor);
+
+  std::vector<PredictorMemoryReport> reports;
+  for (auto& predictor : predictors) {
+    std::vector<PaddleTensor> outputs;
+    ASSERT_TRUE(predictor->Run(inputs, &outputs));
+    auto* analysis_predictor = static_cast<AnalysisPredictor*>(predictor.get());
+    reports.push_back(analysis_predictor->GetMemoryReport());
+    LOG(INFO) << reports.back().DebugString();
+  }
+  // the weights are held once by the root scope
+  EXPECT_GT(reports[0].shared_bytes, 0UL);
+  for (auto& report : reports) {
+    EXPECT_EQ(report.shared_bytes, reports[0].shared_bytes);
+    EXPECT_EQ(report.shared_var_num, reports[0].shared_var_num);
+    EXPECT_GT(report.private_bytes, 0UL);
+    EXPECT_LT(report.private_bytes, report.shared_bytes);
+  }
+}
+
 // This function is not released yet, will fail on some machine.
 // TODO(Superjomn) Turn on it latter.
 /*
@@ -490,6 +490,38 @@ struct PD_INFER_DECL AnalysisConfig {
   ///
   bool enable_memory_optim() const;
 
+  ///
+  /// \brief Turn on the static memory plan of the executor. The first run
+  /// records the sizes of the intermediate tensors, which are laid out in
+  /// one arena for the later runs. The runs with larger inputs plan again.
+  ///
+  /// \param x Whether the static memory plan is turned on.
+  ///
+  void EnableStaticMemoryPlan(bool x = true);
+  ///
+  /// \brief A boolean state telling whether the static memory plan is
+  /// turned on.
+  ///
+  /// \return bool Whether the static memory plan is turned on.
+  ///
+  bool static_memory_plan_enabled() const { return static_memory_plan_; }
+
+  ///
+  /// \brief Turn on the shared weights mode. The persistable tensors are
+  /// held by the root scope which all the clones reference, the scope of a
+  /// clone holds only the activations. The runs enforce that the shared
+  /// weights are not modified and that no clone creates its own copy.
+  ///
+  /// \param x Whether the shared weights mode is turned on.
+  ///
+  void EnableSharedWeights(bool x = true);
+  ///
+  /// \brief A boolean state telling whether the shared weights mode is on.
+  ///
+  /// \return bool Whether the shared weights mode is on.
+  ///
+  bool shared_weights_enabled() const { return shared_weights_; }
+
   ///
   /// \brief Turn on profiling report.
   /// If not turned on, no profiling report will be generated.
@@ -591,6 +623,8 @@ struct PD_INFER_DECL AnalysisConfig {
 
   // memory reuse related.
   bool enable_memory_optim_{false};
+  bool static_memory_plan_{false};
+  bool shared_weights_{false};
 
   bool use_mkldnn_{false};
   std::unordered_set<std::string> mkldnn_enabled_op_types_;
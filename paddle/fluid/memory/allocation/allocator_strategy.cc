@@ -38,9 +38,12 @@ static AllocatorStrategy GetStrategyFromFlag() {
   if (FLAGS_allocator_strategy == "sample_pool") {
     return AllocatorStrategy::kSamplePool;
   }
+  if (FLAGS_allocator_strategy == "thread_cache") {
+    return AllocatorStrategy::kThreadCache;
+  }
   PADDLE_THROW(platform::errors::InvalidArgument(
       "Unsupported allocator strategy: %s, condicates are naive_best_fit, "
-      "auto_growth or thread_local.",
+      "auto_growth, thread_local, sample_pool or thread_cache.",
       FLAGS_allocator_strategy));
 }
 
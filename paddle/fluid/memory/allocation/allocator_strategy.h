@@ -22,7 +22,8 @@ enum class AllocatorStrategy {
   kNaiveBestFit,
   kAutoGrowth,
   kThreadLocal,
-  kSamplePool
+  kSamplePool,
+  kThreadCache
 };
 
 extern AllocatorStrategy GetAllocatorStrategy();
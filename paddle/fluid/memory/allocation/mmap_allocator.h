@@ -58,9 +58,45 @@ class MemoryMapReaderAllocation : public Allocation {
   std::string ipc_name_;
 };
 
+// A regular file mapped privately. The pages are shared with the page cache
+// until they are written, then only the written pages are copied, the file
+// itself is never modified.
+class MemoryMapFileAllocation : public Allocation {
+ public:
+  explicit MemoryMapFileAllocation(void *ptr, size_t size,
+                                   std::string file_name)
+      : Allocation(ptr, size, platform::CPUPlace()),
+        file_name_(std::move(file_name)) {}
+
+  inline const std::string &file_name() const { return file_name_; }
+
+  ~MemoryMapFileAllocation() override;
+
+ private:
+  std::string file_name_;
+};
+
+// [offset, offset + size) of a MemoryMapFileAllocation, the holder of the
+// tensors aliasing a mapped file. It keeps the whole mapping alive.
+class MemoryMapFileSliceAllocation : public Allocation {
+ public:
+  explicit MemoryMapFileSliceAllocation(
+      std::shared_ptr<MemoryMapFileAllocation> file, size_t offset,
+      size_t size)
+      : Allocation(static_cast<char *>(file->ptr()) + offset, size,
+                   platform::CPUPlace()),
+        file_(std::move(file)) {}
+
+ private:
+  std::shared_ptr<MemoryMapFileAllocation> file_;
+};
+
 std::shared_ptr<MemoryMapWriterAllocation> AllocateMemoryMapWriterAllocation(
     size_t size);
 
+std::shared_ptr<MemoryMapFileAllocation> AllocateMemoryMapFileAllocation(
+    const std::string &file_name);
+
 std::shared_ptr<MemoryMapReaderAllocation> RebuildMemoryMapReaderAllocation(
     const std::string &ipc_name, size_t size);
 
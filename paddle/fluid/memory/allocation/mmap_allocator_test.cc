@@ -16,6 +16,13 @@
 
 #include "paddle/fluid/memory/allocation/mmap_allocator.h"
 
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 namespace paddle {
@@ -45,6 +52,39 @@ TEST(MemoryMapAllocation, test_allocation_base) {
   }
 }
 
+TEST(MemoryMapAllocation, test_file_allocation) {
+  const std::string file_name =
+      "mmap_allocator_test_" + std::to_string(getpid()) + ".data";
+  std::vector<int32_t> data(1024);
+  for (int32_t i = 0; i < 1024; ++i) {
+    data[i] = i;
+  }
+  {
+    std::ofstream fout(file_name, std::ios::binary);
+    fout.write(reinterpret_cast<const char*>(data.data()),
+               data.size() * sizeof(int32_t));
+  }
+  auto file_holder = AllocateMemoryMapFileAllocation(file_name);
+  ASSERT_EQ(file_holder->size(), data.size() * sizeof(int32_t));
+  auto slice_holder = std::make_shared<MemoryMapFileSliceAllocation>(
+      file_holder, 512 * sizeof(int32_t), 512 * sizeof(int32_t));
+  file_holder.reset();
+  // the slice keeps the mapping alive
+  auto* slice_ptr = static_cast<int32_t*>(slice_holder->ptr());
+  for (int32_t i = 0; i < 512; ++i) {
+    ASSERT_EQ(slice_ptr[i], 512 + i);
+    slice_ptr[i] = -1;
+  }
+  slice_holder.reset();
+  // writes to the mapped pages never reach the file
+  std::ifstream fin(file_name, std::ios::binary);
+  std::vector<int32_t> reload(1024);
+  fin.read(reinterpret_cast<char*>(reload.data()),
+           reload.size() * sizeof(int32_t));
+  ASSERT_EQ(reload, data);
+  std::remove(file_name.c_str());
+}
+
 }  // namespace allocation
 }  // namespace memory
 }  // namespace paddle
@@ -0,0 +1,411 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/memory/allocation/thread_cache_cpu_allocator.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+#include "paddle/fluid/memory/allocation/cpu_allocator.h"
+#include "paddle/fluid/platform/cpu_info.h"
+#include "paddle/fluid/string/printf.h"
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+namespace {
+
+// 16 classes of 64 bytes steps up to 1KB, then 4 classes per power of two
+// up to kMaxSmallSize
+constexpr int kTinyClassNum = 16;
+constexpr int kClassNum = kTinyClassNum + 8 * 4;
+// the bytes a thread caches per size class, and a chunk carves at least
+constexpr size_t kCacheBytesPerClass = 256 << 10;
+constexpr size_t kMinChunkBytes = 256 << 10;
+constexpr size_t kMaxCachedNum = 256;
+// the thread caches fold their counters every kStatsBatch operations
+constexpr uint32_t kStatsBatch = 256;
+
+int SizeClassOf(size_t size) {
+  if (size <= 1024) {
+    return size == 0 ? 0 : static_cast<int>((size - 1) / 64);
+  }
+  // size is in (2^lg, 2^(lg + 1)]
+  int lg = 10;
+  while ((2UL << lg) < size) {
+    ++lg;
+  }
+  size_t step = 1UL << (lg - 2);
+  int idx = static_cast<int>((size - 1 - (1UL << lg)) / step);
+  return kTinyClassNum + (lg - 10) * 4 + idx;
+}
+
+size_t ClassSize(int cls) {
+  if (cls < kTinyClassNum) {
+    return (cls + 1) * 64;
+  }
+  int lg = (cls - kTinyClassNum) / 4 + 10;
+  int idx = (cls - kTinyClassNum) % 4;
+  return (1UL << lg) + (idx + 1) * (1UL << (lg - 2));
+}
+
+size_t MaxCachedNum(int cls) {
+  return std::max<size_t>(
+      2, std::min(kMaxCachedNum, kCacheBytesPerClass / ClassSize(cls)));
+}
+
+size_t BatchNum(int cls) { return std::max<size_t>(1, MaxCachedNum(cls) / 2); }
+
+std::atomic<uint64_t> g_heap_id(0);
+
+}  // namespace
+
+class ThreadCacheCPUHeap {
+ public:
+  ThreadCacheCPUHeap()
+      : id_(++g_heap_id),
+        node_num_(platform::NumaNodeNum()),
+        underlying_(std::make_shared<CPUAllocator>()),
+        nodes_(node_num_) {}
+
+  ~ThreadCacheCPUHeap() {
+    for (auto& node : nodes_) {
+      for (auto* block : node.blocks) {
+        delete block;
+      }
+    }
+  }
+
+  uint64_t id() const { return id_; }
+
+  // Move num blocks of cls into blocks, a chunk is carved on node if the
+  // central list of the node is short.
+  void Fetch(int node, int cls, size_t num,
+             std::vector<ThreadCacheAllocation*>* blocks) {
+    FreeList& list = nodes_[node].lists[cls];
+    {
+      std::lock_guard<std::mutex> lock(list.mutex);
+      size_t take = std::min(num, list.blocks.size());
+      blocks->insert(blocks->end(), list.blocks.end() - take,
+                     list.blocks.end());
+      list.blocks.resize(list.blocks.size() - take);
+      num -= take;
+    }
+    if (num > 0) {
+      Carve(node, cls, num, blocks);
+    }
+  }
+
+  // Return the blocks of cls to the central lists of their nodes.
+  void Release(int cls, ThreadCacheAllocation* const* blocks, size_t num) {
+    size_t i = 0;
+    while (i < num) {
+      int node = blocks[i]->node();
+      FreeList& list = nodes_[node].lists[cls];
+      std::lock_guard<std::mutex> lock(list.mutex);
+      for (; i < num && blocks[i]->node() == node; ++i) {
+        list.blocks.push_back(blocks[i]);
+      }
+    }
+  }
+
+  ThreadCacheAllocation* AllocateLarge(size_t size) {
+    auto* allocation =
+        new ThreadCacheAllocation(underlying_->Allocate(size));
+    reserved_bytes_ += allocation->size();
+    allocated_bytes_ += allocation->size();
+    return allocation;
+  }
+
+  void FreeLarge(ThreadCacheAllocation* allocation) {
+    reserved_bytes_ -= allocation->size();
+    allocated_bytes_ -= allocation->size();
+    delete allocation;
+  }
+
+  void AddStats(uint64_t hits, uint64_t misses, int64_t allocated) {
+    cache_hits_.fetch_add(hits, std::memory_order_relaxed);
+    cache_misses_.fetch_add(misses, std::memory_order_relaxed);
+    allocated_bytes_.fetch_add(allocated, std::memory_order_relaxed);
+  }
+
+  ThreadCacheCPUStats GetStats() const {
+    ThreadCacheCPUStats stats;
+    stats.reserved_bytes = reserved_bytes_.load();
+    stats.allocated_bytes =
+        static_cast<uint64_t>(std::max<int64_t>(0, allocated_bytes_.load()));
+    stats.cache_hits = cache_hits_.load();
+    stats.cache_misses = cache_misses_.load();
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+      // ru_maxrss is in KB on linux
+      stats.peak_rss_bytes = static_cast<uint64_t>(usage.ru_maxrss) << 10;
+    }
+#endif
+    return stats;
+  }
+
+ private:
+  struct FreeList {
+    std::mutex mutex;
+    std::vector<ThreadCacheAllocation*> blocks;
+  };
+
+  struct Node {
+    FreeList lists[kClassNum];
+    std::mutex chunk_mutex;
+    std::vector<AllocationPtr> chunks;
+    // every block ever carved, deleted with the heap
+    std::vector<ThreadCacheAllocation*> blocks;
+  };
+
+  void Carve(int node, int cls, size_t num,
+             std::vector<ThreadCacheAllocation*>* blocks) {
+    const size_t size = ClassSize(cls);
+    size_t block_num = std::max(num, BatchNum(cls));
+    block_num = std::max(block_num, kMinChunkBytes / size);
+    AllocationPtr chunk = underlying_->Allocate(block_num * size);
+    char* base = static_cast<char*>(chunk->ptr());
+    if (node_num_ > 1) {
+      // the caller runs on node, place the pages there by first touch
+      memset(base, 0, chunk->size());
+    }
+    std::vector<ThreadCacheAllocation*> carved(block_num);
+    for (size_t i = 0; i < block_num; ++i) {
+      carved[i] = new ThreadCacheAllocation(base + i * size, size, cls, node);
+    }
+    reserved_bytes_ += chunk->size();
+    {
+      std::lock_guard<std::mutex> lock(nodes_[node].chunk_mutex);
+      nodes_[node].chunks.emplace_back(std::move(chunk));
+      nodes_[node].blocks.insert(nodes_[node].blocks.end(), carved.begin(),
+                                 carved.end());
+    }
+    blocks->insert(blocks->end(), carved.end() - num, carved.end());
+    Release(cls, carved.data(), block_num - num);
+  }
+
+  uint64_t id_;
+  int node_num_;
+  // destroyed after the chunks of the nodes
+  std::shared_ptr<Allocator> underlying_;
+  std::vector<Node> nodes_;
+  std::atomic<uint64_t> reserved_bytes_{0};
+  std::atomic<int64_t> allocated_bytes_{0};
+  std::atomic<uint64_t> cache_hits_{0};
+  std::atomic<uint64_t> cache_misses_{0};
+};
+
+namespace {
+
+class ThreadCache {
+ public:
+  explicit ThreadCache(std::shared_ptr<ThreadCacheCPUHeap> heap)
+      : heap_(std::move(heap)), node_(platform::CurrentNumaNode()) {
+    for (int cls = 0; cls < kClassNum; ++cls) {
+      lists_[cls].reserve(MaxCachedNum(cls) + 1);
+    }
+  }
+
+  ~ThreadCache() {
+    for (int cls = 0; cls < kClassNum; ++cls) {
+      heap_->Release(cls, lists_[cls].data(), lists_[cls].size());
+    }
+    FoldStats();
+  }
+
+  Allocation* Allocate(int cls) {
+    auto& list = lists_[cls];
+    if (list.empty()) {
+      ++misses_;
+      heap_->Fetch(node_, cls, BatchNum(cls), &list);
+    } else {
+      ++hits_;
+    }
+    ThreadCacheAllocation* allocation = list.back();
+    list.pop_back();
+    allocated_ += allocation->size();
+    if (++ops_ == kStatsBatch) {
+      FoldStats();
+    }
+    return allocation;
+  }
+
+  void Free(ThreadCacheAllocation* allocation) {
+    const int cls = allocation->size_class();
+    auto& list = lists_[cls];
+    list.push_back(allocation);
+    allocated_ -= allocation->size();
+    if (list.size() > MaxCachedNum(cls)) {
+      // flush the oldest half, the recently freed blocks are warm
+      size_t num = BatchNum(cls);
+      heap_->Release(cls, list.data(), num);
+      list.erase(list.begin(), list.begin() + num);
+    }
+    if (++ops_ == kStatsBatch) {
+      FoldStats();
+    }
+  }
+
+  void FoldStats() {
+    heap_->AddStats(hits_, misses_, allocated_);
+    hits_ = 0;
+    misses_ = 0;
+    allocated_ = 0;
+    ops_ = 0;
+  }
+
+  bool unique() const { return heap_.use_count() == 1; }
+
+ private:
+  std::shared_ptr<ThreadCacheCPUHeap> heap_;
+  int node_;
+  std::vector<ThreadCacheAllocation*> lists_[kClassNum];
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+  int64_t allocated_ = 0;
+  uint32_t ops_ = 0;
+};
+
+// The thread caches of a thread, one per heap.
+class ThreadCacheRegistry {
+ public:
+  // nullptr if the thread is exiting and its caches are destroyed
+  static ThreadCache* Get(const std::shared_ptr<ThreadCacheCPUHeap>& heap) {
+    static thread_local bool destroyed = false;
+    static thread_local ThreadCacheRegistry registry(&destroyed);
+    if (destroyed) {
+      return nullptr;
+    }
+    if (registry.last_id_ == heap->id()) {
+      return registry.last_;
+    }
+    auto it = registry.caches_.find(heap->id());
+    if (it == registry.caches_.end()) {
+      registry.RemoveUnusedCaches();
+      it = registry.caches_
+               .emplace(heap->id(),
+                        std::unique_ptr<ThreadCache>(new ThreadCache(heap)))
+               .first;
+    }
+    registry.last_id_ = heap->id();
+    registry.last_ = it->second.get();
+    return registry.last_;
+  }
+
+ private:
+  explicit ThreadCacheRegistry(bool* destroyed) : destroyed_(destroyed) {}
+
+  ~ThreadCacheRegistry() {
+    *destroyed_ = true;
+    caches_.clear();
+  }
+
+  // drop the caches of the destroyed allocators, they hold the last
+  // reference of their heaps
+  void RemoveUnusedCaches() {
+    for (auto it = caches_.begin(); it != caches_.end();) {
+      if (it->second->unique()) {
+        it = caches_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    last_id_ = 0;
+    last_ = nullptr;
+  }
+
+  bool* destroyed_;
+  uint64_t last_id_ = 0;
+  ThreadCache* last_ = nullptr;
+  std::unordered_map<uint64_t, std::unique_ptr<ThreadCache>> caches_;
+};
+
+}  // namespace
+
+double ThreadCacheCPUStats::Fragmentation() const {
+  if (reserved_bytes == 0 || allocated_bytes >= reserved_bytes) {
+    return 0;
+  }
+  return 1.0 - static_cast<double>(allocated_bytes) / reserved_bytes;
+}
+
+double ThreadCacheCPUStats::CacheHitRate() const {
+  uint64_t total = cache_hits + cache_misses;
+  return total == 0 ? 0 : static_cast<double>(cache_hits) / total;
+}
+
+std::string ThreadCacheCPUStats::DebugString() const {
+  return string::Sprintf(
+      "reserved: %.2fMB, allocated: %.2fMB, fragmentation: %.4f, thread cache "
+      "hit rate: %.4f, peak rss: %.2fMB",
+      reserved_bytes / 1048576.0, allocated_bytes / 1048576.0,
+      Fragmentation(), CacheHitRate(), peak_rss_bytes / 1048576.0);
+}
+
+ThreadCacheCPUAllocator::ThreadCacheCPUAllocator()
+    : heap_(std::make_shared<ThreadCacheCPUHeap>()) {}
+
+ThreadCacheCPUAllocator::~ThreadCacheCPUAllocator() {
+  VLOG(1) << "ThreadCacheCPUAllocator " << heap_->GetStats().DebugString();
+}
+
+ThreadCacheCPUStats ThreadCacheCPUAllocator::GetStats() const {
+  ThreadCache* cache = ThreadCacheRegistry::Get(heap_);
+  if (cache != nullptr) {
+    cache->FoldStats();
+  }
+  return heap_->GetStats();
+}
+
+Allocation* ThreadCacheCPUAllocator::AllocateImpl(size_t size) {
+  if (size > kMaxSmallSize) {
+    return heap_->AllocateLarge(size);
+  }
+  const int cls = SizeClassOf(size);
+  ThreadCache* cache = ThreadCacheRegistry::Get(heap_);
+  if (cache == nullptr) {
+    std::vector<ThreadCacheAllocation*> blocks;
+    heap_->Fetch(0, cls, 1, &blocks);
+    heap_->AddStats(0, 1, blocks[0]->size());
+    return blocks[0];
+  }
+  return cache->Allocate(cls);
+}
+
+void ThreadCacheCPUAllocator::FreeImpl(Allocation* allocation) {
+  auto* tc_allocation = static_cast<ThreadCacheAllocation*>(allocation);
+  if (tc_allocation->size_class() < 0) {
+    heap_->FreeLarge(tc_allocation);
+    return;
+  }
+  ThreadCache* cache = ThreadCacheRegistry::Get(heap_);
+  if (cache == nullptr) {
+    heap_->AddStats(0, 0, -static_cast<int64_t>(tc_allocation->size()));
+    heap_->Release(tc_allocation->size_class(), &tc_allocation, 1);
+    return;
+  }
+  cache->Free(tc_allocation);
+}
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
@@ -0,0 +1,112 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "paddle/fluid/memory/allocation/allocator.h"
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+struct ThreadCacheCPUStats {
+  // the bytes of the chunks taken from the system
+  uint64_t reserved_bytes = 0;
+  // the bytes of the live allocations, rounded to their size classes
+  uint64_t allocated_bytes = 0;
+  // the small allocations served by the thread caches or not
+  uint64_t cache_hits = 0;
+  uint64_t cache_misses = 0;
+  uint64_t peak_rss_bytes = 0;
+
+  double Fragmentation() const;
+  double CacheHitRate() const;
+  std::string DebugString() const;
+};
+
+class ThreadCacheCPUHeap;
+
+class ThreadCacheAllocation : public Allocation {
+ public:
+  // a block of size_class carved from a chunk of node
+  ThreadCacheAllocation(void* ptr, size_t size, int size_class, int node)
+      : Allocation(ptr, size, platform::CPUPlace()),
+        size_class_(size_class),
+        node_(node) {}
+
+  // a large allocation taken from the system directly
+  explicit ThreadCacheAllocation(AllocationPtr underlying)
+      : Allocation(underlying->ptr(), underlying->size(),
+                   underlying->place()),
+        size_class_(-1),
+        node_(0),
+        underlying_(std::move(underlying)) {}
+
+  // -1 for the large allocations
+  int size_class() const { return size_class_; }
+  int node() const { return node_; }
+
+ private:
+  int size_class_;
+  int node_;
+  AllocationPtr underlying_;
+};
+
+/**
+ * ThreadCacheCPUAllocator serves the small CPU allocations of the op
+ * kernels, which are made and freed by many threads at a high rate.
+ *
+ * The sizes up to kMaxSmallSize are rounded to size classes. Every thread
+ * keeps a bounded free list per size class and allocates and frees without
+ * any lock. A thread refills or flushes its lists in batches from the
+ * central heap of its NUMA node, which carves the chunks it takes from the
+ * system into the blocks of a size class. The chunks of a node are first
+ * touched by a thread running on the node, so their pages are placed there.
+ * The allocation objects are cached along with the blocks, so a cache hit
+ * does not call malloc at all.
+ *
+ * The larger allocations are taken from the system directly. The chunks
+ * are kept until the allocator and all the thread caches are destroyed.
+ */
+class ThreadCacheCPUAllocator : public Allocator {
+ public:
+  static constexpr size_t kMaxSmallSize = 256 << 10;
+
+  ThreadCacheCPUAllocator();
+  ~ThreadCacheCPUAllocator();
+
+  bool IsAllocThreadSafe() const override { return true; }
+
+  // the thread caches fold their counters into the stats in batches, the
+  // counters of the calling thread are folded before they are read
+  ThreadCacheCPUStats GetStats() const;
+
+ protected:
+  Allocation* AllocateImpl(size_t size) override;
+  void FreeImpl(Allocation* allocation) override;
+
+ private:
+  std::shared_ptr<ThreadCacheCPUHeap> heap_;
+};
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
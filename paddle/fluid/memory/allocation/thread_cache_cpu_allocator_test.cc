@@ -0,0 +1,134 @@
+// Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/memory/allocation/thread_cache_cpu_allocator.h"
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstring>
+#include <random>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/memory/allocation/cpu_allocator.h"
+#include "paddle/fluid/memory/allocation/naive_best_fit_allocator.h"
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+// Every thread allocates small temporaries of random sizes, writes them and
+// frees them in a random order, as the op kernels of the workers do. A few
+// allocations are larger than the size classes.
+static double RunThreads(Allocator* allocator, int thread_num, int iters,
+                         bool with_large) {
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_num; ++t) {
+    threads.emplace_back([=]() {
+      std::mt19937 rng(t);
+      std::vector<AllocationPtr> live;
+      for (int i = 0; i < iters; ++i) {
+        size_t size = rng() % 4096 + 1;
+        if (with_large && i % 64 == 0) {
+          size = rng() % (ThreadCacheCPUAllocator::kMaxSmallSize * 2) + 1;
+        }
+        auto allocation = allocator->Allocate(size);
+        ASSERT_GE(allocation->size(), size);
+        memset(allocation->ptr(), t, size);
+        live.emplace_back(std::move(allocation));
+        if (live.size() > 16) {
+          size_t k = rng() % live.size();
+          ASSERT_EQ(*static_cast<char*>(live[k]->ptr()),
+                    static_cast<char>(t));
+          live.erase(live.begin() + k);
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+TEST(ThreadCacheCPUAllocator, SizeClasses) {
+  ThreadCacheCPUAllocator allocator;
+  for (size_t size = 1; size <= ThreadCacheCPUAllocator::kMaxSmallSize;
+       size = size * 5 / 4 + 1) {
+    auto allocation = allocator.Allocate(size);
+    EXPECT_GE(allocation->size(), size);
+    // the classes waste at most 63 bytes or a quarter of a size
+    EXPECT_LE(allocation->size(), size + std::max<size_t>(63, size / 4));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(allocation->ptr()) % 64, 0UL);
+  }
+  // a freed block is reused by the same thread
+  void* ptr = allocator.Allocate(100)->ptr();
+  EXPECT_EQ(allocator.Allocate(100)->ptr(), ptr);
+}
+
+TEST(ThreadCacheCPUAllocator, MultiThreads) {
+  ThreadCacheCPUAllocator allocator;
+  RunThreads(&allocator, 8, 20000, true);
+
+  // free the blocks allocated by another thread
+  std::vector<AllocationPtr> allocations;
+  std::thread producer([&]() {
+    for (int i = 0; i < 10000; ++i) {
+      allocations.emplace_back(allocator.Allocate(i % 2000 + 1));
+    }
+  });
+  producer.join();
+  std::thread consumer([&]() { allocations.clear(); });
+  consumer.join();
+
+  auto stats = allocator.GetStats();
+  LOG(INFO) << stats.DebugString();
+  EXPECT_GT(stats.reserved_bytes, 0UL);
+  EXPECT_EQ(stats.allocated_bytes, 0UL);
+  EXPECT_GT(stats.CacheHitRate(), 0.9);
+  auto allocation = allocator.Allocate(1000);
+  EXPECT_EQ(allocator.GetStats().allocated_bytes, allocation->size());
+}
+
+// The unit tests run it at a smoke size, build WITH_BENCHMARK to measure.
+TEST(ThreadCacheCPUAllocator, Benchmark) {
+  const int thread_num = std::max(4U, std::thread::hardware_concurrency());
+#ifdef PADDLE_WITH_BENCHMARK
+  const int iters = 100000;
+#else
+  const int iters = 1000;
+#endif
+  ThreadCacheCPUAllocator thread_cache;
+  NaiveBestFitAllocator naive_best_fit{platform::CPUPlace()};
+  CPUAllocator system;
+  double thread_cache_sec =
+      RunThreads(&thread_cache, thread_num, iters, false);
+  double naive_best_fit_sec =
+      RunThreads(&naive_best_fit, thread_num, iters, false);
+  double system_sec = RunThreads(&system, thread_num, iters, false);
+  LOG(INFO) << thread_num << " threads, " << iters
+            << " small allocations each, thread_cache: " << thread_cache_sec
+            << "s, naive_best_fit: " << naive_best_fit_sec
+            << "s, system: " << system_sec << "s";
+  LOG(INFO) << thread_cache.GetStats().DebugString();
+}
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
@@ -0,0 +1,182 @@
+/* Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "gflags/gflags.h"
+#include "gtest/gtest.h"
+#include "paddle/fluid/framework/op_registry.h"
+#include "paddle/fluid/platform/init.h"
+#include "paddle/fluid/platform/timer.h"
+
+USE_OP(cvm);
+USE_OP(cvm_grad);
+
+#ifdef PADDLE_WITH_BENCHMARK
+DEFINE_int32(cvm_batch_size, 409600, "Number of instances fed to cvm.");
+DEFINE_int32(cvm_repeat, 20, "Repeat times of the benchmark.");
+#else
+// a smoke test size for ctest, which still covers the parallel blocks and
+// the tail block
+DEFINE_int32(cvm_batch_size, 1000, "Number of instances fed to cvm.");
+DEFINE_int32(cvm_repeat, 1, "Repeat times of the benchmark.");
+#endif
+DEFINE_int32(cvm_item_size, 11, "Width of each instance, show/click included.");
+
+namespace paddle {
+namespace operators {
+namespace benchmark {
+
+using LoDTensor = framework::LoDTensor;
+
+// The per instance scalar implementation the CPU kernel used to run.
+static void ScalarCvm(bool use_cvm, int64_t batch_size, int64_t item_size,
+                      const float* x, float* y) {
+  const int64_t cvm_offset = use_cvm ? 0 : 2;
+  for (int64_t i = 0; i < batch_size; ++i) {
+    std::memcpy(y, x + cvm_offset, (item_size - cvm_offset) * sizeof(float));
+    if (use_cvm) {
+      y[0] = log(y[0] + 1);
+      y[1] = log(y[1] + 1) - y[0];
+    }
+    x += item_size;
+    y += item_size - cvm_offset;
+  }
+}
+
+static void ScalarCvmGrad(bool use_cvm, int64_t batch_size, int64_t item_size,
+                          const float* cvm, const float* dy, float* dx) {
+  const int64_t cvm_offset = use_cvm ? 0 : 2;
+  for (int64_t i = 0; i < batch_size; ++i) {
+    std::memcpy(dx + cvm_offset, dy, (item_size - cvm_offset) * sizeof(float));
+    dx[0] = cvm[0];
+    dx[1] = cvm[1];
+    cvm += 2;
+    dx += item_size;
+    dy += item_size - cvm_offset;
+  }
+}
+
+static void FillRandom(LoDTensor* tensor, const framework::DDim& dims) {
+  std::mt19937 rng(100);
+  // show/click are counters, keep every value positive
+  std::uniform_real_distribution<float> dist(0.f, 100.f);
+  float* data = tensor->mutable_data<float>(dims, platform::CPUPlace());
+  for (int64_t i = 0; i < tensor->numel(); ++i) {
+    data[i] = dist(rng);
+  }
+}
+
+static void PrepareScope(framework::Scope* scope, bool use_cvm,
+                         int64_t batch_size, int64_t item_size) {
+  FillRandom(scope->Var("x")->GetMutable<LoDTensor>(),
+             framework::make_ddim({batch_size, item_size}));
+  FillRandom(scope->Var("cvm")->GetMutable<LoDTensor>(),
+             framework::make_ddim({batch_size, 2}));
+  FillRandom(
+      scope->Var("y@GRAD")->GetMutable<LoDTensor>(),
+      framework::make_ddim({batch_size, use_cvm ? item_size : item_size - 2}));
+  scope->Var("y")->GetMutable<LoDTensor>();
+  scope->Var("x@GRAD")->GetMutable<LoDTensor>();
+}
+
+static void RunCvmBenchmark(bool use_cvm) {
+  framework::InitDevices();
+  platform::CPUPlace place;
+  const int64_t batch_size = FLAGS_cvm_batch_size;
+  const int64_t item_size = FLAGS_cvm_item_size;
+
+  framework::Scope scope;
+  PrepareScope(&scope, use_cvm, batch_size, item_size);
+  framework::AttributeMap attrs;
+  attrs.insert({"use_cvm", use_cvm});
+  auto cvm_op = framework::OpRegistry::CreateOp(
+      "cvm", {{"X", {"x"}}, {"CVM", {"cvm"}}}, {{"Y", {"y"}}}, attrs);
+  auto cvm_grad_op = framework::OpRegistry::CreateOp(
+      "cvm_grad",
+      {{"X", {"x"}}, {"CVM", {"cvm"}}, {"Y@GRAD", {"y@GRAD"}}},
+      {{"X@GRAD", {"x@GRAD"}}}, attrs);
+
+  const auto& x = scope.FindVar("x")->Get<LoDTensor>();
+  const auto& cvm = scope.FindVar("cvm")->Get<LoDTensor>();
+  const auto& dy = scope.FindVar("y@GRAD")->Get<LoDTensor>();
+  const int64_t y_width = use_cvm ? item_size : item_size - 2;
+  std::vector<float> y_ref(batch_size * y_width);
+  std::vector<float> dx_ref(batch_size * item_size);
+
+  // Warm up and check against the scalar implementation
+  cvm_op->Run(scope, place);
+  cvm_grad_op->Run(scope, place);
+  ScalarCvm(use_cvm, batch_size, item_size, x.data<float>(), y_ref.data());
+  ScalarCvmGrad(use_cvm, batch_size, item_size, cvm.data<float>(),
+                dy.data<float>(), dx_ref.data());
+  const float* y = scope.FindVar("y")->Get<LoDTensor>().data<float>();
+  const float* dx = scope.FindVar("x@GRAD")->Get<LoDTensor>().data<float>();
+  for (size_t i = 0; i < y_ref.size(); ++i) {
+    ASSERT_NEAR(y[i], y_ref[i], 1e-5) << " at index : " << i;
+  }
+  for (size_t i = 0; i < dx_ref.size(); ++i) {
+    ASSERT_EQ(dx[i], dx_ref[i]) << " at index : " << i;
+  }
+
+  platform::Timer timer;
+  timer.Start();
+  for (int i = 0; i < FLAGS_cvm_repeat; ++i) {
+    ScalarCvm(use_cvm, batch_size, item_size, x.data<float>(), y_ref.data());
+  }
+  timer.Pause();
+  double scalar_ms = timer.ElapsedMS() / FLAGS_cvm_repeat;
+
+  timer.Reset();
+  timer.Start();
+  for (int i = 0; i < FLAGS_cvm_repeat; ++i) {
+    cvm_op->Run(scope, place);
+  }
+  timer.Pause();
+  double kernel_ms = timer.ElapsedMS() / FLAGS_cvm_repeat;
+
+  timer.Reset();
+  timer.Start();
+  for (int i = 0; i < FLAGS_cvm_repeat; ++i) {
+    ScalarCvmGrad(use_cvm, batch_size, item_size, cvm.data<float>(),
+                  dy.data<float>(), dx_ref.data());
+  }
+  timer.Pause();
+  double scalar_grad_ms = timer.ElapsedMS() / FLAGS_cvm_repeat;
+
+  timer.Reset();
+  timer.Start();
+  for (int i = 0; i < FLAGS_cvm_repeat; ++i) {
+    cvm_grad_op->Run(scope, place);
+  }
+  timer.Pause();
+  double kernel_grad_ms = timer.ElapsedMS() / FLAGS_cvm_repeat;
+
+  LOG(INFO) << "=== cvm use_cvm=" << use_cvm << " batch_size=" << batch_size
+            << " item_size=" << item_size << " ===";
+  LOG(INFO) << "forward  scalar: " << scalar_ms << " ms, kernel: " << kernel_ms
+            << " ms";
+  LOG(INFO) << "backward scalar: " << scalar_grad_ms
+            << " ms, kernel: " << kernel_grad_ms << " ms";
+}
+
+TEST(cvm_op_benchmark, use_cvm) { RunCvmBenchmark(true); }
+
+TEST(cvm_op_benchmark, no_cvm) { RunCvmBenchmark(false); }
+
+}  // namespace benchmark
+}  // namespace operators
+}  // namespace paddle
@@ -13,8 +13,12 @@ See the License for the specific language governing permissions and
 limitations under the License. */
 
 #pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include "paddle/fluid/framework/eigen.h"
 #include "paddle/fluid/framework/op_registry.h"
+#include "paddle/fluid/operators/jit/kernels.h"
 
 namespace paddle {
 namespace operators {
@@ -22,34 +26,96 @@ namespace operators {
 using Tensor = framework::Tensor;
 using LoDTensor = framework::LoDTensor;
 
-template <typename T>
-void CvmComputeKernel(const bool use_cvm, const int64_t item_width, const T** X,
-                      T** Y) {
-  const auto cvm_offset = use_cvm ? 0 : 2;
+// Number of instances processed by one CPU task. The show/click columns of a
+// block are gathered into contiguous buffers so that log(x + 1) runs through
+// the vectorized jit kernels, and the blocks are spread over the intra-op
+// threads.
+constexpr int64_t kCvmBlockRows = 256;
 
-  std::memcpy(*Y, *X + cvm_offset, (item_width - cvm_offset) * sizeof(T));
+template <typename T>
+struct CvmLogFuncs {
+  explicit CvmLogFuncs(int n)
+      : vaddbias(jit::KernelFuncs<jit::VAddBiasTuple<T>,
+                                  platform::CPUPlace>::Cache()
+                     .At(n)),
+        vlog(jit::KernelFuncs<jit::VLogTuple<T>, platform::CPUPlace>::Cache()
+                 .At(n)),
+        vsub(jit::KernelFuncs<jit::VSubTuple<T>, platform::CPUPlace>::Cache()
+                 .At(n)) {}
+
+  typename jit::VAddBiasTuple<T>::func_type vaddbias;
+  typename jit::VLogTuple<T>::func_type vlog;
+  typename jit::VSubTuple<T>::func_type vsub;
+};
 
-  if (use_cvm) {
-    (*Y)[0] = log((*Y)[0] + 1);
-    (*Y)[1] = log((*Y)[1] + 1) - (*Y)[0];
+// y[0] = log(show + 1), y[1] = log(click + 1) - log(show + 1) for `rows`
+// instances, the remaining columns are copied through.
+template <typename T>
+void CvmComputeBlock(const bool use_cvm, const int64_t item_width,
+                     const CvmLogFuncs<T>& funcs, const T* x, T* y,
+                     const int rows) {
+  if (!use_cvm) {
+    const int64_t y_width = item_width - 2;
+    for (int i = 0; i < rows; ++i) {
+      std::memcpy(y + i * y_width, x + i * item_width + 2,
+                  y_width * sizeof(T));
+    }
+    return;
   }
 
-  (*X) += item_width;
-  (*Y) += item_width - cvm_offset;
+  std::memcpy(y, x, rows * item_width * sizeof(T));
+  T show[kCvmBlockRows];
+  T click[kCvmBlockRows];
+  for (int i = 0; i < rows; ++i) {
+    show[i] = x[i * item_width];
+    click[i] = x[i * item_width + 1];
+  }
+  const T one = static_cast<T>(1);
+  funcs.vaddbias(&one, show, show, rows);
+  funcs.vaddbias(&one, click, click, rows);
+  funcs.vlog(show, show, rows);
+  funcs.vlog(click, click, rows);
+  funcs.vsub(click, show, click, rows);
+  for (int i = 0; i < rows; ++i) {
+    y[i * item_width] = show[i];
+    y[i * item_width + 1] = click[i];
+  }
 }
 
+// dx[0:2] = cvm, dx[2:] = dy (use_cvm also passes through dy[0:2] before it
+// is overwritten by cvm) for `rows` instances sharing one cvm row.
 template <typename T>
-void CvmGradComputeKernel(const bool use_cvm, const int64_t item_width,
-                          const T& CVM, const T** DY, T** DX) {
+void CvmGradComputeRows(const bool use_cvm, const int64_t item_width,
+                        const T* cvm, const T* dy, T* dx, const int64_t rows) {
   const auto cvm_offset = use_cvm ? 0 : 2;
+  const int64_t dy_width = item_width - cvm_offset;
+  for (int64_t i = 0; i < rows; ++i) {
+    std::memcpy(dx + cvm_offset, dy, dy_width * sizeof(T));
+    dx[0] = cvm[0];
+    dx[1] = cvm[1];
+    dx += item_width;
+    dy += dy_width;
+  }
+}
 
-  std::memcpy(*DX + cvm_offset, *DY, (item_width - cvm_offset) * sizeof(T));
-
-  (*DX)[0] = (&CVM)[0];
-  (*DX)[1] = (&CVM)[1];
-
-  (*DX) += item_width;
-  (*DY) += item_width - cvm_offset;
+// The same as CvmGradComputeRows for `rows` instances with a cvm row each.
+template <typename T>
+void CvmGradComputeBlock(const bool use_cvm, const int64_t item_width,
+                         const T* cvm, const T* dy, T* dx, const int64_t rows) {
+  if (use_cvm) {
+    // dy has the layout of dx, the block is copied at once
+    std::memcpy(dx, dy, rows * item_width * sizeof(T));
+  } else {
+    const int64_t dy_width = item_width - 2;
+    for (int64_t i = 0; i < rows; ++i) {
+      std::memcpy(dx + i * item_width + 2, dy + i * dy_width,
+                  dy_width * sizeof(T));
+    }
+  }
+  for (int64_t i = 0; i < rows; ++i) {
+    dx[i * item_width] = cvm[i * 2];
+    dx[i * item_width + 1] = cvm[i * 2 + 1];
+  }
 }
 
 template <typename T>
@@ -65,30 +131,27 @@ class CVMOpKernel : public framework::OpKernel<T> {
 
     auto* y = context.Output<LoDTensor>("Y");
     T* y_data = y->mutable_data<T>(context.GetPlace());
-
-    // for Input X do not have Lod Information.
-    if (x->NumLevels() == 0) {
-      if (use_cvm) {
-        for (int i = 0; i < batch_size; i++) {
-          int cursor = i * item_size;
-          y_data[cursor] = log(x_data[cursor] + 1);
-          y_data[cursor + 1] = log(x_data[cursor + 1] + 1) - y_data[cursor];
-          for (int j = 2; j < item_size; j++) {
-            y_data[cursor + j] = x_data[cursor + j];
-          }
-        }
-      } else {
-        for (int i = 0; i < batch_size; i++) {
-          CvmComputeKernel(use_cvm, item_size, &x_data, &y_data);
-        }
-      }
-    } else {
-      auto lod = x->lod()[0];
-      for (size_t i = 0; i < lod.size() - 1; ++i) {
-        for (size_t j = 0; j < lod[i + 1] - lod[i]; ++j) {
-          CvmComputeKernel(use_cvm, item_size, &x_data, &y_data);
-        }
-      }
+    const int64_t y_width = use_cvm ? item_size : item_size - 2;
+
+    // The output of every instance only depends on its own input row, so the
+    // LoD of X (if any) does not change the computation.
+    const int64_t block_num = (batch_size + kCvmBlockRows - 1) / kCvmBlockRows;
+    const int tail_rows =
+        static_cast<int>(batch_size - (block_num - 1) * kCvmBlockRows);
+    // jit kernels are specialized by length and cached per thread, resolve
+    // them once here for the full and the tail block.
+    const CvmLogFuncs<T> block_funcs(static_cast<int>(kCvmBlockRows));
+    const CvmLogFuncs<T> tail_funcs(tail_rows);
+
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel for if (block_num > 1)
+#endif
+    for (int64_t b = 0; b < block_num; ++b) {
+      const bool is_tail = (b == block_num - 1);
+      const int64_t row = b * kCvmBlockRows;
+      CvmComputeBlock<T>(use_cvm, item_size, is_tail ? tail_funcs : block_funcs,
+                         x_data + row * item_size, y_data + row * y_width,
+                         is_tail ? tail_rows : static_cast<int>(kCvmBlockRows));
     }
   }
 };
@@ -112,23 +175,35 @@ class CVMGradOpKernel : public framework::OpKernel<T> {
     auto offset = 2;
     auto batch_size = dx->dims()[0];
     auto item_size = dx->numel() / batch_size;
+    const int64_t dy_width = use_cvm ? item_size : item_size - 2;
 
     // for Input X do not have Lod Information.
     if (dx->NumLevels() == 0) {
-      for (int x = 0; x < batch_size; ++x) {
-        CvmGradComputeKernel(use_cvm, item_size, *cvm_data, &dout_data,
-                             &dx_data);
-        cvm_data += offset;
+      const int64_t block_num =
+          (batch_size + kCvmBlockRows - 1) / kCvmBlockRows;
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel for if (block_num > 1)
+#endif
+      for (int64_t b = 0; b < block_num; ++b) {
+        const int64_t begin = b * kCvmBlockRows;
+        const int64_t end =
+            std::min<int64_t>(begin + kCvmBlockRows, batch_size);
+        CvmGradComputeBlock<T>(use_cvm, item_size, cvm_data + begin * offset,
+                               dout_data + begin * dy_width,
+                               dx_data + begin * item_size, end - begin);
       }
     } else {
       auto lod = dx->lod()[0];
-      int seq_num = static_cast<int>(lod.size()) - 1;
-      for (int i = 0; i < seq_num; ++i) {
-        for (size_t j = 0; j < lod[i + 1] - lod[i]; ++j) {
-          CvmGradComputeKernel(use_cvm, item_size, *cvm_data, &dout_data,
-                               &dx_data);
-        }
-        cvm_data += offset;
+      int64_t seq_num = static_cast<int64_t>(lod.size()) - 1;
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel for if (batch_size > kCvmBlockRows)
+#endif
+      for (int64_t i = 0; i < seq_num; ++i) {
+        const int64_t begin = static_cast<int64_t>(lod[i]);
+        CvmGradComputeRows<T>(use_cvm, item_size, cvm_data + i * offset,
+                              dout_data + begin * dy_width,
+                              dx_data + begin * item_size,
+                              static_cast<int64_t>(lod[i + 1]) - begin);
       }
     }
   }
@@ -496,6 +496,7 @@ void BenchKernelVBroadcast() {
 #define BenchKernelVIdentity BenchKernelXYN
 #define BenchKernelVSquare BenchKernelXYN
 #define BenchKernelVExp BenchKernelXYN
+#define BenchKernelVLog BenchKernelXYN
 #define BenchKernelVSigmoid BenchKernelXYN
 #define BenchKernelVTanh BenchKernelXYN
 #define BenchKernelVCopy BenchKernelXYN
@@ -532,6 +533,7 @@ BENCH_FP32_CPU(VRelu);
 BENCH_FP32_CPU(VIdentity);
 BENCH_FP32_CPU(VSquare);
 BENCH_FP32_CPU(VExp);
+BENCH_FP32_CPU(VLog);
 BENCH_FP32_CPU(VSigmoid);
 BENCH_FP32_CPU(VTanh);
 BENCH_FP32_CPU(VCopy);
@@ -108,6 +108,16 @@ void VExp<double>(const double* x, double* y, int n) {
   platform::dynload::vdExp(n, x, y);
 }
 
+template <>
+void VLog<float>(const float* x, float* y, int n) {
+  platform::dynload::vsLn(n, x, y);
+}
+
+template <>
+void VLog<double>(const double* x, double* y, int n) {
+  platform::dynload::vdLn(n, x, y);
+}
+
 template <>
 void VSquare<float>(const float* x, float* y, int n) {
   platform::dynload::vsSqr(n, x, y);
@@ -184,6 +194,11 @@ bool VExpKernel<float>::CanBeUsed(const int& d) const {
   return d > 7;
 }
 
+template <>
+bool VLogKernel<float>::CanBeUsed(const int& d) const {
+  return d > 7;
+}
+
 template <>
 bool VSquareKernel<float>::CanBeUsed(const int& d) const {
   return d > 7;
@@ -272,6 +287,7 @@ AWALYS_USE_ME_WITH_DOUBLE(VAdd);
 AWALYS_USE_ME_WITH_DOUBLE(VScal);
 AWALYS_USE_ME_WITH_DOUBLE(StrideScal);
 AWALYS_USE_ME_WITH_DOUBLE(VExp);
+AWALYS_USE_ME_WITH_DOUBLE(VLog);
 AWALYS_USE_ME_WITH_DOUBLE(VSigmoid);
 AWALYS_USE_ME_WITH_DOUBLE(VTanh);
 AWALYS_USE_ME_WITH_DOUBLE(VSquare);
@@ -297,6 +313,7 @@ REGISTER_MKL_KERNEL(VAdd);
 REGISTER_MKL_KERNEL(VScal);
 REGISTER_MKL_KERNEL(StrideScal);
 REGISTER_MKL_KERNEL(VExp);
+REGISTER_MKL_KERNEL(VLog);
 REGISTER_MKL_KERNEL(VSquare);
 REGISTER_MKL_KERNEL(VCopy);
 REGISTER_MKL_KERNEL(VBroadcast);
@@ -42,6 +42,9 @@ void VScal(const T* a, const T* x, T* y, int n);
 template <typename T>
 void VExp(const T* x, T* y, int n);
 
+template <typename T>
+void VLog(const T* x, T* y, int n);
+
 template <typename T>
 void VSquare(const T* x, T* y, int n);
 
@@ -254,6 +257,7 @@ DECLARE_MKL_KERNEL(StrideScal);
 
 // XYN
 DECLARE_MKL_KERNEL(VExp);
+DECLARE_MKL_KERNEL(VLog);
 DECLARE_MKL_KERNEL(VSigmoid);
 DECLARE_MKL_KERNEL(VTanh);
 DECLARE_MKL_KERNEL(VSquare);
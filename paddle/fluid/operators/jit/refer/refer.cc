@@ -35,6 +35,7 @@ REGISTER_REFER_KERNEL(VCopy);
 REGISTER_REFER_KERNEL(VIdentity);
 REGISTER_REFER_KERNEL(VSquare);
 REGISTER_REFER_KERNEL(VExp);
+REGISTER_REFER_KERNEL(VLog);
 REGISTER_REFER_KERNEL(VSigmoid);
 REGISTER_REFER_KERNEL(VTanh);
 
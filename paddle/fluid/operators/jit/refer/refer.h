@@ -113,6 +113,13 @@ void VExp(const T* x, T* y, int n) {
   }
 }
 
+template <typename T>
+void VLog(const T* x, T* y, int n) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::log(x[i]);
+  }
+}
+
 template <typename T>
 void VSigmoid(const T* x, T* y, int n) {
   // y = 1 / (1 + e^-x)
@@ -576,6 +583,7 @@ DECLARE_REFER_KERNEL(StrideScal);
 DECLARE_REFER_KERNEL(VRelu);
 DECLARE_REFER_KERNEL(VIdentity);
 DECLARE_REFER_KERNEL(VExp);
+DECLARE_REFER_KERNEL(VLog);
 DECLARE_REFER_KERNEL(VSigmoid);
 DECLARE_REFER_KERNEL(VTanh);
 DECLARE_REFER_KERNEL(VSquare);
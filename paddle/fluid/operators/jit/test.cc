@@ -188,7 +188,12 @@ void TestKernelXYN() {
 
     std::vector<T> x(d), yref(d);
     std::vector<T> xinp(d);  // inplace test
-    RandomVec<T>(d, x.data());
+    if (KernelTuple::kernel_type == jit::kVLog) {
+      // log is only defined on positive inputs
+      RandomVec<T>(d, x.data(), static_cast<T>(0.1f), static_cast<T>(4.f));
+    } else {
+      RandomVec<T>(d, x.data());
+    }
     std::copy(x.begin(), x.end(), xinp.begin());
 
     const T* x_data = x.data();
@@ -1328,6 +1333,7 @@ TEST(JITKernel_key, sgd) {
 #define TestKernelVIdentity TestKernelXYN
 #define TestKernelVSquare TestKernelXYN
 #define TestKernelVExp TestKernelXYN
+#define TestKernelVLog TestKernelXYN
 #define TestKernelVSigmoid TestKernelXYN
 #define TestKernelVTanh TestKernelXYN
 #define TestKernelVCopy TestKernelXYN
@@ -1360,6 +1366,7 @@ TEST_CPU_KERNEL(VRelu);
 TEST_CPU_KERNEL(VIdentity);
 TEST_CPU_KERNEL(VSquare);
 TEST_CPU_KERNEL(VExp);
+TEST_CPU_KERNEL(VLog);
 TEST_CPU_KERNEL(VSigmoid);
 TEST_CPU_KERNEL(VTanh);
 TEST_CPU_KERNEL(VCopy);
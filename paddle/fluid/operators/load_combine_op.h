@@ -14,15 +14,24 @@ limitations under the License. */
 
 #pragma once
 
+#include <cstdint>
 #include <fstream>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "paddle/fluid/framework/combined_tensor_file.h"
 #include "paddle/fluid/framework/data_type.h"
 #include "paddle/fluid/framework/data_type_transform.h"
 #include "paddle/fluid/framework/op_registry.h"
+#ifndef _WIN32
+#include "paddle/fluid/memory/allocation/mmap_allocator.h"
+#endif
 #include "paddle/fluid/platform/device_context.h"
 
+DECLARE_bool(load_combine_use_mmap);
+DECLARE_int32(combine_file_io_thread_num);
+
 namespace paddle {
 namespace operators {
 template <typename DeviceContext, typename T>
@@ -30,7 +39,7 @@ class LoadCombineOpKernel : public framework::OpKernel<T> {
  public:
   void Compute(const framework::ExecutionContext &ctx) const override {
     auto place = ctx.GetPlace();
-    auto filename = ctx.Attr<std::string>("file_path");
+    const auto &filename = ctx.Attr<std::string>("file_path");
     auto load_as_fp16 = ctx.Attr<bool>("load_as_fp16");
     auto model_from_memory = ctx.Attr<bool>("model_from_memory");
     auto out_var_names = ctx.OutputNames("Out");
@@ -41,6 +50,21 @@ class LoadCombineOpKernel : public framework::OpKernel<T> {
                           "it to be greater than 0.",
                           out_var_names.size()));
     if (!model_from_memory) {
+#ifndef _WIN32
+      if (FLAGS_load_combine_use_mmap) {
+        // the tensors on CPU alias the pages of the mapped file
+        auto file = memory::allocation::AllocateMemoryMapFileAllocation(
+            filename);
+        const char *begin = static_cast<const char *>(file->ptr());
+        LoadParamsFromMemory(ctx, place, begin, begin + file->size(), file,
+                             load_as_fp16, out_var_names);
+        return;
+      }
+      if (framework::IsAlignedCombinedFile(filename)) {
+        LoadAlignedParams(ctx, place, filename, load_as_fp16, out_var_names);
+        return;
+      }
+#endif
       std::ifstream fin(filename, std::ios::binary);
       PADDLE_ENFORCE_EQ(
           static_cast<bool>(fin), true,
@@ -56,10 +80,129 @@ class LoadCombineOpKernel : public framework::OpKernel<T> {
               "LoadCombine operator fails to open file %s, please check "
               "whether the model file is complete or damaged.",
               filename));
-      std::stringstream fin(filename, std::ios::in | std::ios::binary);
-      LoadParamsFromBuffer(ctx, place, &fin, load_as_fp16, out_var_names);
+      // the attribute holds the model, read it in place
+      LoadParamsFromMemory(ctx, place, filename.data(),
+                           filename.data() + filename.size(), nullptr,
+                           load_as_fp16, out_var_names);
+    }
+  }
+
+  // Load the params saved in [begin, end) in either combined format. If file
+  // is not null, it is the mapping of [begin, end) and the aligned CPU
+  // tensors alias it.
+  void LoadParamsFromMemory(
+      const framework::ExecutionContext &context, const platform::Place &place,
+      const char *begin, const char *end,
+      const std::shared_ptr<memory::Allocation> &file, bool load_as_fp16,
+      const std::vector<std::string> &out_var_names) const {
+    auto out_vars = context.MultiOutputVar("Out");
+    const char *pos = begin;
+    size_t alias_num = 0;
+    std::vector<framework::CombinedTensorInfo> infos;
+    bool aligned = framework::IsAlignedCombinedFile(begin, end - begin);
+    if (aligned) {
+      infos = framework::ParseAlignedCombinedFile(begin, end - begin);
+      PADDLE_ENFORCE_EQ(infos.size(), out_var_names.size(),
+                        platform::errors::InvalidArgument(
+                            "The combined file has %d tensors, but %d "
+                            "variables are to be loaded.",
+                            infos.size(), out_var_names.size()));
+    }
+    for (size_t i = 0; i < out_var_names.size(); i++) {
+      VLOG(4) << "loading tensor: " << out_var_names[i];
+      PADDLE_ENFORCE_NOT_NULL(
+          out_vars[i], platform::errors::InvalidArgument(
+                           "The variable %s to be loaded cannot be found.",
+                           out_var_names[i]));
+
+      auto *tensor = out_vars[i]->GetMutable<framework::LoDTensor>();
+      framework::proto::VarType::Type type;
+      const char *data = nullptr;
+      if (aligned) {
+        tensor->Resize(framework::make_ddim(infos[i].dims));
+        tensor->set_lod(infos[i].lod);
+        type = infos[i].type;
+        data = begin + infos[i].offset;
+        framework::CheckCombinedTensor(infos[i], data);
+      } else {
+        framework::DeserializeMetaFromMemory(&pos, end, tensor, &type, &data);
+      }
+      size_t size = tensor->numel() * framework::SizeOfType(type);
+      bool alias = false;
+#ifndef _WIN32
+      if (file != nullptr && platform::is_cpu_place(place) &&
+          reinterpret_cast<uintptr_t>(data) % framework::SizeOfType(type) ==
+              0) {
+        tensor->clear();
+        tensor->ResetHolderWithType(
+            std::make_shared<memory::allocation::MemoryMapFileSliceAllocation>(
+                std::static_pointer_cast<
+                    memory::allocation::MemoryMapFileAllocation>(file),
+                data - begin, size),
+            type);
+        alias = true;
+        ++alias_num;
+      }
+#endif
+      if (!alias) {
+        // a view of the serialized data, copied to the place of tensor
+        framework::Tensor view;
+        view.Resize(tensor->dims());
+        view.ResetHolderWithType(
+            std::make_shared<memory::Allocation>(const_cast<char *>(data),
+                                                 size, platform::CPUPlace()),
+            type);
+        framework::TensorCopySync(view, place, tensor);
+      }
+      ConvertToFP16(place, load_as_fp16, out_vars[i], &tensor);
+    }
+    PADDLE_ENFORCE_EQ(aligned || pos == end, true,
+                      platform::errors::Unavailable(
+                          "Not allowed to load partial data via "
+                          "load_combine_op, please use load_op instead."));
+    VLOG(3) << "load_combine " << out_var_names.size() << " tensors, "
+            << alias_num << " of them alias the mapped file";
+  }
+
+#ifndef _WIN32
+  // Read an aligned combined file with parallel pread.
+  void LoadAlignedParams(const framework::ExecutionContext &context,
+                         const platform::Place &place,
+                         const std::string &filename, bool load_as_fp16,
+                         const std::vector<std::string> &out_var_names) const {
+    auto out_vars = context.MultiOutputVar("Out");
+    std::vector<framework::LoDTensor *> tensors;
+    for (size_t i = 0; i < out_var_names.size(); i++) {
+      PADDLE_ENFORCE_NOT_NULL(
+          out_vars[i], platform::errors::InvalidArgument(
+                           "The variable %s to be loaded cannot be found.",
+                           out_var_names[i]));
+      tensors.push_back(out_vars[i]->GetMutable<framework::LoDTensor>());
+    }
+    std::vector<framework::LoDTensor> cpu_tensors;
+    if (!platform::is_cpu_place(place)) {
+      // read to host, then copy to the place of the tensors
+      cpu_tensors.resize(tensors.size());
+      std::vector<framework::LoDTensor *> cpu_ptrs;
+      for (auto &tensor : cpu_tensors) {
+        cpu_ptrs.push_back(&tensor);
+      }
+      framework::LoadAlignedCombinedFile(filename, cpu_ptrs,
+                                         FLAGS_combine_file_io_thread_num);
+    } else {
+      framework::LoadAlignedCombinedFile(filename, tensors,
+                                         FLAGS_combine_file_io_thread_num);
+    }
+    for (size_t i = 0; i < tensors.size(); i++) {
+      auto *tensor = tensors[i];
+      if (!cpu_tensors.empty()) {
+        tensor->set_lod(cpu_tensors[i].lod());
+        framework::TensorCopySync(cpu_tensors[i], place, tensor);
+      }
+      ConvertToFP16(place, load_as_fp16, out_vars[i], &tensor);
     }
   }
+#endif
 
   void LoadParamsFromBuffer(
       const framework::ExecutionContext &context, const platform::Place &place,
@@ -87,27 +230,7 @@ class LoadCombineOpKernel : public framework::OpKernel<T> {
 
       // Get data from fin to tensor
       DeserializeFromStream(*buffer, tensor, dev_ctx);
-
-      auto in_dtype = tensor->type();
-      auto out_dtype =
-          load_as_fp16 ? framework::proto::VarType::FP16 : in_dtype;
-
-      if (in_dtype != out_dtype) {
-        // convert to float16 tensor
-        auto in_kernel_type = framework::OpKernelType(in_dtype, place);
-        auto out_kernel_type = framework::OpKernelType(out_dtype, place);
-        framework::LoDTensor fp16_tensor;
-        // copy LoD info to the new tensor
-        fp16_tensor.set_lod(tensor->lod());
-        framework::TransDataType(in_kernel_type, out_kernel_type, *tensor,
-                                 &fp16_tensor);
-
-        // reset output tensor
-        out_vars[i]->Clear();
-        tensor = out_vars[i]->GetMutable<framework::LoDTensor>();
-        tensor->set_lod(fp16_tensor.lod());
-        tensor->ShareDataWith(fp16_tensor);
-      }
+      ConvertToFP16(place, load_as_fp16, out_vars[i], &tensor);
     }
     buffer->peek();
     PADDLE_ENFORCE_EQ(buffer->eof(), true,
@@ -115,6 +238,30 @@ class LoadCombineOpKernel : public framework::OpKernel<T> {
                           "Not allowed to load partial data via "
                           "load_combine_op, please use load_op instead."));
   }
+
+  void ConvertToFP16(const platform::Place &place, bool load_as_fp16,
+                     framework::Variable *var,
+                     framework::LoDTensor **tensor) const {
+    auto in_dtype = (*tensor)->type();
+    auto out_dtype = load_as_fp16 ? framework::proto::VarType::FP16 : in_dtype;
+
+    if (in_dtype != out_dtype) {
+      // convert to float16 tensor
+      auto in_kernel_type = framework::OpKernelType(in_dtype, place);
+      auto out_kernel_type = framework::OpKernelType(out_dtype, place);
+      framework::LoDTensor fp16_tensor;
+      // copy LoD info to the new tensor
+      fp16_tensor.set_lod((*tensor)->lod());
+      framework::TransDataType(in_kernel_type, out_kernel_type, **tensor,
+                               &fp16_tensor);
+
+      // reset output tensor
+      var->Clear();
+      *tensor = var->GetMutable<framework::LoDTensor>();
+      (*tensor)->set_lod(fp16_tensor.lod());
+      (*tensor)->ShareDataWith(fp16_tensor);
+    }
+  }
 };
 
 }  // namespace operators
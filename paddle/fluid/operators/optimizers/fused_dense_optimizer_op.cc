@@ -0,0 +1,145 @@
+/* Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/operators/optimizers/fused_dense_optimizer_op.h"
+
+#include <string>
+#include <vector>
+
+namespace paddle {
+namespace operators {
+
+class FusedDenseOptimizerOp : public framework::OperatorWithKernel {
+ public:
+  using framework::OperatorWithKernel::OperatorWithKernel;
+
+  void InferShape(framework::InferShapeContext* ctx) const override {
+    OP_INOUT_CHECK(ctx->HasInputs("Param"), "Input", "Param",
+                   "FusedDenseOptimizer");
+    OP_INOUT_CHECK(ctx->HasInputs("Grad"), "Input", "Grad",
+                   "FusedDenseOptimizer");
+    OP_INOUT_CHECK(ctx->HasInput("LearningRate"), "Input", "LearningRate",
+                   "FusedDenseOptimizer");
+    OP_INOUT_CHECK(ctx->HasOutputs("ParamOut"), "Output", "ParamOut",
+                   "FusedDenseOptimizer");
+
+    auto lr_dims = ctx->GetInputDim("LearningRate");
+    PADDLE_ENFORCE_EQ(framework::product(lr_dims), 1,
+                      platform::errors::InvalidArgument(
+                          "LearningRate should have one element"));
+    auto param_dims = ctx->GetInputsDim("Param");
+    auto grad_dims = ctx->GetInputsDim("Grad");
+    PADDLE_ENFORCE_EQ(
+        param_dims.size(), grad_dims.size(),
+        platform::errors::InvalidArgument(
+            "The number of Param(%d) and Grad(%d) should be equal.",
+            param_dims.size(), grad_dims.size()));
+    for (size_t i = 0; i < param_dims.size(); ++i) {
+      PADDLE_ENFORCE_EQ(
+          param_dims[i], grad_dims[i],
+          platform::errors::InvalidArgument(
+              "Param and Grad %d of FusedDenseOptimizerOp should have the "
+              "same dimension.",
+              i));
+    }
+    ctx->SetOutputsDim("ParamOut", param_dims);
+  }
+
+  framework::OpKernelType GetExpectedKernelType(
+      const framework::ExecutionContext& ctx) const override {
+    return framework::OpKernelType(
+        OperatorWithKernel::IndicateVarDataType(ctx, "Param"), ctx.GetPlace());
+  }
+};
+
+class FusedDenseOptimizerOpMaker : public framework::OpProtoAndCheckerMaker {
+ public:
+  void Make() override {
+    AddInput("Param", "(vector<Tensor>) Input parameters").AsDuplicable();
+    AddInput("Grad", "(vector<Tensor>) Input dense gradients").AsDuplicable();
+    AddInput("LearningRate", "(Tensor) Learning rate of all the parameters");
+    AddInput("Moment", "(vector<Tensor>) Moments of adagrad")
+        .AsDuplicable()
+        .AsDispensable();
+    AddInput("Moment1", "(vector<Tensor>) First moments of adam")
+        .AsDuplicable()
+        .AsDispensable();
+    AddInput("Moment2", "(vector<Tensor>) Second moments of adam")
+        .AsDuplicable()
+        .AsDispensable();
+    AddInput("Beta1Pow", "(vector<Tensor>) Beta1 power accumulators of adam")
+        .AsDuplicable()
+        .AsDispensable();
+    AddInput("Beta2Pow", "(vector<Tensor>) Beta2 power accumulators of adam")
+        .AsDuplicable()
+        .AsDispensable();
+
+    AddOutput("ParamOut", "(vector<Tensor>) Output parameters")
+        .AsDuplicable();
+    AddOutput("MomentOut", "(vector<Tensor>) Output moments of adagrad")
+        .AsDuplicable()
+        .AsDispensable();
+    AddOutput("Moment1Out", "(vector<Tensor>) Output first moments of adam")
+        .AsDuplicable()
+        .AsDispensable();
+    AddOutput("Moment2Out", "(vector<Tensor>) Output second moments of adam")
+        .AsDuplicable()
+        .AsDispensable();
+    AddOutput("Beta1PowOut", "(vector<Tensor>) Output beta1 power accumulators")
+        .AsDuplicable()
+        .AsDispensable();
+    AddOutput("Beta2PowOut", "(vector<Tensor>) Output beta2 power accumulators")
+        .AsDuplicable()
+        .AsDispensable();
+
+    AddAttr<std::string>("optimizer_type",
+                         "(string) The optimizer, sgd, adam or adagrad");
+    AddAttr<float>("beta1", "(float, default 0.9) The beta1 of adam")
+        .SetDefault(0.9f);
+    AddAttr<float>("beta2", "(float, default 0.999) The beta2 of adam")
+        .SetDefault(0.999f);
+    AddAttr<float>("epsilon",
+                   "(float, default 1.0e-8) "
+                   "Constant for numerical stability of adam and adagrad")
+        .SetDefault(1.0e-8f);
+    AddAttr<int64_t>("min_numel_to_use_multithread",
+                     "(int64_t, default 65536) "
+                     "when inner_op_parallelism is larger than 1, a thread "
+                     "updates at least min_numel_to_use_multithread elements")
+        .SetDefault(65536);
+
+    AddComment(R"DOC(
+Fused Dense Optimizer.
+
+Update all the dense parameters of an optimizer with one op. The
+parameters make one flattened index space, which is split into the ranges
+of FLAGS_inner_op_parallelism threads, and every range is updated with the
+Eigen arrays in SIMD packets. The updates are the same as the sgd, adam and
+adagrad ops, the outputs are usually the inputs, which are updated in
+place.
+
+)DOC");
+  }
+};
+
+}  // namespace operators
+}  // namespace paddle
+
+namespace ops = paddle::operators;
+REGISTER_OP_WITHOUT_GRADIENT(fused_dense_optimizer, ops::FusedDenseOptimizerOp,
+                             ops::FusedDenseOptimizerOpMaker);
+REGISTER_OP_CPU_KERNEL(
+    fused_dense_optimizer,
+    ops::FusedDenseOptimizerKernel<paddle::platform::CPUDeviceContext, float>,
+    ops::FusedDenseOptimizerKernel<paddle::platform::CPUDeviceContext, double>);
@@ -0,0 +1,290 @@
+/* Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+#include <math.h>
+#include <Eigen/Dense>
+#include <algorithm>
+#include <future>  // NOLINT
+#include <string>
+#include <vector>
+#include "gflags/gflags.h"
+#include "paddle/fluid/framework/op_registry.h"
+#include "paddle/fluid/framework/threadpool.h"
+
+DECLARE_int32(inner_op_parallelism);
+
+namespace paddle {
+namespace operators {
+
+using LoDTensor = framework::LoDTensor;
+
+// A parameter in the flattened index space of all the parameters, the
+// moment1 is the first moment of adam and the moment of adagrad. The
+// outputs may be the inputs.
+template <typename T>
+struct DenseOptimizerSegment {
+  int64_t offset;
+  int64_t numel;
+  const T* param;
+  T* param_out;
+  const T* grad;
+  const T* moment1;
+  T* moment1_out;
+  const T* moment2;
+  T* moment2_out;
+  // the learning rate and the epsilon with the bias correction of adam
+  T lr;
+  T epsilon;
+};
+
+template <typename T>
+using DenseArrayMap = Eigen::Map<Eigen::Array<T, Eigen::Dynamic, 1>>;
+template <typename T>
+using ConstDenseArrayMap = Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>>;
+
+// Update the elements [begin, begin + numel) of a segment, the Eigen arrays
+// are computed in SIMD packets.
+template <typename T>
+struct SGDSegmentUpdate {
+  void operator()(const DenseOptimizerSegment<T>& s, int64_t begin,
+                  int64_t numel) const {
+    ConstDenseArrayMap<T> param(s.param + begin, numel);
+    ConstDenseArrayMap<T> grad(s.grad + begin, numel);
+    DenseArrayMap<T> param_out(s.param_out + begin, numel);
+    param_out = param - s.lr * grad;
+  }
+};
+
+template <typename T>
+struct AdagradSegmentUpdate {
+  void operator()(const DenseOptimizerSegment<T>& s, int64_t begin,
+                  int64_t numel) const {
+    ConstDenseArrayMap<T> param(s.param + begin, numel);
+    ConstDenseArrayMap<T> grad(s.grad + begin, numel);
+    ConstDenseArrayMap<T> moment(s.moment1 + begin, numel);
+    DenseArrayMap<T> param_out(s.param_out + begin, numel);
+    DenseArrayMap<T> moment_out(s.moment1_out + begin, numel);
+    moment_out = moment + grad * grad;
+    param_out = param - s.lr * grad / (moment_out.sqrt() + s.epsilon);
+  }
+};
+
+template <typename T>
+struct AdamSegmentUpdate {
+  T beta1;
+  T beta2;
+
+  void operator()(const DenseOptimizerSegment<T>& s, int64_t begin,
+                  int64_t numel) const {
+    ConstDenseArrayMap<T> param(s.param + begin, numel);
+    ConstDenseArrayMap<T> grad(s.grad + begin, numel);
+    ConstDenseArrayMap<T> moment1(s.moment1 + begin, numel);
+    ConstDenseArrayMap<T> moment2(s.moment2 + begin, numel);
+    DenseArrayMap<T> param_out(s.param_out + begin, numel);
+    DenseArrayMap<T> moment1_out(s.moment1_out + begin, numel);
+    DenseArrayMap<T> moment2_out(s.moment2_out + begin, numel);
+    moment1_out = beta1 * moment1 + (1 - beta1) * grad;
+    moment2_out = beta2 * moment2 + (1 - beta2) * grad * grad;
+    param_out =
+        param - s.lr * (moment1_out / (moment2_out.sqrt() + s.epsilon));
+  }
+};
+
+// Update the flattened elements [begin, end) of the segments.
+template <typename T, typename Update>
+void UpdateDenseSegments(const std::vector<DenseOptimizerSegment<T>>& segments,
+                         int64_t begin, int64_t end, const Update& update) {
+  auto it = std::upper_bound(
+      segments.begin(), segments.end(), begin,
+      [](int64_t pos, const DenseOptimizerSegment<T>& s) {
+        return pos < s.offset;
+      });
+  for (--it; it != segments.end() && it->offset < end; ++it) {
+    int64_t seg_begin = std::max(begin, it->offset);
+    int64_t seg_end = std::min(end, it->offset + it->numel);
+    if (seg_begin < seg_end) {
+      update(*it, seg_begin - it->offset, seg_end - seg_begin);
+    }
+  }
+}
+
+// Split the flattened space into the ranges of FLAGS_inner_op_parallelism
+// threads, a thread takes at least min_numel elements.
+template <typename T, typename Update>
+void RunDenseSegments(const std::vector<DenseOptimizerSegment<T>>& segments,
+                      int64_t total, int64_t min_numel, const Update& update) {
+  if (total == 0) {
+    return;
+  }
+  int64_t thread_num = 1;
+  if (FLAGS_inner_op_parallelism > 1 && min_numel > 0) {
+    thread_num = std::min<int64_t>(FLAGS_inner_op_parallelism,
+                                   total / min_numel);
+  }
+  if (thread_num <= 1) {
+    UpdateDenseSegments(segments, 0, total, update);
+    return;
+  }
+  // the ranges start at a cache line of a segment mostly
+  constexpr int64_t kAlign = 64;
+  int64_t chunk = (total + thread_num - 1) / thread_num;
+  chunk = (chunk + kAlign - 1) / kAlign * kAlign;
+  std::vector<std::future<void>> fs;
+  for (int64_t begin = chunk; begin < total; begin += chunk) {
+    int64_t end = std::min(total, begin + chunk);
+    fs.push_back(framework::Async([&segments, &update, begin, end] {
+      UpdateDenseSegments(segments, begin, end, update);
+    }));
+  }
+  UpdateDenseSegments(segments, 0, std::min(total, chunk), update);
+  for (auto& f : fs) {
+    f.wait();
+  }
+}
+
+template <typename DeviceContext, typename T>
+class FusedDenseOptimizerKernel : public framework::OpKernel<T> {
+ public:
+  void Compute(const framework::ExecutionContext& ctx) const override {
+    const auto& type = ctx.Attr<std::string>("optimizer_type");
+    auto params = ctx.MultiInput<LoDTensor>("Param");
+    auto grads = ctx.MultiInput<LoDTensor>("Grad");
+    auto param_outs = ctx.MultiOutput<LoDTensor>("ParamOut");
+    PADDLE_ENFORCE_EQ(
+        grads.size(), params.size(),
+        platform::errors::InvalidArgument(
+            "The number of Grad(%d) should equal the number of Param(%d).",
+            grads.size(), params.size()));
+    CheckOutputs(params, param_outs, "Param");
+
+    auto* lr = ctx.Input<LoDTensor>("LearningRate");
+    PADDLE_ENFORCE_EQ(lr->numel(), 1,
+                      platform::errors::InvalidArgument(
+                          "The LearningRate of fused_dense_optimizer should "
+                          "have one element, but received %d.",
+                          lr->numel()));
+    T lr_value = lr->data<T>()[0];
+    T epsilon = static_cast<T>(ctx.Attr<float>("epsilon"));
+    int64_t min_numel = ctx.Attr<int64_t>("min_numel_to_use_multithread");
+
+    std::vector<DenseOptimizerSegment<T>> segments(params.size());
+    int64_t total = 0;
+    for (size_t i = 0; i < params.size(); ++i) {
+      PADDLE_ENFORCE_EQ(
+          grads[i]->numel(), params[i]->numel(),
+          platform::errors::InvalidArgument(
+              "The Grad(%d) of Param %d should have %d elements.",
+              grads[i]->numel(), i, params[i]->numel()));
+      auto& s = segments[i];
+      s.offset = total;
+      s.numel = params[i]->numel();
+      s.param = params[i]->data<T>();
+      s.param_out = param_outs[i]->mutable_data<T>(ctx.GetPlace());
+      s.grad = grads[i]->data<T>();
+      s.moment1 = nullptr;
+      s.moment1_out = nullptr;
+      s.moment2 = nullptr;
+      s.moment2_out = nullptr;
+      s.lr = lr_value;
+      s.epsilon = epsilon;
+      total += s.numel;
+    }
+
+    if (type == "sgd") {
+      RunDenseSegments(segments, total, min_numel, SGDSegmentUpdate<T>());
+    } else if (type == "adagrad") {
+      SetMoments(ctx, "Moment", &segments, 1);
+      RunDenseSegments(segments, total, min_numel, AdagradSegmentUpdate<T>());
+    } else if (type == "adam") {
+      SetMoments(ctx, "Moment1", &segments, 1);
+      SetMoments(ctx, "Moment2", &segments, 2);
+      T beta1 = static_cast<T>(ctx.Attr<float>("beta1"));
+      T beta2 = static_cast<T>(ctx.Attr<float>("beta2"));
+      auto beta1_pows = ctx.MultiInput<LoDTensor>("Beta1Pow");
+      auto beta2_pows = ctx.MultiInput<LoDTensor>("Beta2Pow");
+      auto beta1_pow_outs = ctx.MultiOutput<LoDTensor>("Beta1PowOut");
+      auto beta2_pow_outs = ctx.MultiOutput<LoDTensor>("Beta2PowOut");
+      CheckOutputs(beta1_pows, beta1_pow_outs, "Beta1Pow");
+      CheckOutputs(beta2_pows, beta2_pow_outs, "Beta2Pow");
+      PADDLE_ENFORCE_EQ(
+          beta1_pows.size() == params.size() &&
+              beta2_pows.size() == params.size(),
+          true, platform::errors::InvalidArgument(
+                    "Every Param of adam should have a Beta1Pow and a "
+                    "Beta2Pow."));
+      for (size_t i = 0; i < segments.size(); ++i) {
+        T beta1_pow = beta1_pows[i]->data<T>()[0];
+        T beta2_pow = beta2_pows[i]->data<T>()[0];
+        segments[i].lr = lr_value * sqrt(1 - beta2_pow) / (1 - beta1_pow);
+        segments[i].epsilon = epsilon * sqrt(1 - beta2_pow);
+      }
+      RunDenseSegments(segments, total, min_numel,
+                       AdamSegmentUpdate<T>{beta1, beta2});
+      for (size_t i = 0; i < segments.size(); ++i) {
+        T beta1_pow = beta1_pows[i]->data<T>()[0];
+        T beta2_pow = beta2_pows[i]->data<T>()[0];
+        beta1_pow_outs[i]->mutable_data<T>(ctx.GetPlace())[0] =
+            beta1 * beta1_pow;
+        beta2_pow_outs[i]->mutable_data<T>(ctx.GetPlace())[0] =
+            beta2 * beta2_pow;
+      }
+    } else {
+      PADDLE_THROW(platform::errors::InvalidArgument(
+          "The optimizer_type of fused_dense_optimizer should be sgd, adam "
+          "or adagrad, but received %s.",
+          type));
+    }
+  }
+
+ private:
+  void CheckOutputs(const std::vector<const LoDTensor*>& ins,
+                    const std::vector<LoDTensor*>& outs,
+                    const std::string& name) const {
+    PADDLE_ENFORCE_EQ(ins.size(), outs.size(),
+                      platform::errors::InvalidArgument(
+                          "The number of %s(%d) and %sOut(%d) should be equal.",
+                          name, ins.size(), name, outs.size()));
+  }
+
+  void SetMoments(const framework::ExecutionContext& ctx,
+                  const std::string& name,
+                  std::vector<DenseOptimizerSegment<T>>* segments,
+                  int index) const {
+    auto moments = ctx.MultiInput<LoDTensor>(name);
+    auto moment_outs = ctx.MultiOutput<LoDTensor>(name + "Out");
+    CheckOutputs(moments, moment_outs, name);
+    PADDLE_ENFORCE_EQ(moments.size(), segments->size(),
+                      platform::errors::InvalidArgument(
+                          "Every Param should have a %s.", name));
+    for (size_t i = 0; i < moments.size(); ++i) {
+      auto& s = (*segments)[i];
+      PADDLE_ENFORCE_EQ(moments[i]->numel(), s.numel,
+                        platform::errors::InvalidArgument(
+                            "The %s of Param %d should have %d elements.",
+                            name, i, s.numel));
+      T* moment_out = moment_outs[i]->mutable_data<T>(ctx.GetPlace());
+      if (index == 1) {
+        s.moment1 = moments[i]->data<T>();
+        s.moment1_out = moment_out;
+      } else {
+        s.moment2 = moments[i]->data<T>();
+        s.moment2_out = moment_out;
+      }
+    }
+  }
+};
+
+}  // namespace operators
+}  // namespace paddle
@@ -19,7 +19,9 @@ limitations under the License. */
 #include <numeric>
 #include <sstream>
 #include <string>
+#include <vector>
 
+#include "paddle/fluid/framework/combined_tensor_file.h"
 #include "paddle/fluid/framework/data_type.h"
 #include "paddle/fluid/framework/data_type_transform.h"
 #include "paddle/fluid/framework/framework.pb.h"
@@ -28,6 +30,10 @@ limitations under the License. */
 #include "paddle/fluid/platform/device_context.h"
 #include "paddle/fluid/platform/port.h"
 
+DECLARE_bool(save_combine_aligned_format);
+DECLARE_bool(save_combine_checksum);
+DECLARE_int32(combine_file_io_thread_num);
+
 namespace paddle {
 namespace operators {
 template <typename DeviceContext, typename T>
@@ -49,6 +55,13 @@ class SaveCombineOpKernel : public framework::OpKernel<T> {
           filename, overwrite));
     }
 
+#ifndef _WIN32
+    if (FLAGS_save_combine_aligned_format && !save_to_memory) {
+      SaveAligned(ctx, place, filename, save_as_fp16);
+      return;
+    }
+#endif
+
     std::ostringstream ss;
     auto inp_var_names = ctx.InputNames("X");
     auto &inp_vars = ctx.MultiInputVar("X");
@@ -112,6 +125,65 @@ class SaveCombineOpKernel : public framework::OpKernel<T> {
       fout.close();
     }
   }
+
+#ifndef _WIN32
+  // Save the tensors in the aligned combined format, they are copied to
+  // host first and written with parallel pwrite.
+  void SaveAligned(const framework::ExecutionContext &ctx,
+                   const platform::Place &place, const std::string &filename,
+                   bool save_as_fp16) const {
+    auto inp_var_names = ctx.InputNames("X");
+    auto &inp_vars = ctx.MultiInputVar("X");
+    PADDLE_ENFORCE_GT(inp_var_names.size(), 0UL,
+                      platform::errors::InvalidArgument(
+                          "The number of variables to be saved is %d, expect "
+                          "it to be greater than 0.",
+                          inp_var_names.size()));
+    std::vector<framework::LoDTensor> copies(inp_var_names.size());
+    std::vector<const framework::LoDTensor *> tensors;
+    for (size_t i = 0; i < inp_var_names.size(); i++) {
+      PADDLE_ENFORCE_NOT_NULL(
+          inp_vars[i],
+          platform::errors::InvalidArgument("Cannot find variable %s to save.",
+                                            inp_var_names[i]));
+      PADDLE_ENFORCE_EQ(inp_vars[i]->IsType<framework::LoDTensor>(), true,
+                        platform::errors::InvalidArgument(
+                            "SaveCombine operator only supports saving "
+                            "LoDTensor variable, %s has wrong type.",
+                            inp_var_names[i]));
+      auto &tensor = inp_vars[i]->Get<framework::LoDTensor>();
+      PADDLE_ENFORCE_EQ(
+          tensor.IsInitialized(), true,
+          platform::errors::InvalidArgument(
+              "The Tensor of Variable(%s) to be saved is not initialized.",
+              inp_var_names[i]));
+      const framework::LoDTensor *cpu_tensor = &tensor;
+      auto in_dtype = tensor.type();
+      auto out_dtype =
+          save_as_fp16 ? framework::proto::VarType::FP16 : in_dtype;
+      if (in_dtype != out_dtype) {
+        auto in_kernel_type = framework::OpKernelType(in_dtype, place);
+        auto out_kernel_type = framework::OpKernelType(out_dtype, place);
+        copies[i].set_lod(tensor.lod());
+        framework::TransDataType(in_kernel_type, out_kernel_type, tensor,
+                                 &copies[i]);
+        cpu_tensor = &copies[i];
+      }
+      if (!platform::is_cpu_place(cpu_tensor->place())) {
+        framework::LoDTensor host;
+        host.set_lod(cpu_tensor->lod());
+        framework::TensorCopySync(*cpu_tensor, platform::CPUPlace(), &host);
+        copies[i] = host;
+        cpu_tensor = &copies[i];
+      }
+      tensors.push_back(cpu_tensor);
+    }
+    MkDirRecursively(DirName(filename).c_str());
+    framework::SaveAlignedCombinedFile(filename, inp_var_names, tensors,
+                                       FLAGS_save_combine_checksum,
+                                       FLAGS_combine_file_io_thread_num);
+  }
+#endif
 };
 
 }  // namespace operators
@@ -12,9 +12,13 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License. */
 
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <string>
 #include <vector>
+#include "gflags/gflags.h"
 #include "gtest/gtest.h"
 #include "paddle/fluid/framework/op_registry.h"
 #include "paddle/fluid/platform/float16.h"
@@ -22,6 +26,9 @@ limitations under the License. */
 USE_CPU_ONLY_OP(save_combine);
 USE_CPU_ONLY_OP(load_combine);
 
+DECLARE_bool(load_combine_use_mmap);
+DECLARE_bool(save_combine_aligned_format);
+
 template <typename T, typename U>
 T* CreateForSaveCombineOp(int x, int y, const std::vector<int>& lod_info,
                           std::string var_name,
@@ -344,3 +351,139 @@ TEST(SaveLoadTestWithCombineOp, CPU) {
     }
   }
 }
+
+// Saves the combined file under the temp directory and removes it.
+class SaveLoadCombineFileTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    filename_ = ::testing::TempDir() + "check_tensor_combine.ls";
+  }
+  void TearDown() override { std::remove(filename_.c_str()); }
+
+  std::string filename_;
+};
+
+// Load with memory mapping and from memory, the tensors aliasing the mapped
+// file are copied on write.
+TEST_F(SaveLoadCombineFileTest, CPUMemoryMap) {
+  paddle::framework::Scope scope;
+  paddle::platform::CPUPlace place;
+
+  std::vector<int> lod1 = {0, 1, 2, 3, 10};
+  int numel1 = 100;
+  paddle::framework::LoD expect_lod1;
+  int* expect1 = CreateForSaveCombineOp<int, int>(10, 10, lod1, "test_var1",
+                                                  place, &scope, &expect_lod1);
+
+  std::vector<int> lod2 = {0, 2, 5, 10};
+  int numel2 = 200;
+  paddle::framework::LoD expect_lod2;
+  float* expect2 = CreateForSaveCombineOp<float, float>(
+      10, 20, lod2, "test_var2", place, &scope, &expect_lod2);
+
+  const std::string& filename = filename_;
+  paddle::framework::AttributeMap attrs;
+  attrs.insert({"file_path", std::string(filename)});
+  auto save_combine_op = paddle::framework::OpRegistry::CreateOp(
+      "save_combine", {{"X", {"test_var1", "test_var2"}}}, {}, attrs);
+  save_combine_op->Run(scope, place);
+
+  auto target1 = GeneratePlaceholderBeforeLoad("out_var1", &scope);
+  auto target2 = GeneratePlaceholderBeforeLoad("out_var2", &scope);
+  auto load_combine_op = paddle::framework::OpRegistry::CreateOp(
+      "load_combine", {}, {{"Out", {"out_var1", "out_var2"}}}, attrs);
+  FLAGS_load_combine_use_mmap = true;
+  load_combine_op->Run(scope, place);
+  FLAGS_load_combine_use_mmap = false;
+
+  paddle::framework::LoD actual_lod1, actual_lod2;
+  int* actual1 = GetValuesAfterLoadCombineOp<int>(target1, scope, &actual_lod1);
+  float* actual2 =
+      GetValuesAfterLoadCombineOp<float>(target2, scope, &actual_lod2);
+  CheckValues<int, int>(expect1, actual1, expect_lod1, actual_lod1, numel1);
+  CheckValues<float, float>(expect2, actual2, expect_lod2, actual_lod2,
+                            numel2);
+  // mutate the loaded tensors, the file is not changed
+  for (int i = 0; i < numel1; ++i) {
+    target1->mutable_data<int>(place)[i] = -1;
+  }
+  for (int i = 0; i < numel2; ++i) {
+    target2->mutable_data<float>(place)[i] = -1;
+  }
+
+  std::ifstream fin(filename, std::ios::binary);
+  std::string model((std::istreambuf_iterator<char>(fin)),
+                    std::istreambuf_iterator<char>());
+  paddle::framework::AttributeMap memory_attrs;
+  memory_attrs.insert({"file_path", model});
+  memory_attrs.insert({"model_from_memory", true});
+  auto load_memory_op = paddle::framework::OpRegistry::CreateOp(
+      "load_combine", {}, {{"Out", {"out_var3", "out_var4"}}}, memory_attrs);
+  auto target3 = GeneratePlaceholderBeforeLoad("out_var3", &scope);
+  auto target4 = GeneratePlaceholderBeforeLoad("out_var4", &scope);
+  load_memory_op->Run(scope, place);
+
+  paddle::framework::LoD actual_lod3, actual_lod4;
+  int* actual3 = GetValuesAfterLoadCombineOp<int>(target3, scope, &actual_lod3);
+  float* actual4 =
+      GetValuesAfterLoadCombineOp<float>(target4, scope, &actual_lod4);
+  CheckValues<int, int>(expect1, actual3, expect_lod1, actual_lod3, numel1);
+  CheckValues<float, float>(expect2, actual4, expect_lod2, actual_lod4,
+                            numel2);
+}
+
+// Save in the aligned combined format, load it with pread, with memory
+// mapping and from memory.
+TEST_F(SaveLoadCombineFileTest, CPUAlignedFormat) {
+  paddle::framework::Scope scope;
+  paddle::platform::CPUPlace place;
+
+  std::vector<int> lod1 = {0, 1, 2, 3, 10};
+  int numel1 = 100;
+  paddle::framework::LoD expect_lod1;
+  int* expect1 = CreateForSaveCombineOp<int, int>(10, 10, lod1, "test_var1",
+                                                  place, &scope, &expect_lod1);
+
+  std::vector<int> lod2 = {0, 2, 5, 10};
+  int numel2 = 200;
+  paddle::framework::LoD expect_lod2;
+  float* expect2 = CreateForSaveCombineOp<float, float>(
+      10, 20, lod2, "test_var2", place, &scope, &expect_lod2);
+
+  paddle::framework::AttributeMap attrs;
+  attrs.insert({"file_path", filename_});
+  auto save_combine_op = paddle::framework::OpRegistry::CreateOp(
+      "save_combine", {{"X", {"test_var1", "test_var2"}}}, {}, attrs);
+  FLAGS_save_combine_aligned_format = true;
+  save_combine_op->Run(scope, place);
+  FLAGS_save_combine_aligned_format = false;
+
+  std::ifstream fin(filename_, std::ios::binary);
+  std::string model((std::istreambuf_iterator<char>(fin)),
+                    std::istreambuf_iterator<char>());
+  paddle::framework::AttributeMap memory_attrs;
+  memory_attrs.insert({"file_path", model});
+  memory_attrs.insert({"model_from_memory", true});
+
+  for (int mode = 0; mode < 3; ++mode) {
+    std::string out1 = "out_var1_" + std::to_string(mode);
+    std::string out2 = "out_var2_" + std::to_string(mode);
+    auto target1 = GeneratePlaceholderBeforeLoad(out1, &scope);
+    auto target2 = GeneratePlaceholderBeforeLoad(out2, &scope);
+    auto load_combine_op = paddle::framework::OpRegistry::CreateOp(
+        "load_combine", {}, {{"Out", {out1, out2}}},
+        mode == 2 ? memory_attrs : attrs);
+    FLAGS_load_combine_use_mmap = mode == 1;
+    load_combine_op->Run(scope, place);
+    FLAGS_load_combine_use_mmap = false;
+
+    paddle::framework::LoD actual_lod1, actual_lod2;
+    int* actual1 =
+        GetValuesAfterLoadCombineOp<int>(target1, scope, &actual_lod1);
+    float* actual2 =
+        GetValuesAfterLoadCombineOp<float>(target2, scope, &actual_lod2);
+    CheckValues<int, int>(expect1, actual1, expect_lod1, actual_lod1, numel1);
+    CheckValues<float, float>(expect2, actual2, expect_lod2, actual_lod2,
+                              numel2);
+  }
+}
@@ -29,8 +29,14 @@ limitations under the License. */
 #else
 #include <unistd.h>
 #endif  // _WIN32
+#ifdef __linux__
+#include <sched.h>
+#endif
 
 #include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <string>
 #include "gflags/gflags.h"
 
 DECLARE_double(fraction_of_cpu_memory_to_use);
@@ -104,6 +110,106 @@ size_t CUDAPinnedMaxChunkSize() {
   return CUDAPinnedMaxAllocSize() / 256;
 }
 
+namespace {
+
+#ifdef __linux__
+// parse a cpu list like "0-15,32-47"
+std::vector<int> ParseCpuList(const std::string& list) {
+  std::vector<int> cpus;
+  size_t pos = 0;
+  while (pos < list.size()) {
+    size_t end = list.find(',', pos);
+    if (end == std::string::npos) {
+      end = list.size();
+    }
+    std::string range = list.substr(pos, end - pos);
+    size_t dash = range.find('-');
+    int first = std::atoi(range.c_str());
+    int last = dash == std::string::npos
+                   ? first
+                   : std::atoi(range.c_str() + dash + 1);
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+    pos = end + 1;
+  }
+  return cpus;
+}
+#endif
+
+// The NUMA node of every cpu read from sysfs, a single node if it is not
+// available.
+class NumaTopology {
+ public:
+  static const NumaTopology& Instance() {
+    static NumaTopology topology;
+    return topology;
+  }
+
+  int node_num() const { return node_num_; }
+
+  int CpuNode(int cpu) const {
+    if (cpu >= 0 && cpu < static_cast<int>(cpu_to_node_.size())) {
+      return cpu_to_node_[cpu];
+    }
+    return 0;
+  }
+
+  const std::vector<int>& NodeCpus(int node) const {
+    static const std::vector<int> empty;
+    if (node >= 0 && node < static_cast<int>(node_cpus_.size())) {
+      return node_cpus_[node];
+    }
+    return empty;
+  }
+
+ private:
+  NumaTopology() {
+#ifdef __linux__
+    for (int node = 0;; ++node) {
+      std::ifstream fin("/sys/devices/system/node/node" +
+                        std::to_string(node) + "/cpulist");
+      std::string list;
+      if (!fin || !std::getline(fin, list)) {
+        break;
+      }
+      node_cpus_.push_back(ParseCpuList(list));
+      for (int cpu : node_cpus_.back()) {
+        if (cpu >= static_cast<int>(cpu_to_node_.size())) {
+          cpu_to_node_.resize(cpu + 1, 0);
+        }
+        cpu_to_node_[cpu] = node;
+      }
+      node_num_ = node + 1;
+    }
+#endif
+  }
+
+  int node_num_ = 1;
+  std::vector<int> cpu_to_node_;
+  std::vector<std::vector<int>> node_cpus_;
+};
+
+}  // namespace
+
+int NumaNodeNum() { return NumaTopology::Instance().node_num(); }
+
+int CpuNumaNode(int cpu) { return NumaTopology::Instance().CpuNode(cpu); }
+
+int CurrentNumaNode() {
+#ifdef __linux__
+  const auto& topology = NumaTopology::Instance();
+  if (topology.node_num() > 1) {
+    return topology.CpuNode(sched_getcpu());
+  }
+#endif
+  return 0;
+}
+
+std::vector<int> NumaNodeCpus(int node) {
+  return NumaTopology::Instance().NodeCpus(node);
+}
+
 #ifdef PADDLE_WITH_XBYAK
 static Xbyak::util::Cpu cpu;
 bool MayIUse(const cpu_isa_t cpu_isa) {
@@ -16,6 +16,8 @@ limitations under the License. */
 
 #include <stddef.h>
 
+#include <vector>
+
 #ifdef _WIN32
 #if defined(__AVX2__)
 #include <immintrin.h>  // avx2
@@ -88,5 +90,17 @@ typedef enum {
 // May I use some instruction
 bool MayIUse(const cpu_isa_t cpu_isa);
 
+//! Get the number of NUMA nodes, 1 if the topology is not available.
+int NumaNodeNum();
+
+//! Get the NUMA node of a cpu.
+int CpuNumaNode(int cpu);
+
+//! Get the NUMA node of the cpu the calling thread runs on.
+int CurrentNumaNode();
+
+//! Get the cpus of a NUMA node.
+std::vector<int> NumaNodeCpus(int node);
+
 }  // namespace platform
 }  // namespace paddle
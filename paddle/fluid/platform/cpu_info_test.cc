@@ -32,3 +32,14 @@ TEST(CpuMemoryUsage, Print) {
                                        use_percent, memory_size)
             << std::endl;
 }
+
+TEST(CpuNumaNode, Topology) {
+  int node_num = paddle::platform::NumaNodeNum();
+  ASSERT_GE(node_num, 1);
+  EXPECT_LT(paddle::platform::CurrentNumaNode(), node_num);
+  for (int node = 0; node < node_num; ++node) {
+    for (int cpu : paddle::platform::NumaNodeCpus(node)) {
+      EXPECT_EQ(paddle::platform::CpuNumaNode(cpu), node);
+    }
+  }
+}
@@ -97,6 +97,8 @@ extern void* mklml_dso_handle;
   __macro(vdDiv);                   \
   __macro(vsExp);                   \
   __macro(vdExp);                   \
+  __macro(vsLn);                    \
+  __macro(vdLn);                    \
   __macro(vsSqr);                   \
   __macro(vdSqr);                   \
   __macro(vsPowx);                  \
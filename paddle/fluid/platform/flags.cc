@@ -303,10 +303,12 @@ DEFINE_double(memory_fraction_of_eager_deletion, 1.0,
  * Allocator related FLAG
  * Name: FLAGS_allocator_strategy
  * Since Version: 1.2
- * Value Range: string, {naive_best_fit, auto_growth, thread_local},
- * default=auto_growth
+ * Value Range: string, {naive_best_fit, auto_growth, thread_local,
+ * sample_pool, thread_cache}, default=auto_growth
  * Example:
- * Note: For selecting allocator policy of PaddlePaddle.
+ * Note: For selecting allocator policy of PaddlePaddle. thread_cache serves
+ *       the small CPU allocations from per thread size class caches, the
+ *       GPU memory is allocated as auto_growth.
  */
 #ifdef PADDLE_ON_INFERENCE
 static constexpr char kDefaultAllocatorStrategy[] = "naive_best_fit";
@@ -325,7 +327,9 @@ DEFINE_string(
     "size of models may be larger). auto_growth strategy would allocate "
     "GPU memory on demand, which allows users to start several Paddle jobs "
     "on the same GPU card but may lead to more memory fragmentation "
-    "(i.e., maximum batch size of models may be smaller).");
+    "(i.e., maximum batch size of models may be smaller). thread_cache "
+    "serves the small CPU allocations from per thread size class caches "
+    "and allocates GPU memory as auto_growth.");
 
 /**
  * Memory related FLAG
@@ -474,6 +478,110 @@ DEFINE_double(local_exe_sub_scope_limit, 256.0,  // MBytes
               "you should set FLAGS_local_exe_sub_scope_limit=-1. "
               "The default value is 256 MBytes.");
 
+/**
+ * Operator related FLAG
+ * Name: FLAGS_load_combine_use_mmap
+ * Since Version: 2.0.0
+ * Value Range: bool, default=false
+ * Example: FLAGS_load_combine_use_mmap=true would make load_combine map the
+ * combined params file, the CPU tensors alias the mapped pages and are only
+ * copied on write.
+ * Note: The file should not be truncated while the params are in use.
+ */
+DEFINE_bool(load_combine_use_mmap, false,
+            "Whether load_combine maps the combined params file, the CPU "
+            "tensors alias the mapped pages instead of copying them");
+
+/**
+ * Operator related FLAG
+ * Name: FLAGS_save_combine_aligned_format
+ * Since Version: 2.0.0
+ * Value Range: bool, default=false
+ * Example: FLAGS_save_combine_aligned_format=true would make save_combine
+ * write an indexed file with page aligned tensor payloads in parallel.
+ * Note: load_combine reads both formats, the files saved to memory keep the
+ * sequential format.
+ */
+DEFINE_bool(save_combine_aligned_format, false,
+            "Whether save_combine writes the aligned combined format with "
+            "an index and page aligned tensor payloads");
+DEFINE_bool(save_combine_checksum, true,
+            "Whether save_combine stores a checksum of every tensor in the "
+            "aligned combined format, load_combine verifies them");
+DEFINE_int32(combine_file_io_thread_num, 8,
+             "The number of threads reading or writing an aligned combined "
+             "file in save_combine and load_combine");
+
+/**
+ * Executor related FLAG
+ * Name: FLAGS_enable_op_instruction_list
+ * Since Version: 2.0.0
+ * Value Range: bool, default=false
+ * Example: FLAGS_enable_op_instruction_list=true would make the Hogwild and
+ * BoxPS workers freeze their ops into instructions after two warmup steps,
+ * the instructions replay the kernels without the scope lookups.
+ * Note: The profiler and the debug flags run the ops as usual.
+ */
+DEFINE_bool(enable_op_instruction_list, false,
+            "Whether the device workers freeze their ops into instructions "
+            "which replay the prepared kernels after the warmup steps");
+
+/**
+ * Executor related FLAG
+ * Name: FLAGS_hogwild_fuse_dense_optimizer
+ * Since Version: 2.0.0
+ * Value Range: bool, default=false
+ * Example: FLAGS_hogwild_fuse_dense_optimizer=true would make the
+ * HogwildWorker rewrite the sgd, adam and adagrad ops of the dense
+ * parameters into a fused_dense_optimizer op per learning rate.
+ * Note: The fused op splits the update into FLAGS_inner_op_parallelism
+ * threads.
+ */
+DEFINE_bool(hogwild_fuse_dense_optimizer, false,
+            "Whether the HogwildWorker fuses the optimizer ops of the dense "
+            "parameters into one op");
+
+/**
+ * Distributed related FLAG
+ * Name: FLAGS_downpour_prefetch_sparse
+ * Since Version: 2.0.0
+ * Value Range: bool, default=false
+ * Example: FLAGS_downpour_prefetch_sparse=true would make the DownpourWorker
+ * read the next batch and pull its unique feasigns while the current batch
+ * runs.
+ * Note: The worker pulls synchronously when it dumps the fields or copies
+ * the tables.
+ */
+DEFINE_bool(downpour_prefetch_sparse, false,
+            "Whether the DownpourWorker pulls the sparse values of the next "
+            "batch while the current batch runs");
+
+/**
+ * Distributed related FLAG
+ * Name: FLAGS_global_shuffle_message_kb
+ * Since Version: 2.0.0
+ * Value Range: int32, default=1024
+ * Example: FLAGS_global_shuffle_message_kb=1024 would make the GlobalShuffle
+ * of a dataset send the records to a trainer once 1MB of them are
+ * serialized.
+ */
+DEFINE_int32(global_shuffle_message_kb, 1024,
+             "The kilobytes of a message of the global shuffle");
+
+/**
+ * Distributed related FLAG
+ * Name: FLAGS_global_shuffle_max_inflight_mb
+ * Since Version: 2.0.0
+ * Value Range: int32, default=64
+ * Example: FLAGS_global_shuffle_max_inflight_mb=64 would make the
+ * GlobalShuffle of a dataset wait before sending to a trainer which has 64MB
+ * of messages not handled yet.
+ * Note: It replaces the sleep of set_fleet_send_sleep_seconds.
+ */
+DEFINE_int32(global_shuffle_max_inflight_mb, 64,
+             "The megabytes of the global shuffle messages in flight to a "
+             "trainer");
+
 DEFINE_int32(fix_dayid, 0, "Whether fix dayid in PaddleBox");
 DEFINE_int32(padbox_record_pool_max_size, 2000000,
              "PadBoxSlotDataset slot record pool max size");
@@ -483,6 +591,15 @@ DEFINE_int32(padbox_dataset_merge_thread_num, 20,
              "PadBoxSlotDataset shuffle thread num");
 DEFINE_int32(padbox_slotpool_thread_num, 1,
              "PadBoxSlotDataset slot pool thread num");
+DEFINE_bool(padbox_numa_aware_placement, false,
+            "if true, the slot records are pooled per numa node, the load "
+            "threads are bound per node and every reader gets the records "
+            "of the numa node of its gpu");
+DEFINE_int32(padbox_pack_prefetch_num, 0,
+             "number of batches a reader packs on the host ahead of the "
+             "trainer, 0 packs every batch when it is fed");
+DEFINE_int32(padbox_pack_thread_num, 1,
+             "number of threads packing the batches ahead of a reader");
 DEFINE_bool(use_gpu_replica_cache, false,
             "if true ,will open use_gpu_replica_cache");
 DEFINE_int32(gpu_replica_cache_dim, 8, "use_gpu_replica_cache,the dim");
@@ -490,6 +607,12 @@ DEFINE_bool(padbox_dataset_disable_shuffle, false,
             "if true ,will disable data shuffle");
 DEFINE_int32(padbox_slotrecord_extend_dim, 0, "paddlebox pcoc extend dim");
 DEFINE_bool(padbox_auc_runner_mode, false, "auc runner mode");
+DEFINE_bool(padbox_auc_runner_overlay, false,
+            "if true, the auc runner keeps the records untouched and the "
+            "readers overlay the replaced slots when packing a batch");
+DEFINE_int32(padbox_auc_shard_num, 8,
+             "number of histogram shards each auc calculator accumulates "
+             "batches into, threads are spread over the shards");
 DEFINE_bool(padbox_dataset_disable_polling, false,
             "if true ,will disable input file list polling");
 DEFINE_bool(padbox_dataset_enable_unrollinstance, false,
@@ -500,6 +623,25 @@ DEFINE_bool(lineid_have_extend_info, false,
 DEFINE_bool(dump_filed_same_as_aibox, false,
             "if true , will change dump format from abc.tmp0:2:1:1 into "
             "abc:1:1, which same as aibox");
+DEFINE_bool(enable_async_dump_field, false,
+            "if true, dump fields are snapshotted on the training thread and "
+            "formatted and written by the dump threads");
+DEFINE_bool(dump_field_binary_format, false,
+            "if true, async dump fields are written as binary columnar blocks "
+            "instead of text lines");
+DEFINE_bool(padbox_hot_path_trace, true,
+            "if true, the reader, shuffle, merge, feed pass, pull/push and "
+            "train steps are recorded into per thread ring buffers");
+DEFINE_int32(padbox_hot_path_trace_ring_size, 8192,
+             "the number of the hot path trace records kept per thread");
+DEFINE_string(padbox_hot_path_trace_dir, "",
+              "if not empty, the hot path trace of every pass is dumped into "
+              "this directory as a chrome trace at the end of the pass");
+DEFINE_string(padbox_metrics_file, "",
+              "if not empty, the metrics are written into this file in the "
+              "prometheus text format periodically");
+DEFINE_int32(padbox_metrics_interval_sec, 60,
+             "the seconds between two snapshots of the metrics file");
 
 /**
  * MKLDNN related FLAG
@@ -564,6 +706,51 @@ DEFINE_int32(
     "less FLAGS_max_inplace_grad_add, than it will be use several grad_add"
     "instead of sum. Default is 0.");
 
+/**
+ * Performance related FLAG
+ * Name: inplace_sum_gradient
+ * Since Version: 2.0.0
+ * Value Range: bool, default=false
+ * Example:
+ * Note: If True, the gradients on CPUPlace are summed in place in dygraph,
+ * the SelectedRows gradients are merged by the hash of their rows with
+ * the parallel adds of FLAGS_inner_op_parallelism threads. It is ignored
+ * when FLAGS_sort_sum_gradient is True.
+ */
+DEFINE_bool(inplace_sum_gradient, false,
+            "Sum the gradients on CPUPlace in place in dygraph.");
+
+/**
+ * Performance related FLAG
+ * Name: sparse_gradient_dense_ratio
+ * Since Version: 2.0.0
+ * Value Range: double, default=0.5
+ * Example:
+ * Note: When FLAGS_inplace_sum_gradient is True, the sum of the SelectedRows
+ * gradients turns into a LoDTensor once its rows cover this ratio of the
+ * height. A value larger than 1 keeps the SelectedRows.
+ */
+DEFINE_double(sparse_gradient_dense_ratio, 0.5,
+              "The ratio of the rows to the height at which the sum of the "
+              "SelectedRows gradients turns into a LoDTensor.");
+
+/**
+ * Performance related FLAG
+ * Name: tracer_op_cache_capacity
+ * Since Version: 2.0.0
+ * Value Range: int32, default=0
+ * Example:
+ * Note: If positive, the tracer of dygraph caches at most this number of
+ * ops with their checked attributes and kernels, keyed by the op type, the
+ * attributes, the place and the types, data types and places of the
+ * inputs. A traced op of a cached signature skips the op creation, the
+ * attribute check and the kernel choice. The ops with block attributes are
+ * not cached, and the cache is disabled when FLAGS_use_mkldnn is True.
+ */
+DEFINE_int32(tracer_op_cache_capacity, 0,
+             "The max number of the op signatures cached by the dygraph "
+             "tracer, 0 disables the cache.");
+
 /**
  * Debug related FLAG
  * Name: tracer_mkldnn_ops_on
@@ -14,8 +14,11 @@ limitations under the License. */
 
 #include "paddle/fluid/platform/gpu_info.h"
 #include <algorithm>
+#include <cctype>
 #include <cstdlib>
+#include <fstream>
 #include <memory>
+#include <string>
 
 #include "gflags/gflags.h"
 #include "paddle/fluid/platform/cuda_device_guard.h"
@@ -106,6 +109,30 @@ int GetCUDAComputeCapability(int id) {
   return major * 10 + minor;
 }
 
+int GetCUDANumaNode(int id) {
+  PADDLE_ENFORCE_LT(id, GetCUDADeviceCount(),
+                    platform::errors::InvalidArgument(
+                        "Device id must be less than GPU count, "
+                        "but received id is: %d. GPU count is: %d.",
+                        id, GetCUDADeviceCount()));
+  char bus_id[32] = {0};
+  if (cudaDeviceGetPCIBusId(bus_id, sizeof(bus_id), id) != cudaSuccess) {
+    cudaGetLastError();
+    return 0;
+  }
+  // sysfs names the devices with the lower case bus id
+  std::string path = "/sys/bus/pci/devices/";
+  for (char* c = bus_id; *c != '\0'; ++c) {
+    path.push_back(static_cast<char>(std::tolower(*c)));
+  }
+  std::ifstream fin(path + "/numa_node");
+  int node = -1;
+  if (!(fin >> node) || node < 0) {
+    return 0;
+  }
+  return node;
+}
+
 dim3 GetGpuMaxGridDimSize(int id) {
   PADDLE_ENFORCE_LT(id, GetCUDADeviceCount(),
                     platform::errors::InvalidArgument(
@@ -53,6 +53,9 @@ int GetCUDAMaxThreadsPerBlock(int i);
 //! Get the current GPU device id in system.
 int GetCurrentDeviceId();
 
+//! Get the NUMA node of the PCIe root of the ith GPU, 0 if it is unknown.
+int GetCUDANumaNode(int id);
+
 //! Get the maximum GridDim size for GPU buddy allocator.
 dim3 GetGpuMaxGridDimSize(int);
 
@@ -0,0 +1,222 @@
+/* Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/platform/hot_path_trace.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+
+#include "glog/logging.h"
+
+DECLARE_int32(padbox_hot_path_trace_ring_size);
+
+namespace paddle {
+namespace platform {
+
+const char* TraceEventName(TraceEvent event) {
+  static const char* names[] = {
+#define PADDLE_TRACE_EVENT_NAME(id, name) name,
+      PADDLE_HOT_PATH_TRACE_EVENTS(PADDLE_TRACE_EVENT_NAME)
+#undef PADDLE_TRACE_EVENT_NAME
+  };
+  auto index = static_cast<size_t>(event);
+  return index < static_cast<size_t>(TraceEvent::kNum) ? names[index]
+                                                       : "unknown";
+}
+
+// The ring of a thread is written by the thread only. The reader copies the
+// records below head and drops the ones the writer may have overwritten
+// meanwhile. The slot of head may be halfway written, so a full ring is
+// read from head + 1 - capacity.
+struct HotPathTrace::Ring {
+  Ring(size_t capacity, int tid)
+      : records(capacity), mask(capacity - 1), tid(tid) {}
+
+  std::vector<TraceRecord> records;
+  size_t mask;
+  int tid;
+  // the number of the records ever written
+  std::atomic<uint64_t> head{0};
+  // set when the thread exits, the ring is dropped by the next dump
+  std::atomic<bool> retired{false};
+};
+
+namespace {
+
+size_t RingCapacity() {
+  size_t capacity = 1;
+  size_t size =
+      static_cast<size_t>(std::max(FLAGS_padbox_hot_path_trace_ring_size, 1));
+  while (capacity < size) {
+    capacity <<= 1;
+  }
+  return capacity;
+}
+
+}  // namespace
+
+HotPathTrace& HotPathTrace::Instance() {
+  static HotPathTrace trace;
+  return trace;
+}
+
+HotPathTrace::Ring* HotPathTrace::LocalRing() {
+  struct RingHolder {
+    std::shared_ptr<Ring> ring;
+    ~RingHolder() {
+      if (ring) {
+        ring->retired = true;
+      }
+    }
+  };
+  thread_local RingHolder holder;
+  if (holder.ring == nullptr) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    holder.ring = std::make_shared<Ring>(RingCapacity(), next_tid_++);
+    rings_.push_back(holder.ring);
+  }
+  return holder.ring.get();
+}
+
+void HotPathTrace::Record(TraceEvent event, int64_t begin_ns, int64_t end_ns,
+                          uint64_t arg) {
+  auto* ring = LocalRing();
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  auto& record = ring->records[head & ring->mask];
+  record.begin_ns = begin_ns;
+  record.end_ns = end_ns;
+  record.arg = arg;
+  record.event = event;
+  record.tid = ring->tid;
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+std::vector<TraceRecord> HotPathTrace::Collect(int64_t since_ns) const {
+  std::vector<std::shared_ptr<Ring>> rings;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rings = rings_;
+  }
+  std::vector<TraceRecord> records;
+  for (auto& ring : rings) {
+    uint64_t capacity = ring->records.size();
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    uint64_t begin = head >= capacity ? head + 1 - capacity : 0;
+    std::vector<TraceRecord> copied;
+    copied.reserve(head - begin);
+    for (uint64_t i = begin; i < head; ++i) {
+      copied.push_back(ring->records[i & ring->mask]);
+    }
+    // the records the writer passed over or was writing during the copy
+    // are dropped
+    uint64_t new_head = ring->head.load(std::memory_order_acquire);
+    uint64_t valid_begin =
+        new_head >= capacity ? new_head + 1 - capacity : 0;
+    for (uint64_t i = std::max(begin, valid_begin); i < head; ++i) {
+      auto& record = copied[i - begin];
+      if (record.end_ns > since_ns) {
+        records.push_back(record);
+      }
+    }
+  }
+  std::sort(records.begin(), records.end(),
+            [](const TraceRecord& a, const TraceRecord& b) {
+              return a.begin_ns < b.begin_ns;
+            });
+  return records;
+}
+
+std::string HotPathTrace::ToChromeTrace(
+    const std::vector<TraceRecord>& records) {
+  std::ostringstream os;
+  os.setf(std::ios::fixed);
+  os.precision(3);
+  int pid = static_cast<int>(getpid());
+  std::vector<int> tids;
+  for (auto& record : records) {
+    tids.push_back(record.tid);
+  }
+  std::sort(tids.begin(), tids.end());
+  tids.erase(std::unique(tids.begin(), tids.end()), tids.end());
+
+  os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  for (int tid : tids) {
+    os << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\","
+       << "\"pid\":" << pid << ",\"tid\":" << tid
+       << ",\"args\":{\"name\":\"thread " << tid << "\"}}";
+    first = false;
+  }
+  for (auto& record : records) {
+    os << (first ? "" : ",") << "\n{\"name\":\"" << TraceEventName(record.event)
+       << "\",\"cat\":\"hot_path\",\"ph\":\"X\",\"pid\":" << pid
+       << ",\"tid\":" << record.tid << ",\"ts\":" << record.begin_ns / 1000.0
+       << ",\"dur\":" << (record.end_ns - record.begin_ns) / 1000.0
+       << ",\"args\":{\"arg\":" << record.arg << "}}";
+    first = false;
+  }
+  os << "\n]}\n";
+  return os.str();
+}
+
+std::string HotPathTrace::DumpPass(const std::string& dir) {
+  if (dir.empty()) {
+    return "";
+  }
+  // the rings retired before the collect are complete in this dump
+  std::vector<Ring*> retired;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& ring : rings_) {
+      if (ring->retired) {
+        retired.push_back(ring.get());
+      }
+    }
+  }
+  int64_t now = NowNs();
+  auto records = Collect(last_dump_ns_);
+  std::string path =
+      dir + "/hot_path_trace_pass_" + std::to_string(pass_num_) + ".json";
+  {
+    std::ofstream out(path);
+    if (!out) {
+      LOG(WARNING) << "Fail to open " << path << " to dump the trace";
+      return "";
+    }
+    out << ToChromeTrace(records);
+  }
+  last_dump_ns_ = now;
+  ++pass_num_;
+  {
+    // drop the rings of the exited threads
+    std::lock_guard<std::mutex> lock(mutex_);
+    rings_.erase(std::remove_if(rings_.begin(), rings_.end(),
+                                [&retired](const std::shared_ptr<Ring>& ring) {
+                                  return std::find(retired.begin(),
+                                                   retired.end(),
+                                                   ring.get()) != retired.end();
+                                }),
+                 rings_.end());
+  }
+  VLOG(0) << "dump " << records.size() << " hot path trace records to "
+          << path;
+  return path;
+}
+
+}  // namespace platform
+}  // namespace paddle
@@ -0,0 +1,139 @@
+/* Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+
+DECLARE_bool(padbox_hot_path_trace);
+
+namespace paddle {
+namespace platform {
+
+// The events of the hot paths of the BoxPS pipeline. They are registered at
+// compile time, a record holds the id of its event instead of a name.
+#define PADDLE_HOT_PATH_TRACE_EVENTS(_)   \
+  _(kReadIns, "read_ins")                 \
+  _(kParseIns, "parse_ins")               \
+  _(kShuffleSend, "shuffle_send")         \
+  _(kShuffleReceive, "shuffle_receive")   \
+  _(kMergeIns, "merge_ins")               \
+  _(kBeginFeedPass, "begin_feed_pass")    \
+  _(kEndFeedPass, "end_feed_pass")        \
+  _(kPullSparse, "pull_sparse")           \
+  _(kPushSparse, "push_sparse")           \
+  _(kTrainStep, "train_step")
+
+enum class TraceEvent : uint16_t {
+#define PADDLE_DECLARE_TRACE_EVENT(id, name) id,
+  PADDLE_HOT_PATH_TRACE_EVENTS(PADDLE_DECLARE_TRACE_EVENT)
+#undef PADDLE_DECLARE_TRACE_EVENT
+  kNum
+};
+
+const char* TraceEventName(TraceEvent event);
+
+struct TraceRecord {
+  int64_t begin_ns;
+  int64_t end_ns;
+  // the number of the instances, keys, bytes ... of the event
+  uint64_t arg;
+  TraceEvent event;
+  // the index of the thread in the trace
+  int tid;
+};
+
+/*
+ * HotPathTrace keeps the records of every thread in a ring buffer of the
+ * thread, a record is written without any lock or allocation, so that the
+ * trace may be left on in production. The oldest records of a thread are
+ * overwritten when its ring is full, the rings hold
+ * FLAGS_padbox_hot_path_trace_ring_size records.
+ *
+ * DumpPass writes the records since the last dump as a Chrome trace, which
+ * chrome://tracing and Perfetto open.
+ */
+class HotPathTrace {
+ public:
+  static HotPathTrace& Instance();
+
+  static bool Enabled() { return FLAGS_padbox_hot_path_trace; }
+
+  static int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // Append a record to the ring of the current thread.
+  void Record(TraceEvent event, int64_t begin_ns, int64_t end_ns,
+              uint64_t arg = 0);
+
+  // The records of all the threads which end after since_ns, ordered by
+  // their begin.
+  std::vector<TraceRecord> Collect(int64_t since_ns = 0) const;
+
+  // Write the records since the last dump into
+  // dir/hot_path_trace_pass_<n>.json, return the path of the file, or an
+  // empty string if nothing is written. The passes are dumped by one thread
+  // at a time.
+  std::string DumpPass(const std::string& dir);
+
+  static std::string ToChromeTrace(const std::vector<TraceRecord>& records);
+
+ private:
+  struct Ring;
+
+  HotPathTrace() = default;
+  Ring* LocalRing();
+
+  mutable std::mutex mutex_;
+  std::vector<std::shared_ptr<Ring>> rings_;
+  int next_tid_{0};
+  int64_t last_dump_ns_{0};
+  int pass_num_{0};
+};
+
+// TraceScope records an event from its construction to its destruction.
+class TraceScope {
+ public:
+  explicit TraceScope(TraceEvent event, uint64_t arg = 0)
+      : event_(event),
+        arg_(arg),
+        begin_ns_(HotPathTrace::Enabled() ? HotPathTrace::NowNs() : -1) {}
+
+  ~TraceScope() {
+    if (begin_ns_ >= 0) {
+      HotPathTrace::Instance().Record(event_, begin_ns_, HotPathTrace::NowNs(),
+                                      arg_);
+    }
+  }
+
+  void set_arg(uint64_t arg) { arg_ = arg; }
+
+ private:
+  TraceEvent event_;
+  uint64_t arg_;
+  int64_t begin_ns_;
+};
+
+}  // namespace platform
+}  // namespace paddle
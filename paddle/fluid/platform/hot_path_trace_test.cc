@@ -0,0 +1,101 @@
+/* Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/platform/hot_path_trace.h"
+
+#include <fstream>
+#include <sstream>
+#include <thread>  // NOLINT
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+DECLARE_int32(padbox_hot_path_trace_ring_size);
+
+namespace paddle {
+namespace platform {
+
+TEST(HotPathTrace, EventName) {
+  EXPECT_STREQ(TraceEventName(TraceEvent::kReadIns), "read_ins");
+  EXPECT_STREQ(TraceEventName(TraceEvent::kTrainStep), "train_step");
+  EXPECT_STREQ(TraceEventName(TraceEvent::kNum), "unknown");
+}
+
+TEST(HotPathTrace, Ring) {
+  auto& trace = HotPathTrace::Instance();
+  int64_t since = HotPathTrace::NowNs();
+  int old_size = FLAGS_padbox_hot_path_trace_ring_size;
+  FLAGS_padbox_hot_path_trace_ring_size = 10;
+  // a ring of 16 records keeps the latest 16 steps of the thread, the
+  // oldest one shares its slot with the next record and is not collected
+  std::thread t([]() {
+    for (uint64_t i = 0; i < 100; ++i) {
+      TraceScope scope(TraceEvent::kTrainStep, i);
+    }
+  });
+  t.join();
+  FLAGS_padbox_hot_path_trace_ring_size = old_size;
+
+  auto records = trace.Collect(since);
+  ASSERT_EQ(records.size(), 15UL);
+  for (size_t i = 0; i < records.size(); ++i) {
+    EXPECT_EQ(records[i].event, TraceEvent::kTrainStep);
+    EXPECT_EQ(records[i].arg, 85 + i);
+    EXPECT_LE(records[i].begin_ns, records[i].end_ns);
+  }
+
+  FLAGS_padbox_hot_path_trace = false;
+  { TraceScope scope(TraceEvent::kPullSparse); }
+  FLAGS_padbox_hot_path_trace = true;
+  EXPECT_EQ(trace.Collect(since).size(), 15UL);
+}
+
+TEST(HotPathTrace, DumpPass) {
+  auto& trace = HotPathTrace::Instance();
+  EXPECT_EQ(trace.DumpPass(""), "");
+  std::string dir = testing::TempDir();
+  // the records of the other tests go into the first pass
+  std::string first = trace.DumpPass(dir);
+  ASSERT_FALSE(first.empty());
+
+  std::thread t([]() {
+    TraceScope scope(TraceEvent::kMergeIns, 7);
+    { TraceScope pull(TraceEvent::kPullSparse, 1024); }
+  });
+  t.join();
+  std::string second = trace.DumpPass(dir);
+  ASSERT_NE(first, second);
+  std::ifstream in(second);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  std::string json = ss.str();
+  EXPECT_NE(json.find("\"traceEvents\""), std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"merge_ins\""), std::string::npos);
+  EXPECT_NE(json.find("\"args\":{\"arg\":1024}"), std::string::npos);
+  EXPECT_EQ(json.find("train_step"), std::string::npos);
+}
+
+TEST(HotPathTrace, Benchmark) {
+  const int num = 1000000;
+  int64_t begin = HotPathTrace::NowNs();
+  for (int i = 0; i < num; ++i) {
+    TraceScope scope(TraceEvent::kParseIns, i);
+  }
+  int64_t end = HotPathTrace::NowNs();
+  LOG(INFO) << "trace scope: " << static_cast<double>(end - begin) / num
+            << " ns";
+}
+
+}  // namespace platform
+}  // namespace paddle
@@ -0,0 +1,284 @@
+/* Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/platform/metrics.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+#include "gflags/gflags.h"
+#include "paddle/fluid/platform/enforce.h"
+#include "paddle/fluid/platform/monitor.h"
+
+DECLARE_string(padbox_metrics_file);
+DECLARE_int32(padbox_metrics_interval_sec);
+
+namespace paddle {
+namespace platform {
+
+int MetricShardIndex() {
+  static std::atomic<int> next_index{0};
+  thread_local int index = next_index.fetch_add(1) % kMetricShardNum;
+  return index;
+}
+
+int64_t Counter::Value() const {
+  int64_t value = 0;
+  for (auto& shard : shards_) {
+    value += shard.value.load(std::memory_order_relaxed);
+  }
+  return value;
+}
+
+Histogram::Histogram(const std::vector<double>& bounds) : bounds_(bounds) {
+  PADDLE_ENFORCE_EQ(
+      std::is_sorted(bounds_.begin(), bounds_.end()), true,
+      errors::InvalidArgument("The bounds of a histogram should be sorted."));
+  for (auto& shard : shards_) {
+    shard.counts.reset(new std::atomic<uint64_t>[bounds_.size() + 1]);
+    for (size_t i = 0; i <= bounds_.size(); ++i) {
+      shard.counts[i] = 0;
+    }
+  }
+}
+
+void Histogram::Observe(double value) {
+  size_t bucket = std::lower_bound(bounds_.begin(), bounds_.end(), value) -
+                  bounds_.begin();
+  auto& shard = shards_[MetricShardIndex()];
+  shard.counts[bucket].fetch_add(1, std::memory_order_relaxed);
+  // the shard is rarely shared, the loop hardly retries
+  double sum = shard.sum.load(std::memory_order_relaxed);
+  while (!shard.sum.compare_exchange_weak(sum, sum + value,
+                                          std::memory_order_relaxed)) {
+  }
+}
+
+Histogram::Snapshot Histogram::GetSnapshot() const {
+  Snapshot snapshot;
+  snapshot.bounds = bounds_;
+  snapshot.counts.assign(bounds_.size() + 1, 0);
+  for (auto& shard : shards_) {
+    for (size_t i = 0; i <= bounds_.size(); ++i) {
+      uint64_t count = shard.counts[i].load(std::memory_order_relaxed);
+      snapshot.counts[i] += count;
+      snapshot.count += count;
+    }
+    snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+  }
+  return snapshot;
+}
+
+const std::vector<double>& DefaultLatencyBoundsMs() {
+  static const std::vector<double> bounds = {
+      0.1, 0.25, 0.5, 1, 2.5, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 10000};
+  return bounds;
+}
+
+MetricsRegistry& MetricsRegistry::Instance() {
+  static MetricsRegistry registry;
+  return registry;
+}
+
+MetricsRegistry::~MetricsRegistry() { StopWriter(); }
+
+static bool IsValidMetricName(const std::string& name) {
+  if (name.empty() || isdigit(name[0])) {
+    return false;
+  }
+  for (char c : name) {
+    if (!isalnum(c) && c != '_' && c != ':') {
+      return false;
+    }
+  }
+  return true;
+}
+
+MetricsRegistry::Metric* MetricsRegistry::GetMetric(const std::string& name,
+                                                    const std::string& help,
+                                                    MetricType type) {
+  auto it = metrics_.find(name);
+  if (it != metrics_.end()) {
+    PADDLE_ENFORCE_EQ(
+        it->second.type == type, true,
+        errors::AlreadyExists("The metric %s exists with another type.", name));
+    return &it->second;
+  }
+  PADDLE_ENFORCE_EQ(IsValidMetricName(name), true,
+                    errors::InvalidArgument(
+                        "The metric name %s should match "
+                        "[a-zA-Z_:][a-zA-Z0-9_:]*.",
+                        name));
+  auto& metric = metrics_[name];
+  metric.type = type;
+  metric.help = help;
+  return &metric;
+}
+
+Counter* MetricsRegistry::GetCounter(const std::string& name,
+                                     const std::string& help) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto* metric = GetMetric(name, help, MetricType::kCounter);
+  if (metric->counter == nullptr) {
+    metric->counter.reset(new Counter());
+  }
+  return metric->counter.get();
+}
+
+Gauge* MetricsRegistry::GetGauge(const std::string& name,
+                                 const std::string& help) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto* metric = GetMetric(name, help, MetricType::kGauge);
+  if (metric->gauge == nullptr) {
+    metric->gauge.reset(new Gauge());
+  }
+  return metric->gauge.get();
+}
+
+Histogram* MetricsRegistry::GetHistogram(const std::string& name,
+                                         const std::string& help,
+                                         const std::vector<double>& bounds) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto* metric = GetMetric(name, help, MetricType::kHistogram);
+  if (metric->histogram == nullptr) {
+    metric->histogram.reset(new Histogram(bounds));
+  }
+  return metric->histogram.get();
+}
+
+static void WriteHeader(std::ostream& os, const std::string& name,
+                        const std::string& help, const char* type) {
+  if (!help.empty()) {
+    os << "# HELP " << name << " " << help << "\n";
+  }
+  os << "# TYPE " << name << " " << type << "\n";
+}
+
+template <typename T>
+static void WriteStats(std::ostream& os) {
+  for (auto& stat : StatRegistry<T>::Instance().publish()) {
+    if (!IsValidMetricName(stat.key)) continue;
+    WriteHeader(os, stat.key, "", "gauge");
+    os << stat.key << " " << stat.value << "\n";
+  }
+}
+
+std::string MetricsRegistry::ToPrometheusText() const {
+  std::ostringstream os;
+  os.precision(15);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& pair : metrics_) {
+      auto& name = pair.first;
+      auto& metric = pair.second;
+      switch (metric.type) {
+        case MetricType::kCounter:
+          WriteHeader(os, name, metric.help, "counter");
+          os << name << " " << metric.counter->Value() << "\n";
+          break;
+        case MetricType::kGauge:
+          WriteHeader(os, name, metric.help, "gauge");
+          os << name << " " << metric.gauge->Value() << "\n";
+          break;
+        case MetricType::kHistogram: {
+          WriteHeader(os, name, metric.help, "histogram");
+          auto snapshot = metric.histogram->GetSnapshot();
+          uint64_t cumulative = 0;
+          for (size_t i = 0; i < snapshot.bounds.size(); ++i) {
+            cumulative += snapshot.counts[i];
+            os << name << "_bucket{le=\"" << snapshot.bounds[i] << "\"} "
+               << cumulative << "\n";
+          }
+          os << name << "_bucket{le=\"+Inf\"} " << snapshot.count << "\n";
+          os << name << "_sum " << snapshot.sum << "\n";
+          os << name << "_count " << snapshot.count << "\n";
+          break;
+        }
+      }
+    }
+  }
+  WriteStats<int64_t>(os);
+  WriteStats<float>(os);
+  return os.str();
+}
+
+bool MetricsRegistry::WriteSnapshot(const std::string& path) const {
+  std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream out(tmp_path);
+    if (!out) {
+      LOG(WARNING) << "Fail to open " << tmp_path << " to write the metrics";
+      return false;
+    }
+    out << ToPrometheusText();
+    if (!out) {
+      LOG(WARNING) << "Fail to write the metrics into " << tmp_path;
+      return false;
+    }
+  }
+  if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+    LOG(WARNING) << "Fail to rename " << tmp_path << " to " << path;
+    return false;
+  }
+  return true;
+}
+
+void MetricsRegistry::StartWriter(const std::string& path,
+                                  int64_t interval_ms) {
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  if (writer_ != nullptr) {
+    return;
+  }
+  writer_stop_ = false;
+  writer_.reset(new std::thread([this, path, interval_ms]() {
+    std::unique_lock<std::mutex> lock(writer_mutex_);
+    while (!writer_cv_.wait_for(lock, std::chrono::milliseconds(interval_ms),
+                                [this] { return writer_stop_; })) {
+      WriteSnapshot(path);
+    }
+    // the last snapshot
+    WriteSnapshot(path);
+  }));
+  VLOG(0) << "write the metrics into " << path << " every " << interval_ms
+          << " ms";
+}
+
+void MetricsRegistry::StopWriter() {
+  std::unique_ptr<std::thread> writer;
+  {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    writer_stop_ = true;
+    writer = std::move(writer_);
+  }
+  writer_cv_.notify_all();
+  if (writer != nullptr) {
+    writer->join();
+  }
+}
+
+void StartMetricsWriterFromFlags() {
+  if (FLAGS_padbox_metrics_file.empty()) {
+    return;
+  }
+  MetricsRegistry::Instance().StartWriter(
+      FLAGS_padbox_metrics_file,
+      std::max(FLAGS_padbox_metrics_interval_sec, 1) * 1000L);
+}
+
+}  // namespace platform
+}  // namespace paddle
@@ -0,0 +1,187 @@
+/* Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+namespace paddle {
+namespace platform {
+
+// The metrics are spread over kMetricShardNum shards, a thread updates the
+// shard of its own with a relaxed atomic, a read sums the shards.
+constexpr int kMetricShardNum = 32;
+
+// The shard of the current thread.
+int MetricShardIndex();
+
+// A monotonic counter.
+class Counter {
+ public:
+  void Increase(int64_t value = 1) {
+    shards_[MetricShardIndex()].value.fetch_add(value,
+                                                std::memory_order_relaxed);
+  }
+  int64_t Value() const;
+
+ private:
+  // a shard takes a cache line, over-aligned types are not allocated with
+  // their alignment before C++17
+  struct Shard {
+    std::atomic<int64_t> value{0};
+    char padding[64 - sizeof(std::atomic<int64_t>)];
+  };
+  Shard shards_[kMetricShardNum];
+};
+
+// A value which goes up and down, as a channel depth or a pool size.
+class Gauge {
+ public:
+  void Set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+  void Increase(int64_t value = 1) {
+    value_.fetch_add(value, std::memory_order_relaxed);
+  }
+  void Decrease(int64_t value = 1) {
+    value_.fetch_sub(value, std::memory_order_relaxed);
+  }
+  int64_t Value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<int64_t> value_{0};
+};
+
+// A histogram of fixed buckets, bounds are the inclusive upper bounds of
+// the buckets in ascending order, the last bucket holds the values above
+// bounds.back().
+class Histogram {
+ public:
+  struct Snapshot {
+    std::vector<double> bounds;
+    // the number of the values of every bucket, not cumulative
+    std::vector<uint64_t> counts;
+    double sum = 0;
+    uint64_t count = 0;
+  };
+
+  explicit Histogram(const std::vector<double>& bounds);
+
+  void Observe(double value);
+  Snapshot GetSnapshot() const;
+
+  const std::vector<double>& bounds() const { return bounds_; }
+
+ private:
+  struct Shard {
+    std::unique_ptr<std::atomic<uint64_t>[]> counts;
+    std::atomic<double> sum{0};
+    char padding[64 - sizeof(std::unique_ptr<std::atomic<uint64_t>[]>) -
+                 sizeof(std::atomic<double>)];
+  };
+
+  std::vector<double> bounds_;
+  Shard shards_[kMetricShardNum];
+};
+
+// The latency buckets in milliseconds, from 0.1ms to 10s.
+const std::vector<double>& DefaultLatencyBoundsMs();
+
+// Observe the milliseconds from the construction to the destruction.
+class ScopedLatency {
+ public:
+  explicit ScopedLatency(Histogram* histogram)
+      : histogram_(histogram), begin_(std::chrono::steady_clock::now()) {}
+  ~ScopedLatency() {
+    histogram_->Observe(std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - begin_)
+                            .count());
+  }
+
+ private:
+  Histogram* histogram_;
+  std::chrono::steady_clock::time_point begin_;
+};
+
+/*
+ * MetricsRegistry names the counters, gauges and histograms of the process.
+ * A metric is created by its first Get and lives as long as the process,
+ * the hot paths keep the pointer in a function local static.
+ *
+ * ToPrometheusText exports the metrics and the StatValues of StatRegistry
+ * in the Prometheus text format, the snapshot writer writes it into a local
+ * file periodically, which a node exporter or a log agent picks up.
+ */
+class MetricsRegistry {
+ public:
+  static MetricsRegistry& Instance();
+
+  ~MetricsRegistry();
+
+  Counter* GetCounter(const std::string& name, const std::string& help = "");
+  Gauge* GetGauge(const std::string& name, const std::string& help = "");
+  // The bounds of an existing histogram are not changed.
+  Histogram* GetHistogram(
+      const std::string& name, const std::string& help = "",
+      const std::vector<double>& bounds = DefaultLatencyBoundsMs());
+
+  std::string ToPrometheusText() const;
+
+  // Write the text into path.tmp and rename it to path, so that a reader
+  // never sees a partial snapshot.
+  bool WriteSnapshot(const std::string& path) const;
+
+  // Write a snapshot into path every interval_ms in a background thread,
+  // a started writer is not started again.
+  void StartWriter(const std::string& path, int64_t interval_ms);
+  // Stop the writer after a last snapshot.
+  void StopWriter();
+
+ private:
+  enum class MetricType { kCounter, kGauge, kHistogram };
+
+  struct Metric {
+    MetricType type;
+    std::string help;
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<Gauge> gauge;
+    std::unique_ptr<Histogram> histogram;
+  };
+
+  MetricsRegistry() = default;
+  Metric* GetMetric(const std::string& name, const std::string& help,
+                    MetricType type);
+
+  mutable std::mutex mutex_;
+  // ordered by the names in the text
+  std::map<std::string, Metric> metrics_;
+
+  std::mutex writer_mutex_;
+  std::condition_variable writer_cv_;
+  std::unique_ptr<std::thread> writer_;
+  bool writer_stop_{false};
+};
+
+// Start the snapshot writer of FLAGS_padbox_metrics_file if it is set.
+void StartMetricsWriterFromFlags();
+
+}  // namespace platform
+}  // namespace paddle
@@ -0,0 +1,98 @@
+/* Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/platform/metrics.h"
+
+#include <fstream>
+#include <sstream>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/platform/enforce.h"
+#include "paddle/fluid/platform/monitor.h"
+
+DEFINE_INT_STATUS(STAT_metrics_test_size)
+
+namespace paddle {
+namespace platform {
+
+TEST(Metrics, Counter) {
+  auto& registry = MetricsRegistry::Instance();
+  auto* counter = registry.GetCounter("test_counter_total", "a counter");
+  EXPECT_EQ(registry.GetCounter("test_counter_total"), counter);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([counter]() {
+      for (int j = 0; j < 10000; ++j) {
+        counter->Increase();
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(counter->Value(), 80000);
+
+  EXPECT_THROW(registry.GetGauge("test_counter_total"),
+               platform::EnforceNotMet);
+  EXPECT_THROW(registry.GetCounter("0 bad name"), platform::EnforceNotMet);
+}
+
+TEST(Metrics, Histogram) {
+  Histogram histogram({1, 10, 100});
+  for (double value : {0.5, 1.0, 5.0, 50.0, 500.0, 5000.0}) {
+    histogram.Observe(value);
+  }
+  auto snapshot = histogram.GetSnapshot();
+  EXPECT_EQ(snapshot.counts, std::vector<uint64_t>({2, 1, 1, 2}));
+  EXPECT_EQ(snapshot.count, 6UL);
+  EXPECT_DOUBLE_EQ(snapshot.sum, 5556.5);
+  EXPECT_THROW(Histogram({10, 1}), platform::EnforceNotMet);
+}
+
+TEST(Metrics, PrometheusText) {
+  auto& registry = MetricsRegistry::Instance();
+  registry.GetGauge("test_channel_size", "a gauge")->Set(42);
+  auto* latency =
+      registry.GetHistogram("test_latency_ms", "a histogram", {1, 10});
+  latency->Observe(0.5);
+  latency->Observe(5);
+  latency->Observe(50);
+  STAT_RESET(STAT_metrics_test_size, 7);
+
+  std::string text = registry.ToPrometheusText();
+  EXPECT_NE(text.find("# HELP test_channel_size a gauge\n"
+                      "# TYPE test_channel_size gauge\n"
+                      "test_channel_size 42\n"),
+            std::string::npos);
+  EXPECT_NE(text.find("# TYPE test_latency_ms histogram\n"
+                      "test_latency_ms_bucket{le=\"1\"} 1\n"
+                      "test_latency_ms_bucket{le=\"10\"} 2\n"
+                      "test_latency_ms_bucket{le=\"+Inf\"} 3\n"
+                      "test_latency_ms_sum 55.5\n"
+                      "test_latency_ms_count 3\n"),
+            std::string::npos);
+  EXPECT_NE(text.find("STAT_metrics_test_size 7\n"), std::string::npos);
+
+  std::string path = testing::TempDir() + "/metrics_test.prom";
+  registry.StartWriter(path, 10);
+  registry.GetCounter("test_written_total")->Increase(3);
+  registry.StopWriter();
+  std::ifstream in(path);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  EXPECT_NE(ss.str().find("test_written_total 3\n"), std::string::npos);
+}
+
+}  // namespace platform
+}  // namespace paddle
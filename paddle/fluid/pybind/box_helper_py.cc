@@ -108,6 +108,9 @@ void BindBoxWrapper(py::module* m) {
            py::call_guard<py::gil_scoped_release>())
       .def("set_input_table_dim", &framework::BoxWrapper::SetInputTableDim,
            py::call_guard<py::gil_scoped_release>())
+      .def("save_input_table_image",
+           &framework::BoxWrapper::SaveInputTableImage,
+           py::call_guard<py::gil_scoped_release>())
       .def("shrink_table", &framework::BoxWrapper::ShrinkTable,
            py::call_guard<py::gil_scoped_release>())
       .def("load_ssd2mem", &framework::BoxWrapper::LoadSSD2Mem,
@@ -206,6 +206,8 @@ void BindDataset(py::module *m) {
            py::call_guard<py::gil_scoped_release>())
       .def("set_index_filelist", &framework::Dataset::SetIndexFileList,
            py::call_guard<py::gil_scoped_release>())
+      .def("set_index_image", &framework::Dataset::SetIndexImage,
+           py::call_guard<py::gil_scoped_release>())
       .def("set_thread_num", &framework::Dataset::SetThreadNum,
            py::call_guard<py::gil_scoped_release>())
       .def("set_trainer_num", &framework::Dataset::SetTrainerNum,
@@ -462,6 +462,13 @@ void BindAnalysisConfig(py::module *m) {
            py::arg("x") = true)
       .def("ir_optim", &AnalysisConfig::ir_optim)
       .def("enable_memory_optim", &AnalysisConfig::EnableMemoryOptim)
+      .def("enable_static_memory_plan",
+           &AnalysisConfig::EnableStaticMemoryPlan, py::arg("x") = true)
+      .def("static_memory_plan_enabled",
+           &AnalysisConfig::static_memory_plan_enabled)
+      .def("enable_shared_weights", &AnalysisConfig::EnableSharedWeights,
+           py::arg("x") = true)
+      .def("shared_weights_enabled", &AnalysisConfig::shared_weights_enabled)
       .def("enable_profile", &AnalysisConfig::EnableProfile)
       .def("disable_glog_info", &AnalysisConfig::DisableGlogInfo)
       .def("glog_info_disabled", &AnalysisConfig::glog_info_disabled)
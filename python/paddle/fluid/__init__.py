@@ -204,10 +204,24 @@ def __bootstrap__():
         'call_stack_level',
         'sort_sum_gradient',
         'max_inplace_grad_add',
+        'inplace_sum_gradient',
+        'sparse_gradient_dense_ratio',
+        'tracer_op_cache_capacity',
         'sample_max_bin_bytes',
         'sample_bin_growth',
         'sample_min_bin',
         'sample_debug_info',
+        'enable_async_dump_field',
+        'dump_field_binary_format',
+        'load_combine_use_mmap',
+        'save_combine_aligned_format',
+        'save_combine_checksum',
+        'combine_file_io_thread_num',
+        'enable_op_instruction_list',
+        'hogwild_fuse_dense_optimizer',
+        'downpour_prefetch_sparse',
+        'global_shuffle_message_kb',
+        'global_shuffle_max_inflight_mb',
     ]
     if 'Darwin' not in sysstr:
         read_env_flags.append('use_pinned_memory')
@@ -263,6 +277,11 @@ def __bootstrap__():
             'padbox_dataset_disable_shuffle',
             'padbox_slotrecord_extend_dim',
             'padbox_auc_runner_mode',
+            'padbox_auc_runner_overlay',
+            'padbox_numa_aware_placement',
+            'padbox_pack_prefetch_num',
+            'padbox_pack_thread_num',
+            'padbox_auc_shard_num',
             'padbox_dataset_enable_unrollinstance',
             'enable_binding_train_cpu',
             'enable_ins_parser_file',
@@ -271,6 +290,11 @@ def __bootstrap__():
             'enable_pullpush_dedup_keys',
             'enable_shuffle_by_searchid',
             'enable_pull_box_padding_zero',
+            'padbox_hot_path_trace',
+            'padbox_hot_path_trace_ring_size',
+            'padbox_hot_path_trace_dir',
+            'padbox_metrics_file',
+            'padbox_metrics_interval_sec',
         ]
     core.init_gflags(["--tryfromenv=" + ",".join(read_env_flags)])
     core.init_glog(sys.argv[0])
@@ -1301,6 +1301,12 @@ class InputTableDataset(PadBoxSlotDataset):
         """
         self.dataset.set_index_filelist(filelist)
 
+    def set_index_image(self, path):
+        """ set the local index image saved by box save_input_table_image,
+        it is mapped instead of parsing the index filelist
+        """
+        self.dataset.set_index_image(path)
+
     def set_feed_type(self, data_feed_type):
         """
         Set data_feed_desc
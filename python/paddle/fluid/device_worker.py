@@ -449,6 +449,11 @@ class BoxPSWorker(DeviceWorker):
         boxps_param.sync_dense_mode = pipeline_opt.get("sync_dense_mode", 0)
         boxps_param.sync_weight_step = pipeline_opt.get("sync_weight_step", 0)
         boxps_param.sync_one_ring = pipeline_opt.get("sync_one_ring", False)
+        boxps_param.async_beta1 = pipeline_opt.get("async_beta1", 0.99)
+        boxps_param.async_beta2 = pipeline_opt.get("async_beta2", 0.9999)
+        boxps_param.async_epsilon = pipeline_opt.get("async_epsilon", 1e-8)
+        boxps_param.async_update_thread_num = pipeline_opt.get(
+            "async_update_thread_num", 4)
         for e in pipeline_opt["param_need_sync"]:
             boxps_param.param_need_sync.append(e)
         boxps_param.dump_thread_num = pipeline_opt.get("dump_thread_num", 1)
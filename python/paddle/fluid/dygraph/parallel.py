@@ -54,9 +54,13 @@ def prepare_context(strategy=None):
         if isinstance(place, core.CUDAPlace):
             parallel_helper._set_parallel_ctx(
                 core.NCCLParallelContext(strategy, place))
+        elif isinstance(place, core.CPUPlace) and hasattr(
+                core, "GLOOParallelContext"):
+            # the gradients of CPUPlace are allreduced by gloo
+            parallel_helper._set_parallel_ctx(
+                core.GLOOParallelContext(strategy, place))
         else:
-            # TODO(Yancey1989): add Gloo Parallel Context to support CPU parallel computation
-            assert ("Only support CUDAPlace for now.")
+            assert ("Only support CUDAPlace or CPUPlace with gloo for now.")
         parallel_helper._init_parallel_ctx()
     return strategy
 
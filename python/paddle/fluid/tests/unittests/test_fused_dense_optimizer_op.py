@@ -0,0 +1,148 @@
+#   Copyright (c) 2020 PaddlePaddle Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+from __future__ import print_function
+
+import unittest
+import numpy as np
+from op_test import OpTest
+
+SHAPES = [(123, 32), (1, ), (7, 5), (1000, )]
+
+
+def random_tensors(prefix):
+    return [(prefix + str(i), np.random.random(shape).astype("float32"))
+            for i, shape in enumerate(SHAPES)]
+
+
+def out_tensors(prefix, values):
+    return [(prefix + str(i), v) for i, v in enumerate(values)]
+
+
+class TestFusedDenseOptimizerSGD(OpTest):
+    def setUp(self):
+        self.op_type = "fused_dense_optimizer"
+        params = random_tensors("param")
+        grads = random_tensors("grad")
+        lr = 0.01
+        self.inputs = {
+            'Param': params,
+            'Grad': grads,
+            'LearningRate': np.array([lr]).astype("float32")
+        }
+        self.attrs = {'optimizer_type': 'sgd'}
+        self.outputs = {
+            'ParamOut': out_tensors(
+                "param_out",
+                [p - lr * g for (_, p), (_, g) in zip(params, grads)])
+        }
+
+    def test_check_output(self):
+        self.check_output()
+
+
+class TestFusedDenseOptimizerAdagrad(OpTest):
+    def setUp(self):
+        self.op_type = "fused_dense_optimizer"
+        params = random_tensors("param")
+        grads = random_tensors("grad")
+        moments = random_tensors("moment")
+        lr = 0.01
+        epsilon = 1e-6
+        self.inputs = {
+            'Param': params,
+            'Grad': grads,
+            'Moment': moments,
+            'LearningRate': np.array([lr]).astype("float32")
+        }
+        self.attrs = {'optimizer_type': 'adagrad', 'epsilon': epsilon}
+
+        param_outs = []
+        moment_outs = []
+        for (_, p), (_, g), (_, m) in zip(params, grads, moments):
+            m_out = m + g * g
+            moment_outs.append(m_out)
+            param_outs.append(p - lr * g / (np.sqrt(m_out) + epsilon))
+        self.outputs = {
+            'ParamOut': out_tensors("param_out", param_outs),
+            'MomentOut': out_tensors("moment_out", moment_outs)
+        }
+
+    def test_check_output(self):
+        self.check_output()
+
+
+class TestFusedDenseOptimizerAdam(OpTest):
+    def setUp(self):
+        self.op_type = "fused_dense_optimizer"
+        params = random_tensors("param")
+        grads = random_tensors("grad")
+        moment1s = random_tensors("moment1")
+        moment2s = random_tensors("moment2")
+        beta1 = 0.9
+        beta2 = 0.999
+        epsilon = 1e-8
+        lr = 0.004
+        beta1_pows = [("beta1_pow" + str(i), np.array([beta1**(i + 3)])
+                       .astype("float32")) for i in range(len(SHAPES))]
+        beta2_pows = [("beta2_pow" + str(i), np.array([beta2**(i + 3)])
+                       .astype("float32")) for i in range(len(SHAPES))]
+        self.inputs = {
+            'Param': params,
+            'Grad': grads,
+            'Moment1': moment1s,
+            'Moment2': moment2s,
+            'Beta1Pow': beta1_pows,
+            'Beta2Pow': beta2_pows,
+            'LearningRate': np.array([lr]).astype("float32")
+        }
+        self.attrs = {
+            'optimizer_type': 'adam',
+            'beta1': beta1,
+            'beta2': beta2,
+            'epsilon': epsilon
+        }
+
+        outs = {
+            'ParamOut': [],
+            'Moment1Out': [],
+            'Moment2Out': [],
+            'Beta1PowOut': [],
+            'Beta2PowOut': []
+        }
+        for i in range(len(SHAPES)):
+            p, g = params[i][1], grads[i][1]
+            m1, m2 = moment1s[i][1], moment2s[i][1]
+            b1p, b2p = beta1_pows[i][1][0], beta2_pows[i][1][0]
+            m1_out = beta1 * m1 + (1 - beta1) * g
+            m2_out = beta2 * m2 + (1 - beta2) * np.square(g)
+            lr_t = lr * np.sqrt(1 - b2p) / (1 - b1p)
+            p_out = p - lr_t * (m1_out /
+                                (np.sqrt(m2_out) + epsilon * np.sqrt(1 - b2p)))
+            outs['ParamOut'].append(p_out)
+            outs['Moment1Out'].append(m1_out)
+            outs['Moment2Out'].append(m2_out)
+            outs['Beta1PowOut'].append(np.array([b1p * beta1]))
+            outs['Beta2PowOut'].append(np.array([b2p * beta2]))
+        self.outputs = {
+            name: out_tensors(name.lower(), values)
+            for name, values in outs.items()
+        }
+
+    def test_check_output(self):
+        self.check_output(atol=1e-5)
+
+
+if __name__ == "__main__":
+    unittest.main()